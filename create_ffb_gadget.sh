@@ -23,10 +23,31 @@ echo 0 > functions/hid.usb0/protocol
 echo 0 > functions/hid.usb0/subclass
 echo 64 > functions/hid.usb0/report_length
 
+# Gamepad report rate; pass the same value to ffb_app -r. High-speed interrupt endpoints
+# poll every 2^(bInterval-1) microframes of 125 us: 8000 Hz = 1, 4000 = 2, 2000 = 3, 1000 = 4.
+HID_REPORT_RATE_HZ=${HID_REPORT_RATE_HZ:-1000}
+case $HID_REPORT_RATE_HZ in
+    8000) HID_BINTERVAL=1 ;;
+    4000) HID_BINTERVAL=2 ;;
+    2000) HID_BINTERVAL=3 ;;
+    *)    HID_BINTERVAL=4 ;;
+esac
+# Only newer kernels expose the endpoint interval for f_hid
+if [ -e functions/hid.usb0/interval ]; then
+    echo $HID_BINTERVAL > functions/hid.usb0/interval
+else
+    echo "Note: kernel f_hid has no interval attribute, using the driver's default polling rate"
+fi
+
 # Fixed FFB HID descriptor for racing wheel with proper report structure
+# Input report 1: X (wheel), Y/Z/Rz (pedals/shifter slaves, centered when absent), 16 buttons
+# Output reports (byte fields, layouts in ffb_pid_parser.c):
+#   3 Set Effect, 4 Set Envelope, 5 Set Condition, 6 Set Periodic, 7 Set Constant Force,
+#   8 Set Ramp Force, 9 Effect Operation, 10 Block Free, 11 Device Control, 12 Device Gain
 echo -ne "\
 \x05\x01\x09\x04\xa1\x01\
 \x85\x01\x09\x38\x16\x00\x80\x26\xff\x7f\x75\x10\x95\x01\x81\x02\
+\x09\x31\x09\x32\x09\x35\x16\x00\x80\x26\xff\x7f\x75\x10\x95\x03\x81\x02\
 \x05\x09\x19\x01\x29\x10\x15\x00\x25\x01\x75\x01\x95\x10\x81\x02\
 \x05\x0f\xa1\x02\x85\x02\x09\x21\x75\x08\x95\x01\x15\x00\x26\xff\x00\x81\x02\
 \x09\x22\x75\x08\x95\x01\x15\x00\x26\xff\x00\x81\x02\xc0\
@@ -43,64 +64,30 @@ echo -ne "\
 \x09\x43\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x44\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x45\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x46\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x47\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x48\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x49\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x4a\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x4b\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x46\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xa1\x02\x85\x05\x09\x50\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x51\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x52\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x53\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x54\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x55\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x56\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x57\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x58\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x54\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xa1\x02\x85\x06\x09\x60\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x61\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x62\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x63\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x64\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x65\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x66\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x65\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xa1\x02\x85\x07\x09\x70\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x71\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x72\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x73\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x74\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x75\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x76\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x77\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x78\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x79\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7a\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7b\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7c\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7d\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7e\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x7f\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x72\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xa1\x02\x85\x08\x09\x80\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x81\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x82\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x83\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x84\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x85\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x86\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x87\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x88\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x89\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x82\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xa1\x02\x85\x09\x09\x90\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
 \x09\x91\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x92\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x93\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x94\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x95\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x96\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x97\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x98\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\
-\x09\x99\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\x09\x92\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\xa1\x02\x85\x0a\x09\xa0\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\xa1\x02\x85\x0b\x09\xb0\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
+\xa1\x02\x85\x0c\x09\xc0\x75\x08\x95\x01\x15\x00\x26\xff\x00\x91\x02\xc0\
 \xc0" > functions/hid.usb0/report_desc
 
 ln -s functions/hid.usb0 configs/c.1/
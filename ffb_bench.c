@@ -0,0 +1,273 @@
+// ffb_bench.c - Benchmark suite for the effect engine and the PID parser, with JSON output
+//
+// Three measurements, all on the host CPU without hardware:
+//   calculate_torque  ffb_calculator_calculate_torque() per effect type (single-effect path)
+//   engine_update     ffb_calculator_update() with 1 to FFB_MAX_EFFECTS effects playing, timed
+//                     per call at a simulated 1 kHz; "active" must equal "effects"
+//   pid_parser        ffb_pid_parser_parse() per report type of the "effects" workload
+// Results go to stdout (or -o) as one JSON object, so runs can be compared across builds.
+//
+// Usage: ffb_bench [-i iterations] [-m cpu_mhz] [-o results.json]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "ffb_calculator.h"
+#include "ffb_pid_parser.h"
+#include "ffb_workload.h"
+#include "rt_clock.h"
+#include "rt_histogram.h"
+
+#define BENCH_DEFAULT_ITERATIONS    100000
+#define BENCH_DEFAULT_CPU_MHZ       1500    // Raspberry Pi 4 (Cortex-A72) default clock
+#define BENCH_WARMUP_UPDATES        1000
+#define BENCH_PARSER_DURATION_MS    100     // Streamed constant force reports in the parser run
+
+// Matches main.c: condition centers and dead bands are normalized to full steering lock
+#define BENCH_POSITION_RANGE        (65536.0f / 360.0f * 900.0f)
+
+static const int effect_counts[] = { 1, 2, 4, 8, 16, 24, 32, FFB_MAX_EFFECTS };
+#define EFFECT_COUNT_STEPS (int)(sizeof(effect_counts) / sizeof(effect_counts[0]))
+
+static const char *const report_names[] = {
+    [FFB_PID_REPORT_SET_EFFECT] = "set_effect",           [FFB_PID_REPORT_SET_ENVELOPE] = "set_envelope",
+    [FFB_PID_REPORT_SET_CONDITION] = "set_condition",     [FFB_PID_REPORT_SET_PERIODIC] = "set_periodic",
+    [FFB_PID_REPORT_SET_CONSTANT] = "set_constant",       [FFB_PID_REPORT_SET_RAMP] = "set_ramp",
+    [FFB_PID_REPORT_EFFECT_OPERATION] = "effect_operation", [FFB_PID_REPORT_BLOCK_FREE] = "block_free",
+    [FFB_PID_REPORT_DEVICE_CONTROL] = "device_control",   [FFB_PID_REPORT_DEVICE_GAIN] = "device_gain",
+};
+#define REPORT_ID_COUNT (int)(sizeof(report_names) / sizeof(report_names[0]))
+
+static uint64_t simulated_ns = 0;
+static ffb_motor_effect_t blocks[FFB_MAX_EFFECTS];
+static rt_histogram_t update_histogram; // Not registered: summarized per effect count
+static unsigned long emitted = 0;
+
+// Keeps results alive so the compiler cannot drop the loops
+static volatile float sink;
+
+static uint64_t bench_clock_ns(void) {
+    return simulated_ns;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void emit_to_engine(const ffb_motor_effect_t *effect, void *user_data) {
+    (void)user_data;
+    ffb_calculator_process_effect(effect);
+}
+
+static void emit_to_blocks(const ffb_motor_effect_t *effect, void *user_data) {
+    (void)user_data;
+    if (effect->effect_block_index >= 1 && effect->effect_block_index <= FFB_MAX_EFFECTS) {
+        blocks[effect->effect_block_index - 1] = *effect;
+    }
+}
+
+static void emit_count(const ffb_motor_effect_t *effect, void *user_data) {
+    (void)effect;
+    (void)user_data;
+    emitted++;
+}
+
+static void parse_all(const ffb_capture_report_t *reports, size_t count, ffb_pid_emit_t emit) {
+    for (size_t i = 0; i < count; i++) {
+        ffb_pid_parser_parse(reports[i].data, reports[i].length, emit, NULL);
+    }
+}
+
+// Fresh engine on the simulated clock, as ffb_replay sets it up
+static void reset_engine(void) {
+    simulated_ns = 0;
+    ffb_calculator_init();
+    ffb_calculator_set_clock(bench_clock_ns);
+    ffb_calculator_set_input_range(BENCH_POSITION_RANGE, 0.0f);
+    ffb_pid_parser_init();
+}
+
+static int bench_calculate_torque(FILE *out, int iterations, double cpu_mhz) {
+    const int types = 9; // One block of every type "effects" creates
+    ffb_capture_report_t *reports;
+    size_t count;
+    if (ffb_workload_build("effects", types, 0, &reports, &count) != 0) return -1;
+    reset_engine();
+    parse_all(reports, count, emit_to_blocks);
+    free(reports);
+
+    fprintf(out, "  \"calculate_torque\": [");
+    for (int block = 1; block <= types; block++) {
+        float acc = 0.0f;
+        double start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            acc += ffb_calculator_calculate_torque(&blocks[block - 1], (float)(i & 1023) - 512.0f, (float)(i & 63) - 32.0f);
+        }
+        double ns = (now_ns() - start) / iterations;
+        sink = acc;
+        fprintf(out, "%s\n    {\"effect\": \"%s\", \"ns_per_call\": %.2f, \"cycles_per_call\": %.1f}",
+                block > 1 ? "," : "", ffb_workload_effect_name(block), ns, ns * cpu_mhz / 1000.0);
+    }
+    fprintf(out, "\n  ],\n");
+    return 0;
+}
+
+static int bench_engine_update(FILE *out, int iterations) {
+    int failed = 0;
+
+    fprintf(out, "  \"engine_update\": [");
+    for (int step = 0; step < EFFECT_COUNT_STEPS; step++) {
+        int effects = effect_counts[step];
+        ffb_capture_report_t *reports;
+        size_t count;
+        if (ffb_workload_build("effects", effects, 0, &reports, &count) != 0) return -1;
+        reset_engine();
+        parse_all(reports, count, emit_to_engine);
+        free(reports);
+
+        // One call per simulated millisecond, the wheel swinging +-45 degrees
+        memset(&update_histogram, 0, sizeof(update_histogram));
+        for (int i = -BENCH_WARMUP_UPDATES; i < iterations; i++) {
+            float position = (float)((i & 4095) - 2048) * 4.0f;
+            float velocity = (float)((i & 255) - 128);
+            simulated_ns += 1000000ULL;
+            uint64_t start = rt_clock_now_ns();
+            ffb_calculator_update(position, velocity, 0.0f);
+            uint64_t elapsed = rt_clock_now_ns() - start;
+            if (i >= 0) rt_histogram_record(&update_histogram, elapsed);
+        }
+        sink = ffb_calculator_get_torque();
+
+        rt_histogram_snapshot_t snapshot;
+        rt_histogram_summary_t summary;
+        rt_histogram_snapshot(&update_histogram, &snapshot);
+        rt_histogram_summarize(&snapshot, &summary);
+        summary.name = "ffb_calculator_update";
+        summary.unit = "ns";
+        int active = __builtin_popcountll(ffb_calculator_get_active_mask());
+        if (active != effects) {
+            fprintf(stderr, "FFB_Bench: %d of %d effects playing\n", active, effects);
+            failed = 1;
+        }
+        fprintf(out, "%s\n    {\"effects\": %d, \"active\": %d, \"timing\": ", step ? "," : "", effects, active);
+        rt_histogram_write_json_summary(out, &summary);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ],\n");
+    return failed ? -1 : 0;
+}
+
+static int bench_pid_parser(FILE *out, int iterations) {
+    ffb_capture_report_t *reports;
+    size_t count;
+    if (ffb_workload_build("effects", FFB_MAX_EFFECTS, BENCH_PARSER_DURATION_MS, &reports, &count) != 0) return -1;
+
+    fprintf(out, "  \"pid_parser\": [");
+    int first = 1;
+    for (int id = 0; id < REPORT_ID_COUNT; id++) {
+        if (!report_names[id]) continue;
+
+        // The workload's reports of this ID, parsed round-robin
+        size_t selected = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (reports[i].data[0] == id) selected++;
+        }
+        if (selected == 0) continue;
+        const ffb_capture_report_t **of_id = malloc(selected * sizeof(*of_id));
+        if (!of_id) break;
+        selected = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (reports[i].data[0] == id) of_id[selected++] = &reports[i];
+        }
+
+        ffb_pid_parser_init();
+        emitted = 0;
+        double start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            const ffb_capture_report_t *r = of_id[(size_t)i % selected];
+            ffb_pid_parser_parse(r->data, r->length, emit_count, NULL);
+        }
+        double ns = (now_ns() - start) / iterations;
+        free(of_id);
+
+        fprintf(out, "%s\n    {\"report_id\": %d, \"report\": \"%s\", \"ns_per_report\": %.2f, \"operations\": %lu}",
+                first ? "" : ",", id, report_names[id], ns, emitted);
+        first = 0;
+    }
+    fprintf(out, "\n  ]\n");
+    free(reports);
+    return 0;
+}
+
+static void write_header(FILE *out, int iterations, double cpu_mhz) {
+    struct utsname host;
+    char when[32];
+    time_t now = time(NULL);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    if (uname(&host) != 0) strcpy(host.machine, "unknown");
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const char *kernel = "neon";
+#else
+    const char *kernel = "scalar";
+#endif
+    fprintf(out, "{\n  \"suite\": \"ffb_bench\",\n  \"time\": \"%s\",\n  \"machine\": \"%s\",\n", when, host.machine);
+    fprintf(out, "  \"build\": {\"fixed_point\": %d, \"condition_kernel\": \"%s\", \"compiler\": \"%s\"},\n",
+            FFB_FIXED_POINT, kernel, __VERSION__);
+    fprintf(out, "  \"iterations\": %d,\n  \"cpu_mhz\": %.0f,\n", iterations, cpu_mhz);
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [-i iterations] [-m cpu_mhz] [-o results.json]\n", prog);
+    printf("  -i iterations  Calls per measurement (default: %d)\n", BENCH_DEFAULT_ITERATIONS);
+    printf("  -m cpu_mhz     CPU clock used to convert time to cycles (default: %d)\n", BENCH_DEFAULT_CPU_MHZ);
+    printf("  -o file        Write the JSON results to a file instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    double cpu_mhz = BENCH_DEFAULT_CPU_MHZ;
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:m:o:h")) != -1) {
+        switch (opt) {
+            case 'i': iterations = atoi(optarg); break;
+            case 'm': cpu_mhz = atof(optarg); break;
+            case 'o': out_path = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (iterations <= 0 || cpu_mhz <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The modules print progress to stdout: send that to stderr so stdout carries only JSON
+    FILE *out = out_path ? fopen(out_path, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (!out || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        perror("FFB_Bench: failed to create the results file");
+        return 1;
+    }
+
+    int status = 0;
+    write_header(out, iterations, cpu_mhz);
+    if (bench_calculate_torque(out, iterations, cpu_mhz) != 0) status = 1;
+    if (bench_engine_update(out, iterations) != 0) status = 1;
+    if (bench_pid_parser(out, iterations) != 0) status = 1;
+    fprintf(out, "}\n");
+
+    if (fclose(out) != 0) {
+        perror("FFB_Bench: failed to write the results file");
+        status = 1;
+    }
+    if (out_path) fprintf(stderr, "FFB_Bench: results written to %s%s\n", out_path, status ? " (with failures)" : "");
+    return status;
+}
@@ -1,42 +1,558 @@
 // ffb_calculator.c
 #include "ffb_calculator.h"
+#include "ffb_oscillator.h"
+#include "ffb_condition.h"
+#include "ffb_fixed.h"
+#include "ffb_profile.h"
+#include "rt_arena.h"
 #include <stdio.h> // For printf (for debugging)
-#include <math.h>  // For fmax, fmin, sin, cos
+#include <math.h>  // For fmax, fmin
 #include <stdint.h>
-#include <sys/time.h> // For gettimeofday
+#include <string.h>
 #include <time.h>
 
-// Define pi value 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+// Effect block table, struct-of-arrays so the per-cycle pass touches only what it needs.
+// Slot i holds PID effect block index i + 1. Bit i of the masks refers to slot i.
+typedef struct {
+    uint64_t allocated_mask;                 // Block holds a defined effect
+    uint64_t active_mask;                    // Effect is playing
+    uint64_t condition_mask;                 // Block is a spring/damper/inertia/friction effect
+    uint8_t  type[FFB_MAX_EFFECTS];          // ffb_effect_type_t
+    float    gain[FFB_MAX_EFFECTS];          // Per-effect gain
+    float    magnitude[FFB_MAX_EFFECTS];     // Constant/periodic magnitude, ramp start
+    float    ramp_end[FFB_MAX_EFFECTS];      // Ramp end magnitude
+    float    coefficient[FFB_MAX_EFFECTS];   // Condition effect strength
+    float    center[FFB_MAX_EFFECTS];        // Condition center point
+    float    dead_band[FFB_MAX_EFFECTS];     // Condition dead band
+    float    saturation[FFB_MAX_EFFECTS];    // Condition force limit (0 = unlimited)
+    float    offset[FFB_MAX_EFFECTS];        // Periodic offset
+    ffb_oscillator_t oscillator[FFB_MAX_EFFECTS]; // Periodic waveform generator
+    float    attack_level[FFB_MAX_EFFECTS];  // Envelope level at start
+    float    fade_level[FFB_MAX_EFFECTS];    // Envelope level at end
+    uint32_t attack_ms[FFB_MAX_EFFECTS];     // Envelope attack time (0 = no attack)
+    uint32_t fade_ms[FFB_MAX_EFFECTS];       // Envelope fade time (0 = no fade)
+    uint32_t duration_ms[FFB_MAX_EFFECTS];   // One playback, 0 = infinite
+    uint32_t start_delay_ms[FFB_MAX_EFFECTS];
+    uint32_t play_ms[FFB_MAX_EFFECTS];       // Total play time for this start, 0 = infinite
+    uint32_t start_ms[FFB_MAX_EFFECTS];      // Time playback begins (start + delay)
+} ffb_effect_table_t;
+
+// In the arena (rt_arena.h), allocated by the first ffb_calculator_init()
+static ffb_effect_table_t *effect_table = NULL;
+
+// Condition kernels: integer with FFB_FIXED_POINT (ffb_fixed.h), float otherwise. Both take
+// the same float parameters when packing.
+#if FFB_FIXED_POINT
+typedef ffb_condition_fixed_batch_t condition_batch_t;
+#define CONDITION_BATCH_CLEAR   ffb_condition_fixed_batch_clear
+#define CONDITION_GROUP_ADD     ffb_condition_fixed_group_add
+#define CONDITION_BATCH_FINISH  ffb_condition_fixed_batch_finish
+#else
+typedef ffb_condition_batch_t condition_batch_t;
+#define CONDITION_BATCH_CLEAR   ffb_condition_batch_clear
+#define CONDITION_GROUP_ADD     ffb_condition_group_add
+#define CONDITION_BATCH_FINISH  ffb_condition_batch_finish
 #endif
 
-// Internal state for time-based effects
-static struct timeval start_time;
+// Active condition effects repacked by type for the batch kernel. Only rebuilt when the
+// set of playing conditions or their parameters change.
+static condition_batch_t *condition_batch = NULL;
+static uint64_t condition_packed_mask = 0;
+static int condition_params_dirty = 0;
+
+// Device state (PID Device Control / Device Gain)
+static float device_gain = 1.0f;
+static int actuators_enabled = 1;
+static int effects_paused = 0;
+
+// Input units per normalized condition center/dead band (-1.0 to 1.0)
+static float position_full_scale = 1.0f;
+static float velocity_full_scale = 1.0f;
+static float calculated_torque = 0.0f;
+static ffb_q16_t calculated_torque_q16 = 0;
+
+// Integer path: device gain times global gain, and the torque limit, both Q15.16
+static ffb_q16_t output_gain_q16 = FFB_Q16_ONE;
+static ffb_q16_t max_torque_q16 = 0;
+
+// Gains and torque limit of the active tuning profile
+static ffb_profile_t tuning = FFB_PROFILE_DEFAULT;
+
+// Internal state for time-based effects (monotonic, unaffected by wall clock adjustments)
+static uint64_t start_time_ns;
+static uint64_t last_update_ns;
 static int time_initialized = 0;
+static ffb_calculator_clock_t clock_source = NULL; // NULL = CLOCK_MONOTONIC
+
+// Helper function to get current time in nanoseconds since the first call
+static uint64_t get_current_time_ns() {
+    uint64_t now_ns;
+    if (clock_source) {
+        now_ns = clock_source();
+    } else {
+        struct timespec current_time;
+        clock_gettime(CLOCK_MONOTONIC, &current_time);
+        now_ns = (uint64_t)current_time.tv_sec * 1000000000ULL + (uint64_t)current_time.tv_nsec;
+    }
 
-// Helper function to get current time in milliseconds
-static uint32_t get_current_time_ms() {
-    struct timeval current_time;
-    gettimeofday(&current_time, NULL);
-    
     if (!time_initialized) {
-        start_time = current_time;
+        start_time_ns = now_ns;
+        last_update_ns = 0;
         time_initialized = 1;
         return 0;
     }
-    
-    return (uint32_t)((current_time.tv_sec - start_time.tv_sec) * 1000 + 
-                      (current_time.tv_usec - start_time.tv_usec) / 1000);
+
+    return now_ns - start_time_ns;
+}
+
+// Helper function to get current time in milliseconds
+static uint32_t get_current_time_ms() {
+    return (uint32_t)(get_current_time_ns() / 1000000ULL);
+}
+
+// Friction: constant resistance opposing the direction of motion
+static float friction_torque(float strength, float velocity) {
+    float friction_force = strength * tuning.friction_gain * FFB_FRICTION_SCALE;
+    if (velocity > FFB_FRICTION_VELOCITY_THRESHOLD) {
+        return -friction_force;
+    } else if (velocity < -FFB_FRICTION_VELOCITY_THRESHOLD) {
+        return friction_force;
+    }
+    return 0.0f; // No friction when stationary
+}
+
+static float clamp_torque(float torque) {
+    return fmaxf(-tuning.max_torque, fminf(tuning.max_torque, torque));
+}
+
+// Refresh the integer copies of the gains after device_gain or tuning changed
+static void update_output_scale(void) {
+    output_gain_q16 = ffb_q16_from_float(device_gain * tuning.global_gain);
+    max_torque_q16 = ffb_q16_from_float(tuning.max_torque);
 }
 
 /**
  * @brief Initializes the FFB calculator.
  */
 void ffb_calculator_init() {
-    printf("FFB_Calculator: Initialized.\n");
+    printf("FFB_Calculator: Initialized (%d effect blocks).\n", FFB_MAX_EFFECTS);
+    time_initialized = 0;
+    if (!effect_table) {
+        effect_table = rt_arena_alloc(sizeof(*effect_table), "effect table");
+        condition_batch = rt_arena_alloc(sizeof(*condition_batch), "condition batch");
+    }
+    memset(effect_table, 0, sizeof(*effect_table));
+    CONDITION_BATCH_CLEAR(condition_batch);
+    condition_packed_mask = 0;
+    condition_params_dirty = 0;
+    device_gain = 1.0f;
+    actuators_enabled = 1;
+    effects_paused = 0;
+    ffb_oscillator_init_table();
+    calculated_torque = 0.0f;
+    calculated_torque_q16 = 0;
+    tuning = (ffb_profile_t)FFB_PROFILE_DEFAULT;
+    update_output_scale();
+}
+
+/**
+ * @brief Switches to the gains and torque limit of a tuning profile.
+ */
+void ffb_calculator_set_profile(const ffb_profile_t *profile) {
+    tuning = *profile;
+    condition_params_dirty = 1; // Condition gains are folded into the packed coefficients
+    update_output_scale();
+}
+
+/**
+ * @brief Publishes the active tuning profile with new condition effect gains.
+ */
+void ffb_calculator_set_gains(float spring_gain, float damper_gain, float inertia_gain) {
+    ffb_profile_t profile;
+    ffb_profile_get_current(&profile);
+    profile.spring_gain = spring_gain;
+    profile.damper_gain = damper_gain;
+    profile.inertia_gain = inertia_gain;
+    ffb_profile_publish(&profile);
+}
+
+// Rebuild the condition batch from the playing condition effects
+static void pack_condition_batch(uint64_t mask) {
+    uint64_t packed = mask;
+    CONDITION_BATCH_CLEAR(condition_batch);
+
+    while (mask) {
+        int slot = __builtin_ctzll(mask);
+        mask &= mask - 1;
+
+        float gain = effect_table->gain[slot];
+        float coefficient = effect_table->coefficient[slot] * gain;
+        float saturation = effect_table->saturation[slot] * tuning.max_torque * gain;
+        // Springs react to position, the other conditions to velocity (inertia to acceleration,
+        // with center and dead band in velocity units per second)
+        float input_scale = (effect_table->type[slot] == FFB_EFFECT_SPRING) ? position_full_scale : velocity_full_scale;
+        float center = effect_table->center[slot] * input_scale;
+        float dead_band = effect_table->dead_band[slot] * input_scale;
+
+        switch (effect_table->type[slot]) {
+            case FFB_EFFECT_SPRING:
+                CONDITION_GROUP_ADD(&condition_batch->spring, coefficient * tuning.spring_gain * FFB_SPRING_SCALE,
+                                    center, dead_band, saturation);
+                break;
+            case FFB_EFFECT_DAMPER:
+                CONDITION_GROUP_ADD(&condition_batch->damper, coefficient * tuning.damper_gain * FFB_DAMPER_SCALE,
+                                    center, dead_band, saturation);
+                break;
+            case FFB_EFFECT_INERTIA:
+                CONDITION_GROUP_ADD(&condition_batch->inertia, coefficient * tuning.inertia_gain * FFB_INERTIA_SCALE,
+                                    center, dead_band, saturation);
+                break;
+            case FFB_EFFECT_FRICTION:
+                // The stationary threshold acts as a minimum dead band around the center velocity
+                CONDITION_GROUP_ADD(&condition_batch->friction, coefficient * tuning.friction_gain * FFB_FRICTION_SCALE, center,
+                                    fmaxf(dead_band, FFB_FRICTION_VELOCITY_THRESHOLD), saturation);
+                break;
+            default:
+                break;
+        }
+    }
+
+    CONDITION_BATCH_FINISH(condition_batch);
+    condition_packed_mask = packed;
+    condition_params_dirty = 0;
+}
+
+// Copy an effect's parameters into its slot of the table (only on updates, never per cycle)
+static void store_effect_parameters(int slot, const ffb_motor_effect_t *effect) {
+    float coefficient;
+    int is_condition = 1;
+    uint64_t bit = 1ULL << slot;
+
+    switch (effect->type) {
+        case FFB_EFFECT_SPRING:   coefficient = effect->spring_coefficient; break;
+        case FFB_EFFECT_DAMPER:   coefficient = effect->damper_coefficient; break;
+        case FFB_EFFECT_INERTIA:  coefficient = effect->inertia_coefficient; break;
+        case FFB_EFFECT_FRICTION: coefficient = effect->friction_coefficient; break;
+        default:                  coefficient = 0.0f; is_condition = 0; break;
+    }
+
+    effect_table->type[slot] = (uint8_t)effect->type;
+    effect_table->gain[slot] = effect->gain;
+    effect_table->magnitude[slot] = effect->magnitude;
+    effect_table->ramp_end[slot] = effect->ramp_end;
+    // Use the coefficient if available, otherwise the magnitude
+    effect_table->coefficient[slot] = (coefficient > 0) ? coefficient : effect->magnitude;
+    effect_table->center[slot] = effect->center_position;
+    effect_table->dead_band[slot] = effect->dead_band;
+    effect_table->saturation[slot] = effect->saturation;
+    effect_table->offset[slot] = effect->offset;
+    // Keeps the accumulator running so a playing effect stays phase-continuous
+    ffb_oscillator_set(&effect_table->oscillator[slot], effect->waveform,
+                       (effect->period_ms > 0) ? 1000.0f / effect->period_ms : 0.0f, effect->phase);
+    effect_table->attack_level[slot] = effect->attack_level;
+    effect_table->fade_level[slot] = effect->fade_level;
+    effect_table->attack_ms[slot] = (effect->attack_time_ms > 0) ? (uint32_t)effect->attack_time_ms : 0;
+    effect_table->fade_ms[slot] = (effect->fade_time_ms > 0) ? (uint32_t)effect->fade_time_ms : 0;
+    effect_table->duration_ms[slot] = (effect->duration_ms > 0) ? (uint32_t)effect->duration_ms : effect->duration;
+    effect_table->start_delay_ms[slot] = effect->start_delay;
+    effect_table->allocated_mask |= bit;
+
+    if (is_condition) {
+        effect_table->condition_mask |= bit;
+    } else {
+        effect_table->condition_mask &= ~bit;
+    }
+    if (condition_packed_mask & bit) {
+        condition_params_dirty = 1; // Parameters of a playing condition changed
+    }
+}
+
+// Device-level operations; returns 1 if the operation was one
+static int process_device_operation(const ffb_motor_effect_t *effect) {
+    switch (effect->operation) {
+        case FFB_EFFECT_OP_STOP_ALL:
+            effect_table->active_mask = 0;
+            return 1;
+        case FFB_EFFECT_OP_FREE_ALL:
+            effect_table->active_mask = 0;
+            effect_table->allocated_mask = 0;
+            effect_table->condition_mask = 0;
+            effects_paused = 0;
+            device_gain = 1.0f;
+            update_output_scale();
+            return 1;
+        case FFB_EFFECT_OP_ENABLE_ACTUATORS:
+            actuators_enabled = 1;
+            return 1;
+        case FFB_EFFECT_OP_DISABLE_ACTUATORS:
+            actuators_enabled = 0;
+            return 1;
+        case FFB_EFFECT_OP_PAUSE:
+            effects_paused = 1;
+            return 1;
+        case FFB_EFFECT_OP_CONTINUE:
+            effects_paused = 0;
+            return 1;
+        case FFB_EFFECT_OP_DEVICE_GAIN:
+            device_gain = fmaxf(0.0f, fminf(1.0f, effect->magnitude));
+            update_output_scale();
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Envelope level relative to the effect magnitude at the given point of a playback
+static float envelope_scale(int slot, float magnitude, uint32_t elapsed_ms, uint32_t duration_ms) {
+    float level = fabsf(magnitude);
+    if (level <= 0.0f) return 1.0f;
+
+    uint32_t attack_ms = effect_table->attack_ms[slot];
+    uint32_t fade_ms = effect_table->fade_ms[slot];
+    if (attack_ms > 0 && elapsed_ms < attack_ms) {
+        float attack_level = effect_table->attack_level[slot];
+        return (attack_level + (level - attack_level) * elapsed_ms / attack_ms) / level;
+    }
+    if (fade_ms > 0 && duration_ms > 0 && elapsed_ms + fade_ms > duration_ms) {
+        uint32_t fade_elapsed = elapsed_ms - (duration_ms > fade_ms ? duration_ms - fade_ms : 0);
+        float fade_level = effect_table->fade_level[slot];
+        return (level + (fade_level - level) * fade_elapsed / fade_ms) / level;
+    }
+    return 1.0f;
+}
+
+/**
+ * @brief Applies an effect block operation (update/start/stop/free) to the effect table.
+ */
+void ffb_calculator_process_effect(const ffb_motor_effect_t *effect) {
+    if (effect == NULL) return;
+
+    if (process_device_operation(effect)) {
+        return;
+    }
+
+    if (effect->effect_block_index < 1 || effect->effect_block_index > FFB_MAX_EFFECTS) {
+        return; // Not addressed to a valid effect block
+    }
+
+    int slot = effect->effect_block_index - 1;
+    uint64_t bit = 1ULL << slot;
+
+    switch (effect->operation) {
+        case FFB_EFFECT_OP_UPDATE:
+            store_effect_parameters(slot, effect);
+            break;
+        case FFB_EFFECT_OP_START_SOLO:
+            effect_table->active_mask = 0;
+            // Fall through
+        case FFB_EFFECT_OP_START:
+            if (effect_table->allocated_mask & bit) {
+                uint8_t loops = effect->loop_count ? effect->loop_count : 1;
+                uint32_t duration_ms = effect_table->duration_ms[slot];
+                effect_table->play_ms[slot] = (loops == FFB_LOOP_INFINITE) ? 0 : duration_ms * loops;
+                effect_table->start_ms[slot] = get_current_time_ms() + effect_table->start_delay_ms[slot];
+                ffb_oscillator_reset(&effect_table->oscillator[slot]);
+                effect_table->active_mask |= bit;
+            }
+            break;
+        case FFB_EFFECT_OP_STOP:
+            effect_table->active_mask &= ~bit;
+            break;
+        case FFB_EFFECT_OP_FREE:
+            effect_table->active_mask &= ~bit;
+            effect_table->allocated_mask &= ~bit;
+            effect_table->condition_mask &= ~bit;
+            break;
+        default:
+            break;
+    }
+}
+
+// One pass over the table: sums the effects that only depend on time (constant, periodic,
+// ramp), stops expired ones and repacks the condition batch if the playing set changed.
+// Returns 0 while paused or disabled: effects keep their state but produce no force.
+static int update_timed_effects(float *torque_out, uint64_t *playing_conditions_out) {
+    uint64_t now_ns = get_current_time_ns();
+    uint64_t dt_ns = now_ns - last_update_ns;
+    last_update_ns = now_ns;
+    uint32_t current_time = (uint32_t)(now_ns / 1000000ULL);
+    uint64_t pending = effect_table->active_mask;
+    uint64_t playing = 0;
+    float total_torque = 0.0f;
+
+    if (effects_paused || !actuators_enabled) {
+        return 0;
+    }
+
+    while (pending) {
+        int slot = __builtin_ctzll(pending);
+        pending &= pending - 1;
+
+        int32_t since_start_ms = (int32_t)(current_time - effect_table->start_ms[slot]);
+        if (since_start_ms < 0) {
+            continue; // Still in its start delay
+        }
+        uint32_t elapsed_ms = (uint32_t)since_start_ms;
+        uint32_t play_ms = effect_table->play_ms[slot];
+        if (play_ms > 0 && elapsed_ms >= play_ms) {
+            effect_table->active_mask &= ~(1ULL << slot); // Effect finished playing
+            continue;
+        }
+        playing |= 1ULL << slot;
+
+        // Position within the current loop of the effect
+        uint32_t duration_ms = effect_table->duration_ms[slot];
+        if (duration_ms > 0) {
+            elapsed_ms %= duration_ms;
+        }
+
+        // Condition effects are summed by the batch kernel below
+        float gain = effect_table->gain[slot];
+        float magnitude = effect_table->magnitude[slot];
+        switch (effect_table->type[slot]) {
+            case FFB_EFFECT_CONSTANT_FORCE:
+                total_torque += magnitude * envelope_scale(slot, magnitude, elapsed_ms, duration_ms) *
+                                gain * tuning.constant_gain * FFB_CONSTANT_SCALE;
+                break;
+            case FFB_EFFECT_PERIODIC: {
+                ffb_oscillator_t *osc = &effect_table->oscillator[slot];
+                ffb_oscillator_advance(osc, dt_ns);
+                float wave_value = ffb_oscillator_value(osc);
+                float envelope = envelope_scale(slot, magnitude, elapsed_ms, duration_ms);
+                total_torque += (wave_value * magnitude * envelope + effect_table->offset[slot]) *
+                                gain * tuning.periodic_gain * FFB_PERIODIC_SCALE;
+                break;
+            }
+            case FFB_EFFECT_RAMP: {
+                float progress = (duration_ms > 0) ? (float)elapsed_ms / duration_ms : 0.0f;
+                total_torque += (magnitude + (effect_table->ramp_end[slot] - magnitude) * progress) *
+                                gain * tuning.ramp_gain * FFB_RAMP_SCALE;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    uint64_t playing_conditions = playing & effect_table->condition_mask;
+    if (condition_params_dirty || playing_conditions != condition_packed_mask) {
+        pack_condition_batch(playing_conditions);
+    }
+    *torque_out = total_torque;
+    *playing_conditions_out = playing_conditions;
+    return 1;
+}
+
+/**
+ * @brief Sums all active effects for the current wheel state in one pass over the table.
+ */
+void ffb_calculator_update(float position, float velocity, float acceleration) {
+#if FFB_FIXED_POINT
+    ffb_calculator_update_fixed(ffb_fixed_from_float(position, FFB_FIXED_POSITION_SHIFT),
+                                ffb_fixed_from_float(velocity, FFB_FIXED_VELOCITY_SHIFT),
+                                ffb_fixed_from_float(acceleration, FFB_FIXED_ACCELERATION_SHIFT));
+#else
+    float total_torque;
+    uint64_t playing_conditions;
+    if (!update_timed_effects(&total_torque, &playing_conditions)) {
+        calculated_torque = 0.0f;
+        return;
+    }
+    if (playing_conditions) {
+        total_torque += ffb_condition_batch_eval(condition_batch, position, velocity, acceleration);
+    }
+    calculated_torque = clamp_torque(total_torque * device_gain * tuning.global_gain);
+#endif
+}
+
+/**
+ * @brief Integer variant of ffb_calculator_update() with the wheel state in drive units.
+ */
+void ffb_calculator_update_fixed(int32_t position, int32_t velocity, int32_t acceleration) {
+#if FFB_FIXED_POINT
+    // Timed effects enter the sum once per update; everything that depends on the wheel state
+    // and everything after the sum is integer
+    float timed_torque;
+    uint64_t playing_conditions;
+    if (!update_timed_effects(&timed_torque, &playing_conditions)) {
+        calculated_torque = 0.0f;
+        calculated_torque_q16 = 0;
+        return;
+    }
+    ffb_q16_t total = ffb_q16_from_float(timed_torque);
+    if (playing_conditions) {
+        total = ffb_sat_add_s32(total, ffb_condition_fixed_batch_eval(condition_batch, position, velocity, acceleration));
+    }
+    total = ffb_q16_mul(total, output_gain_q16);
+    if (total > max_torque_q16) total = max_torque_q16;
+    if (total < -max_torque_q16) total = -max_torque_q16;
+    calculated_torque_q16 = total;
+    calculated_torque = ffb_q16_to_float(total);
+#else
+    ffb_calculator_update(ffb_fixed_to_float(position, FFB_FIXED_POSITION_SHIFT),
+                          ffb_fixed_to_float(velocity, FFB_FIXED_VELOCITY_SHIFT),
+                          ffb_fixed_to_float(acceleration, FFB_FIXED_ACCELERATION_SHIFT));
+#endif
+}
+
+/**
+ * @brief Returns the torque computed by the last ffb_calculator_update().
+ */
+float ffb_calculator_get_torque(void) {
+    return calculated_torque;
+}
+
+/**
+ * @brief Returns the last torque in Q15.16.
+ */
+ffb_q16_t ffb_calculator_get_torque_q16(void) {
+#if FFB_FIXED_POINT
+    return calculated_torque_q16;
+#else
+    return ffb_q16_from_float(calculated_torque);
+#endif
+}
+
+/**
+ * @brief Returns the last torque as a torque command.
+ */
+ffb_torque_t ffb_calculator_get_torque_command(void) {
+#if FFB_FIXED_POINT
+    return calculated_torque_q16;
+#else
+    return calculated_torque;
+#endif
+}
+
+/**
+ * @brief Sets the input range that normalized condition center/dead band values map to.
+ */
+void ffb_calculator_set_input_range(float position_range, float velocity_range) {
+    if (position_range > 0) position_full_scale = position_range;
+    if (velocity_range > 0) velocity_full_scale = velocity_range;
+    condition_params_dirty = 1;
+}
+
+/**
+ * @brief Replaces the time source of effect durations, envelopes and oscillators.
+ */
+void ffb_calculator_set_clock(ffb_calculator_clock_t now_ns) {
+    clock_source = now_ns;
     time_initialized = 0;
-    // Any setup for internal state variables can go here
+}
+
+/**
+ * @brief Returns a bit mask of the playing effect blocks (bit i = block i + 1).
+ */
+uint64_t ffb_calculator_get_active_mask(void) {
+    return effect_table->active_mask;
+}
+
+/**
+ * @brief Returns a bit mask of the defined condition effects (bit i = block i + 1).
+ */
+uint64_t ffb_calculator_get_condition_mask(void) {
+    return effect_table->condition_mask;
 }
 
 /**
@@ -51,111 +567,72 @@ float ffb_calculator_calculate_torque(const ffb_motor_effect_t *effect, float cu
 
     if (effect != NULL) {
         uint32_t current_time = get_current_time_ms();
-        
+
         switch (effect->type) {
             case FFB_EFFECT_CONSTANT_FORCE:
                 // Apply a constant force based on magnitude
-                // Scale factor (e.g., 1000) converts normalized magnitude to motor units
-                desired_torque = effect->magnitude * 1000.0f;
+                desired_torque = effect->magnitude * FFB_CONSTANT_SCALE;
                 break;
-                
+
             case FFB_EFFECT_SPRING:
                 // Spring effect: Torque proportional to displacement from a center point.
                 // Use spring coefficient if available, otherwise use magnitude
                 float center_position = 0.0f; // Assuming center is 0
                 float spring_strength = (effect->spring_coefficient > 0) ? effect->spring_coefficient : effect->magnitude;
-                float spring_gain = 0.8f * spring_strength;
-                desired_torque = -(current_position - center_position) * spring_gain * 500.0f;
+                float spring_gain = tuning.spring_gain * spring_strength;
+                desired_torque = -(current_position - center_position) * spring_gain * FFB_SPRING_SCALE;
                 break;
-                
+
             case FFB_EFFECT_DAMPER:
                 // Damper effect: Torque proportional to velocity, opposing motion.
                 float damper_strength = (effect->damper_coefficient > 0) ? effect->damper_coefficient : effect->magnitude;
-                float damper_gain = 1.0f * damper_strength;
-                desired_torque = -current_velocity * damper_gain * 200.0f;
+                float damper_gain = tuning.damper_gain * damper_strength;
+                desired_torque = -current_velocity * damper_gain * FFB_DAMPER_SCALE;
                 break;
-                
+
             case FFB_EFFECT_INERTIA:
                 // Inertia effect: Resistance to acceleration (simplified as velocity-based)
                 float inertia_strength = (effect->inertia_coefficient > 0) ? effect->inertia_coefficient : effect->magnitude;
-                float inertia_gain = 0.5f * inertia_strength;
-                desired_torque = -current_velocity * inertia_gain * 300.0f;
+                float inertia_gain = tuning.inertia_gain * inertia_strength;
+                desired_torque = -current_velocity * inertia_gain * FFB_INERTIA_VELOCITY_SCALE;
                 break;
-                
+
             case FFB_EFFECT_FRICTION:
                 // Friction effect: Constant resistance to motion
                 float friction_strength = (effect->friction_coefficient > 0) ? effect->friction_coefficient : effect->magnitude;
-                float friction_force = friction_strength * 400.0f;
-                
-                // Apply friction opposite to motion direction
-                if (current_velocity > 0.01f) {
-                    desired_torque = -friction_force;
-                } else if (current_velocity < -0.01f) {
-                    desired_torque = friction_force;
-                } else {
-                    desired_torque = 0.0f; // No friction when stationary
-                }
+                desired_torque = friction_torque(friction_strength, current_velocity);
                 break;
-                
+
             case FFB_EFFECT_PERIODIC:
                 // Periodic effect: Sine wave, square wave, etc.
-                // Unpack parameters from the stored fields
-                uint8_t waveform = (uint8_t)effect->start_delay;
-                uint8_t frequency = (uint8_t)(effect->timestamp >> 16);
-                uint8_t phase = (uint8_t)(effect->timestamp >> 8);
-                uint8_t offset = (uint8_t)effect->timestamp;
-                
-                float time_sec = current_time / 1000.0f;
-                float angular_freq = 2.0f * M_PI * frequency;
-                float phase_rad = phase * M_PI / 128.0f; // Convert to radians
-                float offset_norm = (offset - 128) / 128.0f; // Normalize offset
-                
-                float wave_value = 0.0f;
-                switch (waveform) {
-                    case 0: // Square wave
-                        wave_value = (sinf(angular_freq * time_sec + phase_rad) >= 0) ? 1.0f : -1.0f;
-                        break;
-                    case 1: // Sine wave
-                        wave_value = sinf(angular_freq * time_sec + phase_rad);
-                        break;
-                    case 2: // Triangle wave
-                        {
-                            float t = fmodf(angular_freq * time_sec + phase_rad, 2.0f * M_PI) / (2.0f * M_PI);
-                            wave_value = (t < 0.5f) ? (4.0f * t - 1.0f) : (3.0f - 4.0f * t);
-                        }
-                        break;
-                    case 3: // Sawtooth up
-                        wave_value = 2.0f * fmodf(angular_freq * time_sec + phase_rad, 2.0f * M_PI) / (2.0f * M_PI) - 1.0f;
-                        break;
-                    case 4: // Sawtooth down
-                        wave_value = 1.0f - 2.0f * fmodf(angular_freq * time_sec + phase_rad, 2.0f * M_PI) / (2.0f * M_PI);
-                        break;
-                    default:
-                        wave_value = sinf(angular_freq * time_sec + phase_rad); // Default to sine
-                        break;
-                }
-                
-                desired_torque = (wave_value * effect->magnitude + offset_norm) * 800.0f;
+                // Stateless path: evaluate the oscillator at the absolute time
+                ffb_oscillator_t osc = {0};
+                float frequency = (effect->period_ms > 0) ? 1000.0f / effect->period_ms : 0.0f;
+                ffb_oscillator_set(&osc, effect->waveform, frequency, effect->phase);
+                ffb_oscillator_advance(&osc, get_current_time_ns());
+
+                float wave_value = ffb_oscillator_value(&osc);
+                desired_torque = (wave_value * effect->magnitude + effect->offset) * FFB_PERIODIC_SCALE;
                 break;
-                
+
             case FFB_EFFECT_RAMP:
                 // Ramp effect: Linear interpolation between start and end magnitude
                 if (effect->duration > 0) {
                     float start_magnitude = effect->magnitude;
-                    float end_magnitude = effect->direction; // Reused field
+                    float end_magnitude = effect->ramp_end;
                     float elapsed_time = current_time - effect->timestamp;
                     float progress = elapsed_time / effect->duration;
-                    
+
                     if (progress < 0.0f) progress = 0.0f;
                     if (progress > 1.0f) progress = 1.0f;
-                    
+
                     float current_magnitude = start_magnitude + (end_magnitude - start_magnitude) * progress;
-                    desired_torque = current_magnitude * 1000.0f;
+                    desired_torque = current_magnitude * FFB_RAMP_SCALE;
                 } else {
-                    desired_torque = effect->magnitude * 1000.0f;
+                    desired_torque = effect->magnitude * FFB_RAMP_SCALE;
                 }
                 break;
-                
+
             default:
                 // Unknown effect type, apply no force
                 desired_torque = 0.0f;
@@ -164,10 +641,5 @@ float ffb_calculator_calculate_torque(const ffb_motor_effect_t *effect, float cu
         }
     }
 
-    // Clamp torque to motor limits
-    float max_torque_output = 5000.0f; // Example max motor command units
-    float min_torque_output = -5000.0f; // Example min motor command units
-    desired_torque = fmaxf(min_torque_output, fminf(max_torque_output, desired_torque));
-
-    return desired_torque;
-}
\ No newline at end of file
+    return clamp_torque(desired_torque);
+}
@@ -2,18 +2,38 @@
 #define FFB_CALCULATOR_H
 
 #include "ffb_types.h"
+#include "ffb_profile.h"
+#include "ffb_fixed.h"
 
-// FFB calculator function prototypes
+// Scale factors converting normalized effect strength to motor units. The gains on top of
+// them and the torque limit come from the active tuning profile (ffb_profile.h).
+#define FFB_CONSTANT_SCALE   1000.0f
+#define FFB_SPRING_SCALE     500.0f
+#define FFB_DAMPER_SCALE     200.0f
+#define FFB_INERTIA_SCALE    3.0f     // Per velocity unit per second (inertia reacts to acceleration)
+#define FFB_INERTIA_VELOCITY_SCALE 300.0f // Single-effect path, which only has velocity
+#define FFB_FRICTION_SCALE   400.0f
+#define FFB_FRICTION_VELOCITY_THRESHOLD 0.01f
+#define FFB_PERIODIC_SCALE   800.0f
+#define FFB_RAMP_SCALE       1000.0f
+
+/**
+ * @brief Initializes the FFB calculator with the built-in tuning (FFB_PROFILE_DEFAULT).
+ */
 void ffb_calculator_init(void);
-void ffb_calculator_update(float position, float velocity, float acceleration);
-void ffb_calculator_process_effect(const ffb_motor_effect_t *effect);
-float ffb_calculator_get_torque(void);
-void ffb_calculator_set_gains(float spring_gain, float damper_gain, float inertia_gain);
 
 /**
- * @brief Initializes the FFB calculator.
+ * @brief Switches to the gains and torque limit of a tuning profile. Engine thread only,
+ *        normally with the profile from ffb_profile_acquire(); takes effect in the next update.
+ * @param profile Profile to copy.
+ */
+void ffb_calculator_set_profile(const ffb_profile_t *profile);
+
+/**
+ * @brief Changes the spring, damper and inertia gains of the active tuning profile by
+ *        publishing a copy of it (ffb_profile_publish()). Safe from any thread.
  */
-void ffb_calculator_init();
+void ffb_calculator_set_gains(float spring_gain, float damper_gain, float inertia_gain);
 
 /**
  * @brief Calculates the desired torque based on the FFB effect and current wheel position.
@@ -24,4 +44,75 @@ void ffb_calculator_init();
  */
 float ffb_calculator_calculate_torque(const ffb_motor_effect_t *effect, float current_position, float current_velocity);
 
+/**
+ * @brief Applies an effect block operation to the effect table.
+ * @param effect Effect addressed by effect_block_index; its operation selects update/start/stop/free.
+ *               FFB_EFFECT_OP_STOP_ALL ignores the block index. The struct is only read during the call.
+ */
+void ffb_calculator_process_effect(const ffb_motor_effect_t *effect);
+
+/**
+ * @brief Sums all playing effects for the current wheel state; result via ffb_calculator_get_torque().
+ *        Expired effects (duration elapsed) are stopped. Does not allocate or copy effect structs.
+ * @param position Current wheel position.
+ * @param velocity Current wheel velocity.
+ * @param acceleration Current wheel acceleration (velocity units per second), drives inertia.
+ */
+void ffb_calculator_update(float position, float velocity, float acceleration);
+
+/**
+ * @brief ffb_calculator_update() with the wheel state in drive units. Built with
+ *        FFB_FIXED_POINT, conditions, gains and the limit are integer (ffb_fixed.h) and
+ *        ffb_calculator_update() converts to this; otherwise this converts to floats.
+ * @param position Wheel position in encoder counts, FFB_FIXED_POSITION_SHIFT fraction bits
+ *                 (ffb_fixed_from_int()).
+ * @param velocity Velocity in rpm with FFB_FIXED_VELOCITY_SHIFT fraction bits.
+ * @param acceleration rpm per second with FFB_FIXED_ACCELERATION_SHIFT fraction bits.
+ */
+void ffb_calculator_update_fixed(int32_t position, int32_t velocity, int32_t acceleration);
+
+/**
+ * @brief Returns the clamped total torque computed by the last ffb_calculator_update().
+ */
+float ffb_calculator_get_torque(void);
+
+/**
+ * @brief Returns the same torque in Q15.16 (exact in FFB_FIXED_POINT builds).
+ */
+ffb_q16_t ffb_calculator_get_torque_q16(void);
+
+/**
+ * @brief Returns the same torque as a torque command (ffb_torque_t): the Q15.16 sum without
+ *        a detour through float in FFB_FIXED_POINT builds.
+ */
+ffb_torque_t ffb_calculator_get_torque_command(void);
+
+/**
+ * @brief Sets the input values that a normalized condition center/dead band of 1.0 maps to.
+ * @param position_range Position units (as passed to ffb_calculator_update) for 1.0; springs.
+ * @param velocity_range Velocity units for 1.0; damper, inertia and friction. Values <= 0 are ignored.
+ */
+void ffb_calculator_set_input_range(float position_range, float velocity_range);
+
+/**
+ * @brief Returns a bit mask of the playing effect blocks (bit i = effect block i + 1).
+ */
+uint64_t ffb_calculator_get_active_mask(void);
+
+/**
+ * @brief Returns a bit mask of the defined condition effects (spring, damper, inertia,
+ *        friction), same bit layout. The game sets these once; all other effects it keeps feeding.
+ */
+uint64_t ffb_calculator_get_condition_mask(void);
+
+// Time source in nanoseconds; must never go backwards
+typedef uint64_t (*ffb_calculator_clock_t)(void);
+
+/**
+ * @brief Replaces the time source of effect durations, envelopes and oscillators.
+ *        Lets the replay harness run on simulated time. Call before effects are started.
+ * @param now_ns Clock function, or NULL for CLOCK_MONOTONIC (the default).
+ */
+void ffb_calculator_set_clock(ffb_calculator_clock_t now_ns);
+
 #endif // FFB_CALCULATOR_H
\ No newline at end of file
@@ -0,0 +1,169 @@
+// ffb_capture.c - Text capture of HID output reports (see ffb_capture.h for the format)
+#include "ffb_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static FILE *capture_file = NULL;
+static uint64_t capture_start_us = 0;
+static int capture_started = 0;
+static unsigned long capture_count = 0;
+
+static uint64_t get_monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Starts recording the HID output reports passed to ffb_capture_write().
+ */
+int ffb_capture_start(const char *filename) {
+    capture_file = fopen(filename, "w");
+    if (!capture_file) {
+        perror("FFB_Capture: failed to create capture file");
+        return -1;
+    }
+    fprintf(capture_file, "# ffb_app HID output report capture: <time_us> <report bytes in hex>\n");
+    capture_started = 0;
+    capture_count = 0;
+    printf("FFB_Capture: recording HID output reports to %s\n", filename);
+    return 0;
+}
+
+/**
+ * @brief Appends one report to the capture.
+ */
+void ffb_capture_write(const uint8_t *report, size_t length) {
+    if (!capture_file) return;
+
+    uint64_t now_us = get_monotonic_us();
+    if (!capture_started) {
+        capture_start_us = now_us;
+        capture_started = 1;
+    }
+    if (length > FFB_CAPTURE_MAX_REPORT) length = FFB_CAPTURE_MAX_REPORT;
+
+    fprintf(capture_file, "%llu", (unsigned long long)(now_us - capture_start_us));
+    for (size_t i = 0; i < length; i++) {
+        fprintf(capture_file, " %02x", report[i]);
+    }
+    fputc('\n', capture_file);
+    capture_count++;
+}
+
+/**
+ * @brief Writes reports to a capture file that ffb_capture_load() reads back.
+ */
+int ffb_capture_save(const char *filename, const ffb_capture_report_t *reports, size_t count) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        perror("FFB_Capture: failed to create capture file");
+        return -1;
+    }
+    fprintf(f, "# HID output report script: <time_us> <report bytes in hex>\n");
+    for (size_t n = 0; n < count; n++) {
+        fprintf(f, "%llu", (unsigned long long)reports[n].time_us);
+        for (size_t i = 0; i < reports[n].length; i++) {
+            fprintf(f, " %02x", reports[n].data[i]);
+        }
+        fputc('\n', f);
+    }
+    if (fclose(f) != 0) {
+        perror("FFB_Capture: failed to write capture file");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Flushes and closes the capture file.
+ */
+void ffb_capture_stop(void) {
+    if (!capture_file) return;
+    fclose(capture_file);
+    capture_file = NULL;
+    printf("FFB_Capture: %lu reports recorded\n", capture_count);
+}
+
+// Stable insertion sort: reports with the same timestamp keep their file order, and
+// recorded captures are already sorted so this is a single pass
+static void sort_by_time(ffb_capture_report_t *reports, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        if (reports[i].time_us >= reports[i - 1].time_us) continue;
+        ffb_capture_report_t moved = reports[i];
+        size_t j = i;
+        while (j > 0 && reports[j - 1].time_us > moved.time_us) {
+            reports[j] = reports[j - 1];
+            j--;
+        }
+        reports[j] = moved;
+    }
+}
+
+/**
+ * @brief Loads a capture file.
+ */
+int ffb_capture_load(const char *filename, ffb_capture_report_t **reports_out, size_t *count_out) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror("FFB_Capture: failed to open capture file");
+        return -1;
+    }
+
+    size_t capacity = 1024, count = 0;
+    ffb_capture_report_t *reports = malloc(capacity * sizeof(*reports));
+    char line[512];
+    int line_number = 0;
+
+    while (reports && fgets(line, sizeof(line), f)) {
+        line_number++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        if (count == capacity) {
+            capacity *= 2;
+            ffb_capture_report_t *grown = realloc(reports, capacity * sizeof(*reports));
+            if (!grown) {
+                free(reports);
+                reports = NULL;
+                break;
+            }
+            reports = grown;
+        }
+
+        ffb_capture_report_t *r = &reports[count];
+        char *end;
+        r->time_us = strtoull(p, &end, 10);
+        if (end == p) {
+            fprintf(stderr, "FFB_Capture: %s:%d: missing timestamp\n", filename, line_number);
+            continue;
+        }
+        r->length = 0;
+        for (p = end;;) {
+            unsigned long value = strtoul(p, &end, 16);
+            if (end == p) break;
+            if (value > 0xFF || r->length == FFB_CAPTURE_MAX_REPORT) {
+                fprintf(stderr, "FFB_Capture: %s:%d: bad report bytes\n", filename, line_number);
+                r->length = 0;
+                break;
+            }
+            r->data[r->length++] = (uint8_t)value;
+            p = end;
+        }
+        if (r->length > 0) count++;
+    }
+    fclose(f);
+
+    if (!reports) {
+        fprintf(stderr, "FFB_Capture: out of memory loading %s\n", filename);
+        return -1;
+    }
+    // Hand-written scenarios need not be in order
+    sort_by_time(reports, count);
+    *reports_out = reports;
+    *count_out = count;
+    return 0;
+}
@@ -0,0 +1,50 @@
+// ffb_capture.h - Recording and loading of HID output report streams for offline replay
+#ifndef FFB_CAPTURE_H
+#define FFB_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Text format, one report per line: "<time_us> <byte> <byte> ..." with bytes in hex and
+// time relative to the first report. Lines starting with '#' are comments.
+#define FFB_CAPTURE_MAX_REPORT 64
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t length;
+    uint8_t data[FFB_CAPTURE_MAX_REPORT];
+} ffb_capture_report_t;
+
+/**
+ * @brief Starts recording the HID output reports passed to ffb_capture_write().
+ * @return 0 on success, -1 if the file cannot be created.
+ */
+int ffb_capture_start(const char *filename);
+
+/**
+ * @brief Appends one report to the capture. Does nothing when no capture is running.
+ *        Called from the HID reception thread only.
+ */
+void ffb_capture_write(const uint8_t *report, size_t length);
+
+/**
+ * @brief Flushes and closes the capture file.
+ */
+void ffb_capture_stop(void);
+
+/**
+ * @brief Writes reports to a capture file that ffb_capture_load() reads back, e.g. a
+ *        generated workload (ffb_workload.h).
+ * @return 0 on success, -1 on error (reported on stderr).
+ */
+int ffb_capture_save(const char *filename, const ffb_capture_report_t *reports, size_t count);
+
+/**
+ * @brief Loads a capture file.
+ * @param reports_out Receives a malloc'ed array sorted by time; free() it when done.
+ * @param count_out Number of reports.
+ * @return 0 on success, -1 on error (reported on stderr).
+ */
+int ffb_capture_load(const char *filename, ffb_capture_report_t **reports_out, size_t *count_out);
+
+#endif // FFB_CAPTURE_H
@@ -0,0 +1,311 @@
+// ffb_condition.c - Batched evaluation of condition effects (spring/damper/inertia/friction)
+#include "ffb_condition.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FFB_CONDITION_USE_NEON 1
+#endif
+
+/**
+ * @brief Empties all groups of the batch.
+ */
+void ffb_condition_batch_clear(ffb_condition_batch_t *batch) {
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * @brief Appends one condition to a group.
+ */
+int ffb_condition_group_add(ffb_condition_group_t *group, float coefficient, float center,
+                            float dead_band, float saturation) {
+    if (group->count >= FFB_CONDITION_CAPACITY) return -1;
+
+    int i = group->count++;
+    group->coefficient[i] = coefficient;
+    group->center[i] = center;
+    group->dead_band[i] = fabsf(dead_band);
+    group->saturation[i] = (saturation > 0) ? saturation : FLT_MAX;
+    return 0;
+}
+
+// Padding lanes: zero coefficient and zero saturation yield exactly 0 torque
+static void pad_group(ffb_condition_group_t *group) {
+    while (group->count % FFB_CONDITION_LANES) {
+        int i = group->count++;
+        group->coefficient[i] = 0.0f;
+        group->center[i] = 0.0f;
+        group->dead_band[i] = 0.0f;
+        group->saturation[i] = 0.0f;
+    }
+}
+
+/**
+ * @brief Pads the groups to whole vectors. Call after the last add.
+ */
+void ffb_condition_batch_finish(ffb_condition_batch_t *batch) {
+    pad_group(&batch->spring);
+    pad_group(&batch->damper);
+    pad_group(&batch->inertia);
+    pad_group(&batch->friction);
+}
+
+// The lane sums below are written out for 4 lanes (one NEON q register)
+_Static_assert(FFB_CONDITION_LANES == 4, "scalar kernels assume 4 lanes");
+
+// Branchless helpers; ternaries compile to min/max instructions (fminf/fmaxf carry NaN rules)
+static inline float min_f(float a, float b) { return (a < b) ? a : b; }
+static inline float max_f(float a, float b) { return (a > b) ? a : b; }
+
+// The scalar kernels keep one accumulator per lane, mirroring the vector layout, which
+// also lets the compiler auto-vectorize them on x86 development builds.
+float ffb_condition_eval_linear_scalar(const ffb_condition_group_t *group, float input) {
+    float total[FFB_CONDITION_LANES] = {0};
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        for (int lane = 0; lane < FFB_CONDITION_LANES; lane++) {
+            int j = i + lane;
+            float offset = input - group->center[j];
+            float outside = max_f(fabsf(offset) - group->dead_band[j], 0.0f);
+            float force = -group->coefficient[j] * copysignf(outside, offset);
+            float limit = group->saturation[j];
+            total[lane] += min_f(max_f(force, -limit), limit);
+        }
+    }
+    return (total[0] + total[1]) + (total[2] + total[3]);
+}
+
+float ffb_condition_eval_friction_scalar(const ffb_condition_group_t *group, float velocity) {
+    float total[FFB_CONDITION_LANES] = {0};
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        for (int lane = 0; lane < FFB_CONDITION_LANES; lane++) {
+            int j = i + lane;
+            float offset = velocity - group->center[j];
+            float force = -group->coefficient[j] * copysignf(1.0f, offset);
+            float limit = group->saturation[j];
+            force = min_f(max_f(force, -limit), limit);
+            total[lane] += (fabsf(offset) > group->dead_band[j]) ? force : 0.0f; // Zero while not moving
+        }
+    }
+    return (total[0] + total[1]) + (total[2] + total[3]);
+}
+
+#ifdef FFB_CONDITION_USE_NEON
+static inline float horizontal_sum(float32x4_t v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+}
+
+static inline float32x4_t copy_sign(float32x4_t magnitude, float32x4_t sign_source) {
+    const uint32x4_t sign_mask = vdupq_n_u32(0x80000000U);
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(sign_source), sign_mask);
+    uint32x4_t bits = vbicq_u32(vreinterpretq_u32_f32(magnitude), sign_mask);
+    return vreinterpretq_f32_u32(vorrq_u32(bits, sign));
+}
+
+float ffb_condition_eval_linear(const ffb_condition_group_t *group, float input) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t x = vdupq_n_f32(input);
+    float32x4_t total = zero;
+
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        float32x4_t coefficient = vld1q_f32(&group->coefficient[i]);
+        float32x4_t limit = vld1q_f32(&group->saturation[i]);
+        float32x4_t offset = vsubq_f32(x, vld1q_f32(&group->center[i]));
+        float32x4_t outside = vmaxq_f32(vsubq_f32(vabsq_f32(offset), vld1q_f32(&group->dead_band[i])), zero);
+        float32x4_t force = vnegq_f32(vmulq_f32(coefficient, copy_sign(outside, offset)));
+        force = vminq_f32(vmaxq_f32(force, vnegq_f32(limit)), limit);
+        total = vaddq_f32(total, force);
+    }
+    return horizontal_sum(total);
+}
+
+float ffb_condition_eval_friction(const ffb_condition_group_t *group, float velocity) {
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t v = vdupq_n_f32(velocity);
+    float32x4_t total = vdupq_n_f32(0.0f);
+
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        float32x4_t coefficient = vld1q_f32(&group->coefficient[i]);
+        float32x4_t limit = vld1q_f32(&group->saturation[i]);
+        float32x4_t offset = vsubq_f32(v, vld1q_f32(&group->center[i]));
+        uint32x4_t moving = vcgtq_f32(vabsq_f32(offset), vld1q_f32(&group->dead_band[i]));
+        float32x4_t force = vnegq_f32(vmulq_f32(coefficient, copy_sign(one, offset)));
+        force = vminq_f32(vmaxq_f32(force, vnegq_f32(limit)), limit);
+        total = vaddq_f32(total, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(force), moving)));
+    }
+    return horizontal_sum(total);
+}
+#else
+float ffb_condition_eval_linear(const ffb_condition_group_t *group, float input) {
+    return ffb_condition_eval_linear_scalar(group, input);
+}
+
+float ffb_condition_eval_friction(const ffb_condition_group_t *group, float velocity) {
+    return ffb_condition_eval_friction_scalar(group, velocity);
+}
+#endif
+
+/**
+ * @brief Sums the torque of all conditions in the batch.
+ */
+float ffb_condition_batch_eval(const ffb_condition_batch_t *batch, float position, float velocity, float acceleration) {
+    float total = 0.0f;
+    if (batch->spring.count)   total += ffb_condition_eval_linear(&batch->spring, position);
+    if (batch->damper.count)   total += ffb_condition_eval_linear(&batch->damper, velocity);
+    if (batch->inertia.count)  total += ffb_condition_eval_linear(&batch->inertia, acceleration);
+    if (batch->friction.count) total += ffb_condition_eval_friction(&batch->friction, velocity);
+    return total;
+}
+
+// --- Integer kernels ---
+
+/**
+ * @brief Empties all groups and sets their input formats.
+ */
+void ffb_condition_fixed_batch_clear(ffb_condition_fixed_batch_t *batch) {
+    memset(batch, 0, sizeof(*batch));
+    batch->spring.input_shift = FFB_FIXED_POSITION_SHIFT;
+    batch->damper.input_shift = FFB_FIXED_VELOCITY_SHIFT;
+    batch->inertia.input_shift = FFB_FIXED_ACCELERATION_SHIFT;
+    batch->friction.input_shift = FFB_FIXED_VELOCITY_SHIFT;
+}
+
+/**
+ * @brief Appends one condition, converted from the float parameters of ffb_condition_group_add().
+ */
+int ffb_condition_fixed_group_add(ffb_condition_fixed_group_t *group, float coefficient, float center,
+                                  float dead_band, float saturation) {
+    if (group->count >= FFB_CONDITION_CAPACITY) return -1;
+
+    int i = group->count++;
+    int32_t q_coefficient = ffb_q16_from_float(coefficient);
+    group->coefficient[i] = (q_coefficient < -INT32_MAX) ? -INT32_MAX : q_coefficient; // Negation must not overflow
+    group->center[i] = ffb_fixed_from_float(center, group->input_shift);
+    group->dead_band[i] = ffb_fixed_from_float(fabsf(dead_band), group->input_shift);
+    group->saturation[i] = (saturation > 0) ? ffb_q16_from_float(saturation) : INT32_MAX;
+    return 0;
+}
+
+static void pad_fixed_group(ffb_condition_fixed_group_t *group) {
+    while (group->count % FFB_CONDITION_LANES) {
+        int i = group->count++;
+        group->coefficient[i] = 0;
+        group->center[i] = 0;
+        group->dead_band[i] = 0;
+        group->saturation[i] = 0;
+    }
+}
+
+/**
+ * @brief Pads the groups to whole vectors. Call after the last add.
+ */
+void ffb_condition_fixed_batch_finish(ffb_condition_fixed_batch_t *batch) {
+    pad_fixed_group(&batch->spring);
+    pad_fixed_group(&batch->damper);
+    pad_fixed_group(&batch->inertia);
+    pad_fixed_group(&batch->friction);
+}
+
+static inline int32_t min_s32(int32_t a, int32_t b) { return (a < b) ? a : b; }
+static inline int32_t max_s32(int32_t a, int32_t b) { return (a > b) ? a : b; }
+
+// Each step mirrors one NEON instruction of the vector kernels below (saturating subtract and
+// absolute value, 32x32->64 multiply, truncating shift, saturating narrow), which is what
+// makes the two agree bit for bit.
+int64_t ffb_condition_fixed_eval_linear_scalar(const ffb_condition_fixed_group_t *group, int32_t input) {
+    int64_t total[FFB_CONDITION_LANES] = {0};
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        for (int lane = 0; lane < FFB_CONDITION_LANES; lane++) {
+            int j = i + lane;
+            int32_t offset = ffb_sat_sub_s32(input, group->center[j]);
+            int32_t outside = max_s32(ffb_sat_abs_s32(offset) - group->dead_band[j], 0);
+            int32_t toward_center = (offset < 0) ? outside : -outside;
+            int32_t force = ffb_sat_s32(((int64_t)group->coefficient[j] * toward_center) >> group->input_shift);
+            int32_t limit = group->saturation[j];
+            total[lane] += min_s32(max_s32(force, -limit), limit);
+        }
+    }
+    return (total[0] + total[1]) + (total[2] + total[3]);
+}
+
+int64_t ffb_condition_fixed_eval_friction_scalar(const ffb_condition_fixed_group_t *group, int32_t velocity) {
+    int64_t total[FFB_CONDITION_LANES] = {0};
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        for (int lane = 0; lane < FFB_CONDITION_LANES; lane++) {
+            int j = i + lane;
+            int32_t offset = ffb_sat_sub_s32(velocity, group->center[j]);
+            int32_t force = (offset < 0) ? group->coefficient[j] : -group->coefficient[j];
+            int32_t limit = group->saturation[j];
+            force = min_s32(max_s32(force, -limit), limit);
+            total[lane] += (ffb_sat_abs_s32(offset) > group->dead_band[j]) ? force : 0; // Zero while not moving
+        }
+    }
+    return (total[0] + total[1]) + (total[2] + total[3]);
+}
+
+#ifdef FFB_CONDITION_USE_NEON
+int64_t ffb_condition_fixed_eval_linear(const ffb_condition_fixed_group_t *group, int32_t input) {
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t x = vdupq_n_s32(input);
+    const int64x2_t shift = vdupq_n_s64(-group->input_shift); // Negative: arithmetic shift right
+    int64x2_t total = vdupq_n_s64(0);
+
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        int32x4_t coefficient = vld1q_s32(&group->coefficient[i]);
+        int32x4_t limit = vld1q_s32(&group->saturation[i]);
+        int32x4_t offset = vqsubq_s32(x, vld1q_s32(&group->center[i]));
+        int32x4_t outside = vmaxq_s32(vsubq_s32(vqabsq_s32(offset), vld1q_s32(&group->dead_band[i])), zero);
+        int32x4_t toward_center = vbslq_s32(vcltq_s32(offset, zero), outside, vnegq_s32(outside));
+        int64x2_t low = vshlq_s64(vmull_s32(vget_low_s32(coefficient), vget_low_s32(toward_center)), shift);
+        int64x2_t high = vshlq_s64(vmull_s32(vget_high_s32(coefficient), vget_high_s32(toward_center)), shift);
+        int32x4_t force = vcombine_s32(vqmovn_s64(low), vqmovn_s64(high));
+        force = vminq_s32(vmaxq_s32(force, vnegq_s32(limit)), limit);
+        total = vpadalq_s32(total, force);
+    }
+    return vgetq_lane_s64(total, 0) + vgetq_lane_s64(total, 1);
+}
+
+int64_t ffb_condition_fixed_eval_friction(const ffb_condition_fixed_group_t *group, int32_t velocity) {
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t v = vdupq_n_s32(velocity);
+    int64x2_t total = vdupq_n_s64(0);
+
+    for (int i = 0; i < group->count; i += FFB_CONDITION_LANES) {
+        int32x4_t coefficient = vld1q_s32(&group->coefficient[i]);
+        int32x4_t limit = vld1q_s32(&group->saturation[i]);
+        int32x4_t offset = vqsubq_s32(v, vld1q_s32(&group->center[i]));
+        uint32x4_t moving = vcgtq_s32(vqabsq_s32(offset), vld1q_s32(&group->dead_band[i]));
+        int32x4_t force = vbslq_s32(vcltq_s32(offset, zero), coefficient, vnegq_s32(coefficient));
+        force = vminq_s32(vmaxq_s32(force, vnegq_s32(limit)), limit);
+        total = vpadalq_s32(total, vandq_s32(force, vreinterpretq_s32_u32(moving)));
+    }
+    return vgetq_lane_s64(total, 0) + vgetq_lane_s64(total, 1);
+}
+#else
+int64_t ffb_condition_fixed_eval_linear(const ffb_condition_fixed_group_t *group, int32_t input) {
+    return ffb_condition_fixed_eval_linear_scalar(group, input);
+}
+
+int64_t ffb_condition_fixed_eval_friction(const ffb_condition_fixed_group_t *group, int32_t velocity) {
+    return ffb_condition_fixed_eval_friction_scalar(group, velocity);
+}
+#endif
+
+/**
+ * @brief Sums the torque of all conditions in the batch, saturated once at the end.
+ */
+ffb_q16_t ffb_condition_fixed_batch_eval(const ffb_condition_fixed_batch_t *batch, int32_t position,
+                                         int32_t velocity, int32_t acceleration) {
+    int64_t total = 0;
+    if (batch->spring.count)   total += ffb_condition_fixed_eval_linear(&batch->spring, position);
+    if (batch->damper.count)   total += ffb_condition_fixed_eval_linear(&batch->damper, velocity);
+    if (batch->inertia.count)  total += ffb_condition_fixed_eval_linear(&batch->inertia, acceleration);
+    if (batch->friction.count) total += ffb_condition_fixed_eval_friction(&batch->friction, velocity);
+    return ffb_sat_s32(total);
+}
@@ -0,0 +1,136 @@
+// ffb_condition.h - Batched evaluation of condition effects (spring/damper/inertia/friction)
+#ifndef FFB_CONDITION_H
+#define FFB_CONDITION_H
+
+#include <stdint.h>
+#include "ffb_types.h"
+#include "ffb_fixed.h"
+
+// Lanes evaluated per vector step; groups are padded to a multiple of this
+#define FFB_CONDITION_LANES 4
+
+// Storage for FFB_MAX_EFFECTS conditions rounded up to whole vectors
+#define FFB_CONDITION_CAPACITY \
+    (((FFB_MAX_EFFECTS) + FFB_CONDITION_LANES - 1) / FFB_CONDITION_LANES * FFB_CONDITION_LANES)
+
+// Conditions of one type in struct-of-arrays form. Padding lanes have coefficient and
+// saturation 0 so they contribute nothing.
+typedef struct {
+    int count;  // Number of used lanes, padded to FFB_CONDITION_LANES
+    float coefficient[FFB_CONDITION_CAPACITY] __attribute__((aligned(16))); // Torque per input unit (gains applied)
+    float center[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));      // Input value with no force
+    float dead_band[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));   // Half-width of the no-force zone
+    float saturation[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));  // Max |torque| of this condition
+} ffb_condition_group_t;
+
+// All active conditions, grouped by the input each type reacts to
+typedef struct {
+    ffb_condition_group_t spring;   // Position
+    ffb_condition_group_t damper;   // Velocity
+    ffb_condition_group_t inertia;  // Acceleration
+    ffb_condition_group_t friction; // Direction of motion
+} ffb_condition_batch_t;
+
+/**
+ * @brief Empties all groups of the batch.
+ */
+void ffb_condition_batch_clear(ffb_condition_batch_t *batch);
+
+/**
+ * @brief Appends one condition to a group.
+ * @param group Group matching the effect type.
+ * @param coefficient Torque per input unit, gains and scale already applied.
+ * @param center Input value where the condition produces no force.
+ * @param dead_band Half-width of the zone around center with no force.
+ * @param saturation Maximum torque magnitude (0 = unlimited).
+ * @return 0 on success, -1 if the group is full.
+ */
+int ffb_condition_group_add(ffb_condition_group_t *group, float coefficient, float center,
+                            float dead_band, float saturation);
+
+/**
+ * @brief Pads the groups to whole vectors. Call after the last add.
+ */
+void ffb_condition_batch_finish(ffb_condition_batch_t *batch);
+
+/**
+ * @brief Sums the torque of all conditions in the batch.
+ * @param batch Packed conditions.
+ * @param position Current wheel position.
+ * @param velocity Current wheel velocity.
+ * @param acceleration Current wheel acceleration (inertia).
+ * @return Total condition torque (unclamped).
+ */
+float ffb_condition_batch_eval(const ffb_condition_batch_t *batch, float position, float velocity, float acceleration);
+
+/**
+ * @brief Spring-style group: -coefficient * (input - center) outside the dead band, saturated.
+ *        Uses NEON when available.
+ */
+float ffb_condition_eval_linear(const ffb_condition_group_t *group, float input);
+
+/**
+ * @brief Friction-style group: -coefficient * sign(velocity) while moving, saturated.
+ *        Uses NEON when available.
+ */
+float ffb_condition_eval_friction(const ffb_condition_group_t *group, float velocity);
+
+// Portable implementations, always built (reference and x86 development path)
+float ffb_condition_eval_linear_scalar(const ffb_condition_group_t *group, float input);
+float ffb_condition_eval_friction_scalar(const ffb_condition_group_t *group, float velocity);
+
+// --- Integer kernels (ffb_fixed.h), used by the calculator when built with FFB_FIXED_POINT ---
+
+// Same layout in integers. Inputs have input_shift fraction bits; torques are Q15.16. Padding lanes have coefficient and saturation 0.
+typedef struct {
+    int count;
+    int input_shift;    // Fraction bits of the input this group reacts to
+    int32_t coefficient[FFB_CONDITION_CAPACITY] __attribute__((aligned(16))); // Q15.16 torque per input unit (friction: Q15.16 torque)
+    int32_t center[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));      // Input format
+    int32_t dead_band[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));   // Input format, >= 0
+    int32_t saturation[FFB_CONDITION_CAPACITY] __attribute__((aligned(16)));  // Q15.16, INT32_MAX = unlimited
+} ffb_condition_fixed_group_t;
+
+typedef struct {
+    ffb_condition_fixed_group_t spring;     // Position, FFB_FIXED_POSITION_SHIFT
+    ffb_condition_fixed_group_t damper;     // Velocity, FFB_FIXED_VELOCITY_SHIFT
+    ffb_condition_fixed_group_t inertia;    // Acceleration, FFB_FIXED_ACCELERATION_SHIFT
+    ffb_condition_fixed_group_t friction;   // Velocity, FFB_FIXED_VELOCITY_SHIFT
+} ffb_condition_fixed_batch_t;
+
+/**
+ * @brief Empties all groups and sets their input formats.
+ */
+void ffb_condition_fixed_batch_clear(ffb_condition_fixed_batch_t *batch);
+
+/**
+ * @brief Appends one condition, converted from the float parameters of
+ *        ffb_condition_group_add() (same units) with rounding and saturation.
+ * @return 0 on success, -1 if the group is full.
+ */
+int ffb_condition_fixed_group_add(ffb_condition_fixed_group_t *group, float coefficient, float center,
+                                  float dead_band, float saturation);
+
+/**
+ * @brief Pads the groups to whole vectors. Call after the last add.
+ */
+void ffb_condition_fixed_batch_finish(ffb_condition_fixed_batch_t *batch);
+
+/**
+ * @brief Sums the torque of all conditions in the batch. Lanes are summed exactly in 64 bits
+ *        and saturated once, so the result is the same bit for bit on every kernel.
+ * @param position Wheel position, FFB_FIXED_POSITION_SHIFT fraction bits.
+ * @param velocity Wheel velocity, FFB_FIXED_VELOCITY_SHIFT fraction bits.
+ * @param acceleration Wheel acceleration, FFB_FIXED_ACCELERATION_SHIFT fraction bits.
+ * @return Total condition torque, Q15.16 (unclamped apart from saturation).
+ */
+ffb_q16_t ffb_condition_fixed_batch_eval(const ffb_condition_fixed_batch_t *batch, int32_t position,
+                                         int32_t velocity, int32_t acceleration);
+
+// Per group, NEON when available; the _scalar versions are always built
+int64_t ffb_condition_fixed_eval_linear(const ffb_condition_fixed_group_t *group, int32_t input);
+int64_t ffb_condition_fixed_eval_friction(const ffb_condition_fixed_group_t *group, int32_t velocity);
+int64_t ffb_condition_fixed_eval_linear_scalar(const ffb_condition_fixed_group_t *group, int32_t input);
+int64_t ffb_condition_fixed_eval_friction_scalar(const ffb_condition_fixed_group_t *group, int32_t velocity);
+
+#endif // FFB_CONDITION_H
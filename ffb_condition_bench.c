@@ -0,0 +1,261 @@
+// ffb_condition_bench.c - Micro-benchmark: per-effect switch vs batched condition kernel
+#include "ffb_calculator.h"
+#include "ffb_condition.h"
+#include "ffb_profile.h"
+#include "ffb_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_ITERATIONS 200000
+#define BENCH_DEFAULT_CPU_MHZ 1500 // Raspberry Pi 4 (Cortex-A72) default clock
+#define BENCH_FIXED_COMPARE_RANGE 8000.0f // Highest torque limit a profile allows
+// Float kernel against the reference: rounding of the summation order, relative to the
+// summed magnitude of the effects
+#define BENCH_FLOAT_TOLERANCE 1e-5f
+
+// The calculator's scales with the gains of the built-in profile
+static const ffb_profile_t default_profile = FFB_PROFILE_DEFAULT;
+#define SPRING_K   (default_profile.spring_gain * FFB_SPRING_SCALE)
+#define DAMPER_K   (default_profile.damper_gain * FFB_DAMPER_SCALE)
+#define INERTIA_K  (default_profile.inertia_gain * FFB_INERTIA_SCALE)
+#define FRICTION_K (default_profile.friction_gain * FFB_FRICTION_SCALE)
+#define FRICTION_THRESHOLD FFB_FRICTION_VELOCITY_THRESHOLD
+
+static ffb_motor_effect_t effects[FFB_MAX_EFFECTS];
+static ffb_condition_batch_t batch;
+static ffb_condition_fixed_batch_t fixed_batch;
+
+// Keeps results alive so the compiler cannot drop the loops
+static volatile float sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Branchy reference: one switch per effect, as the single-effect calculator path does.
+// magnitude_out, if not NULL, receives the sum of the effects' absolute forces.
+static float eval_per_effect(int count, float position, float velocity, float acceleration, float *magnitude_out) {
+    float total = 0.0f, magnitude = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const ffb_motor_effect_t *e = &effects[i];
+        float input, k, force;
+        switch (e->type) {
+            case FFB_EFFECT_SPRING:  input = position; k = e->spring_coefficient * SPRING_K; break;
+            case FFB_EFFECT_DAMPER:  input = velocity; k = e->damper_coefficient * DAMPER_K; break;
+            case FFB_EFFECT_INERTIA: input = acceleration; k = e->inertia_coefficient * INERTIA_K; break;
+            case FFB_EFFECT_FRICTION: {
+                float offset = velocity - e->center_position;
+                float band = fmaxf(e->dead_band, FRICTION_THRESHOLD);
+                force = 0.0f;
+                if (offset > band) force = -e->friction_coefficient * FRICTION_K;
+                else if (offset < -band) force = e->friction_coefficient * FRICTION_K;
+                if (e->saturation > 0) force = fmaxf(-e->saturation, fminf(e->saturation, force));
+                total += force;
+                magnitude += fabsf(force);
+                continue;
+            }
+            default: continue;
+        }
+        float offset = input - e->center_position;
+        if (offset > e->dead_band) force = -k * (offset - e->dead_band);
+        else if (offset < -e->dead_band) force = -k * (offset + e->dead_band);
+        else force = 0.0f;
+        if (e->saturation > 0) force = fmaxf(-e->saturation, fminf(e->saturation, force));
+        total += force;
+        magnitude += fabsf(force);
+    }
+    if (magnitude_out) *magnitude_out = magnitude;
+    return total;
+}
+
+static float eval_batch_scalar(float position, float velocity, float acceleration) {
+    return ffb_condition_eval_linear_scalar(&batch.spring, position) +
+           ffb_condition_eval_linear_scalar(&batch.damper, velocity) +
+           ffb_condition_eval_linear_scalar(&batch.inertia, acceleration) +
+           ffb_condition_eval_friction_scalar(&batch.friction, velocity);
+}
+
+static int64_t eval_fixed_scalar(int32_t position, int32_t velocity, int32_t acceleration) {
+    return ffb_condition_fixed_eval_linear_scalar(&fixed_batch.spring, position) +
+           ffb_condition_fixed_eval_linear_scalar(&fixed_batch.damper, velocity) +
+           ffb_condition_fixed_eval_linear_scalar(&fixed_batch.inertia, acceleration) +
+           ffb_condition_fixed_eval_friction_scalar(&fixed_batch.friction, velocity);
+}
+
+static int64_t eval_fixed_kernel(int32_t position, int32_t velocity, int32_t acceleration) {
+    return ffb_condition_fixed_eval_linear(&fixed_batch.spring, position) +
+           ffb_condition_fixed_eval_linear(&fixed_batch.damper, velocity) +
+           ffb_condition_fixed_eval_linear(&fixed_batch.inertia, acceleration) +
+           ffb_condition_fixed_eval_friction(&fixed_batch.friction, velocity);
+}
+
+// Integer kernels must agree with their scalar reference exactly, also where they saturate
+static int count_fixed_mismatches(void) {
+    static const int32_t extremes[] = { INT32_MIN, INT32_MIN + 1, -65536, -1, 0, 1, 65536, INT32_MAX - 1, INT32_MAX };
+    const int extreme_count = sizeof(extremes) / sizeof(extremes[0]);
+    int mismatches = 0;
+    // The acceleration stream of the float sweep in main()
+    for (int i = 0; i < 1000; i++) {
+        int32_t position = ffb_fixed_from_int((i - 500) * 3, FFB_FIXED_POSITION_SHIFT);
+        int32_t velocity = ffb_fixed_from_float((i % 50 - 25) * 0.7f, FFB_FIXED_VELOCITY_SHIFT);
+        int32_t acceleration = ffb_fixed_from_float((i % 37 - 18) * 40.0f, FFB_FIXED_ACCELERATION_SHIFT);
+        mismatches += eval_fixed_scalar(position, velocity, acceleration) != eval_fixed_kernel(position, velocity, acceleration);
+    }
+    for (int a = 0; a < extreme_count; a++) {
+        for (int b = 0; b < extreme_count; b++) {
+            for (int c = 0; c < extreme_count; c++) {
+                mismatches += eval_fixed_scalar(extremes[a], extremes[b], extremes[c]) !=
+                              eval_fixed_kernel(extremes[a], extremes[b], extremes[c]);
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Same condition in both batches
+static void add_condition(ffb_condition_group_t *group, ffb_condition_fixed_group_t *fixed_group,
+                          float coefficient, float center, float dead_band, float saturation) {
+    ffb_condition_group_add(group, coefficient, center, dead_band, saturation);
+    ffb_condition_fixed_group_add(fixed_group, coefficient, center, dead_band, saturation);
+}
+
+static void build_effects(int count) {
+    srand(1234);
+    ffb_condition_batch_clear(&batch);
+    ffb_condition_fixed_batch_clear(&fixed_batch);
+    for (int i = 0; i < count; i++) {
+        ffb_motor_effect_t *e = &effects[i];
+        memset(e, 0, sizeof(*e));
+        e->type = FFB_EFFECT_SPRING + (i % 4); // Spring, damper, inertia, friction
+        float coefficient = 0.1f + (rand() % 90) / 100.0f;
+        e->center_position = (rand() % 200 - 100) * 1.0f;
+        e->dead_band = (rand() % 20) * 1.0f;
+        e->saturation = (i % 3 == 0) ? 2000.0f : 0.0f;
+        switch (e->type) {
+            case FFB_EFFECT_SPRING:
+                e->spring_coefficient = coefficient;
+                add_condition(&batch.spring, &fixed_batch.spring, coefficient * SPRING_K, e->center_position, e->dead_band, e->saturation);
+                break;
+            case FFB_EFFECT_DAMPER:
+                e->damper_coefficient = coefficient;
+                add_condition(&batch.damper, &fixed_batch.damper, coefficient * DAMPER_K, e->center_position, e->dead_band, e->saturation);
+                break;
+            case FFB_EFFECT_INERTIA:
+                e->inertia_coefficient = coefficient;
+                add_condition(&batch.inertia, &fixed_batch.inertia, coefficient * INERTIA_K, e->center_position, e->dead_band, e->saturation);
+                break;
+            default:
+                e->friction_coefficient = coefficient;
+                add_condition(&batch.friction, &fixed_batch.friction, coefficient * FRICTION_K, e->center_position,
+                              fmaxf(e->dead_band, FRICTION_THRESHOLD), e->saturation);
+                break;
+        }
+    }
+    ffb_condition_batch_finish(&batch);
+    ffb_condition_fixed_batch_finish(&fixed_batch);
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [-n effects] [-i iterations] [-m cpu_mhz]\n", prog);
+    printf("  -n effects     Condition effects to evaluate, 1-%d (default: all sizes 4,8,16,%d)\n",
+           FFB_MAX_EFFECTS, FFB_MAX_EFFECTS);
+    printf("  -i iterations  Evaluations per measurement (default: %d)\n", BENCH_DEFAULT_ITERATIONS);
+    printf("  -m cpu_mhz     CPU clock used to convert time to cycles (default: %d)\n", BENCH_DEFAULT_CPU_MHZ);
+}
+
+int main(int argc, char *argv[]) {
+    int only_count = 0;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    double cpu_mhz = BENCH_DEFAULT_CPU_MHZ;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:i:m:h")) != -1) {
+        switch (opt) {
+            case 'n': only_count = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 'm': cpu_mhz = atof(optarg); break;
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (only_count < 0 || only_count > FFB_MAX_EFFECTS || iterations <= 0 || cpu_mhz <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const int sizes[] = {4, 8, 16, FFB_MAX_EFFECTS};
+    const int size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const char *kernel_name = "NEON";
+#else
+    const char *kernel_name = "scalar fallback";
+#endif
+    printf("Condition kernel benchmark (batch kernel: %s, %d iterations, %.0f MHz)\n",
+           kernel_name, iterations, cpu_mhz);
+    printf("%8s %18s %18s %18s %18s %10s %10s %10s\n", "effects", "switch cyc/eff", "batch-scalar cyc/eff",
+           "batch cyc/eff", "fixed cyc/eff", "max diff", "fixed diff", "fixed bits");
+
+    for (int s = 0; s < size_count; s++) {
+        int count = only_count ? only_count : sizes[s];
+        build_effects(count);
+
+        // Verify the paths agree over a sweep of wheel states. The float kernel must match the
+        // reference up to rounding. The integer batch differs from the float one by
+        // quantization within the torque a drive can be sent (beyond +-32767 it saturates);
+        // its kernels must match each other exactly.
+        float max_diff = 0.0f, fixed_diff = 0.0f;
+        int float_mismatch = 0;
+        for (int i = 0; i < 1000; i++) {
+            float position = (i - 500) * 3.0f, velocity = (i % 50 - 25) * 0.7f, acceleration = (i % 37 - 18) * 40.0f;
+            float magnitude;
+            float ref = eval_per_effect(count, position, velocity, acceleration, &magnitude);
+            float vec = ffb_condition_batch_eval(&batch, position, velocity, acceleration);
+            float scalar = eval_batch_scalar(position, velocity, acceleration);
+            float tolerance = BENCH_FLOAT_TOLERANCE * fmaxf(1.0f, magnitude);
+            if (fabsf(ref - vec) > tolerance || fabsf(ref - scalar) > tolerance) float_mismatch = 1;
+            ffb_q16_t fixed = ffb_condition_fixed_batch_eval(&fixed_batch, ffb_fixed_from_float(position, FFB_FIXED_POSITION_SHIFT),
+                                                             ffb_fixed_from_float(velocity, FFB_FIXED_VELOCITY_SHIFT),
+                                                             ffb_fixed_from_float(acceleration, FFB_FIXED_ACCELERATION_SHIFT));
+            max_diff = fmaxf(max_diff, fabsf(ref - vec));
+            if (fabsf(vec) <= BENCH_FIXED_COMPARE_RANGE) fixed_diff = fmaxf(fixed_diff, fabsf(ffb_q16_to_float(fixed) - vec));
+        }
+        int mismatches = count_fixed_mismatches();
+
+        double results[4];
+        for (int path = 0; path < 4; path++) {
+            float acc = 0.0f;
+            double start = now_ns();
+            for (int i = 0; i < iterations; i++) {
+                float position = (float)(i & 1023) - 512.0f;
+                float velocity = (float)(i & 63) - 32.0f;
+                float acceleration = (float)(i & 511) - 256.0f;
+                if (path == 0) acc += eval_per_effect(count, position, velocity, acceleration, NULL);
+                else if (path == 1) acc += eval_batch_scalar(position, velocity, acceleration);
+                else if (path == 2) acc += ffb_condition_batch_eval(&batch, position, velocity, acceleration);
+                else acc += (float)ffb_condition_fixed_batch_eval(&fixed_batch, ((i & 1023) - 512) * (1 << FFB_FIXED_POSITION_SHIFT),
+                                                                    ((i & 63) - 32) * FFB_Q16_ONE,
+                                                                    ((i & 511) - 256) * (1 << FFB_FIXED_ACCELERATION_SHIFT));
+            }
+            double elapsed = now_ns() - start;
+            sink = acc;
+            results[path] = elapsed / iterations / count * cpu_mhz / 1000.0;
+        }
+
+        printf("%8d %18.2f %18.2f %18.2f %18.2f %10.4f %10.4f %10s%s\n", count, results[0], results[1], results[2],
+               results[3], max_diff, fixed_diff, mismatches ? "MISMATCH" : "exact",
+               float_mismatch ? "  FLOAT MISMATCH" : "");
+        if (mismatches || float_mismatch) failed = 1;
+        if (only_count) break;
+    }
+
+    return failed;
+}
@@ -0,0 +1,127 @@
+// ffb_e2e.c - End-to-end latency probe (see ffb_e2e.h)
+#include "ffb_e2e.h"
+#include "rt_histogram.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+
+typedef enum {
+    E2E_IDLE = 0,
+    E2E_WAIT_WRITE,             // Report stamped, torque command not changed yet
+    E2E_WAIT_ACTUAL             // New command sent, drive not there yet
+} e2e_phase_t;
+
+static rt_histogram_t *hist_report_write = NULL;
+static rt_histogram_t *hist_write_actual = NULL;
+
+// Written by the HID reception thread when 0, cleared by the EtherCAT thread
+static _Atomic uint64_t report_ns = 0;
+
+// EtherCAT thread only
+static e2e_phase_t phase = E2E_IDLE;
+static int16_t last_command = 0;
+static int16_t baseline_command = 0;
+static int16_t step = 0;
+static int16_t latest_actual = 0;
+static int16_t baseline_actual = 0;
+static uint64_t write_ns = 0;
+
+static _Atomic uint32_t probes = 0;
+static _Atomic uint32_t unchanged = 0;
+static _Atomic uint32_t completed = 0;
+static _Atomic uint32_t no_response = 0;
+
+static void finish_probe(void) {
+    phase = E2E_IDLE;
+    atomic_store_explicit(&report_ns, 0, memory_order_release);
+}
+
+/**
+ * @brief Creates the histograms.
+ */
+void ffb_e2e_init(void) {
+    hist_report_write = rt_histogram_create("e2e report to torque", "ns");
+    hist_write_actual = rt_histogram_create("e2e torque to actual", "ns");
+}
+
+/**
+ * @brief Stamps the arrival of an output report unless a probe is running.
+ */
+void ffb_e2e_report_received(void) {
+    if (atomic_load_explicit(&report_ns, memory_order_relaxed) != 0) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t expected = 0;
+    uint64_t stamp = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    if (atomic_compare_exchange_strong_explicit(&report_ns, &expected, stamp, memory_order_release, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&probes, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Passes the wheel's torque command just written to the frame.
+ */
+void ffb_e2e_torque_written(int16_t command, uint64_t now_ns) {
+    if (!hist_report_write) return;
+
+    uint64_t received_ns = atomic_load_explicit(&report_ns, memory_order_acquire);
+    if (phase == E2E_IDLE && received_ns != 0) {
+        phase = E2E_WAIT_WRITE;
+        baseline_command = last_command; // Sent before the report arrived
+    }
+    if (phase == E2E_WAIT_WRITE) {
+        int delta = command - baseline_command;
+        if (abs(delta) >= FFB_E2E_MIN_STEP) {
+            rt_histogram_record(hist_report_write, now_ns > received_ns ? now_ns - received_ns : 0);
+            phase = E2E_WAIT_ACTUAL;
+            step = (int16_t)delta;
+            baseline_actual = latest_actual;
+            write_ns = now_ns;
+        } else if (now_ns > received_ns + FFB_E2E_WRITE_TIMEOUT_NS) {
+            atomic_fetch_add_explicit(&unchanged, 1, memory_order_relaxed);
+            finish_probe();
+        }
+    }
+    last_command = command;
+}
+
+/**
+ * @brief Passes the wheel's torque actual value of the frame just received.
+ */
+void ffb_e2e_torque_actual(int16_t torque_actual, uint64_t sample_ns) {
+    latest_actual = torque_actual;
+    if (phase != E2E_WAIT_ACTUAL) return;
+
+    // Half of the step covered, in the direction of the step
+    int moved = (torque_actual - baseline_actual) * (step > 0 ? 1 : -1);
+    if (2 * moved >= abs(step)) {
+        rt_histogram_record(hist_write_actual, sample_ns > write_ns ? sample_ns - write_ns : 0);
+        atomic_fetch_add_explicit(&completed, 1, memory_order_relaxed);
+        finish_probe();
+    } else if (sample_ns > write_ns + FFB_E2E_ACTUAL_TIMEOUT_NS) {
+        atomic_fetch_add_explicit(&no_response, 1, memory_order_relaxed);
+        finish_probe();
+    }
+}
+
+/**
+ * @brief Returns the probe counters.
+ */
+void ffb_e2e_get_stats(ffb_e2e_stats_t *stats_out) {
+    stats_out->probes = atomic_load(&probes);
+    stats_out->unchanged = atomic_load(&unchanged);
+    stats_out->completed = atomic_load(&completed);
+    stats_out->no_response = atomic_load(&no_response);
+}
+
+/**
+ * @brief Writes the probe counters as a JSON object.
+ */
+void ffb_e2e_write_json(FILE *file) {
+    ffb_e2e_stats_t stats;
+    ffb_e2e_get_stats(&stats);
+    fprintf(file, "{\"probes\": %u, \"unchanged\": %u, \"completed\": %u, \"no_response\": %u, \"min_step_per_mille\": %d}",
+            stats.probes, stats.unchanged, stats.completed, stats.no_response, FFB_E2E_MIN_STEP);
+}
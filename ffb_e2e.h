@@ -0,0 +1,63 @@
+// ffb_e2e.h - End-to-end latency probe: HID report arrival -> PDO torque write -> torque actual
+//
+// One probe at a time. The HID reception thread stamps the arrival of a report when no probe
+// is running. The EtherCAT thread then watches the wheel's torque command: the first frame
+// whose command differs from the one sent before the report by at least FFB_E2E_MIN_STEP
+// ends the first interval, and the first torque actual value that has covered half of that
+// step ends the second. Reports that change no torque (most parameter updates) time out
+// and only free the probe. Both intervals are CLOCK_MONOTONIC, recorded in histograms
+// shown with the other timings (Ctrl+T) and written by ffb_app -B.
+#ifndef FFB_E2E_H
+#define FFB_E2E_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define FFB_E2E_MIN_STEP            20      // Per mille of rated torque
+#define FFB_E2E_WRITE_TIMEOUT_NS    50000000ULL     // A report that changes no torque
+#define FFB_E2E_ACTUAL_TIMEOUT_NS   100000000ULL    // Drive never followed (disabled, limited)
+
+typedef struct {
+    uint32_t probes;            // Reports stamped
+    uint32_t unchanged;         // Reports after which the torque did not change
+    uint32_t completed;         // Probes with both intervals recorded
+    uint32_t no_response;       // Torque written, torque actual never followed
+} ffb_e2e_stats_t;
+
+/**
+ * @brief Creates the histograms. Call before the HID and EtherCAT threads start.
+ */
+void ffb_e2e_init(void);
+
+/**
+ * @brief Stamps the arrival of an output report unless a probe is running. HID reception
+ *        thread; one atomic load when busy, lock-free.
+ */
+void ffb_e2e_report_received(void);
+
+/**
+ * @brief Passes the wheel's torque command just written to the frame. EtherCAT thread, once
+ *        per cycle before the frame is sent.
+ * @param command Target torque in per mille of rated torque.
+ * @param now_ns CLOCK_MONOTONIC time of the write.
+ */
+void ffb_e2e_torque_written(int16_t command, uint64_t now_ns);
+
+/**
+ * @brief Passes the wheel's torque actual value of the frame just received. EtherCAT thread.
+ * @param torque_actual Per mille of rated torque (0x6077).
+ * @param sample_ns CLOCK_MONOTONIC time of the exchange.
+ */
+void ffb_e2e_torque_actual(int16_t torque_actual, uint64_t sample_ns);
+
+/**
+ * @brief Returns the probe counters.
+ */
+void ffb_e2e_get_stats(ffb_e2e_stats_t *stats_out);
+
+/**
+ * @brief Writes the probe counters as a JSON object.
+ */
+void ffb_e2e_write_json(FILE *file);
+
+#endif // FFB_E2E_H
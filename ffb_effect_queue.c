@@ -0,0 +1,167 @@
+// ffb_effect_queue.c - SPSC operation ring with per-effect-block update coalescing
+#include "ffb_effect_queue.h"
+#include "rt_seqlock.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#if (FFB_EFFECT_QUEUE_SIZE & (FFB_EFFECT_QUEUE_SIZE - 1)) != 0
+#error "FFB_EFFECT_QUEUE_SIZE must be a power of two"
+#endif
+
+// Ring entries are small; the parameters of updates live in the per-block mailbox below
+typedef struct {
+    uint8_t operation;          // ffb_effect_op_t
+    uint8_t effect_block_index; // 0 for device-level operations
+    uint8_t loop_count;         // Start operations
+    float value;                // Device gain
+} effect_command_t;
+
+static effect_command_t ring[FFB_EFFECT_QUEUE_SIZE];
+static atomic_uint ring_head; // Next entry to consume (written by consumer)
+static atomic_uint ring_tail; // Next entry to fill (written by producer)
+
+// Latest parameters per effect block, written by the producer under the block's seqlock
+static ffb_motor_effect_t block_params[FFB_MAX_EFFECTS];
+static rt_seqlock_t block_params_lock[FFB_MAX_EFFECTS];
+
+// Set by the producer when an update entry for the block is in the ring, cleared by the
+// consumer before it reads the parameters
+static atomic_uint update_pending[FFB_MAX_EFFECTS];
+
+// Producer-only: the pending update is the newest ring entry for the block, so newer
+// parameters may replace it without reordering them past a later start/stop/free
+static uint8_t update_is_last[FFB_MAX_EFFECTS];
+
+static atomic_uint dropped_count;
+static atomic_uint coalesced_count;
+
+/**
+ * @brief Resets the queue and its counters. Call before producer and consumer start.
+ */
+void ffb_effect_queue_init(void) {
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    for (int i = 0; i < FFB_MAX_EFFECTS; i++) {
+        atomic_store(&update_pending[i], 0);
+        atomic_store(&block_params_lock[i].sequence, 0);
+        update_is_last[i] = 0;
+    }
+    memset(block_params, 0, sizeof(block_params));
+    atomic_store(&dropped_count, 0);
+    atomic_store(&coalesced_count, 0);
+}
+
+static int ring_push(const effect_command_t *command) {
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    if (tail - head >= FFB_EFFECT_QUEUE_SIZE) {
+        atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+        return -1;
+    }
+    ring[tail & (FFB_EFFECT_QUEUE_SIZE - 1)] = *command;
+    atomic_store_explicit(&ring_tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Queues an effect block operation (producer side).
+ */
+int ffb_effect_queue_push(const ffb_motor_effect_t *effect) {
+    effect_command_t command = {
+        .operation = (uint8_t)effect->operation,
+        .effect_block_index = effect->effect_block_index,
+        .loop_count = effect->loop_count,
+        .value = effect->magnitude,
+    };
+    int block_valid = effect->effect_block_index >= 1 && effect->effect_block_index <= FFB_MAX_EFFECTS;
+    int slot = effect->effect_block_index - 1;
+
+    if (effect->operation != FFB_EFFECT_OP_UPDATE) {
+        if (block_valid) {
+            update_is_last[slot] = 0;
+        } else {
+            memset(update_is_last, 0, sizeof(update_is_last)); // Device operations affect every block
+        }
+        return ring_push(&command);
+    }
+
+    if (!block_valid) return -1;
+
+    // Publish the parameters first, then claim the pending flag. If the flag was still set,
+    // the consumer has not cleared it yet, so it will read these parameters.
+    rt_seqlock_write_begin(&block_params_lock[slot]);
+    block_params[slot] = *effect;
+    rt_seqlock_write_end(&block_params_lock[slot]);
+
+    unsigned int was_pending = atomic_exchange(&update_pending[slot], 1);
+    if (was_pending && update_is_last[slot]) {
+        atomic_fetch_add_explicit(&coalesced_count, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    int result = ring_push(&command);
+    update_is_last[slot] = (result > 0);
+    if (result < 0 && !was_pending) {
+        atomic_store(&update_pending[slot], 0); // Nothing in the ring will consume it
+    }
+    return result;
+}
+
+// Copy a block's parameters; gives up if the producer keeps the seqlock busy (it is not
+// real-time and may be preempted mid-write, so an unbounded spin could stall the engine)
+#define PARAMS_READ_ATTEMPTS 16
+
+static int read_block_params(int slot, ffb_motor_effect_t *effect_out) {
+    for (int attempt = 0; attempt < PARAMS_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = atomic_load_explicit(&block_params_lock[slot].sequence, memory_order_acquire);
+        if (seq & 1U) {
+            rt_seqlock_cpu_relax();
+            continue;
+        }
+        *effect_out = block_params[slot];
+        if (!rt_seqlock_read_retry(&block_params_lock[slot], seq)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Takes the oldest pending operation (consumer side).
+ */
+int ffb_effect_queue_pop(ffb_motor_effect_t *effect_out) {
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head == tail) return 0;
+
+    effect_command_t command = ring[head & (FFB_EFFECT_QUEUE_SIZE - 1)];
+
+    if (command.operation == FFB_EFFECT_OP_UPDATE) {
+        int slot = command.effect_block_index - 1;
+        // Clear before reading: a producer that still sees the flag set relies on this read
+        atomic_store(&update_pending[slot], 0);
+        if (!read_block_params(slot, effect_out)) {
+            atomic_store(&update_pending[slot], 1); // Entry stays queued, retried next call
+            return 0;
+        }
+        atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+        effect_out->operation = FFB_EFFECT_OP_UPDATE;
+        return 1;
+    }
+
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    memset(effect_out, 0, sizeof(*effect_out));
+    effect_out->operation = (ffb_effect_op_t)command.operation;
+    effect_out->effect_block_index = command.effect_block_index;
+    effect_out->loop_count = command.loop_count;
+    effect_out->magnitude = command.value;
+    return 1;
+}
+
+/**
+ * @brief Returns the number of dropped and coalesced operations since init.
+ */
+void ffb_effect_queue_get_stats(uint32_t *dropped, uint32_t *coalesced) {
+    if (dropped) *dropped = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    if (coalesced) *coalesced = atomic_load_explicit(&coalesced_count, memory_order_relaxed);
+}
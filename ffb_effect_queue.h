@@ -0,0 +1,38 @@
+// ffb_effect_queue.h - Lock-free hand-off of effect block operations from HID reception to the FFB engine
+#ifndef FFB_EFFECT_QUEUE_H
+#define FFB_EFFECT_QUEUE_H
+
+#include <stdint.h>
+#include "ffb_types.h"
+
+// Ring capacity in operations (power of two). Parameter updates coalesce per effect
+// block, so the ring only has to hold distinct pending operations.
+#define FFB_EFFECT_QUEUE_SIZE 64
+
+// Single producer (HID reception thread), single consumer (FFB engine).
+
+/**
+ * @brief Resets the queue and its counters. Call before producer and consumer start.
+ */
+void ffb_effect_queue_init(void);
+
+/**
+ * @brief Queues an effect block operation (producer side).
+ *        An update for a block whose previous update has not been consumed yet replaces it.
+ * @return 1 if queued, 0 if coalesced into a pending update, -1 if dropped (ring full).
+ */
+int ffb_effect_queue_push(const ffb_motor_effect_t *effect);
+
+/**
+ * @brief Takes the oldest pending operation (consumer side).
+ *        Updates are returned with the newest parameters of their effect block.
+ * @return 1 if an operation was returned, 0 if the queue is empty.
+ */
+int ffb_effect_queue_pop(ffb_motor_effect_t *effect_out);
+
+/**
+ * @brief Returns the number of dropped and coalesced operations since init.
+ */
+void ffb_effect_queue_get_stats(uint32_t *dropped, uint32_t *coalesced);
+
+#endif // FFB_EFFECT_QUEUE_H
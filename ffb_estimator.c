@@ -0,0 +1,86 @@
+// ffb_estimator.c - Alpha-beta-gamma estimator of wheel position, velocity and acceleration
+#include "ffb_estimator.h"
+#include <math.h>
+
+/**
+ * @brief Configures the estimator and clears its state.
+ */
+void ffb_estimator_init(ffb_estimator_t *est, float cycle_s, float time_constant_s, float latency_s) {
+    est->nominal_dt_s = cycle_s;
+    est->latency_s = latency_s;
+    ffb_estimator_set_time_constant(est, time_constant_s);
+    est->initialized = 0;
+}
+
+/**
+ * @brief Changes the filter memory, keeping the current state.
+ */
+void ffb_estimator_set_time_constant(ffb_estimator_t *est, float time_constant_s) {
+    // Fading memory gains: theta is the weight left on a sample after one sample interval
+    float theta = expf(-est->nominal_dt_s / time_constant_s);
+    float one_minus = 1.0f - theta;
+
+    est->alpha = 1.0f - theta * theta * theta;
+    est->beta = 1.5f * one_minus * one_minus * (1.0f + theta);
+    est->gamma = 0.5f * one_minus * one_minus * one_minus;
+}
+
+// Interval since the previous sample: drive clock when mapped, host exchange time otherwise
+static float sample_interval_s(const ffb_estimator_t *est, const soem_pdo_snapshot_t *sample) {
+    if (sample->drive_time_us != 0 && est->last_drive_time_us != 0) {
+        return (float)(uint32_t)(sample->drive_time_us - est->last_drive_time_us) * 1e-6f; // Wraps every 71 minutes
+    }
+    return (float)(sample->timestamp_ns - est->last_sample_ns) * 1e-9f;
+}
+
+/**
+ * @brief Feeds a feedback sample.
+ */
+void ffb_estimator_update(ffb_estimator_t *est, const soem_pdo_snapshot_t *sample) {
+    if (!est->initialized) {
+        est->measured = sample->position;
+        est->position = est->measured;
+        est->velocity = 0.0f;
+        est->acceleration = 0.0f;
+        est->initialized = 1;
+    } else {
+        if (sample->cycle_count == est->last_cycle_count) {
+            return;
+        }
+        // 32-bit delta so a wrapping multi-turn counter stays continuous
+        est->measured += (int32_t)((uint32_t)sample->position - (uint32_t)est->last_position);
+
+        float dt = sample_interval_s(est, sample);
+        if (!(dt > 0.0f) || dt > est->nominal_dt_s * FFB_ESTIMATOR_MAX_GAP_CYCLES) {
+            // Too long without feedback for the old velocity to mean anything
+            est->position = est->measured;
+            est->velocity = 0.0f;
+            est->acceleration = 0.0f;
+        } else {
+            // Predict with constant acceleration, then correct with the position residual
+            double predicted = est->position + (double)(est->velocity * dt + 0.5f * est->acceleration * dt * dt);
+            float residual = (float)(est->measured - predicted);
+            est->position = predicted + est->alpha * residual;
+            est->velocity += est->acceleration * dt + est->beta * residual / dt;
+            est->acceleration += 2.0f * est->gamma * residual / (dt * dt);
+        }
+    }
+
+    est->last_position = sample->position;
+    est->last_drive_time_us = sample->drive_time_us;
+    est->last_sample_ns = sample->timestamp_ns;
+    est->last_cycle_count = sample->cycle_count;
+    est->sample_time_ns = sample->timestamp_ns;
+}
+
+/**
+ * @brief Returns the state extrapolated by the configured latency plus extra_s.
+ */
+void ffb_estimator_predict(const ffb_estimator_t *est, float extra_s, ffb_estimate_t *out) {
+    float horizon = est->latency_s + (extra_s > 0.0f ? extra_s : 0.0f);
+
+    out->position = est->position + (double)(est->velocity * horizon + 0.5f * est->acceleration * horizon * horizon);
+    out->velocity = est->velocity + est->acceleration * horizon;
+    out->acceleration = est->acceleration;
+    out->sample_time_ns = est->sample_time_ns;
+}
@@ -0,0 +1,69 @@
+// ffb_estimator.h - Alpha-beta-gamma estimator of wheel position, velocity and acceleration
+#ifndef FFB_ESTIMATOR_H
+#define FFB_ESTIMATOR_H
+
+#include <stdint.h>
+#include "soem_interface.h"
+
+// Filter memory: how far back position samples still influence velocity and acceleration
+#define FFB_ESTIMATOR_TIME_CONSTANT_S  0.004f
+// Samples further apart than this many cycles (lost frames, drive reset) restart the filter
+#define FFB_ESTIMATOR_MAX_GAP_CYCLES   20
+
+// Tracks the encoder position with a constant-acceleration model. Sample intervals come from
+// the drive's 0x20F0 timestamp when it is mapped, so master wakeup jitter does not show up as
+// velocity noise. Gains are the critically damped (fading memory) set for the nominal interval.
+typedef struct {
+    double position;            // Estimated encoder counts, unwrapped
+    double measured;            // Last encoder reading, unwrapped
+    float velocity;             // Counts per second
+    float acceleration;         // Counts per second squared
+    float alpha, beta, gamma;   // Filter gains
+    float nominal_dt_s;         // Configured sample interval
+    float latency_s;            // Transport latency compensated by ffb_estimator_predict()
+    int32_t last_position;      // Last encoder reading
+    uint32_t last_drive_time_us;
+    uint64_t last_sample_ns;
+    uint32_t last_cycle_count;
+    uint64_t sample_time_ns;    // CLOCK_MONOTONIC time of the sample the state refers to
+    int initialized;
+} ffb_estimator_t;
+
+// Wheel state predicted to the time the torque computed from it takes effect
+typedef struct {
+    double position;            // Encoder counts, unwrapped from the first sample
+    float velocity;             // Counts per second
+    float acceleration;         // Counts per second squared
+    uint64_t sample_time_ns;    // Time of the underlying encoder sample
+} ffb_estimate_t;
+
+/**
+ * @brief Configures the estimator and clears its state.
+ * @param est Estimator to configure.
+ * @param cycle_s Nominal interval between ffb_estimator_update() calls in seconds: the EtherCAT
+ *                cycle when fed from it, the loop period when fed from a slower loop.
+ * @param time_constant_s Filter memory in seconds, e.g. FFB_ESTIMATOR_TIME_CONSTANT_S.
+ * @param latency_s Time from sample to torque application, normally one cycle.
+ */
+void ffb_estimator_init(ffb_estimator_t *est, float cycle_s, float time_constant_s, float latency_s);
+
+/**
+ * @brief Changes the filter memory without clearing the state (tuning profile switch).
+ * @param est Estimator configured by ffb_estimator_init().
+ * @param time_constant_s Filter memory in seconds.
+ */
+void ffb_estimator_set_time_constant(ffb_estimator_t *est, float time_constant_s);
+
+/**
+ * @brief Feeds a feedback sample. Samples with an already seen cycle count are ignored, so it
+ *        is safe to call at a rate above the EtherCAT cycle.
+ */
+void ffb_estimator_update(ffb_estimator_t *est, const soem_pdo_snapshot_t *sample);
+
+/**
+ * @brief Returns the state extrapolated by the configured latency plus extra_s (e.g. the age of
+ *        the sample when the engine runs outside the EtherCAT cycle).
+ */
+void ffb_estimator_predict(const ffb_estimator_t *est, float extra_s, ffb_estimate_t *out);
+
+#endif // FFB_ESTIMATOR_H
@@ -0,0 +1,118 @@
+// ffb_fixed.h - Saturating fixed-point helpers for the integer torque path (FFB_FIXED_POINT)
+//
+// Formats: torque is Q15.16 in an int32_t, i.e. 16 fraction bits and +-32767 units of range,
+// which covers the torque ceiling of the tuning profile with 4x headroom. The wheel state
+// stays in drive units: encoder counts and rpm, with the fraction bits defined below. Products are formed in 64 bits and narrowed with saturation, and
+// sums of lanes are accumulated in 64 bits and saturated once, so the result does not depend
+// on the order lanes are added in: scalar and NEON kernels agree bit for bit.
+#ifndef FFB_FIXED_H
+#define FFB_FIXED_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Selects the integer path in ffb_calculator.c at compile time (make FIXED=1)
+#ifndef FFB_FIXED_POINT
+#define FFB_FIXED_POINT 0
+#endif
+
+#define FFB_Q16_SHIFT   16
+#define FFB_Q16_ONE     (1 << FFB_Q16_SHIFT)
+
+// Fraction bits of the wheel state fed to the integer engine. Positions are whole counts, but
+// centers and dead bands from the host are not (a spring's edge off by 0.3 counts is a
+// constant torque error), so they get 8 bits: +-8M counts, 128 turns of a 16-bit encoder.
+// Velocity keeps +-32767 rpm; acceleration needs more integer range (a reversal at the end
+// stop exceeds 50000 rpm/s).
+#define FFB_FIXED_POSITION_SHIFT        8       // Encoder counts
+#define FFB_FIXED_VELOCITY_SHIFT        16      // rpm
+#define FFB_FIXED_ACCELERATION_SHIFT    8       // rpm per second
+
+typedef int32_t ffb_q16_t;
+
+/**
+ * @brief Clamps a 64-bit value to the int32_t range.
+ */
+static inline int32_t ffb_sat_s32(int64_t value) {
+    if (value > INT32_MAX) return INT32_MAX;
+    if (value < INT32_MIN) return INT32_MIN;
+    return (int32_t)value;
+}
+
+static inline int32_t ffb_sat_add_s32(int32_t a, int32_t b) {
+    return ffb_sat_s32((int64_t)a + b);
+}
+
+static inline int32_t ffb_sat_sub_s32(int32_t a, int32_t b) {
+    return ffb_sat_s32((int64_t)a - b);
+}
+
+// |INT32_MIN| saturates to INT32_MAX, like NEON vqabs
+static inline int32_t ffb_sat_abs_s32(int32_t a) {
+    return (a < 0) ? ffb_sat_s32(-(int64_t)a) : a;
+}
+
+/**
+ * @brief Integer to frac_bits fraction bits, saturated (encoder counts to the position format).
+ */
+static inline int32_t ffb_fixed_from_int(int32_t value, int frac_bits) {
+    return ffb_sat_s32((int64_t)value * ((int64_t)1 << frac_bits));
+}
+
+/**
+ * @brief Q15.16 product, truncated towards minus infinity like an arithmetic shift.
+ */
+static inline ffb_q16_t ffb_q16_mul(ffb_q16_t a, ffb_q16_t b) {
+    return ffb_sat_s32(((int64_t)a * b) >> FFB_Q16_SHIFT);
+}
+
+/**
+ * @brief Float to int32_t with frac_bits fraction bits, rounded to nearest and saturated;
+ *        NaN gives 0.
+ */
+static inline int32_t ffb_fixed_from_float(float value, int frac_bits) {
+    float scaled = ldexpf(value, frac_bits);
+    if (isnan(scaled)) return 0;
+    if (scaled >= 2147483520.0f) return INT32_MAX;     // Largest float below 2^31
+    if (scaled <= -2147483648.0f) return INT32_MIN;
+    return (int32_t)lrintf(scaled);
+}
+
+static inline float ffb_fixed_to_float(int32_t value, int frac_bits) {
+    return ldexpf((float)value, -frac_bits);
+}
+
+static inline ffb_q16_t ffb_q16_from_float(float value) {
+    return ffb_fixed_from_float(value, FFB_Q16_SHIFT);
+}
+
+static inline float ffb_q16_to_float(ffb_q16_t value) {
+    return ffb_fixed_to_float(value, FFB_Q16_SHIFT);
+}
+
+// Torque command from the engine through the output stage to the drive, in engine torque
+// units (the profile's max_torque is the drive's 0x6072): Q15.16 in the integer build, so
+// the command stays an integer up to the PDO
+#if FFB_FIXED_POINT
+typedef ffb_q16_t ffb_torque_t;
+
+static inline ffb_torque_t ffb_torque_from_float(float value) {
+    return ffb_q16_from_float(value);
+}
+
+static inline float ffb_torque_to_float(ffb_torque_t value) {
+    return ffb_q16_to_float(value);
+}
+#else
+typedef float ffb_torque_t;
+
+static inline ffb_torque_t ffb_torque_from_float(float value) {
+    return value;
+}
+
+static inline float ffb_torque_to_float(ffb_torque_t value) {
+    return value;
+}
+#endif
+
+#endif // FFB_FIXED_H
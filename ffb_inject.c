@@ -0,0 +1,155 @@
+// ffb_inject.c - Host-side injector: plays scripted PID output reports into the wheel
+//
+// Runs on the PC the Pi is plugged into. The gadget's /dev/hidg0 shows up there as a
+// /dev/hidrawN; every write() to it is one output report, exactly what a game's force
+// feedback driver sends. The script is a capture file (ffb_app -R, ffb_capture.h) or a
+// generated workload (ffb_workload.h), played on its own timestamps. How late each report
+// left and how long write() took go to a JSON summary; the wheel side of the same run is
+// measured by ffb_app -B (report arrival to torque write to torque actual).
+//
+// Usage: ffb_inject [-d /dev/hidrawN] [-w workload] [-n effects] [-t duration_ms]
+//                   [-g script_out] [-o results.json] [script]
+//   -d  hidraw device of the wheel (required unless -g)
+//   -w  workload when no script is given: "steps" (default) or "effects"
+//   -n  effects for the "effects" workload (default 8)
+//   -t  streamed part of the workload (default 10000 ms)
+//   -g  write the workload as a script and exit, to edit or replay it later
+//   -o  write the JSON summary to a file instead of stdout
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "ffb_capture.h"
+#include "ffb_workload.h"
+#include "rt_histogram.h"
+
+#define INJECT_DEFAULT_EFFECTS      8
+#define INJECT_DEFAULT_DURATION_MS  10000
+#define INJECT_PRIORITY             50      // SCHED_FIFO, when permitted
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline_ns) {
+    struct timespec ts = { .tv_sec = (time_t)(deadline_ns / 1000000000ULL), .tv_nsec = (long)(deadline_ns % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// Best effort: the host is a desktop, not the Pi's isolated topology
+static void setup_scheduling(void) {
+    struct sched_param param = { .sched_priority = INJECT_PRIORITY };
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        fprintf(stderr, "FFB_Inject: WARNING: no SCHED_FIFO (%s), report timing is less precise\n", strerror(errno));
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fprintf(stderr, "FFB_Inject: WARNING: mlockall failed: %s\n", strerror(errno));
+    }
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-d /dev/hidrawN] [-w steps|effects] [-n effects] [-t duration_ms] "
+                    "[-g script_out] [-o results.json] [script]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *device = NULL;
+    const char *workload = "steps";
+    const char *generate_path = NULL;
+    const char *out_path = NULL;
+    int effects = INJECT_DEFAULT_EFFECTS;
+    long duration_ms = INJECT_DEFAULT_DURATION_MS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:w:n:t:g:o:h")) != -1) {
+        switch (opt) {
+            case 'd': device = optarg; break;
+            case 'w': workload = optarg; break;
+            case 'n': effects = atoi(optarg); break;
+            case 't': duration_ms = atol(optarg); break;
+            case 'g': generate_path = optarg; break;
+            case 'o': out_path = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (duration_ms < 0 || (!device && !generate_path)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ffb_capture_report_t *reports;
+    size_t report_count;
+    const char *script = (optind < argc) ? argv[optind] : workload;
+    if (optind < argc) {
+        if (ffb_capture_load(argv[optind], &reports, &report_count) != 0) return EXIT_FAILURE;
+    } else if (ffb_workload_build(workload, effects, (uint32_t)duration_ms, &reports, &report_count) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (generate_path) {
+        int ret = ffb_capture_save(generate_path, reports, report_count);
+        if (ret == 0) fprintf(stderr, "FFB_Inject: %zu reports written to %s\n", report_count, generate_path);
+        free(reports);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int fd = open(device, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "FFB_Inject: cannot open %s: %s\n", device, strerror(errno));
+        free(reports);
+        return EXIT_FAILURE;
+    }
+    rt_histogram_t *hist_late = rt_histogram_create("inject late", "ns");
+    rt_histogram_t *hist_write = rt_histogram_create("inject write", "ns");
+    setup_scheduling();
+
+    fprintf(stderr, "FFB_Inject: playing %zu reports (%s) into %s\n", report_count, script, device);
+    unsigned long written = 0, errors = 0;
+    uint64_t start_ns = monotonic_ns() + 100000000ULL; // Leave time for the first page faults
+    for (size_t i = 0; i < report_count; i++) {
+        const ffb_capture_report_t *r = &reports[i];
+        uint64_t due_ns = start_ns + r->time_us * 1000ULL;
+        sleep_until_ns(due_ns);
+
+        uint64_t write_ns = monotonic_ns();
+        ssize_t ret = write(fd, r->data, r->length);
+        uint64_t done_ns = monotonic_ns();
+        rt_histogram_record(hist_late, write_ns > due_ns ? write_ns - due_ns : 0);
+        rt_histogram_record(hist_write, done_ns - write_ns);
+        if (ret == (ssize_t)r->length) {
+            written++;
+        } else if (errors++ == 0) {
+            fprintf(stderr, "FFB_Inject: write of report %zu failed: %s\n", i, ret < 0 ? strerror(errno) : "short write");
+        }
+    }
+    double elapsed_s = (monotonic_ns() - start_ns) / 1e9;
+    close(fd);
+    free(reports);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror("FFB_Inject: failed to create the results file");
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "{\n  \"suite\": \"ffb_inject\",\n  \"device\": \"%s\",\n  \"script\": \"%s\",\n", device, script);
+    fprintf(out, "  \"reports\": %zu,\n  \"written\": %lu,\n  \"errors\": %lu,\n  \"elapsed_s\": %.3f,\n",
+            report_count, written, errors, elapsed_s);
+    fprintf(out, "  \"histograms\": ");
+    rt_histogram_write_json(out);
+    fprintf(out, "\n}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "FFB_Inject: %lu of %zu reports written in %.1f s\n", written, report_count, elapsed_s);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
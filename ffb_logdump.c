@@ -0,0 +1,209 @@
+// ffb_logdump.c - Converts binary telemetry log segments (telemetry.h format) to CSV
+//
+// Usage: ffb_logdump [-q] [-l] [-s seconds] [-o out.csv] segment.ffbt...
+//   -q  do not print the summary and block errors to stderr
+//   -l  only list the segments from their headers, without reading the blocks
+//   -s  start that many seconds after the first record of the first segment; the
+//       segment headers and timestamp indexes are used to skip straight there
+//   -o  write the CSV to a file instead of stdout
+// Segments are read in the order given; pass them sorted (<base>_0000.ffbt, _0001, ...).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+static int quiet = 0;
+
+// Totals over all segments
+static uint32_t blocks_read = 0, bad_blocks = 0, records_out = 0, dropped = 0;
+static uint32_t expected_sequence = 0, sequence_gaps = 0;
+static int have_sequence = 0;
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-q] [-l] [-s seconds] [-o out.csv] segment.ffbt...\n", name);
+}
+
+static void print_record(FILE *out, const telemetry_record_t *r) {
+    fprintf(out, "%" PRIu64 ",%u,%.3f,%.3f,%.3f,0x%010" PRIx64 ",%u,%u,%.3f,%d,%d,%d,%d\n",
+            r->timestamp_ns, r->sequence, r->position_deg, r->velocity, r->torque,
+            r->active_mask, r->effects_applied, r->last_report_id, r->last_magnitude,
+            (r->status & TELEMETRY_STATUS_EMERGENCY_STOP) ? 1 : 0,
+            (r->status & TELEMETRY_STATUS_ETHERCAT_OK) ? 1 : 0,
+            (r->status & TELEMETRY_STATUS_HID_OK) ? 1 : 0,
+            (r->status & TELEMETRY_STATUS_PAUSED) ? 1 : 0);
+}
+
+static int read_segment_header(int fd, const char *path, telemetry_segment_header_t *header, uint64_t *index) {
+    static uint8_t buffer[TELEMETRY_SEGMENT_HEADER_SIZE];
+    if (pread(fd, buffer, sizeof(buffer), 0) != (ssize_t)sizeof(buffer)) {
+        fprintf(stderr, "%s: too short for a segment header\n", path);
+        return -1;
+    }
+    memcpy(header, buffer, sizeof(*header));
+    if (header->magic != TELEMETRY_SEGMENT_MAGIC || header->version != TELEMETRY_FORMAT_VERSION ||
+        header->header_size != TELEMETRY_SEGMENT_HEADER_SIZE || header->index_stride == 0 ||
+        header->index_count > TELEMETRY_SEGMENT_INDEX_ENTRIES) {
+        fprintf(stderr, "%s: not a version %d telemetry segment\n", path, TELEMETRY_FORMAT_VERSION);
+        return -1;
+    }
+    memcpy(index, buffer + sizeof(*header), (size_t)header->index_count * sizeof(uint64_t));
+    return 0;
+}
+
+// First block that can contain records at or after start_ns
+static uint32_t find_start_block(const telemetry_segment_header_t *header, const uint64_t *index, uint64_t start_ns) {
+    uint32_t low = 0, high = header->index_count;
+    // Last index entry whose first timestamp is <= start_ns
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        if (index[mid] <= start_ns) low = mid; else high = mid;
+    }
+    return low * header->index_stride;
+}
+
+// Returns 0 when the segment was clean, 1 when it had bad blocks, -1 when unreadable
+static int dump_segment(FILE *out, const char *path, int list_only, uint64_t start_ns) {
+    static uint64_t index[TELEMETRY_SEGMENT_INDEX_ENTRIES];
+    static uint8_t block[TELEMETRY_BLOCK_SIZE];
+    telemetry_segment_header_t header;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (read_segment_header(fd, path, &header, index) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (list_only) {
+        printf("%s: segment %u, %u/%u blocks committed, %s, first %" PRIu64 " ns, last %" PRIu64 " ns\n",
+               path, header.segment_index, header.committed_blocks, header.block_capacity,
+               header.closed ? "closed" : "not closed (writer stopped unexpectedly)",
+               header.first_timestamp_ns, header.last_timestamp_ns);
+        close(fd);
+        return 0;
+    }
+
+    if (header.closed && header.last_timestamp_ns < start_ns) {
+        close(fd);
+        return 0; // Entirely before the requested start
+    }
+
+    uint32_t first_block = (start_ns && header.index_count) ? find_start_block(&header, index, start_ns) : 0;
+    int bad = 0;
+    // Past committed_blocks, keep reading blocks that validate: a crash can leave complete
+    // blocks that the header was not updated for
+    for (uint32_t b = first_block; b < header.block_capacity; b++) {
+        off_t offset = (off_t)header.header_size + (off_t)b * TELEMETRY_BLOCK_SIZE;
+        if (pread(fd, block, sizeof(block), offset) != (ssize_t)sizeof(block)) {
+            break;
+        }
+        const telemetry_block_header_t *bh = (const telemetry_block_header_t *)block;
+        const telemetry_record_t *records = (const telemetry_record_t *)(bh + 1);
+        int valid = bh->magic == TELEMETRY_BLOCK_MAGIC && bh->version == TELEMETRY_FORMAT_VERSION &&
+                    bh->record_size == sizeof(telemetry_record_t) &&
+                    bh->record_count > 0 && bh->record_count <= TELEMETRY_RECORDS_PER_BLOCK &&
+                    telemetry_crc32(records, (size_t)bh->record_count * sizeof(telemetry_record_t)) == bh->crc32;
+        if (!valid) {
+            if (b < header.committed_blocks) {
+                if (!quiet) fprintf(stderr, "%s: block %u damaged, skipped\n", path, b);
+                bad_blocks++;
+                bad = 1;
+                continue;
+            }
+            break; // End of the recorded data
+        }
+
+        blocks_read++;
+        dropped = bh->dropped_total;
+        for (uint16_t i = 0; i < bh->record_count; i++) {
+            if (records[i].timestamp_ns < start_ns) continue;
+            if (have_sequence && records[i].sequence != expected_sequence) {
+                sequence_gaps++;
+            }
+            have_sequence = 1;
+            expected_sequence = records[i].sequence + 1;
+            print_record(out, &records[i]);
+            records_out++;
+        }
+    }
+
+    close(fd);
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    int list_only = 0;
+    double start_seconds = 0.0;
+    const char *out_path = NULL;
+
+    while ((opt = getopt(argc, argv, "qls:o:h")) != -1) {
+        switch (opt) {
+            case 'q':
+                quiet = 1;
+                break;
+            case 'l':
+                list_only = 1;
+                break;
+            case 's':
+                start_seconds = atof(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = stdout;
+    if (out_path && !list_only) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            perror("Failed to create CSV file");
+            return EXIT_FAILURE;
+        }
+    }
+    if (!list_only) {
+        fprintf(out, "timestamp_ns,sequence,position_deg,velocity,torque_output,active_mask,"
+                     "effects_applied,last_report_id,last_magnitude,emergency_stop,ethercat_ok,hid_ok,paused\n");
+    }
+
+    // -s counts from the first record of the first segment
+    uint64_t start_ns = 0;
+    if (start_seconds > 0.0) {
+        static uint64_t index[TELEMETRY_SEGMENT_INDEX_ENTRIES];
+        telemetry_segment_header_t header;
+        int fd = open(argv[optind], O_RDONLY);
+        if (fd < 0 || read_segment_header(fd, argv[optind], &header, index) != 0) {
+            if (fd >= 0) close(fd);
+            return EXIT_FAILURE;
+        }
+        close(fd);
+        start_ns = header.first_timestamp_ns + (uint64_t)(start_seconds * 1e9);
+    }
+
+    int status = EXIT_SUCCESS;
+    for (int i = optind; i < argc; i++) {
+        int ret = dump_segment(out, argv[i], list_only, start_ns);
+        if (ret != 0) status = 2;
+    }
+
+    if (!quiet && !list_only) {
+        fprintf(stderr, "%u blocks (%u damaged), %u records, %u dropped by the ring, %u sequence gaps\n",
+                blocks_read, bad_blocks, records_out, dropped, sequence_gaps);
+    }
+    if (out != stdout) fclose(out);
+    return status;
+}
@@ -0,0 +1,88 @@
+// ffb_monitor.c - Prints the live state that ffb_app publishes in /dev/shm/ddecat
+//
+// Usage: ffb_monitor [-r rate_hz] [-H] [-1]
+//   -r  refresh rate (default 10 Hz)
+//   -H  also print the latency histograms
+//   -1  print once and exit
+// Reading never blocks or slows down ffb_app; use it as a template for dashboards.
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "shm_telemetry.h"
+
+static const char *status_flag(uint32_t status, uint32_t bit, const char *set, const char *clear) {
+    return (status & bit) ? set : clear;
+}
+
+static void print_histograms(const shm_telemetry_t *shm) {
+    static shm_telemetry_histogram_t histograms[SHM_TELEMETRY_MAX_HISTOGRAMS];
+    int count = shm_telemetry_read_histograms(shm, histograms);
+    printf("  %-24s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "p50", "p99", "p99.9", "max");
+    for (int i = 0; i < count; i++) {
+        const shm_telemetry_histogram_t *h = &histograms[i];
+        double scale = strcmp(h->unit, "ns") == 0 ? 1e-3 : 1.0;
+        printf("  %-24s %10" PRIu64 " %10.1f %10.1f %10.1f %10.1f%s%s\n", h->name, h->count,
+               h->p50 * scale, h->p99 * scale, h->p999 * scale, h->max * scale,
+               scale == 1.0 ? " " : "", scale == 1.0 ? h->unit : "");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    double rate_hz = 10.0;
+    int histograms = 0, once = 0;
+
+    while ((opt = getopt(argc, argv, "r:H1h")) != -1) {
+        switch (opt) {
+            case 'r':
+                rate_hz = atof(optarg);
+                if (rate_hz <= 0.0) rate_hz = 10.0;
+                break;
+            case 'H':
+                histograms = 1;
+                break;
+            case '1':
+                once = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r rate_hz] [-H] [-1]\n", argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    const shm_telemetry_t *shm = shm_telemetry_open_reader();
+    if (!shm) {
+        fprintf(stderr, "No live state at /dev/shm%s (is ffb_app running?)\n", SHM_TELEMETRY_NAME);
+        return EXIT_FAILURE;
+    }
+
+    long period_ns = (long)(1e9 / rate_hz);
+    struct timespec period = { period_ns / 1000000000L, period_ns % 1000000000L };
+    uint64_t last_update = 0;
+    do {
+        if (atomic_load_explicit(&shm->magic, memory_order_acquire) != SHM_TELEMETRY_MAGIC) {
+            fprintf(stderr, "ffb_app stopped\n");
+            return EXIT_SUCCESS;
+        }
+        shm_telemetry_state_t state;
+        shm_telemetry_read_state(shm, &state);
+        printf("Deg=%7.1f Norm=%7.4f Vel=%8.1f Torque=%7.1f Actual=%5d CiA402=%u EtherCAT=%s HID=%s%s%s Effects=0x%010" PRIx64 " Updates=%" PRIu64 "%s\n",
+               state.angle_deg, state.normalized_position, state.velocity, state.torque_command,
+               state.torque_actual, state.cia402_state,
+               status_flag(state.status, SHM_TELEMETRY_STATUS_ETHERCAT_OK, "OK", "LOST"),
+               status_flag(state.status, SHM_TELEMETRY_STATUS_HID_OK, "OK", "LOST"),
+               status_flag(state.status, SHM_TELEMETRY_STATUS_EMERGENCY_STOP, " STOP", ""),
+               status_flag(state.status, SHM_TELEMETRY_STATUS_PAUSED, " PAUSED", ""),
+               state.active_mask, state.update_count,
+               state.update_count == last_update ? " (stale)" : "");
+        last_update = state.update_count;
+        if (histograms) print_histograms(shm);
+        fflush(stdout);
+        if (!once) nanosleep(&period, NULL);
+    } while (!once);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+// ffb_oscillator.c - Wavetable / analytic waveform generation from a phase accumulator
+#include "ffb_oscillator.h"
+#include "ffb_types.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Sine wavetable: top bits of the phase select the entry, the next bits interpolate
+#define SINE_TABLE_BITS 8
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+#define SINE_FRACTION_BITS 16
+
+// Phase units per cycle and per degree
+#define PHASE_PER_CYCLE 4294967296.0
+#define PHASE_PER_DEGREE (PHASE_PER_CYCLE / 360.0)
+
+// One extra entry so interpolation never needs to wrap the index
+static float sine_table[SINE_TABLE_SIZE + 1];
+
+/**
+ * @brief Builds the shared sine wavetable. Call once before using any oscillator.
+ */
+void ffb_oscillator_init_table(void) {
+    for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+        sine_table[i] = (float)sin(2.0 * M_PI * i / SINE_TABLE_SIZE);
+    }
+}
+
+/**
+ * @brief Resets the oscillator phase to the start of a cycle.
+ */
+void ffb_oscillator_reset(ffb_oscillator_t *osc) {
+    osc->phase = 0;
+}
+
+/**
+ * @brief Sets waveform, frequency and phase offset. Does not touch the accumulator.
+ */
+void ffb_oscillator_set(ffb_oscillator_t *osc, uint8_t waveform, float frequency_hz, float phase_deg) {
+    osc->waveform = waveform;
+    osc->phase_per_ns = (frequency_hz > 0) ? frequency_hz * (PHASE_PER_CYCLE / 1e9) : 0.0;
+    double offset = fmod(phase_deg, 360.0);
+    if (offset < 0) offset += 360.0;
+    osc->phase_offset = (uint32_t)(offset * PHASE_PER_DEGREE);
+}
+
+/**
+ * @brief Advances the phase accumulator by the elapsed time.
+ */
+void ffb_oscillator_advance(ffb_oscillator_t *osc, uint64_t dt_ns) {
+    // Whole cycles are dropped by the wrap to 32 bits
+    double step = fmod(osc->phase_per_ns * (double)dt_ns, PHASE_PER_CYCLE);
+    osc->phase += (uint32_t)step;
+}
+
+static inline float sine_lookup(uint32_t phase) {
+    uint32_t index = phase >> (32 - SINE_TABLE_BITS);
+    float fraction = (float)((phase >> (32 - SINE_TABLE_BITS - SINE_FRACTION_BITS)) &
+                             ((1U << SINE_FRACTION_BITS) - 1)) * (1.0f / (1U << SINE_FRACTION_BITS));
+    float a = sine_table[index];
+    return a + (sine_table[index + 1] - a) * fraction;
+}
+
+/**
+ * @brief Samples the waveform at the current phase.
+ */
+float ffb_oscillator_value(const ffb_oscillator_t *osc) {
+    uint32_t phase = osc->phase + osc->phase_offset;
+    // Position within the cycle, 0.0 to 1.0
+    float t = (float)phase * (float)(1.0 / PHASE_PER_CYCLE);
+
+    switch (osc->waveform) {
+        case FFB_WAVEFORM_SQUARE:
+            return (phase < 0x80000000U) ? 1.0f : -1.0f;
+        case FFB_WAVEFORM_SINE:
+            return sine_lookup(phase);
+        case FFB_WAVEFORM_TRIANGLE:
+            // Same shape as the previous fmodf-based triangle: -1 at cycle start, +1 at half
+            return (t < 0.5f) ? (4.0f * t - 1.0f) : (3.0f - 4.0f * t);
+        case FFB_WAVEFORM_SAWTOOTH_UP:
+            return 2.0f * t - 1.0f;
+        case FFB_WAVEFORM_SAWTOOTH_DOWN:
+            return 1.0f - 2.0f * t;
+        default:
+            return sine_lookup(phase); // Default to sine
+    }
+}
@@ -0,0 +1,49 @@
+// ffb_oscillator.h - Phase-accumulator oscillator for periodic FFB effects
+#ifndef FFB_OSCILLATOR_H
+#define FFB_OSCILLATOR_H
+
+#include <stdint.h>
+
+// One full waveform cycle spans the whole 32-bit phase range, so wrap-around is free.
+// Frequency and phase offset can change at any time without resetting the accumulator,
+// which keeps the output phase-continuous across effect parameter updates.
+typedef struct {
+    uint32_t phase;           // Phase accumulator (2^32 = one cycle)
+    uint32_t phase_offset;    // Effect phase offset, added when sampling
+    double   phase_per_ns;    // Accumulator increment per nanosecond of elapsed time
+    uint8_t  waveform;        // ffb_waveform_t
+} ffb_oscillator_t;
+
+/**
+ * @brief Builds the shared sine wavetable. Call once before using any oscillator.
+ */
+void ffb_oscillator_init_table(void);
+
+/**
+ * @brief Resets the oscillator phase to the start of a cycle.
+ */
+void ffb_oscillator_reset(ffb_oscillator_t *osc);
+
+/**
+ * @brief Sets waveform, frequency and phase offset. Does not touch the accumulator.
+ * @param osc Oscillator to configure.
+ * @param waveform ffb_waveform_t value.
+ * @param frequency_hz Waveform frequency in Hz (0 = hold current phase).
+ * @param phase_deg Phase offset in degrees.
+ */
+void ffb_oscillator_set(ffb_oscillator_t *osc, uint8_t waveform, float frequency_hz, float phase_deg);
+
+/**
+ * @brief Advances the phase accumulator by the elapsed time.
+ * @param osc Oscillator to advance.
+ * @param dt_ns Time since the last advance in nanoseconds.
+ */
+void ffb_oscillator_advance(ffb_oscillator_t *osc, uint64_t dt_ns);
+
+/**
+ * @brief Samples the waveform at the current phase.
+ * @return Value in the range -1.0 to 1.0.
+ */
+float ffb_oscillator_value(const ffb_oscillator_t *osc);
+
+#endif // FFB_OSCILLATOR_H
@@ -0,0 +1,235 @@
+// ffb_output.c - Torque output stage run at the EtherCAT cycle rate
+#include "ffb_output.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Weight of the newest interval in the smoothed command interval (1/4)
+#define UPDATE_INTERVAL_SMOOTHING 0.25f
+#define UPDATE_INTERVAL_SMOOTHING_SHIFT 2
+
+#if FFB_FIXED_POINT
+// Filter inputs are clamped to twice the torque ceiling of a profile, so the 64-bit sums of
+// the Q2.29 products cannot overflow
+#define FIXED_FILTER_LIMIT ((int32_t)16384 << FFB_Q16_SHIFT)
+#define UPDATE_INTERVAL_ONE (1U << FFB_OUTPUT_INTERVAL_SHIFT)
+#define COEFF_ONE ((int32_t)1 << FFB_OUTPUT_COEFF_SHIFT)
+
+static inline ffb_torque_t torque_abs(ffb_torque_t value) {
+    return ffb_sat_abs_s32(value);
+}
+
+static inline ffb_torque_t torque_add(ffb_torque_t a, ffb_torque_t b) {
+    return ffb_sat_add_s32(a, b);
+}
+
+static inline ffb_torque_t torque_sub(ffb_torque_t a, ffb_torque_t b) {
+    return ffb_sat_sub_s32(a, b);
+}
+#else
+#define UPDATE_INTERVAL_ONE 1.0f
+
+static inline ffb_torque_t torque_abs(ffb_torque_t value) {
+    return fabsf(value);
+}
+
+static inline ffb_torque_t torque_add(ffb_torque_t a, ffb_torque_t b) {
+    return a + b;
+}
+
+static inline ffb_torque_t torque_sub(ffb_torque_t a, ffb_torque_t b) {
+    return a - b;
+}
+#endif
+
+// Coefficients from the RBJ audio EQ cookbook, normalized by a0
+static void biquad_set(ffb_biquad_t *bq, float b0, float b1, float b2, float a0, float a1, float a2) {
+#if FFB_FIXED_POINT
+    bq->b0 = ffb_fixed_from_float(b0 / a0, FFB_OUTPUT_COEFF_SHIFT);
+    bq->b1 = ffb_fixed_from_float(b1 / a0, FFB_OUTPUT_COEFF_SHIFT);
+    bq->b2 = ffb_fixed_from_float(b2 / a0, FFB_OUTPUT_COEFF_SHIFT);
+    bq->a1 = ffb_fixed_from_float(a1 / a0, FFB_OUTPUT_COEFF_SHIFT);
+    bq->a2 = ffb_fixed_from_float(a2 / a0, FFB_OUTPUT_COEFF_SHIFT);
+#else
+    bq->b0 = b0 / a0;
+    bq->b1 = b1 / a0;
+    bq->b2 = b2 / a0;
+    bq->a1 = a1 / a0;
+    bq->a2 = a2 / a0;
+#endif
+    bq->enabled = 1;
+}
+
+static void biquad_lowpass(ffb_biquad_t *bq, float corner_hz, float q, float cycle_s) {
+    float w0 = 2.0f * (float)M_PI * corner_hz * cycle_s;
+    float cos_w0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    biquad_set(bq, (1.0f - cos_w0) * 0.5f, 1.0f - cos_w0, (1.0f - cos_w0) * 0.5f,
+               1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+#if FFB_FIXED_POINT
+    // Numerator from the rounded denominator: a DC gain of exactly 1 even at low corners
+    int32_t dc = COEFF_ONE + bq->a1 + bq->a2;
+    bq->b0 = bq->b2 = dc / 4;
+    bq->b1 = dc - 2 * bq->b0;
+#endif
+}
+
+static void biquad_notch(ffb_biquad_t *bq, float center_hz, float q, float cycle_s) {
+    float w0 = 2.0f * (float)M_PI * center_hz * cycle_s;
+    float cos_w0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    biquad_set(bq, 1.0f, -2.0f * cos_w0, 1.0f, 1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+#if FFB_FIXED_POINT
+    // b1 = a1 and b0 + b2 = 1 + a2 exactly, so DC passes with a gain of 1
+    bq->b1 = bq->a1;
+    bq->b0 = (COEFF_ONE + bq->a2) / 2;
+    bq->b2 = COEFF_ONE + bq->a2 - bq->b0;
+#endif
+}
+
+#if FFB_FIXED_POINT
+static inline ffb_torque_t biquad_step(ffb_biquad_t *bq, ffb_torque_t x) {
+    if (!bq->enabled) return x;
+    if (x > FIXED_FILTER_LIMIT) x = FIXED_FILTER_LIMIT;
+    if (x < -FIXED_FILTER_LIMIT) x = -FIXED_FILTER_LIMIT;
+    int64_t sum = (int64_t)bq->b0 * x + bq->z1;
+    ffb_torque_t y = ffb_sat_s32((sum + ((int64_t)1 << (FFB_OUTPUT_COEFF_SHIFT - 1))) >> FFB_OUTPUT_COEFF_SHIFT);
+    bq->z1 = (int64_t)bq->b1 * x - (int64_t)bq->a1 * y + bq->z2;
+    bq->z2 = (int64_t)bq->b2 * x - (int64_t)bq->a2 * y;
+    return y;
+}
+#else
+static inline ffb_torque_t biquad_step(ffb_biquad_t *bq, ffb_torque_t x) {
+    if (!bq->enabled) return x;
+    float y = bq->b0 * x + bq->z1;
+    bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+    bq->z2 = bq->b2 * x - bq->a2 * y;
+    return y;
+}
+#endif
+
+// Smooths the interval between the last two commands; returns the cycles to ramp over
+static uint32_t smooth_update_interval(ffb_output_t *out, uint32_t interval) {
+#if FFB_FIXED_POINT
+    int32_t target = (int32_t)(interval << FFB_OUTPUT_INTERVAL_SHIFT);
+    out->update_interval += (uint32_t)((target - (int32_t)out->update_interval) >> UPDATE_INTERVAL_SMOOTHING_SHIFT);
+    return (out->update_interval + UPDATE_INTERVAL_ONE / 2) >> FFB_OUTPUT_INTERVAL_SHIFT;
+#else
+    out->update_interval += ((float)interval - out->update_interval) * UPDATE_INTERVAL_SMOOTHING;
+    return (uint32_t)lroundf(out->update_interval);
+#endif
+}
+
+// Point done/cycles of the way from start to target
+static inline ffb_torque_t ramp_point(ffb_torque_t start, ffb_torque_t target, uint32_t done, uint32_t cycles) {
+#if FFB_FIXED_POINT
+    return start + (ffb_torque_t)(((int64_t)target - start) * done / cycles);
+#else
+    return start + (target - start) * (float)done / (float)cycles;
+#endif
+}
+
+// Corner frequency the filter can represent at this cycle rate, 0 = filter off
+static float usable_corner(float hz, float cycle_s) {
+    if (!(hz > 0.0f)) return 0.0f;
+    float max_hz = FFB_OUTPUT_MAX_CORNER_FRACTION / cycle_s;
+    return hz < max_hz ? hz : max_hz;
+}
+
+/**
+ * @brief Configures an output stage and clears its state to zero torque.
+ */
+void ffb_output_init(ffb_output_t *out, float cycle_s, const ffb_output_config_t *config) {
+    memset(out, 0, sizeof(*out));
+    out->cycle_s = cycle_s;
+    ffb_output_configure(out, config);
+    ffb_output_reset(out);
+}
+
+/**
+ * @brief Changes filters and limits while running, keeping the filter state.
+ */
+void ffb_output_configure(ffb_output_t *out, const ffb_output_config_t *config) {
+    float lowpass_hz = usable_corner(config->lowpass_hz, out->cycle_s);
+    float notch_hz = usable_corner(config->notch_hz, out->cycle_s);
+
+    out->interpolate = config->interpolate;
+    out->lowpass.enabled = 0;
+    if (lowpass_hz > 0.0f) biquad_lowpass(&out->lowpass, lowpass_hz, FFB_OUTPUT_LOWPASS_Q, out->cycle_s);
+    out->notch.enabled = 0;
+    if (notch_hz > 0.0f && config->notch_q > 0.0f) biquad_notch(&out->notch, notch_hz, config->notch_q, out->cycle_s);
+    out->max_step = config->slew_rate > 0.0f ? ffb_torque_from_float(config->slew_rate * out->cycle_s) : 0;
+    out->max_ramp_cycles = (uint32_t)(FFB_OUTPUT_MAX_INTERPOLATION_S / out->cycle_s);
+    if (out->max_ramp_cycles < 1) out->max_ramp_cycles = 1;
+}
+
+/**
+ * @brief Clears the state to zero torque.
+ */
+void ffb_output_reset(ffb_output_t *out) {
+    out->notch.z1 = out->notch.z2 = 0;
+    out->lowpass.z1 = out->lowpass.z2 = 0;
+    out->cycles_since_update = 0;
+    out->update_interval = UPDATE_INTERVAL_ONE;
+    out->ramp_start = out->ramp_target = 0;
+    out->ramp_cycles = out->ramp_done = 0;
+    out->interpolated = 0;
+    out->output = 0;
+}
+
+// First-order hold: from where the output is now to the new command, over one command interval
+static ffb_torque_t reconstruct(ffb_output_t *out, ffb_torque_t command, uint32_t update_count) {
+    if (update_count != out->last_update) {
+        uint32_t interval = out->cycles_since_update;
+        if (interval < 1) interval = 1;
+        if (interval > out->max_ramp_cycles) interval = out->max_ramp_cycles;
+
+        out->last_update = update_count;
+        out->cycles_since_update = 0;
+        out->ramp_start = out->interpolated;
+        out->ramp_target = command;
+        out->ramp_cycles = smooth_update_interval(out, interval);
+        out->ramp_done = 0;
+    }
+    out->cycles_since_update++;
+
+    if (!out->interpolate || out->ramp_cycles <= 1 || out->ramp_done >= out->ramp_cycles) {
+        out->interpolated = out->ramp_target;
+    } else {
+        out->ramp_done++;
+        out->interpolated = ramp_point(out->ramp_start, out->ramp_target, out->ramp_done, out->ramp_cycles);
+    }
+    return out->interpolated;
+}
+
+/**
+ * @brief Runs one cycle of the stage.
+ */
+ffb_torque_t ffb_output_step(ffb_output_t *out, ffb_torque_t command, uint32_t update_count) {
+    ffb_torque_t torque = reconstruct(out, command, update_count);
+    torque = biquad_step(&out->notch, torque);
+    torque = biquad_step(&out->lowpass, torque);
+
+    if (out->max_step > 0) {
+        ffb_torque_t previous = out->output;
+        // Crossing zero: the fall to zero is free
+        if ((torque < 0 && previous > 0) || (torque > 0 && previous < 0)) previous = 0;
+        if (torque_abs(torque) > torque_abs(previous)) {
+            ffb_torque_t step = torque_sub(torque, previous);
+            if (step > out->max_step) step = out->max_step;
+            if (step < -out->max_step) step = -out->max_step;
+            torque = torque_add(previous, step);
+        }
+    }
+#if !FFB_FIXED_POINT
+    if (isnan(torque)) {
+        ffb_output_reset(out); // A NaN command would otherwise stay in the filter state
+        return 0.0f;
+    }
+#endif
+    out->output = torque;
+    return torque;
+}
@@ -0,0 +1,107 @@
+// ffb_output.h - Torque output stage run at the EtherCAT cycle rate
+//
+// The engine produces a torque when it runs (every cycle inline, 100 Hz in the main loop,
+// and the game only changes its effects at 60-400 Hz), while the drive is commanded every
+// cycle. Between the torque command and the PDO write, each drive's command passes through:
+//   1. Reconstruction: a new command is ramped to over the measured interval between
+//      commands instead of jumping to it. The ramp delays the torque by that interval; it is
+//      skipped when commands arrive every cycle.
+//   2. Notch and low-pass biquads, e.g. against motor cogging or a rim resonance.
+//   3. A slew limit on rising torque. Drops towards zero are not limited, so zero torque
+//      (emergency stop, pause, lost feedback) still takes effect in the next frame.
+// All state is in ffb_output_t; a step is a fixed number of multiply-adds. The torque is an
+// ffb_torque_t: in the integer build (FFB_FIXED_POINT) all three steps run on Q15.16, and
+// only the coefficients are computed in float, on configuration. The header does not depend
+// on SOEM.
+#ifndef FFB_OUTPUT_H
+#define FFB_OUTPUT_H
+
+#include <stdint.h>
+#include "ffb_fixed.h"
+
+// Commands further apart than this are not ramped over the whole gap (engine stalled)
+#define FFB_OUTPUT_MAX_INTERPOLATION_S  0.02f
+// Filter corners are kept below this fraction of the cycle rate
+#define FFB_OUTPUT_MAX_CORNER_FRACTION  0.45f
+#define FFB_OUTPUT_LOWPASS_Q            0.7071f     // Butterworth
+// Integer build: Q2.29 filter coefficients, and fraction bits of the smoothed interval
+#define FFB_OUTPUT_COEFF_SHIFT          29
+#define FFB_OUTPUT_INTERVAL_SHIFT       8
+
+typedef struct {
+    int interpolate;            // Ramp between commands slower than the cycle
+    float lowpass_hz;           // 0 = off
+    float notch_hz;             // 0 = off
+    float notch_q;              // Notch width: center frequency / bandwidth
+    float slew_rate;            // Torque units per second on rising torque, 0 = unlimited
+} ffb_output_config_t;
+
+#define FFB_OUTPUT_CONFIG_DEFAULT { \
+    .interpolate = 1, .lowpass_hz = 0.0f, .notch_hz = 0.0f, .notch_q = 2.0f, .slew_rate = 0.0f }
+
+// Second-order section, transposed direct form II. The integer state keeps the products
+// FFB_OUTPUT_COEFF_SHIFT bits finer than the torque.
+typedef struct {
+#if FFB_FIXED_POINT
+    int32_t b0, b1, b2, a1, a2;
+    int64_t z1, z2;
+#else
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+#endif
+    int enabled;
+} ffb_biquad_t;
+
+typedef struct {
+    float cycle_s;
+    int interpolate;
+    ffb_biquad_t notch;
+    ffb_biquad_t lowpass;
+    ffb_torque_t max_step;      // Slew limit per cycle, 0 = unlimited
+    uint32_t max_ramp_cycles;
+    uint32_t last_update;       // Command counter at the last new command
+    uint32_t cycles_since_update;
+#if FFB_FIXED_POINT
+    uint32_t update_interval;   // Smoothed cycles between commands, FFB_OUTPUT_INTERVAL_SHIFT fraction bits
+#else
+    float update_interval;      // Smoothed cycles between commands
+#endif
+    ffb_torque_t ramp_start;
+    ffb_torque_t ramp_target;
+    uint32_t ramp_cycles;
+    uint32_t ramp_done;
+    ffb_torque_t interpolated;  // Output of the reconstruction
+    ffb_torque_t output;        // Output of the whole stage
+} ffb_output_t;
+
+/**
+ * @brief Configures an output stage and clears its state to zero torque.
+ * @param out Stage to set up.
+ * @param cycle_s Cycle time the stage is stepped at, in seconds.
+ * @param config Filters and limits.
+ */
+void ffb_output_init(ffb_output_t *out, float cycle_s, const ffb_output_config_t *config);
+
+/**
+ * @brief Changes filters and limits while running, keeping the filter state so the torque
+ *        does not jump. Corners at or above FFB_OUTPUT_MAX_CORNER_FRACTION of the cycle rate
+ *        are lowered to it. Computes the coefficients (sin/cos), so call it only on changes.
+ */
+void ffb_output_configure(ffb_output_t *out, const ffb_output_config_t *config);
+
+/**
+ * @brief Clears the state to zero torque, e.g. while the drive is not enabled.
+ */
+void ffb_output_reset(ffb_output_t *out);
+
+/**
+ * @brief Runs one cycle of the stage.
+ * @param out Stage.
+ * @param command Latest torque command.
+ * @param update_count Incremented by the producer with every new command; a change starts
+ *                     a new ramp from the current value to command.
+ * @return Torque to write to the drive this cycle, in the units of command.
+ */
+ffb_torque_t ffb_output_step(ffb_output_t *out, ffb_torque_t command, uint32_t update_count);
+
+#endif // FFB_OUTPUT_H
@@ -0,0 +1,322 @@
+// ffb_pid_parser.c - USB PID output report parser with a report ID dispatch table
+#include "ffb_pid_parser.h"
+#include <string.h>
+#include <time.h>
+
+// Wire formats of the output reports. All fields are bytes as declared in the descriptor;
+// signed values are offset by 128, 16-bit values are split into low/high bytes.
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_EFFECT
+    uint8_t effect_block_index; // 1..FFB_MAX_EFFECTS
+    uint8_t effect_type;        // PID effect type, see map_pid_effect_type()
+    uint8_t duration_low;       // Duration in ms, 0 = infinite
+    uint8_t duration_high;
+    uint8_t start_delay_low;    // Delay before playing in ms
+    uint8_t start_delay_high;
+    uint8_t gain;               // 0-255
+} __attribute__((packed)) pid_set_effect_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_ENVELOPE
+    uint8_t effect_block_index;
+    uint8_t attack_level;       // 0-255
+    uint8_t fade_level;         // 0-255
+    uint8_t attack_time_low;    // ms
+    uint8_t attack_time_high;
+    uint8_t fade_time_low;      // ms
+    uint8_t fade_time_high;
+} __attribute__((packed)) pid_set_envelope_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_CONDITION
+    uint8_t effect_block_index;
+    uint8_t center;             // Signed, offset 128
+    uint8_t coefficient;        // 0-255
+    uint8_t saturation;         // 0-255, 0 = unlimited
+    uint8_t dead_band;          // 0-255
+} __attribute__((packed)) pid_set_condition_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_PERIODIC
+    uint8_t effect_block_index;
+    uint8_t magnitude;          // 0-255
+    uint8_t offset;             // Signed, offset 128
+    uint8_t phase;              // 0-255 = 0-360 degrees
+    uint8_t period_low;         // ms
+    uint8_t period_high;
+} __attribute__((packed)) pid_set_periodic_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_CONSTANT
+    uint8_t effect_block_index;
+    uint8_t magnitude_low;      // int16, -10000 to 10000
+    uint8_t magnitude_high;
+} __attribute__((packed)) pid_set_constant_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_SET_RAMP
+    uint8_t effect_block_index;
+    uint8_t ramp_start;         // Signed, offset 128
+    uint8_t ramp_end;           // Signed, offset 128
+} __attribute__((packed)) pid_set_ramp_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_EFFECT_OPERATION
+    uint8_t effect_block_index;
+    uint8_t operation;          // 1 = start, 2 = start solo, 3 = stop
+    uint8_t loop_count;         // FFB_LOOP_INFINITE = until stopped
+} __attribute__((packed)) pid_effect_operation_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_BLOCK_FREE
+    uint8_t effect_block_index;
+} __attribute__((packed)) pid_block_free_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_DEVICE_CONTROL
+    uint8_t control;            // See handle_device_control()
+} __attribute__((packed)) pid_device_control_report_t;
+
+typedef struct {
+    uint8_t report_id;          // FFB_PID_REPORT_DEVICE_GAIN
+    uint8_t gain;               // 0-255
+} __attribute__((packed)) pid_device_gain_report_t;
+
+// Handlers decode straight from the read buffer into the effect block and emit the result
+typedef int (*pid_report_handler_t)(const uint8_t *report, ffb_pid_emit_t emit, void *user_data);
+
+typedef struct {
+    pid_report_handler_t handler;
+    uint8_t min_length;
+} pid_report_entry_t;
+
+// Per-block state, updated field by field as reports arrive
+static ffb_motor_effect_t effect_blocks[FFB_MAX_EFFECTS];
+
+// Device-level operations carry no block state
+static ffb_motor_effect_t device_command;
+
+static inline float signed_byte(uint8_t value) {
+    return (value - 128) / 128.0f;
+}
+
+static inline float unsigned_byte(uint8_t value) {
+    return value / 255.0f;
+}
+
+static inline uint16_t le16(uint8_t low, uint8_t high) {
+    return (uint16_t)((high << 8) | low);
+}
+
+// Returns the addressed block, or NULL for an invalid index
+static inline ffb_motor_effect_t *get_block(uint8_t effect_block_index) {
+    if (effect_block_index < 1 || effect_block_index > FFB_MAX_EFFECTS) return NULL;
+    return &effect_blocks[effect_block_index - 1];
+}
+
+static void reset_block(ffb_motor_effect_t *effect, uint8_t effect_block_index) {
+    memset(effect, 0, sizeof(*effect));
+    effect->effect_block_index = effect_block_index;
+    effect->gain = 1.0f;
+    effect->loop_count = 1;
+}
+
+static inline int emit_block(ffb_motor_effect_t *effect, uint8_t report_id, ffb_effect_op_t operation,
+                             ffb_pid_emit_t emit, void *user_data) {
+    effect->report_id = report_id;
+    effect->operation = operation;
+    clock_gettime(CLOCK_REALTIME, &effect->received_time);
+    emit(effect, user_data);
+    return 1;
+}
+
+// Map a PID effect type (usage order of the PID effect types) to calculator type/waveform
+static int map_pid_effect_type(uint8_t pid_type, ffb_motor_effect_t *effect) {
+    switch (pid_type) {
+        case 1:  effect->type = FFB_EFFECT_CONSTANT_FORCE; break;
+        case 2:  effect->type = FFB_EFFECT_RAMP; break;
+        case 3:  effect->type = FFB_EFFECT_PERIODIC; effect->waveform = FFB_WAVEFORM_SQUARE; break;
+        case 4:  effect->type = FFB_EFFECT_PERIODIC; effect->waveform = FFB_WAVEFORM_SINE; break;
+        case 5:  effect->type = FFB_EFFECT_PERIODIC; effect->waveform = FFB_WAVEFORM_TRIANGLE; break;
+        case 6:  effect->type = FFB_EFFECT_PERIODIC; effect->waveform = FFB_WAVEFORM_SAWTOOTH_UP; break;
+        case 7:  effect->type = FFB_EFFECT_PERIODIC; effect->waveform = FFB_WAVEFORM_SAWTOOTH_DOWN; break;
+        case 8:  effect->type = FFB_EFFECT_SPRING; break;
+        case 9:  effect->type = FFB_EFFECT_DAMPER; break;
+        case 10: effect->type = FFB_EFFECT_INERTIA; break;
+        case 11: effect->type = FFB_EFFECT_FRICTION; break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static int handle_set_effect(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_effect_report_t *r = (const pid_set_effect_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    ffb_effect_type_t previous_type = effect->type;
+    uint8_t previous_waveform = effect->waveform;
+    if (!map_pid_effect_type(r->effect_type, effect)) {
+        effect->type = previous_type;
+        effect->waveform = previous_waveform;
+        return 0;
+    }
+    effect->effect_type = r->effect_type;
+    effect->duration_ms = le16(r->duration_low, r->duration_high);
+    effect->start_delay = le16(r->start_delay_low, r->start_delay_high);
+    effect->gain = unsigned_byte(r->gain);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_set_envelope(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_envelope_report_t *r = (const pid_set_envelope_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    effect->attack_level = unsigned_byte(r->attack_level);
+    effect->fade_level = unsigned_byte(r->fade_level);
+    effect->attack_time_ms = le16(r->attack_time_low, r->attack_time_high);
+    effect->fade_time_ms = le16(r->fade_time_low, r->fade_time_high);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_set_condition(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_condition_report_t *r = (const pid_set_condition_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    float coefficient = unsigned_byte(r->coefficient);
+    effect->spring_coefficient = coefficient;
+    effect->damper_coefficient = coefficient;
+    effect->inertia_coefficient = coefficient;
+    effect->friction_coefficient = coefficient;
+    effect->center_position = signed_byte(r->center);
+    effect->saturation = unsigned_byte(r->saturation);
+    effect->dead_band = unsigned_byte(r->dead_band);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_set_periodic(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_periodic_report_t *r = (const pid_set_periodic_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    effect->magnitude = unsigned_byte(r->magnitude);
+    effect->offset = signed_byte(r->offset);
+    effect->phase = r->phase * 360.0f / 256.0f;
+    effect->period_ms = le16(r->period_low, r->period_high);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_set_constant(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_constant_report_t *r = (const pid_set_constant_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    float magnitude = (int16_t)le16(r->magnitude_low, r->magnitude_high) / 10000.0f;
+    if (magnitude > 1.0f) magnitude = 1.0f;
+    if (magnitude < -1.0f) magnitude = -1.0f;
+    effect->magnitude = magnitude;
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_set_ramp(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_set_ramp_report_t *r = (const pid_set_ramp_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    effect->magnitude = signed_byte(r->ramp_start);
+    effect->ramp_end = signed_byte(r->ramp_end);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_UPDATE, emit, user_data);
+}
+
+static int handle_effect_operation(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_effect_operation_report_t *r = (const pid_effect_operation_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    ffb_effect_op_t operation;
+    switch (r->operation) {
+        case 1: operation = FFB_EFFECT_OP_START; break;
+        case 2: operation = FFB_EFFECT_OP_START_SOLO; break;
+        case 3: operation = FFB_EFFECT_OP_STOP; break;
+        default: return 0;
+    }
+    if (operation != FFB_EFFECT_OP_STOP) {
+        effect->loop_count = r->loop_count;
+    }
+    return emit_block(effect, r->report_id, operation, emit, user_data);
+}
+
+static int handle_block_free(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_block_free_report_t *r = (const pid_block_free_report_t *)report;
+    ffb_motor_effect_t *effect = get_block(r->effect_block_index);
+    if (!effect) return 0;
+
+    reset_block(effect, r->effect_block_index);
+    return emit_block(effect, r->report_id, FFB_EFFECT_OP_FREE, emit, user_data);
+}
+
+static int handle_device_control(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_device_control_report_t *r = (const pid_device_control_report_t *)report;
+    ffb_effect_op_t operation;
+
+    switch (r->control) {
+        case 1: operation = FFB_EFFECT_OP_ENABLE_ACTUATORS; break;
+        case 2: operation = FFB_EFFECT_OP_DISABLE_ACTUATORS; break;
+        case 3: operation = FFB_EFFECT_OP_STOP_ALL; break;
+        case 4: // Device reset frees every block
+            for (int i = 0; i < FFB_MAX_EFFECTS; i++) {
+                reset_block(&effect_blocks[i], (uint8_t)(i + 1));
+            }
+            operation = FFB_EFFECT_OP_FREE_ALL;
+            break;
+        case 5: operation = FFB_EFFECT_OP_PAUSE; break;
+        case 6: operation = FFB_EFFECT_OP_CONTINUE; break;
+        default: return 0;
+    }
+    return emit_block(&device_command, r->report_id, operation, emit, user_data);
+}
+
+static int handle_device_gain(const uint8_t *report, ffb_pid_emit_t emit, void *user_data) {
+    const pid_device_gain_report_t *r = (const pid_device_gain_report_t *)report;
+    device_command.magnitude = unsigned_byte(r->gain);
+    return emit_block(&device_command, r->report_id, FFB_EFFECT_OP_DEVICE_GAIN, emit, user_data);
+}
+
+// Indexed directly by report ID; unlisted IDs have no handler
+static const pid_report_entry_t report_table[256] = {
+    [FFB_PID_REPORT_SET_EFFECT]       = { handle_set_effect,       sizeof(pid_set_effect_report_t) },
+    [FFB_PID_REPORT_SET_ENVELOPE]     = { handle_set_envelope,     sizeof(pid_set_envelope_report_t) },
+    [FFB_PID_REPORT_SET_CONDITION]    = { handle_set_condition,    sizeof(pid_set_condition_report_t) },
+    [FFB_PID_REPORT_SET_PERIODIC]     = { handle_set_periodic,     sizeof(pid_set_periodic_report_t) },
+    [FFB_PID_REPORT_SET_CONSTANT]     = { handle_set_constant,     sizeof(pid_set_constant_report_t) },
+    [FFB_PID_REPORT_SET_RAMP]         = { handle_set_ramp,         sizeof(pid_set_ramp_report_t) },
+    [FFB_PID_REPORT_EFFECT_OPERATION] = { handle_effect_operation, sizeof(pid_effect_operation_report_t) },
+    [FFB_PID_REPORT_BLOCK_FREE]       = { handle_block_free,       sizeof(pid_block_free_report_t) },
+    [FFB_PID_REPORT_DEVICE_CONTROL]   = { handle_device_control,   sizeof(pid_device_control_report_t) },
+    [FFB_PID_REPORT_DEVICE_GAIN]      = { handle_device_gain,      sizeof(pid_device_gain_report_t) },
+};
+
+/**
+ * @brief Resets all effect blocks to their defaults.
+ */
+void ffb_pid_parser_init(void) {
+    for (int i = 0; i < FFB_MAX_EFFECTS; i++) {
+        reset_block(&effect_blocks[i], (uint8_t)(i + 1));
+    }
+    memset(&device_command, 0, sizeof(device_command));
+}
+
+/**
+ * @brief Decodes one output report straight into the addressed effect block.
+ */
+int ffb_pid_parser_parse(const uint8_t *report, size_t len, ffb_pid_emit_t emit, void *user_data) {
+    if (len < 1 || emit == NULL) return 0;
+
+    const pid_report_entry_t *entry = &report_table[report[0]];
+    if (entry->handler == NULL || len < entry->min_length) {
+        return 0; // Unknown or truncated report
+    }
+    return entry->handler(report, emit, user_data);
+}
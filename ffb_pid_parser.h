@@ -0,0 +1,43 @@
+// ffb_pid_parser.h - USB PID output report parser (host -> wheel force feedback commands)
+#ifndef FFB_PID_PARSER_H
+#define FFB_PID_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ffb_types.h"
+
+// Output report IDs (must match the report descriptor in create_ffb_gadget.sh)
+#define FFB_PID_REPORT_SET_EFFECT       3
+#define FFB_PID_REPORT_SET_ENVELOPE     4
+#define FFB_PID_REPORT_SET_CONDITION    5
+#define FFB_PID_REPORT_SET_PERIODIC     6
+#define FFB_PID_REPORT_SET_CONSTANT     7
+#define FFB_PID_REPORT_SET_RAMP         8
+#define FFB_PID_REPORT_EFFECT_OPERATION 9
+#define FFB_PID_REPORT_BLOCK_FREE       10
+#define FFB_PID_REPORT_DEVICE_CONTROL   11
+#define FFB_PID_REPORT_DEVICE_GAIN      12
+
+/**
+ * @brief Called for every effect block operation decoded from a report.
+ * @param effect Parser-owned block state; only valid during the call.
+ * @param user_data Pointer passed to ffb_pid_parser_parse().
+ */
+typedef void (*ffb_pid_emit_t)(const ffb_motor_effect_t *effect, void *user_data);
+
+/**
+ * @brief Resets all effect blocks to their defaults.
+ */
+void ffb_pid_parser_init(void);
+
+/**
+ * @brief Decodes one output report straight into the addressed effect block.
+ * @param report Raw report, byte 0 is the report ID.
+ * @param len Report length in bytes.
+ * @param emit Receives the resulting block operation(s).
+ * @param user_data Passed through to emit.
+ * @return Number of operations emitted, 0 if the report was ignored.
+ */
+int ffb_pid_parser_parse(const uint8_t *report, size_t len, ffb_pid_emit_t emit, void *user_data);
+
+#endif // FFB_PID_PARSER_H
@@ -0,0 +1,335 @@
+// ffb_profile.c - Per-game tuning profiles, swapped into the running engine without locks
+#include "ffb_profile.h"
+#include "rt_threads.h"
+#include "rt_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define PROFILE_SLOTS 3 // Published, in use by the reader, being written
+
+// Settings a profile file may contain, with their valid ranges
+typedef struct {
+    const char *key;
+    size_t offset;
+    float min;
+    float max;
+} profile_key_t;
+
+static const profile_key_t profile_keys[] = {
+    { "global_gain",               offsetof(ffb_profile_t, global_gain),               0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "constant_gain",             offsetof(ffb_profile_t, constant_gain),             0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "spring_gain",               offsetof(ffb_profile_t, spring_gain),               0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "damper_gain",               offsetof(ffb_profile_t, damper_gain),               0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "inertia_gain",              offsetof(ffb_profile_t, inertia_gain),              0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "friction_gain",             offsetof(ffb_profile_t, friction_gain),             0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "periodic_gain",             offsetof(ffb_profile_t, periodic_gain),             0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "ramp_gain",                 offsetof(ffb_profile_t, ramp_gain),                 0.0f,    FFB_PROFILE_GAIN_MAX },
+    { "max_torque",                offsetof(ffb_profile_t, max_torque),                FFB_PROFILE_MAX_TORQUE_FLOOR, FFB_PROFILE_MAX_TORQUE_CEILING },
+    { "steering_range_deg",        offsetof(ffb_profile_t, steering_range_deg),        90.0f,   1440.0f },
+    { "estimator_time_constant_s", offsetof(ffb_profile_t, estimator_time_constant_s), 0.0005f, 0.1f },
+    { "output_interpolate",        offsetof(ffb_profile_t, output_interpolate),        0.0f,    1.0f },
+    { "output_lowpass_hz",         offsetof(ffb_profile_t, output_lowpass_hz),         0.0f,    2000.0f },
+    { "output_notch_hz",           offsetof(ffb_profile_t, output_notch_hz),           0.0f,    2000.0f },
+    { "output_notch_q",            offsetof(ffb_profile_t, output_notch_q),            0.1f,    20.0f },
+    { "output_slew_rate",          offsetof(ffb_profile_t, output_slew_rate),          0.0f,    10000000.0f },
+    { "safety_ramp_ms",            offsetof(ffb_profile_t, safety_ramp_ms),            0.0f,    1000.0f },
+    { "safety_hid_timeout_ms",     offsetof(ffb_profile_t, safety_hid_timeout_ms),     0.0f,    10000.0f },
+    { "safety_engine_timeout_ms",  offsetof(ffb_profile_t, safety_engine_timeout_ms),  0.0f,    10000.0f },
+    { "safety_wkc_timeout_ms",     offsetof(ffb_profile_t, safety_wkc_timeout_ms),     1.0f,    1000.0f },
+};
+#define PROFILE_KEY_COUNT (sizeof(profile_keys) / sizeof(profile_keys[0]))
+
+static ffb_profile_t slots[PROFILE_SLOTS] = { FFB_PROFILE_DEFAULT, FFB_PROFILE_DEFAULT, FFB_PROFILE_DEFAULT };
+static _Atomic(ffb_profile_t *) published = &slots[0];
+static _Atomic(ffb_profile_t *) reader_hazard = NULL;    // Slot the engine thread is using
+static uint32_t generation = 0;
+
+// Writer side: publish, the profile files and the reload thread's view of them
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    char path[256];
+    struct timespec mtime;
+    ffb_profile_t profile;
+} profile_file_t;
+
+static profile_file_t *files = NULL;   // FFB_PROFILE_MAX_FILES entries in the arena, from the first add
+static int file_count = 0;
+static int selected_file = -1;
+
+static pthread_t watch_thread;
+static atomic_int watch_running = 0;
+
+static float *profile_field(ffb_profile_t *profile, const profile_key_t *key) {
+    return (float *)((char *)profile + key->offset);
+}
+
+static int check_ranges(const ffb_profile_t *profile) {
+    for (size_t i = 0; i < PROFILE_KEY_COUNT; i++) {
+        float value = *(const float *)((const char *)profile + profile_keys[i].offset);
+        if (!(value >= profile_keys[i].min && value <= profile_keys[i].max)) {
+            printf("FFB_Profile: '%s': %s = %g is outside %g..%g\n", profile->name, profile_keys[i].key,
+                   value, profile_keys[i].min, profile_keys[i].max);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+// Profile name from the file name: directory and extension stripped
+static void name_from_path(const char *path, char *name) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = strcspn(base, ".");
+    if (len >= FFB_PROFILE_NAME_MAX) len = FFB_PROFILE_NAME_MAX - 1;
+    memcpy(name, base, len);
+    name[len] = '\0';
+}
+
+/**
+ * @brief Reads a profile file on top of the built-in defaults.
+ */
+int ffb_profile_load(const char *path, ffb_profile_t *profile_out) {
+    ffb_profile_t profile = FFB_PROFILE_DEFAULT;
+    char line[256];
+    int line_number = 0;
+    int result = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        printf("FFB_Profile: Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    name_from_path(path, profile.name);
+
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        line[strcspn(line, "#\n")] = '\0';
+        char *key = trim(line);
+        if (*key == '\0') continue;
+
+        char *equals = strchr(key, '=');
+        if (!equals) {
+            printf("FFB_Profile: %s:%d: expected key = value\n", path, line_number);
+            result = -1;
+            continue;
+        }
+        *equals = '\0';
+        char *value = trim(equals + 1);
+        key = trim(key);
+
+        if (strcmp(key, "name") == 0) {
+            snprintf(profile.name, sizeof(profile.name), "%s", value);
+            continue;
+        }
+        size_t i;
+        for (i = 0; i < PROFILE_KEY_COUNT; i++) {
+            if (strcmp(key, profile_keys[i].key) == 0) break;
+        }
+        if (i == PROFILE_KEY_COUNT) {
+            printf("FFB_Profile: %s:%d: unknown key '%s' ignored\n", path, line_number, key);
+            continue;
+        }
+        char *end;
+        float number = strtof(value, &end);
+        if (end == value || *end != '\0') {
+            printf("FFB_Profile: %s:%d: %s needs a number\n", path, line_number, key);
+            result = -1;
+            continue;
+        }
+        *profile_field(&profile, &profile_keys[i]) = number;
+    }
+    fclose(f);
+
+    if (result != 0 || check_ranges(&profile) != 0) {
+        printf("FFB_Profile: %s not loaded\n", path);
+        return -1;
+    }
+    *profile_out = profile;
+    return 0;
+}
+
+// Copy into a slot the engine can neither be using nor pick up, then swap the pointer.
+// With three slots one is always free. The reader re-checks the published pointer after
+// setting its hazard (see ffb_profile_acquire()), so once it holds a slot no writer can
+// choose that slot until the reader moves on.
+static void publish_locked(const ffb_profile_t *profile) {
+    ffb_profile_t *current = atomic_load(&published);
+    ffb_profile_t *in_use = atomic_load(&reader_hazard);
+    ffb_profile_t *slot = &slots[0];
+    while (slot == current || slot == in_use) slot++;
+
+    *slot = *profile;
+    slot->generation = ++generation;
+    atomic_store(&published, slot);
+}
+
+/**
+ * @brief Makes a profile the active one; the engine picks it up at its next cycle.
+ */
+int ffb_profile_publish(const ffb_profile_t *profile) {
+    if (check_ranges(profile) != 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&writer_lock);
+    publish_locked(profile);
+    pthread_mutex_unlock(&writer_lock);
+    return 0;
+}
+
+/**
+ * @brief Returns the active profile (engine thread only).
+ */
+const ffb_profile_t *ffb_profile_acquire(void) {
+    ffb_profile_t *profile = atomic_load(&published);
+    for (;;) {
+        atomic_store(&reader_hazard, profile);
+        ffb_profile_t *again = atomic_load(&published);
+        if (again == profile) {
+            return profile;
+        }
+        profile = again; // A publish slipped in between
+    }
+}
+
+/**
+ * @brief Copies the last published profile.
+ */
+void ffb_profile_get_current(ffb_profile_t *profile_out) {
+    pthread_mutex_lock(&writer_lock);
+    *profile_out = *atomic_load(&published);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+static int file_mtime(const char *path, struct timespec *mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    *mtime = st.st_mtim;
+    return 0;
+}
+
+/**
+ * @brief Loads a profile file and adds it to the profiles cycled by ffb_profile_select_next().
+ */
+int ffb_profile_add_file(const char *path) {
+    if (file_count == FFB_PROFILE_MAX_FILES) {
+        printf("FFB_Profile: At most %d profiles, %s ignored\n", FFB_PROFILE_MAX_FILES, path);
+        return -1;
+    }
+    if (strlen(path) >= sizeof(((profile_file_t *)0)->path)) {
+        printf("FFB_Profile: Path too long: %s\n", path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    if (!files) {
+        files = rt_arena_alloc(FFB_PROFILE_MAX_FILES * sizeof(*files), "profile files");
+    }
+    profile_file_t *file = &files[file_count];
+    strcpy(file->path, path);
+    if (file_mtime(path, &file->mtime) != 0 || ffb_profile_load(path, &file->profile) != 0) {
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    if (selected_file < 0) {
+        selected_file = file_count;
+        publish_locked(&file->profile);
+    }
+    file_count++;
+    pthread_mutex_unlock(&writer_lock);
+
+    printf("FFB_Profile: Profile %d '%s' from %s\n", file_count, file->profile.name, path);
+    return 0;
+}
+
+/**
+ * @brief Publishes the next profile file in the order they were added.
+ */
+int ffb_profile_select_next(void) {
+    pthread_mutex_lock(&writer_lock);
+    if (file_count == 0) {
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    selected_file = (selected_file + 1) % file_count;
+    publish_locked(&files[selected_file].profile);
+    int selected = selected_file;
+    pthread_mutex_unlock(&writer_lock);
+    return selected;
+}
+
+// Re-read profile files whose modification time changed. A file that no longer parses keeps
+// its previous profile, so a half-saved edit never reaches the wheel.
+static void *profile_watch_thread(void *arg) {
+    (void)arg;
+    struct timespec period = { 0, FFB_PROFILE_RELOAD_CHECK_MS * 1000000L };
+
+    while (atomic_load(&watch_running)) {
+        nanosleep(&period, NULL);
+
+        for (int i = 0; i < file_count; i++) {
+            struct timespec mtime;
+            ffb_profile_t profile;
+            if (file_mtime(files[i].path, &mtime) != 0 ||
+                (mtime.tv_sec == files[i].mtime.tv_sec && mtime.tv_nsec == files[i].mtime.tv_nsec)) {
+                continue;
+            }
+            files[i].mtime = mtime;
+            if (ffb_profile_load(files[i].path, &profile) != 0) {
+                continue;
+            }
+
+            pthread_mutex_lock(&writer_lock);
+            files[i].profile = profile;
+            if (i == selected_file) {
+                publish_locked(&profile);
+            }
+            pthread_mutex_unlock(&writer_lock);
+            printf("FFB_Profile: Reloaded '%s'%s\n", profile.name, i == selected_file ? " (active)" : "");
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the background thread that re-reads changed profile files.
+ */
+int ffb_profile_watch_start(void) {
+    if (file_count == 0) {
+        return 0;
+    }
+    atomic_store(&watch_running, 1);
+    int ret = rt_threads_create(RT_THREAD_BACKGROUND, &watch_thread, profile_watch_thread, NULL);
+    if (ret != 0) {
+        printf("FFB_Profile: Failed to create the reload thread: %s\n", strerror(ret));
+        atomic_store(&watch_running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the reload thread.
+ */
+void ffb_profile_watch_stop(void) {
+    if (atomic_exchange(&watch_running, 0)) {
+        pthread_join(watch_thread, NULL);
+    }
+}
@@ -0,0 +1,160 @@
+// ffb_profile.h - Per-game tuning profiles, swapped into the running engine without locks
+//
+// A profile holds what used to be compile-time constants of the effect engine: the global
+// gain, a gain per effect type, the torque limit, the steering range, the estimator's
+// filter memory, the output stage filters (ffb_output.h) and the safety deadlines
+// (soem_safety.h). Profiles are read from "key = value" files (see ffb_profile_example.conf).
+//
+// The engine thread calls ffb_profile_acquire() once per cycle and uses the returned profile
+// until its next call, so a new profile always takes effect at a cycle boundary. Publishing
+// copies the profile into one of three slots and swaps a pointer; the reader announces the
+// slot it uses (a hazard pointer) and a writer never reuses that slot or the published one,
+// so the reader neither locks nor waits. Writers (main loop keys, the reload thread) are
+// serialized by a mutex.
+#ifndef FFB_PROFILE_H
+#define FFB_PROFILE_H
+
+#include <stdint.h>
+#include "ffb_output.h"
+#include "soem_safety.h"
+
+#define FFB_PROFILE_NAME_MAX            32
+#define FFB_PROFILE_MAX_FILES           8       // Profiles given with -P, cycled with Ctrl+P
+#define FFB_PROFILE_RELOAD_CHECK_MS     500     // Profile files are re-read when they change
+#define FFB_PROFILE_GAIN_MAX            4.0f
+// Torque limits above this would reach the emergency stop threshold in main.c
+#define FFB_PROFILE_MAX_TORQUE_CEILING  8000.0f
+// The drive's torque full scale must be positive (soem_interface_set_torque_full_scale())
+#define FFB_PROFILE_MAX_TORQUE_FLOOR    1.0f
+#define FFB_PROFILE_TORQUE_LIMIT_MARGIN 1.05f   // Supervisor hard limit, relative to max_torque
+
+typedef struct {
+    uint32_t generation;                // Set by ffb_profile_publish(), differs for every swap
+    char name[FFB_PROFILE_NAME_MAX];
+    float global_gain;                  // Applied to the summed torque, on top of the host's device gain
+    // Per effect type, multiplying the fixed unit scale of each effect in ffb_calculator.c
+    float constant_gain;
+    float spring_gain;
+    float damper_gain;
+    float inertia_gain;
+    float friction_gain;
+    float periodic_gain;
+    float ramp_gain;
+    float max_torque;                   // Engine output limit, motor command units
+    float steering_range_deg;           // Lock to one side: HID axis full scale and spring range
+    float estimator_time_constant_s;    // Velocity/acceleration filter memory (ffb_estimator.h)
+    // Output stage in the EtherCAT cycle (ffb_output_config_t)
+    float output_interpolate;           // 1 = ramp between engine updates, 0 = hold
+    float output_lowpass_hz;            // 0 = off
+    float output_notch_hz;              // 0 = off
+    float output_notch_q;
+    float output_slew_rate;             // Torque units per second, 0 = unlimited
+    // Safety supervisor in the EtherCAT cycle (soem_safety_config_t), milliseconds
+    float safety_ramp_ms;               // Torque ramp on soft faults and after a reset
+    float safety_hid_timeout_ms;        // 0 = not supervised
+    float safety_engine_timeout_ms;     // 0 = not supervised
+    float safety_wkc_timeout_ms;
+} ffb_profile_t;
+
+// The built-in tuning, used until a profile is published
+#define FFB_PROFILE_DEFAULT {                   \
+    .generation = 0,                            \
+    .name = "default",                          \
+    .global_gain = 1.0f,                        \
+    .constant_gain = 1.0f,                      \
+    .spring_gain = 0.8f,                        \
+    .damper_gain = 1.0f,                        \
+    .inertia_gain = 0.5f,                       \
+    .friction_gain = 1.0f,                      \
+    .periodic_gain = 1.0f,                      \
+    .ramp_gain = 1.0f,                          \
+    .max_torque = 5000.0f,                      \
+    .steering_range_deg = 540.0f,               \
+    .estimator_time_constant_s = 0.004f,        /* FFB_ESTIMATOR_TIME_CONSTANT_S */ \
+    .output_interpolate = 1.0f,                 \
+    .output_lowpass_hz = 0.0f,                  \
+    .output_notch_hz = 0.0f,                    \
+    .output_notch_q = 2.0f,                     \
+    .output_slew_rate = 0.0f,                   \
+    .safety_ramp_ms = 50.0f,                    /* SOEM_SAFETY_CONFIG_DEFAULT */ \
+    .safety_hid_timeout_ms = 100.0f,            \
+    .safety_engine_timeout_ms = 50.0f,          \
+    .safety_wkc_timeout_ms = 10.0f,             \
+}
+
+/**
+ * @brief Output stage settings of a profile, for soem_interface_set_output_config().
+ */
+static inline void ffb_profile_output_config(const ffb_profile_t *profile, ffb_output_config_t *config_out) {
+    config_out->interpolate = profile->output_interpolate >= 0.5f;
+    config_out->lowpass_hz = profile->output_lowpass_hz;
+    config_out->notch_hz = profile->output_notch_hz;
+    config_out->notch_q = profile->output_notch_q;
+    config_out->slew_rate = profile->output_slew_rate;
+}
+
+/**
+ * @brief Safety deadlines and torque limit of a profile, for soem_interface_set_safety_config().
+ *        The engine clamps to max_torque, so a command beyond it plus a small margin is a bug.
+ */
+static inline void ffb_profile_safety_config(const ffb_profile_t *profile, soem_safety_config_t *config_out) {
+    config_out->ramp_ms = (uint32_t)(profile->safety_ramp_ms + 0.5f);
+    config_out->hid_timeout_ms = (uint32_t)(profile->safety_hid_timeout_ms + 0.5f);
+    config_out->engine_timeout_ms = (uint32_t)(profile->safety_engine_timeout_ms + 0.5f);
+    config_out->wkc_timeout_ms = (uint32_t)(profile->safety_wkc_timeout_ms + 0.5f);
+    config_out->torque_limit = profile->max_torque * FFB_PROFILE_TORQUE_LIMIT_MARGIN;
+}
+
+/**
+ * @brief Reads a profile file on top of the built-in defaults. Unknown keys are reported and
+ *        skipped; the profile name defaults to the file name.
+ * @param path Profile file.
+ * @param profile_out Filled in on success.
+ * @return 0 on success, -1 if the file cannot be read or a value is out of range.
+ */
+int ffb_profile_load(const char *path, ffb_profile_t *profile_out);
+
+/**
+ * @brief Makes a profile the active one; the engine picks it up at its next cycle.
+ * @param profile Profile to copy; its generation is ignored.
+ * @return 0 on success, -1 if a value is out of range (the active profile stays).
+ */
+int ffb_profile_publish(const ffb_profile_t *profile);
+
+/**
+ * @brief Returns the active profile. Engine thread only: the profile stays valid and unchanged
+ *        until the next call. Never blocks; it only loops again when a publish races with it.
+ */
+const ffb_profile_t *ffb_profile_acquire(void);
+
+/**
+ * @brief Copies the last published profile (any thread except the engine's cycle).
+ */
+void ffb_profile_get_current(ffb_profile_t *profile_out);
+
+/**
+ * @brief Loads a profile file and adds it to the profiles cycled by ffb_profile_select_next().
+ *        The first file added is published right away. Call before ffb_profile_watch_start().
+ * @return 0 on success, -1 if the file is invalid or too many files were added.
+ */
+int ffb_profile_add_file(const char *path);
+
+/**
+ * @brief Publishes the next profile file in the order they were added.
+ * @return Index of the published profile, or -1 if no files were added.
+ */
+int ffb_profile_select_next(void);
+
+/**
+ * @brief Starts the background thread that re-reads profile files when they change and
+ *        publishes the selected one again. Does nothing when no files were added.
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int ffb_profile_watch_start(void);
+
+/**
+ * @brief Stops the reload thread.
+ */
+void ffb_profile_watch_stop(void);
+
+#endif // FFB_PROFILE_H
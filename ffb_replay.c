@@ -0,0 +1,387 @@
+// ffb_replay.c - Runs the FFB pipeline offline against a simulated wheel
+//
+// Feeds a recorded HID output report stream (ffb_app -R, see ffb_capture.h) or a built-in
+// scenario through the PID parser, the effect queue and the FFB calculator, closing the loop
+// with the plant in soem_interface_mock.c. Simulated time advances one EtherCAT cycle per
+// step, so the run is deterministic and as fast as the host allows.
+//
+// Usage: ffb_replay [-c cycle_us] [-d extra_s] [-n repeats] [-o out.csv] [-C reference.csv]
+//                   [-t tolerance] [-F positions.csv] [-P profile] [capture_file]
+//   -c  simulated EtherCAT cycle (default 1000 us)
+//   -d  keep running this long after the last report (default 1 s)
+//   -n  repeat the replay to collect more timing samples; every run must give the same hash
+//   -o  write cycle, time, position, velocity, torque and active mask per cycle
+//   -C  compare the torque against a CSV written by -o; exits 1 above the tolerance
+//   -t  comparison tolerance in torque units (default 0.01)
+//   -F  open loop: feed the engine the positions of a CSV written by -o instead of the
+//       simulated wheel's, so -C compares two builds (e.g. make FIXED=1) on the same input
+//   -P  tuning profile file as given to ffb_app -P (default: the built-in tuning)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "ffb_calculator.h"
+#include "ffb_capture.h"
+#include "ffb_effect_queue.h"
+#include "ffb_estimator.h"
+#include "ffb_pid_parser.h"
+#include "ffb_profile.h"
+#include "soem_interface_mock.h"
+
+// Matches main.c: condition centers and dead bands are normalized to full steering lock
+#define REPLAY_COUNTS_PER_DEGREE (65536.0f / 360.0f)
+#define REPLAY_COUNTS_PER_SECOND_TO_RPM (60.0f / (float)SOEM_MOCK_COUNTS_PER_REV)
+
+typedef struct {
+    float position;
+    float velocity;
+    float torque;
+    uint64_t active_mask;
+} replay_sample_t;
+
+static ffb_profile_t replay_profile = FFB_PROFILE_DEFAULT;
+
+// Positions per cycle from -F, NULL = closed loop with the simulated wheel
+static int32_t *follow_positions = NULL;
+static uint32_t follow_count = 0;
+
+// Hand-off from the parser like the HID reception thread does
+static void emit_effect(const ffb_motor_effect_t *effect, void *user_data) {
+    (void)user_data;
+    ffb_effect_queue_push(effect);
+}
+
+static uint64_t wall_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void add_report(ffb_capture_report_t *reports, size_t *count, uint64_t time_ms, int length, ...) {
+    va_list args;
+    ffb_capture_report_t *r = &reports[(*count)++];
+    r->time_us = time_ms * 1000ULL;
+    r->length = (uint8_t)length;
+    va_start(args, length);
+    for (int i = 0; i < length; i++) {
+        r->data[i] = (uint8_t)va_arg(args, int);
+    }
+    va_end(args);
+}
+
+// Built-in 12 s scenario: spring, damper and friction all the time, kicks of constant force,
+// a sine burst, a 100 Hz stream of constant force updates (like a game) and a ramp
+static ffb_capture_report_t *build_scenario(size_t *count) {
+    ffb_capture_report_t *reports = calloc(1024, sizeof(*reports));
+    size_t n = 0;
+    if (!reports) return NULL;
+
+    add_report(reports, &n, 0, 2, 11, 4);                       // Device reset
+    add_report(reports, &n, 0, 2, 11, 1);                       // Enable actuators
+    add_report(reports, &n, 0, 2, 12, 230);                     // Device gain
+    // Block 1: spring, block 2: damper, block 3: friction (infinite)
+    add_report(reports, &n, 0, 8, 3, 1, 8, 0, 0, 0, 0, 255);
+    add_report(reports, &n, 0, 6, 5, 1, 128, 180, 0, 4);
+    add_report(reports, &n, 0, 8, 3, 2, 9, 0, 0, 0, 0, 200);
+    add_report(reports, &n, 0, 6, 5, 2, 128, 90, 0, 0);
+    add_report(reports, &n, 0, 8, 3, 3, 11, 0, 0, 0, 0, 255);
+    add_report(reports, &n, 0, 6, 5, 3, 128, 50, 0, 0);
+    for (int block = 1; block <= 3; block++) {
+        add_report(reports, &n, 0, 4, 9, block, 1, 255);
+    }
+    // Block 4: 300 ms constant force kicks, alternating direction
+    for (int i = 0; i < 5; i++) {
+        int16_t magnitude = (i & 1) ? -7000 : 7000;
+        uint64_t t = 500 + (uint64_t)i * 2000;
+        add_report(reports, &n, t, 8, 3, 4, 1, 300 & 0xFF, 300 >> 8, 0, 0, 255);
+        add_report(reports, &n, t, 4, 7, 4, magnitude & 0xFF, (magnitude >> 8) & 0xFF);
+        add_report(reports, &n, t, 4, 9, 4, 1, 1);
+    }
+    // Block 5: 40 Hz sine, 1.5 s with attack and fade
+    add_report(reports, &n, 1500, 8, 3, 5, 4, 1500 & 0xFF, 1500 >> 8, 0, 0, 255);
+    add_report(reports, &n, 1500, 7, 6, 5, 160, 128, 0, 25, 0);
+    add_report(reports, &n, 1500, 8, 4, 5, 0, 0, 200, 0, 200, 0);
+    add_report(reports, &n, 1500, 4, 9, 5, 1, 1);
+    // Block 6: constant force streamed at 100 Hz from 4 s to 6 s
+    add_report(reports, &n, 4000, 8, 3, 6, 1, 0, 0, 0, 0, 255);
+    add_report(reports, &n, 4000, 4, 9, 6, 1, 255);
+    for (int i = 0; i < 200; i++) {
+        int16_t magnitude = (int16_t)(4000.0 * sin(i * 0.1));
+        add_report(reports, &n, 4000 + (uint64_t)i * 10, 4, 7, 6, magnitude & 0xFF, (magnitude >> 8) & 0xFF);
+    }
+    add_report(reports, &n, 6000, 4, 9, 6, 3, 0);
+    add_report(reports, &n, 6000, 2, 10, 6);
+    // Block 7: 1 s ramp
+    add_report(reports, &n, 8000, 8, 3, 7, 2, 1000 & 0xFF, 1000 >> 8, 0, 0, 255);
+    add_report(reports, &n, 8000, 4, 8, 7, 28, 228);
+    add_report(reports, &n, 8000, 4, 9, 7, 1, 1);
+    add_report(reports, &n, 11000, 2, 11, 3);                   // Stop all
+
+    *count = n;
+    return reports;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// One complete replay; returns the FNV-1a hash of the torque sequence
+static uint64_t run_replay(const ffb_capture_report_t *reports, size_t report_count, uint32_t cycles,
+                           replay_sample_t *samples, uint32_t *cycle_ns) {
+    soem_mock_plant_t plant = SOEM_MOCK_PLANT_DEFAULT;
+    size_t next_report = 0;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    soem_interface_init_enhanced("mock");
+    soem_interface_mock_set_plant(&plant);
+    ffb_calculator_init();
+    ffb_calculator_set_profile(&replay_profile);
+    ffb_output_config_t output_config;
+    ffb_profile_output_config(&replay_profile, &output_config);
+    soem_interface_set_output_config(&output_config);
+    ffb_calculator_set_clock(soem_interface_mock_time_ns);
+    ffb_calculator_set_input_range(REPLAY_COUNTS_PER_DEGREE * replay_profile.steering_range_deg, 0.0f);
+    ffb_pid_parser_init();
+    ffb_effect_queue_init();
+    ffb_estimator_t estimator;
+    float cycle_s = soem_interface_get_cycle_time() * 1e-6f;
+    ffb_estimator_init(&estimator, cycle_s, replay_profile.estimator_time_constant_s, cycle_s);
+
+    for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+        uint64_t now_us = soem_interface_mock_time_ns() / 1000ULL;
+        while (next_report < report_count && reports[next_report].time_us <= now_us) {
+            ffb_pid_parser_parse(reports[next_report].data, reports[next_report].length, emit_effect, NULL);
+            next_report++;
+        }
+
+        // Same steps as run_ffb_engine() in main.c, without the HID and safety parts
+        uint64_t start_ns = wall_time_ns();
+        soem_pdo_snapshot_t sample;
+        ffb_motor_effect_t effect;
+        soem_interface_get_pdo_snapshot(&sample);
+        if (follow_positions) {
+            sample.position = follow_positions[cycle < follow_count ? cycle : follow_count - 1];
+        }
+        while (ffb_effect_queue_pop(&effect)) {
+            ffb_calculator_process_effect(&effect);
+        }
+        ffb_estimate_t estimate;
+        ffb_estimator_update(&estimator, &sample);
+        ffb_estimator_predict(&estimator, 0.0f, &estimate);
+        float velocity = estimate.velocity * REPLAY_COUNTS_PER_SECOND_TO_RPM;
+#if FFB_FIXED_POINT
+        ffb_calculator_update_fixed(ffb_fixed_from_int(sample.position, FFB_FIXED_POSITION_SHIFT),
+                                    ffb_fixed_from_float(velocity, FFB_FIXED_VELOCITY_SHIFT),
+                                    ffb_fixed_from_float(estimate.acceleration * REPLAY_COUNTS_PER_SECOND_TO_RPM,
+                                                         FFB_FIXED_ACCELERATION_SHIFT));
+#else
+        ffb_calculator_update((float)sample.position, velocity, estimate.acceleration * REPLAY_COUNTS_PER_SECOND_TO_RPM);
+#endif
+        float torque = ffb_calculator_get_torque();
+        cycle_ns[cycle] = (uint32_t)(wall_time_ns() - start_ns);
+
+        soem_interface_send_and_receive_pdo(ffb_calculator_get_torque_command());
+        soem_interface_mock_step();
+
+        samples[cycle].position = (float)sample.position;
+        samples[cycle].velocity = velocity;
+        samples[cycle].torque = torque;
+        samples[cycle].active_mask = ffb_calculator_get_active_mask();
+
+        uint32_t bits;
+        memcpy(&bits, &torque, sizeof(bits));
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((bits >> (8 * i)) & 0xFF)) * 0x100000001b3ULL;
+        }
+    }
+
+    soem_interface_stop_master();
+    return hash;
+}
+
+static int write_csv(const char *filename, const replay_sample_t *samples, uint32_t cycles, uint32_t cycle_us) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        perror("Failed to create output CSV");
+        return -1;
+    }
+    fprintf(f, "cycle,time_ms,position,velocity,torque,active_mask\n");
+    for (uint32_t i = 0; i < cycles; i++) {
+        fprintf(f, "%u,%.3f,%.0f,%.0f,%.6f,0x%010" PRIx64 "\n", i, i * cycle_us / 1000.0,
+                samples[i].position, samples[i].velocity, samples[i].torque, samples[i].active_mask);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Positions column of a CSV written by -o, for -F
+static int load_positions(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror("Failed to open positions CSV");
+        return -1;
+    }
+    char line[256];
+    uint32_t capacity = 0;
+
+    fgets(line, sizeof(line), f); // Header
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int cycle;
+        double time_ms, position;
+        if (sscanf(line, "%u,%lf,%lf", &cycle, &time_ms, &position) != 3 || cycle != follow_count) continue;
+        if (follow_count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            int32_t *grown = realloc(follow_positions, capacity * sizeof(*grown));
+            if (!grown) {
+                fclose(f);
+                return -1;
+            }
+            follow_positions = grown;
+        }
+        follow_positions[follow_count++] = (int32_t)position;
+    }
+    fclose(f);
+
+    if (follow_count == 0) {
+        fprintf(stderr, "Replay: no positions in %s\n", filename);
+        return -1;
+    }
+    printf("Replay: open loop, %u positions from %s\n", follow_count, filename);
+    return 0;
+}
+
+// Returns 0 if every cycle is within tolerance, 1 if not, -1 on error
+static int compare_csv(const char *filename, const replay_sample_t *samples, uint32_t cycles, double tolerance) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror("Failed to open reference CSV");
+        return -1;
+    }
+    char line[256];
+    uint32_t compared = 0, over = 0;
+    long first_over = -1;
+    double max_diff = 0.0;
+
+    fgets(line, sizeof(line), f); // Header
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int cycle;
+        double time_ms, position, velocity, torque;
+        if (sscanf(line, "%u,%lf,%lf,%lf,%lf", &cycle, &time_ms, &position, &velocity, &torque) != 5) continue;
+        if (cycle >= cycles) break;
+        double diff = fabs(torque - samples[cycle].torque);
+        if (diff > max_diff) max_diff = diff;
+        if (diff > tolerance) {
+            if (first_over < 0) first_over = cycle;
+            over++;
+        }
+        compared++;
+    }
+    fclose(f);
+
+    printf("Reference: %u cycles compared, max torque difference %.6f, %u above %.4f", compared, max_diff, over, tolerance);
+    if (first_over >= 0) printf(" (first at cycle %ld)", first_over);
+    printf("\n");
+    if (compared != cycles) {
+        printf("Reference: length differs (%u of %u cycles)\n", compared, cycles);
+        return 1;
+    }
+    return over ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    uint32_t cycle_us = SOEM_CYCLE_TIME_DEFAULT_US;
+    double extra_s = 1.0;
+    int repeats = 1;
+    double tolerance = 0.01;
+    const char *out_path = NULL;
+    const char *reference_path = NULL;
+    const char *follow_path = NULL;
+
+    while ((opt = getopt(argc, argv, "c:d:n:o:C:t:F:P:h")) != -1) {
+        switch (opt) {
+            case 'c': cycle_us = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'd': extra_s = atof(optarg); break;
+            case 'n': repeats = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'C': reference_path = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            case 'F': follow_path = optarg; break;
+            case 'P':
+                if (ffb_profile_load(optarg, &replay_profile) != 0) return EXIT_FAILURE;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-c cycle_us] [-d extra_s] [-n repeats] [-o out.csv] "
+                                "[-C reference.csv] [-t tolerance] [-F positions.csv] [-P profile] [capture_file]\n", argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (soem_interface_set_cycle_time(cycle_us) != 0 || repeats < 1 || extra_s < 0.0) {
+        return EXIT_FAILURE;
+    }
+    if (follow_path && load_positions(follow_path) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    ffb_capture_report_t *reports;
+    size_t report_count;
+    if (optind < argc) {
+        if (ffb_capture_load(argv[optind], &reports, &report_count) != 0) return EXIT_FAILURE;
+        printf("Replay: %zu reports from %s\n", report_count, argv[optind]);
+    } else {
+        reports = build_scenario(&report_count);
+        if (!reports) return EXIT_FAILURE;
+        printf("Replay: built-in scenario, %zu reports\n", report_count);
+    }
+
+    uint64_t end_us = (report_count ? reports[report_count - 1].time_us : 0) + (uint64_t)(extra_s * 1e6);
+    uint32_t cycles = (uint32_t)(end_us / cycle_us) + 1;
+    replay_sample_t *samples = malloc((size_t)cycles * sizeof(*samples));
+    uint32_t *cycle_ns = malloc((size_t)cycles * repeats * sizeof(*cycle_ns));
+    if (!samples || !cycle_ns) {
+        fprintf(stderr, "Replay: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t first_hash = 0;
+    int deterministic = 1;
+    uint64_t wall_start = wall_time_ns();
+    for (int r = 0; r < repeats; r++) {
+        uint64_t hash = run_replay(reports, report_count, cycles, samples, cycle_ns + (size_t)r * cycles);
+        if (r == 0) first_hash = hash;
+        else if (hash != first_hash) deterministic = 0;
+    }
+    double wall_s = (wall_time_ns() - wall_start) / 1e9;
+
+    size_t total = (size_t)cycles * repeats;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < total; i++) sum += cycle_ns[i];
+    qsort(cycle_ns, total, sizeof(*cycle_ns), compare_u32);
+
+    double simulated_s = cycles * cycle_us * 1e-6;
+    printf("Replay: %u cycles of %u us (%.1f s simulated) x %d in %.3f s, %.0fx real time\n",
+           cycles, cycle_us, simulated_s, repeats, wall_s, simulated_s * repeats / wall_s);
+    printf("Engine cycle: avg %.0f ns, p50 %u ns, p99 %u ns, p99.9 %u ns, max %u ns\n",
+           (double)sum / total, cycle_ns[total / 2], cycle_ns[(size_t)(total * 0.99)],
+           cycle_ns[(size_t)(total * 0.999)], cycle_ns[total - 1]);
+    printf("Torque hash: %016" PRIx64 "%s\n", first_hash, deterministic ? "" : " (NOT deterministic across repeats)");
+
+    int status = deterministic ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (out_path && write_csv(out_path, samples, cycles, cycle_us) != 0) status = EXIT_FAILURE;
+    if (reference_path) {
+        int ret = compare_csv(reference_path, samples, cycles, tolerance);
+        if (ret != 0) status = EXIT_FAILURE;
+    }
+
+    free(reports);
+    free(follow_positions);
+    free(samples);
+    free(cycle_ns);
+    return status;
+}
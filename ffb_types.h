@@ -15,6 +15,38 @@ typedef enum {
     FFB_EFFECT_RAMP
 } ffb_effect_type_t;
 
+// Number of effect blocks in the PID effect pool (effect_block_index 1..FFB_MAX_EFFECTS)
+#define FFB_MAX_EFFECTS 40
+
+// Operation requested on an effect block
+typedef enum {
+    FFB_EFFECT_OP_UPDATE = 0,      // Set/replace the block's parameters (keeps playing state)
+    FFB_EFFECT_OP_START,           // Start playing the block
+    FFB_EFFECT_OP_START_SOLO,      // Stop all other effects, then start the block
+    FFB_EFFECT_OP_STOP,            // Stop playing the block
+    FFB_EFFECT_OP_FREE,            // Stop and release the block
+    FFB_EFFECT_OP_STOP_ALL,        // Stop every effect (effect_block_index ignored)
+    // Device-level operations (PID Device Control / Device Gain, effect_block_index ignored)
+    FFB_EFFECT_OP_FREE_ALL,        // Device reset: stop and release every block
+    FFB_EFFECT_OP_ENABLE_ACTUATORS,
+    FFB_EFFECT_OP_DISABLE_ACTUATORS,
+    FFB_EFFECT_OP_PAUSE,           // Hold all effects, output zero torque
+    FFB_EFFECT_OP_CONTINUE,        // Resume after pause
+    FFB_EFFECT_OP_DEVICE_GAIN      // Overall gain in magnitude (0.0 to 1.0)
+} ffb_effect_op_t;
+
+// Loop count value meaning "repeat until stopped"
+#define FFB_LOOP_INFINITE 255
+
+// Periodic waveforms
+typedef enum {
+    FFB_WAVEFORM_SQUARE = 0,
+    FFB_WAVEFORM_SINE,
+    FFB_WAVEFORM_TRIANGLE,
+    FFB_WAVEFORM_SAWTOOTH_UP,
+    FFB_WAVEFORM_SAWTOOTH_DOWN
+} ffb_waveform_t;
+
 /*
 // FFB effect structure
 typedef struct {
@@ -37,6 +69,8 @@ typedef struct {
 // Enhanced FFB effect structure for your motor control
 typedef struct {
     uint8_t report_id;
+    uint8_t effect_block_index; // PID effect block (1..FFB_MAX_EFFECTS), 0 = unassigned
+    ffb_effect_op_t operation;  // What to do with the effect block
     ffb_effect_type_t type;
     uint8_t effect_type;    // Constant force, spring, damper, etc.
     float magnitude;        // -1.0 to 1.0
@@ -45,6 +79,8 @@ typedef struct {
     uint32_t duration;
     uint32_t start_delay;
     uint32_t timestamp;
+    float gain;             // Per-effect gain 0.0 to 1.0
+    uint8_t loop_count;     // Times to play the effect, FFB_LOOP_INFINITE = until stopped
 
     // Additional parameters for different effect types
     float spring_coefficient;
@@ -53,6 +89,16 @@ typedef struct {
     float inertia_coefficient;
     float center_position;
     float dead_band;
+    float saturation;       // Max condition force 0.0 to 1.0 of full torque, 0 = unlimited
+    
+    // Periodic parameters
+    uint8_t waveform;       // ffb_waveform_t
+    float offset;           // -1.0 to 1.0
+    float phase;            // 0 to 360 degrees
+    uint32_t period_ms;     // Period of one cycle in milliseconds
+    
+    // Ramp parameters (start level is magnitude)
+    float ramp_end;         // -1.0 to 1.0
     
     // Envelope parameters
     float attack_level;
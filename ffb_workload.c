@@ -0,0 +1,136 @@
+// ffb_workload.c - Scripted PID output report sequences (see ffb_workload.h)
+#include "ffb_workload.h"
+#include "ffb_pid_parser.h"
+#include "ffb_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+// PID effect types cycled through by "effects" (see map_pid_effect_type() in ffb_pid_parser.c)
+static const uint8_t effect_types[] = { 1, 4, 8, 9, 11, 5, 10, 2, 3 };
+static const char *const effect_names[] = {
+    "constant", "sine", "spring", "damper", "friction", "triangle", "inertia", "ramp", "square"
+};
+#define EFFECT_TYPE_COUNT (sizeof(effect_types) / sizeof(effect_types[0]))
+
+// Reports appended so far; data is only written when reports is not NULL (counting pass)
+typedef struct {
+    ffb_capture_report_t *reports;
+    size_t count;
+} workload_t;
+
+static void add(workload_t *w, uint64_t time_ms, int length, ...) {
+    if (w->reports) {
+        ffb_capture_report_t *r = &w->reports[w->count];
+        va_list args;
+        r->time_us = time_ms * 1000ULL;
+        r->length = (uint8_t)length;
+        va_start(args, length);
+        for (int i = 0; i < length; i++) {
+            r->data[i] = (uint8_t)va_arg(args, int);
+        }
+        va_end(args);
+    }
+    w->count++;
+}
+
+static void add_constant(workload_t *w, uint64_t time_ms, int block, int16_t magnitude) {
+    add(w, time_ms, 4, FFB_PID_REPORT_SET_CONSTANT, block, magnitude & 0xFF, (magnitude >> 8) & 0xFF);
+}
+
+static void add_setup(workload_t *w) {
+    add(w, 0, 2, FFB_PID_REPORT_DEVICE_CONTROL, 4);     // Device reset
+    add(w, 0, 2, FFB_PID_REPORT_DEVICE_CONTROL, 1);     // Enable actuators
+    add(w, 0, 2, FFB_PID_REPORT_DEVICE_GAIN, 255);
+}
+
+// Infinite duration, played until stopped
+static void add_effect(workload_t *w, int block, uint8_t pid_type) {
+    add(w, 0, 8, FFB_PID_REPORT_SET_EFFECT, block, pid_type, 0, 0, 0, 0, 255);
+    switch (pid_type) {
+        case 1:
+            add_constant(w, 0, block, (int16_t)(((block % 5) + 1) * 1000 * ((block & 1) ? 1 : -1)));
+            break;
+        case 2:
+            add(w, 0, 4, FFB_PID_REPORT_SET_RAMP, block, 28, 228);
+            break;
+        case 3: case 4: case 5: {
+            int period_ms = 20 + block;
+            add(w, 0, 7, FFB_PID_REPORT_SET_PERIODIC, block, 60 + block, 128, (block * 20) & 0xFF,
+                period_ms & 0xFF, period_ms >> 8);
+            add(w, 0, 8, FFB_PID_REPORT_SET_ENVELOPE, block, 255, 255, 0, 0, 0, 0); // Flat: no attack or fade
+            break;
+        }
+        default: // Conditions
+            add(w, 0, 6, FFB_PID_REPORT_SET_CONDITION, block, 128, 80 + block * 3, (block % 3) ? 0 : 200, block % 8);
+            break;
+    }
+    add(w, 0, 4, FFB_PID_REPORT_EFFECT_OPERATION, block, 1, FFB_LOOP_INFINITE);
+}
+
+static int build(workload_t *w, const char *name, int effect_count, uint32_t duration_ms) {
+    add_setup(w);
+    if (strcmp(name, "effects") == 0) {
+        if (effect_count < 1 || effect_count > FFB_MAX_EFFECTS) return -1;
+        for (int block = 1; block <= effect_count; block++) {
+            add_effect(w, block, effect_types[(block - 1) % EFFECT_TYPE_COUNT]);
+        }
+        // Block 1 is the constant force: a 2 Hz sine of updates, like a game's road feel
+        for (uint32_t t = FFB_WORKLOAD_STREAM_PERIOD_MS; t <= duration_ms; t += FFB_WORKLOAD_STREAM_PERIOD_MS) {
+            add_constant(w, t, 1, (int16_t)lrint(4000.0 * sin(t * 2.0 * M_PI / 500.0)));
+        }
+    } else if (strcmp(name, "steps") == 0) {
+        add_effect(w, 1, 1);
+        int16_t magnitude = FFB_WORKLOAD_STEP_MAGNITUDE;
+        for (uint32_t t = FFB_WORKLOAD_STEP_PERIOD_MS; t <= duration_ms; t += FFB_WORKLOAD_STEP_PERIOD_MS) {
+            add_constant(w, t, 1, magnitude);
+            magnitude = (int16_t)-magnitude;
+        }
+    } else {
+        return -1;
+    }
+    if (duration_ms) {
+        add(w, duration_ms, 2, FFB_PID_REPORT_DEVICE_CONTROL, 3);  // Stop all
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the name of the effect "effects" creates in a block.
+ */
+const char *ffb_workload_effect_name(int block) {
+    if (block < 1 || block > FFB_MAX_EFFECTS) return "none";
+    return effect_names[(block - 1) % EFFECT_TYPE_COUNT];
+}
+
+/**
+ * @brief Returns the report count ffb_workload_build() produces.
+ */
+size_t ffb_workload_report_count(const char *name, int effect_count, uint32_t duration_ms) {
+    workload_t w = { NULL, 0 };
+    return build(&w, name, effect_count, duration_ms) == 0 ? w.count : 0;
+}
+
+/**
+ * @brief Builds a workload.
+ */
+int ffb_workload_build(const char *name, int effect_count, uint32_t duration_ms,
+                       ffb_capture_report_t **reports_out, size_t *count_out) {
+    size_t count = ffb_workload_report_count(name, effect_count, duration_ms);
+    if (count == 0) {
+        fprintf(stderr, "FFB_Workload: unknown workload '%s' or effect count %d out of range (1-%d)\n",
+                name, effect_count, FFB_MAX_EFFECTS);
+        return -1;
+    }
+    workload_t w = { calloc(count, sizeof(ffb_capture_report_t)), 0 };
+    if (!w.reports) {
+        fprintf(stderr, "FFB_Workload: out of memory for %zu reports\n", count);
+        return -1;
+    }
+    build(&w, name, effect_count, duration_ms);
+    *reports_out = w.reports;
+    *count_out = w.count;
+    return 0;
+}
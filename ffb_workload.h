@@ -0,0 +1,43 @@
+// ffb_workload.h - Scripted PID output report sequences for benchmarks and the report injector
+//
+// A workload is a list of reports in the capture format (ffb_capture.h), so it can be saved,
+// edited and played back like a recording. It starts with a device reset, enables the
+// actuators and sets full device gain.
+//   effects  N effects of mixed types (constant, periodic, conditions, ramp), all playing,
+//            then block 1's constant force streamed at 1 kHz like a game does
+//   steps    one constant force stepping between +-50% every 250 ms, for end-to-end latency
+#ifndef FFB_WORKLOAD_H
+#define FFB_WORKLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ffb_capture.h"
+
+#define FFB_WORKLOAD_STREAM_PERIOD_MS   1       // Constant force updates in "effects"
+#define FFB_WORKLOAD_STEP_PERIOD_MS     250     // Constant force steps in "steps"
+#define FFB_WORKLOAD_STEP_MAGNITUDE     5000    // Of +-10000
+
+/**
+ * @brief Builds a workload.
+ * @param name "effects" or "steps".
+ * @param effect_count Effects created by "effects", 1..FFB_MAX_EFFECTS; ignored by "steps".
+ * @param duration_ms How long the streamed part lasts; 0 for setup reports only.
+ * @param reports_out Receives a malloc'ed array sorted by time; free() it when done.
+ * @param count_out Number of reports.
+ * @return 0 on success, -1 on an unknown name, bad count or out of memory (reported on stderr).
+ */
+int ffb_workload_build(const char *name, int effect_count, uint32_t duration_ms,
+                       ffb_capture_report_t **reports_out, size_t *count_out);
+
+/**
+ * @brief Returns the name of the effect "effects" creates in a block ("constant", "sine",
+ *        "spring", ...); the types repeat every 9 blocks, block 1 is the constant force.
+ */
+const char *ffb_workload_effect_name(int block);
+
+/**
+ * @brief Returns the report count ffb_workload_build() produces, for sizing; 0 on bad arguments.
+ */
+size_t ffb_workload_report_count(const char *name, int effect_count, uint32_t duration_ms);
+
+#endif // FFB_WORKLOAD_H
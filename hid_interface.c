@@ -2,6 +2,13 @@
 #include "hid_interface.h"
 #include "soem_interface.h"
 #include "ffb_types.h"
+#include "ffb_pid_parser.h"
+#include "ffb_capture.h"
+#include "ffb_effect_queue.h"
+#include "ffb_e2e.h"
+#include "rt_log.h"
+#include "rt_threads.h"
+#include "rt_seqlock.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -14,67 +21,57 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/stat.h>
-#include <sys/select.h>
-#include <sched.h> // For CPU affinity
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 
 #define HID_DEVICE_PATH "/dev/hidg0"
-// Optimized send interval for better USB performance
-#define HID_SEND_INTERVAL_MS 10  // Send reports every 10ms (100Hz)
+// Gamepad IN report pacing, matching the host polling interval of the gadget endpoint
+#define HID_REPORT_RATE_MIN_HZ 1000
+#define HID_REPORT_RATE_MAX_HZ 8000
+#define HID_REPORT_RATE_DEFAULT_HZ 1000
+#define HID_STATUS_PRINT_INTERVAL_S 10
 #define USB_RECONNECT_DELAY_MS 1000  // Wait 1 second before trying to reconnect
+#define HID_DEVICE_DIR "/dev"        // Watched for the gadget device node appearing/changing
+#define HID_DEVICE_NAME "hidg0"
+#define MAX_READ_FAILURES 10         // Consecutive read errors before the device is reopened
+#define RECEPTION_MAX_EVENTS 4
 #define MAX_STEERING_ANGLE 540.0f // Adjusted to 540 degrees as per main.c
 
-// Reduced retries and timeouts for better performance
-#define MAX_WRITE_RETRIES 2
-#define WRITE_RETRY_DELAY_US 500
-#define WRITE_SELECT_TIMEOUT_US 5000  // Reduced to 5ms
+#define MAX_WRITE_FAILURES 5 // Consecutive write errors before the device is reopened
 
 // Structure matching standard HID gamepad Report ID 1
 typedef struct {
     uint8_t report_id;      // Report ID = 1
-    int16_t x_axis;         // 16-bit signed X-axis (-32768 to 32767)
+    int16_t x_axis;         // 16-bit signed X-axis (-32768 to 32767), wheel
+    int16_t extra_axes[HID_EXTRA_AXES]; // Y, Z, Rz: pedals/shifter axes from other slaves
     uint16_t buttons;       // 16-bit button field
 } __attribute__((packed)) gamepad_report_t;
 
-// Fixed FFB Input Report structures matching your HID descriptor
-typedef struct {
-    uint8_t report_id;      // Report ID = 2
-    uint8_t effect_block_index;  // Effect block index
-    uint8_t effect_type;    // Effect type
-} __attribute__((packed)) ffb_pid_pool_report_t;
-
-typedef struct {
-    uint8_t report_id;      // Report ID = 3
-    uint8_t magnitude;      // Effect magnitude
-    uint8_t offset;         // Effect offset
-    uint8_t phase;          // Phase
-    uint8_t period;         // Period
-    uint8_t duration_low;   // Duration low byte
-    uint8_t duration_high;  // Duration high byte
-} __attribute__((packed)) ffb_set_effect_report_t;
-
 // Generic FFB report for any report ID
 typedef struct {
     uint8_t report_id;
     uint8_t data[16];  // Maximum data size based on your largest report
 } __attribute__((packed)) ffb_generic_report_t;
 
-// FFB Effect Queue
-#define FFB_EFFECT_QUEUE_SIZE 16
-static ffb_motor_effect_t ffb_effect_queue[FFB_EFFECT_QUEUE_SIZE];
-static int queue_head = 0;
-static int queue_tail = 0;
-static int queue_count = 0;
-static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
-
 // Thread running flag
 volatile int hid_running = 0;
 
-static int hidg_fd = -1;
-static pthread_mutex_t hidg_fd_mutex = PTHREAD_MUTEX_INITIALIZER;
+// The reception thread owns read_fd, the gamepad report writer owns write_fd.
+// Each side opens, closes and reconnects its own descriptor, so they never share a lock.
+static int read_fd = -1;
+static int write_fd = -1;
 
-// USB connection state tracking
+// Reception thread event sources
+static int epoll_fd = -1;
+static int inotify_fd = -1;     // HID_DEVICE_DIR changes (device node created/removed)
+static int stop_event_fd = -1;  // Wakes the reception thread on shutdown
+
+// USB connection state tracking (reception side)
 static volatile int usb_connected = 0;
+
+// Writer state
 static int consecutive_write_failures = 0;
 static struct timespec last_reconnect_attempt = {0, 0};
 
@@ -83,9 +80,20 @@ static int total_write_errors = 0;
 static int total_read_errors = 0;
 static int reconnect_count = 0;
 
-// Debugging - reduced frequency to avoid spam
-static int report_counter = 0;
-static int debug_every_n_reports = 1000;  // Debug every 1000 reports
+// CLOCK_MONOTONIC time of the last FFB report from the host, for the safety supervisor
+static _Atomic uint64_t last_host_activity_ns = 0;
+
+// Latest gamepad sample, published by hid_interface_send_gamepad_report_axes() and sent by
+// the gamepad report thread. sequence 0 means nothing has been published yet.
+typedef struct {
+    int16_t axes[1 + HID_EXTRA_AXES];
+    uint16_t buttons;
+    uint32_t sequence;
+} gamepad_sample_t;
+
+static rt_seqlock_t gamepad_lock = RT_SEQLOCK_INIT;
+static gamepad_sample_t gamepad_mailbox;
+static int report_rate_hz = HID_REPORT_RATE_DEFAULT_HZ;
 
 // Threads
 static pthread_t ffb_reception_thread;
@@ -105,55 +113,61 @@ static int check_hid_device_exists() {
     return S_ISCHR(st.st_mode);
 }
 
-// Safe function to close HID device
-static void safe_close_hid_device() {
-    pthread_mutex_lock(&hidg_fd_mutex);
-    if (hidg_fd >= 0) {
-        close(hidg_fd);
-        hidg_fd = -1; // Invalidate the file descriptor
-        usb_connected = 0;
-        printf("HIDInterface: Closed HID device\n");
+// Open the HID device node; returns the descriptor or -1
+static int open_hid_device(int flags) {
+    if (!check_hid_device_exists()) {
+        return -1;
     }
-    pthread_mutex_unlock(&hidg_fd_mutex);
+    int fd = open(HID_DEVICE_PATH, flags | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0 && errno != ENOENT && errno != EACCES) {
+        RT_LOG(RT_LOG_ERROR, "HIDInterface: Failed to open HID device: %s\n", strerror(errno));
+    }
+    return fd;
 }
 
-// Attempt to open/reopen HID device
-static int try_open_hid_device() {
-    pthread_mutex_lock(&hidg_fd_mutex);
-    
-    // Close existing connection if any before trying to reopen
-    if (hidg_fd >= 0) {
-        close(hidg_fd);
-        hidg_fd = -1;
-    }
-    
-    // Check if device exists
-    if (!check_hid_device_exists()) {
-        pthread_mutex_unlock(&hidg_fd_mutex);
-        return -1;
+// Reception side: stop watching and close the read descriptor
+static void close_read_device() {
+    if (read_fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, read_fd, NULL);
+        close(read_fd);
+        read_fd = -1; // Invalidate the file descriptor
+        usb_connected = 0;
+        RT_LOG(RT_LOG_INFO, "HIDInterface: Closed HID device\n");
     }
-    
-    // Try to open the device
-    hidg_fd = open(HID_DEVICE_PATH, O_RDWR | O_NONBLOCK);
-    if (hidg_fd < 0) {
-        perror("HIDInterface: Failed to open HID device");
-        pthread_mutex_unlock(&hidg_fd_mutex);
+}
+
+// Reception side: open the read descriptor and register it with epoll
+static int open_read_device() {
+    if (read_fd >= 0) return 0;
+
+    int fd = open_hid_device(O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        RT_LOG(RT_LOG_ERROR, "HIDInterface: Failed to watch HID device: %s\n", strerror(errno));
+        close(fd);
         return -1;
     }
-    
+
+    read_fd = fd;
     usb_connected = 1;
-    consecutive_write_failures = 0;
     reconnect_count++;
-    
-    printf("HIDInterface: Successfully opened HID device (reconnect #%d)\n", reconnect_count);
-    
-    pthread_mutex_unlock(&hidg_fd_mutex);
+    RT_LOG(RT_LOG_INFO, "HIDInterface: Successfully opened HID device (reconnect #%d)\n", reconnect_count);
     return 0;
 }
 
+// Writer side: close the write descriptor
+static void close_write_device() {
+    if (write_fd >= 0) {
+        close(write_fd);
+        write_fd = -1;
+    }
+}
+
 // Check if we should attempt reconnection
 static int should_attempt_reconnect() {
-    if (usb_connected) return 0;
+    if (write_fd >= 0) return 0;
     
     struct timespec current_time;
     clock_gettime(CLOCK_MONOTONIC, &current_time);
@@ -169,172 +183,224 @@ static int should_attempt_reconnect() {
     return 1;
 }
 
-// Updated parse FFB reports from PC with proper structure handling
-static int parse_ffb_report(uint8_t *report, size_t len, ffb_motor_effect_t *effect) {
-    if (len < 2) return 0;
-    
-    uint8_t report_id = report[0];
-    
-    // Initialize effect with default values
-    memset(effect, 0, sizeof(ffb_motor_effect_t));
-    effect->report_id = report_id;
-    clock_gettime(CLOCK_REALTIME, &effect->received_time);
-    
-    switch (report_id) {
-        case 2: // PID Pool Report
-            if (len >= sizeof(ffb_pid_pool_report_t)) {
-                ffb_pid_pool_report_t *pid_report = (ffb_pid_pool_report_t *)report;
-                effect->effect_type = pid_report->effect_type;
-                return 1;
-            }
-            break;
-            
-        case 3: // Set Effect Report
-            if (len >= sizeof(ffb_set_effect_report_t)) {
-                ffb_set_effect_report_t *set_effect = (ffb_set_effect_report_t *)report;
-                effect->magnitude = (set_effect->magnitude - 128) / 128.0f;
-                effect->duration_ms = (set_effect->duration_high << 8) | set_effect->duration_low;
-                return 1;
+// Parser callback: hand each decoded block operation to the main loop
+static void emit_effect(const ffb_motor_effect_t *effect, void *user_data) {
+    (void)user_data;
+    ffb_effect_queue_push(effect);
+}
+
+static void note_host_activity(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    atomic_store_explicit(&last_host_activity_ns, (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec,
+                          memory_order_relaxed);
+}
+
+// Drain all queued OUT reports; returns -1 if the device should be reopened
+static int read_pending_reports(int *read_failures) {
+    ffb_generic_report_t ffb_report;
+
+    for (;;) {
+        ssize_t len = read(read_fd, &ffb_report, sizeof(ffb_report));
+        if (len > 0) {
+            *read_failures = 0;
+            ffb_e2e_report_received();
+            note_host_activity();
+            ffb_capture_write((const uint8_t*)&ffb_report, (size_t)len);
+            ffb_pid_parser_parse((const uint8_t*)&ffb_report, (size_t)len, emit_effect, NULL);
+            continue;
+        }
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0; // Drained
+        }
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len < 0 && (errno == ENODEV || errno == ESHUTDOWN || errno == EBADF)) {
+            RT_LOG(RT_LOG_ERROR, "FFB Reception Thread: HID device lost: %s\n", strerror(errno));
+            total_read_errors++;
+            return -1;
+        }
+        RT_LOG(RT_LOG_ERROR, "FFB Reception Thread: read error: %s\n", strerror(errno));
+        total_read_errors++;
+        if (++(*read_failures) > MAX_READ_FAILURES) {
+            return -1;
+        }
+        return 0;
+    }
+}
+
+// Handle device node changes from inotify; reopens or closes the read side as needed
+static void handle_device_node_events() {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+        if (len <= 0) break;
+
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            if (event->len > 0 && strcmp(event->name, HID_DEVICE_NAME) == 0) {
+                if (event->mask & IN_DELETE) {
+                    close_read_device();
+                } else if (event->mask & (IN_CREATE | IN_ATTRIB)) {
+                    open_read_device(); // Permissions may only allow opening after IN_ATTRIB
+                }
             }
-            break;
-            
-        // Add other report types as needed
-        default:
-            // Unknown report type
-            return 0;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
     }
-    
-    return 0;
 }
 
-// FFB reception thread with improved error handling
+// FFB reception thread: sleeps in epoll_wait until a report, a device change or shutdown
 static void* _usb_ffb_reception_thread(void* arg) {
     (void)arg;
     
-    // Set CPU affinity for this thread to core 1
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(1, &cpuset);
-    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
-        perror("FFB Reception Thread: Failed to set CPU affinity");
-    }
+    // Core and priority come from the hid_rx entry of the thread topology
+    rt_threads_verify_self(RT_THREAD_HID_RX);
 
-    ffb_generic_report_t ffb_report;
+    struct epoll_event events[RECEPTION_MAX_EVENTS];
     int read_failures = 0;
 
-    printf("FFB: Reception thread started\n");
+    RT_LOG(RT_LOG_INFO, "FFB: Reception thread started\n");
     
     while (hid_running) {
-        // Check if we need to reconnect
-        if (!usb_connected && should_attempt_reconnect()) {
-            if (try_open_hid_device() == 0) {
-                read_failures = 0;
-            }
+        // Device missing: retry periodically as well, in case no inotify event arrives
+        if (read_fd < 0 && open_read_device() == 0) {
+            read_failures = 0;
         }
-        
-        // Only try to read if we're connected
-        if (usb_connected) {
-            pthread_mutex_lock(&hidg_fd_mutex);
-            int fd = hidg_fd;
-            
-            if (fd >= 0) {
-                fd_set read_fds;
-                struct timeval tv;
-                FD_ZERO(&read_fds);
-                FD_SET(fd, &read_fds);
-                tv.tv_sec = 0;
-                tv.tv_usec = 5000; // 5ms timeout
-
-                int retval = select(fd + 1, &read_fds, NULL, NULL, &tv);
-
-                if (retval == -1) {
-                    perror("FFB Reception Thread: select error");
-                    read_failures++;
-                    total_read_errors++;
-                    if (read_failures > 10) {
-                        safe_close_hid_device();
-                        read_failures = 0;
-                    }
-                } else if (retval) {
-                    ssize_t len = read(fd, &ffb_report, sizeof(ffb_report));
-                    if (len > 0) {
-                        read_failures = 0;
-                        
-                        ffb_motor_effect_t new_effect;
-                        if (parse_ffb_report((uint8_t*)&ffb_report, (size_t)len, &new_effect)) {
-                            pthread_mutex_lock(&queue_mutex);
-                            if (queue_count < FFB_EFFECT_QUEUE_SIZE) {
-                                ffb_effect_queue[queue_tail] = new_effect;
-                                queue_tail = (queue_tail + 1) % FFB_EFFECT_QUEUE_SIZE;
-                                queue_count++;
-                                pthread_cond_signal(&queue_cond);
-                            }
-                            pthread_mutex_unlock(&queue_mutex);
-                        }
-                    } else if (len < 0) {
-                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                            perror("FFB Reception Thread: read error");
-                            read_failures++;
-                            total_read_errors++;
-                            if (read_failures > 10) {
-                                safe_close_hid_device();
-                                read_failures = 0;
-                            }
-                        }
-                    }
+        int timeout_ms = (read_fd < 0) ? USB_RECONNECT_DELAY_MS : -1;
+
+        int count = epoll_wait(epoll_fd, events, RECEPTION_MAX_EVENTS, timeout_ms);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            RT_LOG(RT_LOG_ERROR, "FFB Reception Thread: epoll_wait error: %s\n", strerror(errno));
+            total_read_errors++;
+            usleep(USB_RECONNECT_DELAY_MS * 1000); // Avoid spinning on a broken epoll set
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == stop_event_fd) {
+                break; // hid_running is already cleared
+            } else if (fd == inotify_fd) {
+                handle_device_node_events();
+            } else if (fd == read_fd) {
+                if ((events[i].events & EPOLLIN) && read_pending_reports(&read_failures) < 0) {
+                    close_read_device();
+                    read_failures = 0;
+                } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    close_read_device();
                 }
             }
-            pthread_mutex_unlock(&hidg_fd_mutex);
         }
-        
-        // Small delay to prevent busy waiting
-        usleep(1000); // 1ms
     }
 
-    printf("FFB: Reception thread stopped\n");
+    RT_LOG(RT_LOG_INFO, "FFB: Reception thread stopped\n");
     return NULL;
 }
 
-// Simplified gamepad report sending thread
+// Write one gamepad report without blocking; returns 1 sent, 0 not sent, -1 device lost
+static int write_gamepad_report(const gamepad_report_t *report) {
+    ssize_t bytes_written = write(write_fd, report, sizeof(*report));
+
+    if (bytes_written == sizeof(*report)) {
+        consecutive_write_failures = 0;
+        return 1;
+    }
+    if (bytes_written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0; // Host has not polled the previous report yet; retry with newer data
+        }
+        consecutive_write_failures++;
+        total_write_errors++;
+        if (errno == EBADF || errno == ENODEV || errno == EPIPE || errno == ESHUTDOWN ||
+            consecutive_write_failures > MAX_WRITE_FAILURES) {
+            // Critical error: device lost
+            RT_LOG(RT_LOG_ERROR, "HIDInterface: Critical write error (device lost): %s\n", strerror(errno));
+            close_write_device();
+            return -1;
+        }
+        RT_LOG(RT_LOG_ERROR, "HIDInterface: write error: %s\n", strerror(errno));
+        return 0;
+    }
+
+    // Partial write
+    RT_LOG(RT_LOG_INFO, "HIDInterface: Partial write (%zd/%zu bytes)\n", bytes_written, sizeof(*report));
+    consecutive_write_failures++;
+    total_write_errors++;
+    return 0;
+}
+
+// Gamepad report writer: wakes at the report rate and sends the newest published sample
 static void* _gamepad_report_loop(void* arg) {
     (void)arg;
 
-    // Set CPU affinity for this thread to core 1
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(1, &cpuset);
-    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
-        perror("Gamepad Report Thread: Failed to set CPU affinity");
-    }
+    // Core and priority come from the hid_tx entry of the thread topology
+    rt_threads_verify_self(RT_THREAD_HID_TX);
 
-    printf("HIDInterface: Gamepad report thread started\n");
+    RT_LOG(RT_LOG_INFO, "HIDInterface: Gamepad report thread started (%d Hz)\n", report_rate_hz);
 
-    struct timespec loop_start_time, loop_end_time;
+    struct timespec next_wakeup;
+    clock_gettime(CLOCK_MONOTONIC, &next_wakeup);
+    uint32_t sent_sequence = 0;
+    long ticks = 0;
 
     while (hid_running) {
-        clock_gettime(CLOCK_MONOTONIC, &loop_start_time);
-
-        // The main loop will call hid_interface_send_gamepad_report() directly
-        // This thread just maintains the timing for potential future use
-        
-        // Periodic debugging output
-        report_counter++;
-        if (report_counter % debug_every_n_reports == 0) {
-            printf("HID Thread Status: Connected=%s, WriteErr=%d, ReadErr=%d\n",
+        long period_ns = 1000000000L / report_rate_hz;
+        next_wakeup.tv_nsec += period_ns;
+        while (next_wakeup.tv_nsec >= 1000000000L) {
+            next_wakeup.tv_nsec -= 1000000000L;
+            next_wakeup.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_wakeup, NULL);
+
+        // Fell behind (e.g. preempted): resynchronize instead of bursting to catch up
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_diff_ms(&next_wakeup, &now) > 1) {
+            next_wakeup = now;
+        }
+
+        gamepad_sample_t sample;
+        unsigned int seq;
+        do {
+            seq = rt_seqlock_read_begin(&gamepad_lock);
+            sample = gamepad_mailbox;
+        } while (rt_seqlock_read_retry(&gamepad_lock, seq));
+
+        // Periodic debugging output, paced by the writer whatever rate the samples come at
+        if (++ticks % ((long)report_rate_hz * HID_STATUS_PRINT_INTERVAL_S) == 0) {
+            RT_LOG(RT_LOG_INFO, "HID Thread Status: Connected=%s, WriteErr=%d, ReadErr=%d\n",
                    usb_connected ? "YES" : "NO", total_write_errors, total_read_errors);
+            RT_LOG(RT_LOG_INFO, "HIDInterface: Sending - X-axis: %d, Y/Z/Rz: %d/%d/%d, Buttons: %u\n",
+                   sample.axes[0], sample.axes[1], sample.axes[2], sample.axes[3], sample.buttons);
         }
-        
-        // Enforce the send interval
-        clock_gettime(CLOCK_MONOTONIC, &loop_end_time);
-        long elapsed_ms = timespec_diff_ms(&loop_start_time, &loop_end_time);
-        long sleep_time_ms = HID_SEND_INTERVAL_MS - elapsed_ms;
-
-        if (sleep_time_ms > 0) {
-            usleep(sleep_time_ms * 1000);
+        if (sample.sequence == sent_sequence) {
+            continue; // Nothing newer than what the host already has
+        }
+
+        // Check connection and try to reconnect if needed
+        if (write_fd < 0) {
+            if (!should_attempt_reconnect()) continue;
+            write_fd = open_hid_device(O_WRONLY);
+            if (write_fd < 0) continue; // Temporary failure, couldn't reconnect yet
+            consecutive_write_failures = 0;
+        }
+
+        gamepad_report_t report = {
+            .report_id = 1,
+            .x_axis = sample.axes[0],
+            .buttons = sample.buttons,
+        };
+        memcpy(report.extra_axes, &sample.axes[1], sizeof(report.extra_axes));
+        if (write_gamepad_report(&report) > 0) {
+            sent_sequence = sample.sequence;
         }
     }
 
-    printf("HIDInterface: Gamepad report thread stopped\n");
+    RT_LOG(RT_LOG_INFO, "HIDInterface: Gamepad report thread stopped\n");
     return NULL;
 }
 
@@ -343,9 +409,34 @@ static void* _gamepad_report_loop(void* arg) {
  */
 int hid_interface_init() {
     printf("HIDInterface: Initializing HID interface...\n");
+    ffb_pid_parser_init();
+    ffb_effect_queue_init();
+    
+    // Event sources for the reception thread
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || stop_event_fd < 0) {
+        perror("HIDInterface: Failed to create reception event sources");
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = stop_event_fd };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_event_fd, &ev);
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 &&
+        inotify_add_watch(inotify_fd, HID_DEVICE_DIR, IN_CREATE | IN_DELETE | IN_ATTRIB) >= 0) {
+        ev.data.fd = inotify_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &ev);
+    } else {
+        perror("HIDInterface: Warning - inotify unavailable, polling for the HID device");
+        if (inotify_fd >= 0) {
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+    }
     
     // Try to open HID device initially
-    if (try_open_hid_device() != 0) {
+    if (open_read_device() != 0) {
         printf("HIDInterface: Warning - Could not open HID device initially. Will try to reconnect later.\n");
     } else {
         // Give USB host time to recognize the device
@@ -362,12 +453,12 @@ int hid_interface_init() {
 int hid_interface_start() {
     hid_running = 1;
     
-    if (pthread_create(&ffb_reception_thread, NULL, _usb_ffb_reception_thread, NULL) != 0) {
+    if (rt_threads_create(RT_THREAD_HID_RX, &ffb_reception_thread, _usb_ffb_reception_thread, NULL) != 0) {
         perror("HIDInterface: Failed to create FFB reception thread");
         return -1;
     }
     
-    if (pthread_create(&gamepad_report_thread, NULL, _gamepad_report_loop, NULL) != 0) {
+    if (rt_threads_create(RT_THREAD_HID_TX, &gamepad_report_thread, _gamepad_report_loop, NULL) != 0) {
         perror("HIDInterface: Failed to create gamepad report thread");
         pthread_cancel(ffb_reception_thread);
         pthread_join(ffb_reception_thread, NULL);
@@ -384,6 +475,14 @@ int hid_interface_start() {
 void hid_interface_stop() {
     hid_running = 0;
     
+    // Wake the reception thread out of epoll_wait
+    if (stop_event_fd >= 0) {
+        uint64_t one = 1;
+        if (write(stop_event_fd, &one, sizeof(one)) < 0) {
+            perror("HIDInterface: Failed to signal reception thread");
+        }
+    }
+    
     // Wait for threads to finish
     if (ffb_reception_thread) {
         pthread_join(ffb_reception_thread, NULL);
@@ -393,144 +492,85 @@ void hid_interface_stop() {
         pthread_join(gamepad_report_thread, NULL);
     }
 
-    safe_close_hid_device();
+    close_read_device();
+    close_write_device();
+    if (inotify_fd >= 0) close(inotify_fd);
+    if (stop_event_fd >= 0) close(stop_event_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    inotify_fd = stop_event_fd = epoll_fd = -1;
 
     printf("HIDInterface: Stopped. Stats - Write errors: %d, Read errors: %d, Reconnects: %d\n", 
            total_write_errors, total_read_errors, reconnect_count);
 }
 
 /**
- * @brief Retrieves the latest FFB effect from the queue.
+ * @brief Retrieves the oldest pending FFB effect block operation.
  */
 int hid_interface_get_ffb_effect(ffb_motor_effect_t *effect_out) {
-    pthread_mutex_lock(&queue_mutex);
-    if (queue_count > 0) {
-        *effect_out = ffb_effect_queue[queue_head];
-        queue_head = (queue_head + 1) % FFB_EFFECT_QUEUE_SIZE;
-        queue_count--;
-        pthread_mutex_unlock(&queue_mutex);
-        return 1;
-    }
-    pthread_mutex_unlock(&queue_mutex);
-    return 0;
+    return ffb_effect_queue_pop(effect_out);
+}
+
+// Converts a normalized axis value [-1.0, 1.0] to int16_t [-32768, 32767]
+static int16_t normalized_to_axis(float value) {
+    if (!(value > -1.0f)) return -32768; // Also catches NaN
+    if (value > 1.0f) value = 1.0f;
+    return (value >= 0.0f) ? (int16_t)(value * 32767.0f) : (int16_t)(value * 32768.0f);
 }
 
 /**
- * @brief Sends a gamepad report with the position provided by main.c
+ * @brief Publishes the gamepad state provided by main.c; the report thread sends it to the host
  */
 int hid_interface_send_gamepad_report(float normalized_position, unsigned int buttons) {
+    return hid_interface_send_gamepad_report_axes(&normalized_position, 1, buttons);
+}
+
+/**
+ * @brief Publishes the wheel and the extra axes; the report thread sends them to the host
+ */
+int hid_interface_send_gamepad_report_axes(const float *axes, int count, unsigned int buttons) {
     if (!hid_running) {
         return -1;
     }
 
-    // Check connection and try to reconnect if needed
-    if (!usb_connected && should_attempt_reconnect()) {
-        if (try_open_hid_device() != 0) {
-            return 0; // Temporary failure, couldn't reconnect yet
-        }
-    }
-    
-    // If still not connected after potential reconnect attempt, return
-    if (!usb_connected) {
-        return 0; 
+    // Axes not supplied stay centered
+    gamepad_sample_t sample = { .buttons = (uint16_t)(buttons & 0xFFFF) };
+    if (count > 1 + HID_EXTRA_AXES) count = 1 + HID_EXTRA_AXES;
+    for (int i = 0; i < count; i++) {
+        sample.axes[i] = normalized_to_axis(axes[i]);
     }
 
-    // Clamp position to valid range
-    if (normalized_position > 1.0f) normalized_position = 1.0f;
-    if (normalized_position < -1.0f) normalized_position = -1.0f;
-    
-    // Create report
-    gamepad_report_t report = {0};
-    report.report_id = 1;
-    
-    // Convert normalized float position [-1.0, 1.0] to int16_t [-32768, 32767]
-    if (normalized_position >= 0.0f) {
-        report.x_axis = (int16_t)(normalized_position * 32767.0f);
-    } else {
-        // For negative values, map -1.0 to -32768
-        report.x_axis = (int16_t)(normalized_position * 32768.0f);
-    }
-    
-    report.buttons = (uint16_t)(buttons & 0xFFFF);
+    // Replace whatever the writer has not sent yet; stale samples are never queued.
+    // One thread publishes (the main loop, or the EtherCAT thread in inline mode), so it is
+    // the single writer of the seqlock.
+    static uint32_t sequence = 0;
+    sequence++;
+    if (sequence == 0) sequence = 1; // 0 marks "nothing published" for the writer
+    sample.sequence = sequence;
+    rt_seqlock_write_begin(&gamepad_lock);
+    gamepad_mailbox = sample;
+    rt_seqlock_write_end(&gamepad_lock);
 
-    // Debug print (reduced frequency)
-    static int send_debug_counter = 0;
-    if (++send_debug_counter % 1000 == 0) {  // Every 1000 sends
-        printf("HIDInterface: Sending - Normalized: %.4f, X-axis: %d, Buttons: %u\n",
-               normalized_position, report.x_axis, report.buttons);
-    }
-    
-    // Lock the mutex for the entire write operation
-    pthread_mutex_lock(&hidg_fd_mutex);
-    int fd = hidg_fd;
+    return usb_connected;
+}
 
-    if (fd < 0) {
-        pthread_mutex_unlock(&hidg_fd_mutex);
-        return -1; // Device not open
+/**
+ * @brief Sets the gamepad report rate (host polling rate of the gadget endpoint).
+ */
+int hid_interface_set_report_rate(int rate_hz) {
+    if (rate_hz < HID_REPORT_RATE_MIN_HZ || rate_hz > HID_REPORT_RATE_MAX_HZ) {
+        printf("HIDInterface: Report rate %d Hz out of range (%d-%d Hz)\n",
+               rate_hz, HID_REPORT_RATE_MIN_HZ, HID_REPORT_RATE_MAX_HZ);
+        return -1;
     }
+    report_rate_hz = rate_hz;
+    return 0;
+}
 
-    int success = 0;
-
-    fd_set write_fds;
-    struct timeval tv;
-    
-    FD_ZERO(&write_fds);
-    FD_SET(fd, &write_fds);
-    tv.tv_sec = 0;
-    tv.tv_usec = WRITE_SELECT_TIMEOUT_US; // 5ms timeout
-
-    int retval = select(fd + 1, NULL, &write_fds, NULL, &tv);
-
-    if (retval == -1) {
-        perror("HIDInterface: select error during write");
-        consecutive_write_failures++;
-        total_write_errors++;
-        if (consecutive_write_failures > 5) {
-            safe_close_hid_device();
-            pthread_mutex_unlock(&hidg_fd_mutex);
-            return -1;
-        }
-        pthread_mutex_unlock(&hidg_fd_mutex);
-        return 0;
-    } else if (retval == 0) {
-        // Timeout - buffer not ready, skip sending this report
-        consecutive_write_failures++;
-        pthread_mutex_unlock(&hidg_fd_mutex);
-        return 0;
-    } else {
-        // Buffer ready, attempt write
-        ssize_t bytes_written = write(fd, &report, sizeof(report));
-        
-        if (bytes_written == sizeof(report)) {
-            consecutive_write_failures = 0;
-            success = 1;
-        } else if (bytes_written < 0) {
-            consecutive_write_failures++;
-            total_write_errors++;
-
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Buffer full, skip this report
-            } else if (errno == EBADF || errno == ENODEV || errno == EPIPE) {
-                // Critical error: device lost
-                perror("HIDInterface: Critical write error (device lost)");
-                safe_close_hid_device();
-                pthread_mutex_unlock(&hidg_fd_mutex);
-                return -1;
-            } else {
-                perror("HIDInterface: write error");
-            }
-            success = 0; 
-        } else {
-            // Partial write
-            printf("HIDInterface: Partial write (%zd/%zu bytes)\n", bytes_written, sizeof(report));
-            consecutive_write_failures++;
-            total_write_errors++;
-            success = 0;
-        }
-    }
-    
-    pthread_mutex_unlock(&hidg_fd_mutex);
-    return success;
+/**
+ * @brief Returns the gamepad report rate in Hz.
+ */
+int hid_interface_get_report_rate(void) {
+    return report_rate_hz;
 }
 
 /**
@@ -540,11 +580,24 @@ int hid_interface_get_connection_status() {
     return usb_connected;
 }
 
+/**
+ * @brief Returns the CLOCK_MONOTONIC time of the last OUT (FFB) report from the host, 0 if none yet.
+ */
+uint64_t hid_interface_get_last_activity_ns(void) {
+    return atomic_load_explicit(&last_host_activity_ns, memory_order_relaxed);
+}
+
 /**
  * @brief Get error statistics
  */
-void hid_interface_get_stats(int *write_errors, int *read_errors, int *reconnects) {
+void hid_interface_get_stats(int *write_errors, int *read_errors, int *reconnects,
+                             int *effects_dropped, int *effects_coalesced) {
+    uint32_t dropped, coalesced;
+    ffb_effect_queue_get_stats(&dropped, &coalesced);
+
     if (write_errors) *write_errors = total_write_errors;
     if (read_errors) *read_errors = total_read_errors;
     if (reconnects) *reconnects = reconnect_count;
+    if (effects_dropped) *effects_dropped = (int)dropped;
+    if (effects_coalesced) *effects_coalesced = (int)coalesced;
 }
\ No newline at end of file
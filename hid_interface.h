@@ -2,8 +2,12 @@
 #ifndef HID_INTERFACE_H
 #define HID_INTERFACE_H
 
+#include <stdint.h>
 #include "ffb_types.h"
 
+// Gamepad axes after the wheel (X): Y, Z and Rz, fed from pedal/shifter slaves
+#define HID_EXTRA_AXES 3
+
 // Global running flag
 extern volatile int hid_running;
 
@@ -13,17 +17,27 @@ int hid_interface_start();
 void hid_interface_stop();
 int hid_interface_get_ffb_effect(ffb_motor_effect_t *effect_out);
 int hid_interface_send_gamepad_report(float position, unsigned int buttons);
+// axes[0] is the wheel, then up to HID_EXTRA_AXES extra axes, all normalized to -1..1
+int hid_interface_send_gamepad_report_axes(const float *axes, int count, unsigned int buttons);
 //void hid_interface_send_gamepad_report(float position, unsigned int buttons);
 float hid_interface_get_relative_position(void);
 
 // Configuration functions
 void hid_interface_set_rate_limiting(int enable);
 void hid_interface_set_report_interval(int interval_ms);
+// Gamepad reports are sent by a paced writer at rate_hz (1000-8000, match the endpoint bInterval)
+int hid_interface_set_report_rate(int rate_hz);
+int hid_interface_get_report_rate(void);
 void hid_interface_recenter_wheel(void);
 
 // Status and diagnostics functions
 int hid_interface_get_connection_status();
-void hid_interface_get_stats(int *write_errors, int *read_errors, int *reconnects);
+// CLOCK_MONOTONIC ns of the last OUT (FFB) report read from the host, 0 = none yet; never blocks.
+// IN polls do not count: the host keeps polling the gamepad endpoint after the game exits.
+uint64_t hid_interface_get_last_activity_ns(void);
+// effects_dropped: operations lost to a full queue; effects_coalesced: updates replaced by newer ones
+void hid_interface_get_stats(int *write_errors, int *read_errors, int *reconnects,
+                             int *effects_dropped, int *effects_coalesced);
 
 
 #endif // HID_INTERFACE_H
\ No newline at end of file
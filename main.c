@@ -14,49 +14,110 @@
 #include <errno.h>
 #include <sched.h>
 #include <termios.h>
+#include <stdatomic.h>
 
 // Application libraries
 #include "hid_interface.h"
 #include "ffb_calculator.h"
 #include "soem_interface.h"
 #include "ffb_types.h"
+#include "rt_seqlock.h"
+#include "telemetry.h"
+#include "ffb_capture.h"
+#include "rt_clock.h"
+#include "rt_histogram.h"
+#include "shm_telemetry.h"
+#include "rt_log.h"
+#include "rt_threads.h"
+#include "ffb_estimator.h"
+#include "soem_cia402.h"
+#include "soem_config_cache.h"
+#include "ffb_profile.h"
+#include "rt_arena.h"
+#include "rt_alloc_track.h"
+#include "ffb_e2e.h"
 
 // Configuration constants
 #define MAIN_LOOP_FREQUENCY_HZ 100  // 100 Hz (10ms cycle time)
 #define CYCLE_TIME_NS (1000000000L / MAIN_LOOP_FREQUENCY_HZ)
-#define MAX_STEERING_ANGLE 540.0f  // ±540 degrees (3 full turns)
-#define MAX_TORQUE_LIMIT 5000.0f   // Maximum torque in appropriate units
-#define STATS_PRINT_INTERVAL 100   // Print stats every 100 loops (1 second at 100Hz)
-#define MAX_LATE_WARNINGS 20       // Reduced warnings
+// Steering range and torque limit come from the tuning profile (ffb_profile.h, -P)
 #define EMERGENCY_STOP_THRESHOLD 10000.0f // Emergency torque threshold
 
 // **SYNAPTICON 16-BIT ENCODER SPECIFICATIONS**
 // 16-bit absolute encoder = 65,536 counts per revolution
 // This provides very high precision: 360° / 65536 = 0.0055° per count
 #define ENCODER_COUNTS_PER_REV 65536.0f  // 2^16 = 65,536 counts per revolution
-#define MAX_STEERING_REVOLUTIONS 1.5f    // ±1.5 revolutions = ±540 degrees
+// Estimator output (counts/s) to the drive's 0x606C velocity unit (rpm) the effect gains are tuned for
+#define COUNTS_PER_SECOND_TO_RPM (60.0f / ENCODER_COUNTS_PER_REV)
+// Step of the +/- keys for the wheel drive's max torque (per mille of rated torque)
+#define MAX_TORQUE_TUNING_STEP 100
+// Encoder counts from rest to full travel of an active pedal (drive axis mapped to a HID axis)
+#define PEDAL_TRAVEL_COUNTS (ENCODER_COUNTS_PER_REV / 4.0f)
 
 // **FFB LOGGING CONFIGURATION**
-#define LOG_FILENAME_FORMAT "ffb_log_%Y%m%d_%H%M%S.csv"
-#define LOG_BUFFER_SIZE 1024
-#define LOG_FLUSH_INTERVAL 50  // Flush every 50 loops (0.5 seconds)
+// Binary telemetry segments <name>_NNNN.ffbt; convert with ffb_logdump
+#define LOG_FILENAME_FORMAT "ffb_log_%Y%m%d_%H%M%S"
 
 // Global flags and state
 static volatile int running = 1;
-static volatile int emergency_stop = 0;
+static volatile int emergency_stop = 0;  // Latched until Ctrl+F
 static volatile int pause_control = 0;
+static int inline_mode = 0;  // FFB engine runs inside the EtherCAT cycle
 
 // Position handling - centralized approach
-static float global_current_position = 0.0f;
-static float global_center_position = 0.0f;
-static pthread_mutex_t position_global_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Atomics so the engine can run in the EtherCAT thread while main recenters
+static _Atomic float global_current_position = 0.0f;
+static _Atomic float global_center_position = 0.0f;
 static int position_system_initialized = 0;
 
+// Button states read by the main loop, sent with the axes by whichever thread publishes them
+static atomic_uint gamepad_buttons = 0;
+
+// Set by the engine while a constant, ramp or periodic effect plays; the safety supervisor
+// only expects FFB reports then. Conditions are sent once and may hold for minutes.
+static atomic_int fed_effects_playing = 0;
+
+// Velocity and acceleration from encoder positions, owned by whichever thread runs the engine
+static ffb_estimator_t wheel_estimator;
+// Tuning the engine runs with, same owner; replaced at a cycle boundary when a profile is published
+static ffb_profile_t engine_profile = FFB_PROFILE_DEFAULT;
+
+// Non-wheel EtherCAT axes reported as the HID Y/Z/Rz axes, in bus order
+typedef struct {
+    int axis;                   // soem_interface axis number
+    soem_axis_kind_t kind;
+    int32_t rest_position;      // Drive axes: encoder position at startup = released pedal
+} extra_axis_t;
+
+static extra_axis_t extra_axes[HID_EXTRA_AXES];
+static int extra_axis_count = 0;
+static int wheel_axis = 0;      // soem_interface axis number of the wheel drive
+static uint16_t wheel_slave = 0; // Its EtherCAT slave, as reported in drive events
+
+// Startup: EtherCAT comes up on its own thread while HID and logging start
+typedef struct {
+    const char *ifname;
+    int result;
+} ethercat_boot_t;
+
+static uint64_t startup_time_ns = 0;    // CLOCK_MONOTONIC at startup, like drive event times
+static int first_torque_reported = 0;
+static const char *bench_results_path = NULL;   // -B: timings and end-to-end latency as JSON at exit
+
 // FFB Logging system
-static FILE *log_file = NULL;
-static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int log_counter = 0;
 static int logging_enabled = 1;  // Can be toggled
+static int status_requested = 0; // Ctrl+T: print status and latency histograms
+static int quick_stop_active = 0; // Ctrl+E: CiA 402 quick stop of all drives
+static int wheel_max_torque = SOEM_MAX_TORQUE_DEFAULT; // +/-: wheel drive 0x6072, per mille
+
+// Main loop timing, recorded by the main thread only
+static rt_histogram_t *hist_loop_wakeup_late; // Wakeup after the intended loop start
+static rt_histogram_t *hist_stage_status;     // Communication status and inline engine pickup
+static rt_histogram_t *hist_stage_engine;     // Position, FFB reports, torque and safety
+static rt_histogram_t *hist_stage_log;        // Telemetry record push
+static rt_histogram_t *hist_stage_send;       // Torque command to the EtherCAT thread
+static rt_histogram_t *hist_stage_hid;        // Buttons and gamepad report
+static rt_histogram_t *hist_loop_work;        // Whole loop body
 
 //Keyboard inputs
 struct termios orig_termios;
@@ -64,9 +125,67 @@ struct termios orig_termios;
 // FFB Logging functions
 static int init_ffb_logging(void);
 static void cleanup_ffb_logging(void);
-static void log_ffb_data(const ffb_motor_effect_t *ffb_effect, float position_deg, float velocity, float torque_out, int effect_available);
+static void log_ffb_data(const ffb_motor_effect_t *ffb_effect, float position_deg, float velocity, float torque_out,
+                         int effect_available, uint64_t active_mask, int ethercat_ok, int hid_ok);
 static void toggle_logging(void);
 
+// Assigns the non-wheel axes found on the EtherCAT segment to the extra HID axes
+static void init_extra_axes(void) {
+    extra_axis_count = 0;
+    for (int axis = 0; axis < soem_interface_get_axis_count() && extra_axis_count < HID_EXTRA_AXES; axis++) {
+        soem_axis_info_t info;
+        if (soem_interface_get_axis_info(axis, &info) != 0) continue;
+        if (info.is_wheel) {
+            wheel_axis = axis;
+            wheel_slave = info.slave;
+            continue;
+        }
+
+        extra_axis_t *extra = &extra_axes[extra_axis_count++];
+        extra->axis = axis;
+        extra->kind = info.kind;
+        extra->rest_position = 0;
+        if (info.kind == SOEM_AXIS_DRIVE) {
+            soem_pdo_snapshot_t sample;
+            soem_interface_get_axis_snapshot(axis, &sample);
+            extra->rest_position = sample.position;
+        }
+        printf("HID axis %d: EtherCAT slave %u (%s)\n", extra_axis_count, info.slave, info.name);
+    }
+}
+
+// Fills axes[0] with the wheel and the following entries with the extra axes; returns the count
+static int read_gamepad_axes(float wheel_position, float *axes) {
+    axes[0] = wheel_position;
+    for (int i = 0; i < extra_axis_count; i++) {
+        const extra_axis_t *extra = &extra_axes[i];
+        float value = 0.0f;
+        if (extra->kind == SOEM_AXIS_DRIVE) {
+            soem_pdo_snapshot_t sample;
+            soem_interface_get_axis_snapshot(extra->axis, &sample);
+            // Released pedal is -1, full travel +1
+            value = 2.0f * (float)(sample.position - extra->rest_position) / PEDAL_TRAVEL_COUNTS - 1.0f;
+        } else {
+            // I/O terminal: first input word is the analog channel
+            int16_t raw = 0;
+            if (soem_interface_get_axis_inputs(extra->axis, (uint8_t *)&raw, sizeof(raw)) == (int)sizeof(raw)) {
+                value = (float)raw / 32767.0f;
+            }
+        }
+        axes[1 + i] = value;
+    }
+    return 1 + extra_axis_count;
+}
+
+// Publishes the wheel, the extra axes and the buttons for the gamepad report thread. The
+// engine's thread calls it, so the host gets a fresh sample at every poll in inline mode.
+static void publish_gamepad_report(float wheel_position) {
+    float gamepad_axes[1 + HID_EXTRA_AXES];
+    int axis_count = read_gamepad_axes(wheel_position, gamepad_axes);
+    hid_interface_send_gamepad_report_axes(gamepad_axes, axis_count,
+                                           atomic_load_explicit(&gamepad_buttons, memory_order_relaxed));
+}
+
 // Initialize FFB logging system
 static int init_ffb_logging(void) {
     char filename[256];
@@ -78,109 +197,52 @@ static int init_ffb_logging(void) {
     timeinfo = localtime(&rawtime);
     strftime(filename, sizeof(filename), LOG_FILENAME_FORMAT, timeinfo);
     
-    // Open log file
-    log_file = fopen(filename, "w");
-    if (!log_file) {
-        perror("Failed to create FFB log file");
+    // Records go through a lock-free ring; a low-priority thread does the file I/O
+    if (telemetry_init(filename) != 0) {
         return -1;
     }
     
-    // Write CSV header
-    fprintf(log_file, "timestamp_ms,loop_count,position_deg,velocity_deg_s,effect_available,");
-    fprintf(log_file, "report_id,effect_type_enum,effect_type_raw,magnitude,direction_deg,duration_ms,");
-    fprintf(log_file, "spring_coeff,damper_coeff,friction_coeff,inertia_coeff,center_pos,dead_band,");
-    fprintf(log_file, "attack_level,attack_time_ms,fade_level,fade_time_ms,");
-    fprintf(log_file, "torque_output,emergency_stop,ethercat_status\n");
-    
-    fflush(log_file);
-    
     printf("FFB logging initialized: %s\n", filename);
     return 0;
 }
 
 // Cleanup FFB logging
 static void cleanup_ffb_logging(void) {
-    pthread_mutex_lock(&log_mutex);
-    if (log_file) {
-        fflush(log_file);
-        fclose(log_file);
-        log_file = NULL;
-        printf("FFB logging closed\n");
-    }
-    pthread_mutex_unlock(&log_mutex);
+    telemetry_cleanup();
 }
 
-// Log FFB data to CSV file
-static void log_ffb_data(const ffb_motor_effect_t *ffb_effect, float position_deg, float velocity, float torque_out, int effect_available) {
+// Queue one binary telemetry record; never blocks the control loop
+static void log_ffb_data(const ffb_motor_effect_t *ffb_effect, float position_deg, float velocity, float torque_out,
+                         int effect_available, uint64_t active_mask, int ethercat_ok, int hid_ok) {
     if (!logging_enabled) return;
     
-    pthread_mutex_lock(&log_mutex);
-    
-    if (!log_file) {
-        pthread_mutex_unlock(&log_mutex);
-        return;
-    }
-    
-    // Get current timestamp in milliseconds
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
-    long timestamp_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
-    
-    // Log basic data
-    fprintf(log_file, "%ld,%d,%.3f,%.3f,%d,", 
-            timestamp_ms, log_counter, position_deg, velocity, effect_available);
     
-    // Log FFB effect data (if available)
+    telemetry_record_t record = {
+        .timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec,
+        .status = (emergency_stop || soem_interface_get_safety_faults() ? TELEMETRY_STATUS_EMERGENCY_STOP : 0) |
+                  (ethercat_ok ? TELEMETRY_STATUS_ETHERCAT_OK : 0) |
+                  (hid_ok ? TELEMETRY_STATUS_HID_OK : 0) |
+                  (pause_control ? TELEMETRY_STATUS_PAUSED : 0),
+        .effects_applied = (uint8_t)(effect_available > 255 ? 255 : effect_available),
+        .position_deg = position_deg,
+        .velocity = velocity,
+        .torque = torque_out,
+        .active_mask = active_mask,
+    };
     if (effect_available && ffb_effect) {
-        fprintf(log_file, "%d,%d,%d,%.3f,%.3f,%d,",
-                ffb_effect->report_id,
-                (int)ffb_effect->type,
-                ffb_effect->effect_type,
-                ffb_effect->magnitude,
-                ffb_effect->direction,
-                ffb_effect->duration_ms);
-        
-        // Log coefficient parameters
-        fprintf(log_file, "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
-                ffb_effect->spring_coefficient,
-                ffb_effect->damper_coefficient,
-                ffb_effect->friction_coefficient,
-                ffb_effect->inertia_coefficient,
-                ffb_effect->center_position,
-                ffb_effect->dead_band);
-        
-        // Log envelope parameters
-        fprintf(log_file, "%.3f,%d,%.3f,%d,",
-                ffb_effect->attack_level,
-                ffb_effect->attack_time_ms,
-                ffb_effect->fade_level,
-                ffb_effect->fade_time_ms);
-    } else {
-        // No effect available - log zeros/empty values for all FFB fields
-        fprintf(log_file, "0,0,0,0.0,0.0,0,");           // basic effect data
-        fprintf(log_file, "0.0,0.0,0.0,0.0,0.0,0.0,");   // coefficients
-        fprintf(log_file, "0.0,0,0.0,0,");               // envelope
-    }
-    
-    // Log output torque and status
-    fprintf(log_file, "%.3f,%d,%d\n", 
-            torque_out, emergency_stop ? 1 : 0, 
-            soem_interface_get_communication_status() ? 1 : 0);
-    
-    log_counter++;
-    
-    // Flush periodically for real-time monitoring
-    if (log_counter % LOG_FLUSH_INTERVAL == 0) {
-        fflush(log_file);
+        record.last_report_id = ffb_effect->report_id;
+        record.last_magnitude = ffb_effect->magnitude;
     }
     
-    pthread_mutex_unlock(&log_mutex);
+    telemetry_push(&record);
 }
 
 // Toggle logging on/off
 static void toggle_logging(void) {
     logging_enabled = !logging_enabled;
-    printf("FFB logging %s\n", logging_enabled ? "enabled" : "disabled");
+    RT_LOG(RT_LOG_INFO, "FFB logging %s\n", logging_enabled ? "enabled" : "disabled");
 }
 
 int check_ctrl_combinations() {
@@ -188,17 +250,46 @@ int check_ctrl_combinations() {
     if (read(STDIN_FILENO, &ch, 1) == 1) {
         switch (ch) {
             case 18: // Ctrl+R
-                printf("Ctrl+R pressed - recentering wheel!\n");
+                RT_LOG(RT_LOG_INFO, "Ctrl+R pressed - recentering wheel!\n");
                 // Recenter using our centralized system
-                pthread_mutex_lock(&position_global_mutex);
-                global_center_position = global_current_position;
-                pthread_mutex_unlock(&position_global_mutex);
-                printf("Main: Wheel recentered to position: %.2f encoder counts\n", global_center_position);
+                global_center_position = atomic_load(&global_current_position);
+                RT_LOG(RT_LOG_INFO, "Main: Wheel recentered to position: %.2f encoder counts\n", (double)global_center_position);
                 return 1;
             case 12: // Ctrl+L
-                printf("Ctrl+L pressed - toggling FFB logging!\n");
+                RT_LOG(RT_LOG_INFO, "Ctrl+L pressed - toggling FFB logging!\n");
                 toggle_logging();
                 return 1;
+            case 20: // Ctrl+T
+                status_requested = 1;
+                return 1;
+            case '+':
+            case '-':
+                // Live tuning: the SDO write runs on the mailbox thread, the cycle is untouched
+                wheel_max_torque += (ch == '+') ? MAX_TORQUE_TUNING_STEP : -MAX_TORQUE_TUNING_STEP;
+                if (wheel_max_torque < MAX_TORQUE_TUNING_STEP) wheel_max_torque = MAX_TORQUE_TUNING_STEP;
+                if (wheel_max_torque > SOEM_MAX_TORQUE_DEFAULT) wheel_max_torque = SOEM_MAX_TORQUE_DEFAULT;
+                RT_LOG(RT_LOG_INFO, "Setting wheel max torque to %d per mille\n", wheel_max_torque);
+                soem_interface_set_max_torque(wheel_axis, (uint16_t)wheel_max_torque);
+                return 1;
+            case 6: // Ctrl+F
+                RT_LOG(RT_LOG_INFO, "Ctrl+F pressed - resetting latched faults\n");
+                emergency_stop = 0;
+                soem_interface_reset_safety_faults(SOEM_SAFETY_ALL_FAULTS);
+                return 1;
+            case 5: // Ctrl+E
+                quick_stop_active = !quick_stop_active;
+                RT_LOG(RT_LOG_INFO, "Ctrl+E pressed - quick stop %s!\n", quick_stop_active ? "engaged" : "released");
+                soem_interface_request_quick_stop(quick_stop_active);
+                return 1;
+            case 16: { // Ctrl+P
+                int profile = ffb_profile_select_next();
+                if (profile < 0) {
+                    RT_LOG(RT_LOG_INFO, "Ctrl+P pressed - no tuning profiles given (-P)\n");
+                } else {
+                    RT_LOG(RT_LOG_INFO, "Ctrl+P pressed - switching to tuning profile %d\n", profile + 1);
+                }
+                return 1;
+            }
         }
     }
     return 0;
@@ -213,6 +304,7 @@ typedef struct {
     int late_warnings;
     int emergency_stops;
     int communication_errors;
+    int drive_faults;
     int ffb_effects_processed;
     double avg_torque;
     double max_torque;
@@ -224,14 +316,16 @@ typedef struct {
     float current_position_raw;      // Raw encoder position from SOEM
     float current_position_relative; // Position relative to center (encoder counts)
     float current_angle_degrees;     // Position in degrees
-    float current_velocity;
+    float current_velocity;          // Estimated, predicted to torque application (rpm)
+    float current_acceleration;      // Estimated (rpm/s)
     float desired_torque;
     float normalized_position;       // Normalized for HID (-1.0 to 1.0)
     unsigned int button_states;
     
     // FFB state
-    ffb_motor_effect_t current_ffb_effect;
-    int effect_available;
+    ffb_motor_effect_t current_ffb_effect; // Last effect block operation received
+    int effect_available;                  // Effect operations applied this loop
+    uint64_t active_mask;                  // Playing effect blocks after this loop's update
     
     // Communication status
     int ethercat_status;
@@ -246,6 +340,23 @@ typedef struct {
     struct timespec loop_end_time;
 } app_state_t;
 
+// Engine output published to the supervisory loop in inline mode
+typedef struct {
+    float current_position_raw;
+    float current_position_relative;
+    float current_angle_degrees;
+    float current_velocity;
+    float desired_torque;
+    float normalized_position;
+    int effects_received;            // Effects consumed since the engine started
+    uint64_t active_mask;
+    uint32_t cycle_count;
+} engine_status_t;
+
+static app_state_t engine_state;     // Owned by the EtherCAT thread in inline mode
+static rt_seqlock_t engine_status_lock = RT_SEQLOCK_INIT;
+static engine_status_t engine_status;
+
 // Function prototypes
 static void setup_real_time_scheduling(void);
 static void setup_signal_handlers(void);
@@ -256,32 +367,39 @@ static void sigusr2_handler(int signum);
 static float normalize_position_for_hid(float position_degrees);
 static unsigned int read_button_states(void);
 static void update_performance_stats(app_state_t *state);
+static void publish_live_state(const app_state_t *state);
 static void print_performance_stats(const performance_stats_t *stats);
+static void print_status(const app_state_t *state);
 static void reset_performance_stats(performance_stats_t *stats);
 static int apply_safety_checks(app_state_t *state);
+static void report_drive_events(app_state_t *state);
 static void maintain_loop_timing(const struct timespec *start_time, const struct timespec *end_time);
 static long timespec_diff_ns(const struct timespec *start, const struct timespec *end);
-static void update_position_system(app_state_t *state);
+static void update_position_system(app_state_t *state, float raw_position);
+static ffb_torque_t run_ffb_engine(app_state_t *state, const soem_pdo_snapshot_t *sample);
+static ffb_torque_t engine_cycle_callback(const soem_pdo_snapshot_t *sample, void *user_data);
 
 // Signal handlers
 static void sigint_handler(int signum) {
-    printf("\nCaught SIGINT (Ctrl+C), initiating graceful shutdown...\n");
+    RT_LOG_EVENT(RT_LOG_INFO, "\nCaught SIGINT (Ctrl+C), initiating graceful shutdown...\n");
     running = 0;
 }
 
 static void sigusr1_handler(int signum) {
-    printf("\nCaught SIGUSR1, pausing control loop...\n");
+    RT_LOG_EVENT(RT_LOG_INFO, "\nCaught SIGUSR1, pausing control loop...\n");
     pause_control = 1;
 }
 
 static void sigusr2_handler(int signum) {
-    printf("\nCaught SIGUSR2, resuming control loop...\n");
+    RT_LOG_EVENT(RT_LOG_INFO, "\nCaught SIGUSR2, resuming control loop...\n");
     pause_control = 0;
+    // The pause can stop the torque commands (engine stale); that fault alone is cleared here,
+    // hard faults and a stale host still need Ctrl+F
+    soem_interface_reset_safety_faults(SOEM_SAFETY_FAULT_ENGINE_STALE);
 }
 
 // Setup real-time scheduling and memory locking
 static void setup_real_time_scheduling(void) {
-    struct sched_param param;
     int ret;
 
     // Lock memory to prevent page faults
@@ -290,14 +408,13 @@ static void setup_real_time_scheduling(void) {
         perror("Warning: Failed to lock memory");
     }
 
-    // Use a moderate real-time priority
-    param.sched_priority = 50;
-    ret = sched_setscheduler(0, SCHED_FIFO, &param);
-    if (ret != 0) {
-        perror("Warning: Failed to set real-time scheduling");
+    // Main loop core and priority from the thread topology (engine role); the other
+    // threads get theirs when they are created
+    const rt_thread_config_t *engine = rt_threads_get_config(RT_THREAD_ENGINE);
+    if (rt_threads_apply_self(RT_THREAD_ENGINE) != 0) {
         printf("Running with normal scheduling. Consider running with sudo for real-time priority.\n");
     } else {
-        printf("Real-time scheduling enabled with priority %d\n", param.sched_priority);
+        printf("Real-time scheduling enabled with priority %d\n", engine->priority);
     }
 
     // Set process priority
@@ -351,6 +468,38 @@ static void setup_signal_handlers(void) {
     sigaction(SIGPIPE, &sa, NULL);
 }
 
+static uint64_t monotonic_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// -B: everything the histograms measured, for comparing builds (see ffb_inject)
+static void write_bench_results(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror("Failed to create the benchmark results file");
+        return;
+    }
+    char when[32];
+    time_t now = time(NULL);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(file, "{\n  \"suite\": \"ffb_app\",\n  \"time\": \"%s\",\n  \"cycle_us\": %u,\n", when,
+            soem_interface_get_cycle_time());
+    fprintf(file, "  \"engine_mode\": \"%s\",\n  \"fixed_point\": %d,\n  \"runtime_s\": %.1f,\n",
+            inline_mode ? "inline" : "main loop", FFB_FIXED_POINT, (monotonic_now_ns() - startup_time_ns) / 1e9);
+    fprintf(file, "  \"e2e\": ");
+    ffb_e2e_write_json(file);
+    fprintf(file, ",\n  \"histograms\": ");
+    rt_histogram_write_json(file);
+    fprintf(file, "\n}\n");
+    if (fclose(file) != 0) {
+        perror("Failed to write the benchmark results file");
+        return;
+    }
+    printf("Benchmark results written to %s\n", path);
+}
+
 // Cleanup and exit function
 static void cleanup_and_exit(int exit_code) {
     printf("\nInitiating cleanup sequence...\n");
@@ -368,6 +517,15 @@ static void cleanup_and_exit(int exit_code) {
     // Stop HID interface
     printf("Stopping HID interface...\n");
     hid_interface_stop();
+    ffb_capture_stop();
+    ffb_profile_watch_stop();
+    shm_telemetry_cleanup();
+    if (bench_results_path) write_bench_results(bench_results_path);
+    
+    // Print what the threads queued before they stopped
+    rt_log_stop();
+    rt_alloc_track_report();
+    rt_threads_restore_system();
     
     // Unlock memory
     munlockall();
@@ -378,12 +536,13 @@ static void cleanup_and_exit(int exit_code) {
 
 // Convert position to normalized range for HID report
 static float normalize_position_for_hid(float position_degrees) {
-    // Clamp to range ±540 degrees
-    if (position_degrees > MAX_STEERING_ANGLE) position_degrees = MAX_STEERING_ANGLE;
-    if (position_degrees < -MAX_STEERING_ANGLE) position_degrees = -MAX_STEERING_ANGLE;
+    // Clamp to the profile's steering range
+    float range = engine_profile.steering_range_deg;
+    if (position_degrees > range) position_degrees = range;
+    if (position_degrees < -range) position_degrees = -range;
     
     // Normalize to [-1.0, 1.0]
-    return position_degrees / MAX_STEERING_ANGLE;
+    return position_degrees / range;
 }
 
 // Read button states (placeholder implementation)
@@ -397,11 +556,9 @@ static long timespec_diff_ns(const struct timespec *start, const struct timespec
 }
 
 // Centralized position system update - FIXED FOR SYNAPTICON 16-BIT ENCODER
-static void update_position_system(app_state_t *state) {
-    // Get raw position from SOEM (encoder counts)
-    state->current_position_raw = soem_interface_get_current_position();
-    
-    pthread_mutex_lock(&position_global_mutex);
+static void update_position_system(app_state_t *state, float raw_position) {
+    // Raw position from SOEM (encoder counts)
+    state->current_position_raw = raw_position;
     
     // Update global position
     global_current_position = state->current_position_raw;
@@ -410,34 +567,198 @@ static void update_position_system(app_state_t *state) {
     if (!position_system_initialized) {
         global_center_position = state->current_position_raw;
         position_system_initialized = 1;
-        printf("Main: Position system initialized for Synapticon 16-bit encoder\n");
-        printf("       Encoder resolution: %.0f counts/revolution (16-bit precision)\n", ENCODER_COUNTS_PER_REV);
-        printf("       Precision: %.4f degrees per count\n", 360.0f / ENCODER_COUNTS_PER_REV);
-        printf("       Center position: %.2f encoder counts\n", global_center_position);
-        printf("       Max steering range: ±%.0f degrees (±%.1f revolutions)\n", 
-               MAX_STEERING_ANGLE, MAX_STEERING_REVOLUTIONS);
+        RT_LOG_EVENT(RT_LOG_INFO, "Main: Position system initialized for Synapticon 16-bit encoder\n");
+        RT_LOG_EVENT(RT_LOG_INFO, "       Encoder resolution: %.0f counts/revolution (16-bit precision)\n", ENCODER_COUNTS_PER_REV);
+        RT_LOG_EVENT(RT_LOG_INFO, "       Precision: %.4f degrees per count\n", 360.0f / ENCODER_COUNTS_PER_REV);
+        RT_LOG_EVENT(RT_LOG_INFO, "       Center position: %.2f encoder counts\n", (double)global_center_position);
+        RT_LOG_EVENT(RT_LOG_INFO, "       Max steering range: ±%.0f degrees (±%.1f revolutions)\n", 
+               engine_profile.steering_range_deg, engine_profile.steering_range_deg / 360.0f);
     }
     
     // Calculate relative position (in encoder counts)
     state->current_position_relative = global_current_position - global_center_position;
     
-    pthread_mutex_unlock(&position_global_mutex);
-    
     // Convert to degrees using correct Synapticon 16-bit encoder resolution
     // Formula: degrees = (encoder_counts / counts_per_revolution) * 360°
     state->current_angle_degrees = (state->current_position_relative / ENCODER_COUNTS_PER_REV) * 360.0f;
     
-    // Normalize for HID (-1.0 to +1.0 for ±540°)
+    // Normalize for HID (-1.0 to +1.0 over the steering range)
     state->normalized_position = normalize_position_for_hid(state->current_angle_degrees);
+}
+
+// Print position debug output (called from the supervisory loop only)
+static void print_position_debug(const app_state_t *state) {
+    printf("Position: Raw=%.0f, Center=%.0f, Rel=%.0f, Deg=%.1f°, Norm=%.4f, Rev=%.3f\n",
+           state->current_position_raw, (double)global_center_position, 
+           state->current_position_relative, state->current_angle_degrees, 
+           state->normalized_position, state->current_angle_degrees / 360.0f);
+}
+
+// Take over a newly published tuning profile. Called before anything else in the engine step,
+// so one cycle runs entirely on the old profile and the next entirely on the new one.
+static void apply_tuning_profile(const ffb_profile_t *profile) {
+    if (profile->generation == engine_profile.generation) {
+        return;
+    }
+    engine_profile = *profile;
+    ffb_calculator_set_profile(profile);
+    // Condition centers/dead bands from the host are normalized to full steering lock
+    ffb_calculator_set_input_range(ENCODER_COUNTS_PER_REV * profile->steering_range_deg / 360.0f, 0.0f);
+    ffb_estimator_set_time_constant(&wheel_estimator, profile->estimator_time_constant_s);
+    ffb_output_config_t output_config;
+    ffb_profile_output_config(profile, &output_config);
+    soem_interface_set_output_config(&output_config);
+    soem_safety_config_t safety_config;
+    ffb_profile_safety_config(profile, &safety_config);
+    soem_interface_set_safety_config(&safety_config);
+    // The profile's max torque is the drive's 0x6072: the +/- keys scale all of it
+    soem_interface_set_torque_full_scale(profile->max_torque);
+    RT_LOG_EVENT(RT_LOG_INFO, "Main: Tuning profile #%u active: gain %.2f, max torque %.0f, steering range ±%.0f°\n",
+           profile->generation, profile->global_gain, profile->max_torque, profile->steering_range_deg);
+}
+
+// FFB engine step: encoder sample in, torque command out.
+// Runs in the main loop, or in the EtherCAT thread in inline mode.
+static ffb_torque_t run_ffb_engine(app_state_t *state, const soem_pdo_snapshot_t *sample) {
+    apply_tuning_profile(ffb_profile_acquire());
+    state->ethercat_status = soem_interface_get_communication_status();
+
+    // Position system (centralized with correct 16-bit encoder handling)
+    update_position_system(state, (float)sample->position);
+    
+    // Velocity and acceleration from the position samples, predicted to when this torque
+    // reaches the drive: the sample's age (main loop mode) plus one cycle of transport
+    float sample_age_s = 0.0f;
+    if (!inline_mode) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+        if (now_ns > sample->timestamp_ns) sample_age_s = (float)(now_ns - sample->timestamp_ns) * 1e-9f;
+    }
+    ffb_estimate_t estimate;
+    ffb_estimator_update(&wheel_estimator, sample);
+    ffb_estimator_predict(&wheel_estimator, sample_age_s, &estimate);
+    state->current_velocity = estimate.velocity * COUNTS_PER_SECOND_TO_RPM;
+    state->current_acceleration = estimate.acceleration * COUNTS_PER_SECOND_TO_RPM;
+    
+    // FFB commands from PC: apply every queued effect block operation
+    state->effect_available = 0;
+    while (hid_interface_get_ffb_effect(&state->current_ffb_effect)) {
+        ffb_calculator_process_effect(&state->current_ffb_effect);
+        state->effect_available++;
+    }
     
-    // Enhanced debug output (reduced frequency)
-    static int debug_counter = 0;
-    if (++debug_counter % 50 == 0) {  // Every 50 loops (0.5 seconds)
-        printf("Position: Raw=%.0f, Center=%.0f, Rel=%.0f, Deg=%.1f°, Norm=%.4f, Rev=%.3f\n",
-               state->current_position_raw, global_center_position, 
-               state->current_position_relative, state->current_angle_degrees, 
-               state->normalized_position, state->current_angle_degrees / 360.0f);
+    // Sum all playing effects (use relative position in encoder counts)
+#if FFB_FIXED_POINT
+    // Integer engine: the position stays in the drive's counts, wrapping like the encoder
+    int32_t position_counts = (int32_t)((uint32_t)sample->position - (uint32_t)ffb_fixed_from_float(global_center_position, 0));
+    ffb_calculator_update_fixed(ffb_fixed_from_int(position_counts, FFB_FIXED_POSITION_SHIFT),
+                                ffb_fixed_from_float(state->current_velocity, FFB_FIXED_VELOCITY_SHIFT),
+                                ffb_fixed_from_float(state->current_acceleration, FFB_FIXED_ACCELERATION_SHIFT));
+#else
+    ffb_calculator_update(state->current_position_relative, state->current_velocity, state->current_acceleration);
+#endif
+    state->desired_torque = ffb_calculator_get_torque();
+    state->active_mask = ffb_calculator_get_active_mask();
+    atomic_store_explicit(&fed_effects_playing, (state->active_mask & ~ffb_calculator_get_condition_mask()) != 0,
+                          memory_order_relaxed);
+    
+    // Apply safety checks; communication loss and stale inputs are handled by the
+    // supervisor in the EtherCAT cycle (soem_safety.h)
+    apply_safety_checks(state);
+    
+    // Zero torque if communication is lost, control is paused or emergency stop is active
+    if (!state->ethercat_status || emergency_stop || pause_control) {
+        return 0;
+    }
+    // Already within max_torque: the calculator clamps to the same limit
+    return ffb_calculator_get_torque_command();
+}
+
+// HID deadline of the safety supervisor: the last FFB report from the host, while an effect
+// the game keeps feeding plays. The host keeps polling the gamepad endpoint after the game is
+// gone, so IN reports do not count; a centering spring in a menu or a car standing still sends
+// nothing for long stretches, so conditions alone are not supervised (0 = no deadline).
+static uint64_t host_ffb_activity_ns(void) {
+    if (!atomic_load_explicit(&fed_effects_playing, memory_order_relaxed)) {
+        return 0;
     }
+    return hid_interface_get_last_activity_ns();
+}
+
+// Inline mode: the engine runs between ec_receive_processdata and the next send,
+// so torque is computed from the encoder sample of the same cycle.
+static ffb_torque_t engine_cycle_callback(const soem_pdo_snapshot_t *sample, void *user_data) {
+    app_state_t *state = (app_state_t *)user_data;
+    ffb_torque_t torque = run_ffb_engine(state, sample);
+    if (hid_interface_get_connection_status()) {
+        publish_gamepad_report(state->normalized_position);
+    }
+    
+    rt_seqlock_write_begin(&engine_status_lock);
+    engine_status.current_position_raw = state->current_position_raw;
+    engine_status.current_position_relative = state->current_position_relative;
+    engine_status.current_angle_degrees = state->current_angle_degrees;
+    engine_status.current_velocity = state->current_velocity;
+    engine_status.desired_torque = state->desired_torque;
+    engine_status.normalized_position = state->normalized_position;
+    engine_status.effects_received += state->effect_available;
+    engine_status.active_mask = state->active_mask;
+    engine_status.cycle_count = sample->cycle_count;
+    rt_seqlock_write_end(&engine_status_lock);
+    
+    return torque;
+}
+
+// Copy the inline engine's latest output into the supervisory loop state
+static void read_engine_status(app_state_t *state, int *effects_seen) {
+    engine_status_t status;
+    unsigned int seq;
+    do {
+        seq = rt_seqlock_read_begin(&engine_status_lock);
+        status = engine_status;
+    } while (rt_seqlock_read_retry(&engine_status_lock, seq));
+    
+    state->current_position_raw = status.current_position_raw;
+    state->current_position_relative = status.current_position_relative;
+    state->current_angle_degrees = status.current_angle_degrees;
+    state->current_velocity = status.current_velocity;
+    state->desired_torque = status.desired_torque;
+    state->normalized_position = status.normalized_position;
+    state->effect_available = status.effects_received - *effects_seen;
+    state->active_mask = status.active_mask;
+    *effects_seen = status.effects_received;
+}
+
+// Publish the loop state to /dev/shm for external readers (no syscalls)
+static void publish_live_state(const app_state_t *state) {
+    static uint32_t effects_received = 0;
+    soem_pdo_snapshot_t sample;
+    shm_telemetry_state_t live;
+
+    soem_interface_get_pdo_snapshot(&sample);
+    effects_received += (uint32_t)state->effect_available;
+
+    live.timestamp_ns = (uint64_t)state->loop_end_time.tv_sec * 1000000000ULL + (uint64_t)state->loop_end_time.tv_nsec;
+    live.update_count = 0; // Counted by shm_telemetry_publish()
+    live.status = (emergency_stop || soem_interface_get_safety_faults() ? SHM_TELEMETRY_STATUS_EMERGENCY_STOP : 0) |
+                  (state->ethercat_status ? SHM_TELEMETRY_STATUS_ETHERCAT_OK : 0) |
+                  (state->hid_status ? SHM_TELEMETRY_STATUS_HID_OK : 0) |
+                  (pause_control ? SHM_TELEMETRY_STATUS_PAUSED : 0) |
+                  (inline_mode ? SHM_TELEMETRY_STATUS_INLINE : 0);
+    live.ethercat_cycle = sample.cycle_count;
+    live.angle_deg = state->current_angle_degrees;
+    live.normalized_position = state->normalized_position;
+    live.velocity = state->current_velocity;
+    live.torque_command = state->desired_torque;
+    live.torque_actual = sample.torque_actual;
+    live.statusword = sample.statusword;
+    live.cia402_state = (uint16_t)get_cia402_state(sample.statusword);
+    live.reserved0 = 0;
+    live.active_mask = state->active_mask;
+    live.effects_received = effects_received;
+    live.reserved1 = 0;
+    shm_telemetry_publish(&live);
 }
 
 // Update performance statistics
@@ -471,21 +792,63 @@ static void print_performance_stats(const performance_stats_t *stats) {
            stats->min_time_ns / 1000000.0, stats->max_time_ns / 1000000.0, avg_time_ns / 1000000.0);
     printf("Loop count: %d, Late warnings: %d, Emergency stops: %d\n",
            stats->loop_count, stats->late_warnings, stats->emergency_stops);
-    printf("Communication errors: %d, FFB effects processed: %d\n",
-           stats->communication_errors, stats->ffb_effects_processed);
+    printf("Communication errors: %d, Drive faults: %d, FFB effects processed: %d\n",
+           stats->communication_errors, stats->drive_faults, stats->ffb_effects_processed);
     printf("Torque: Avg=%.1f, Max=%.1f\n", stats->avg_torque, stats->max_torque);
+    ffb_profile_t profile;
+    ffb_profile_get_current(&profile);
     printf("Encoder: Synapticon 16-bit absolute, %.0f counts/rev, ±%.0f° range\n", 
-           ENCODER_COUNTS_PER_REV, MAX_STEERING_ANGLE);
+           ENCODER_COUNTS_PER_REV, profile.steering_range_deg);
     printf("Precision: %.4f degrees per encoder count\n", 360.0f / ENCODER_COUNTS_PER_REV);
-    printf("FFB Logging: %s, Records logged: %d\n", 
-           logging_enabled ? "Enabled" : "Disabled", log_counter);
+    uint32_t log_queued, log_dropped, log_written;
+    telemetry_get_stats(&log_queued, &log_dropped, &log_written);
+    printf("FFB Logging: %s, Records logged: %u, Written: %u, Dropped: %u\n", 
+           logging_enabled ? "Enabled" : "Disabled", log_queued, log_written, log_dropped);
     
     // HID statistics
-    int hid_write_errors, hid_read_errors, hid_reconnects;
-    hid_interface_get_stats(&hid_write_errors, &hid_read_errors, &hid_reconnects);
+    int hid_write_errors, hid_read_errors, hid_reconnects, hid_dropped, hid_coalesced;
+    hid_interface_get_stats(&hid_write_errors, &hid_read_errors, &hid_reconnects,
+                            &hid_dropped, &hid_coalesced);
     printf("HID: Write errors=%d, Read errors=%d, Reconnects=%d, Connected=%s\n",
            hid_write_errors, hid_read_errors, hid_reconnects,
            hid_interface_get_connection_status() ? "Yes" : "No");
+    printf("FFB queue: Dropped=%d, Coalesced=%d\n", hid_dropped, hid_coalesced);
+    uint32_t rt_log_dropped, rt_log_suppressed;
+    rt_log_get_stats(&rt_log_dropped, &rt_log_suppressed);
+    printf("RT log: Dropped=%u, Rate limited=%u\n", rt_log_dropped, rt_log_suppressed);
+    rt_histogram_print_all();
+}
+
+// Faults latched by the EtherCAT cycle's supervisor, cleared with Ctrl+F
+static void print_safety_faults(void) {
+    uint32_t faults = soem_interface_get_safety_faults();
+    printf("Safety: ");
+    if (!faults) printf("no faults");
+    for (int i = 0; i < SOEM_SAFETY_FAULT_COUNT; i++) {
+        if (faults & (1U << i)) {
+            printf("%s%s", (faults & ((1U << i) - 1)) ? ", " : "", soem_safety_fault_name((soem_safety_fault_t)(1U << i)));
+        }
+    }
+    printf("%s\n", faults ? " latched (Ctrl+F to reset)" : "");
+}
+
+// Print the current wheel state and all latency histograms (Ctrl+T)
+static void print_status(const app_state_t *state) {
+    uint32_t logged_records;
+    ffb_profile_t profile;
+    telemetry_get_stats(&logged_records, NULL, NULL);
+    ffb_profile_get_current(&profile);
+    printf("Status: Deg=%.1f° (%.3f rev), Norm=%.4f, Vel=%.1f°/s, Torque=%.1f, EtherCAT=%s, HID=%s, Emergency=%s, Log=%u, Profile=%s\n",
+           state->current_angle_degrees, state->current_angle_degrees / 360.0f,
+           state->normalized_position, state->current_velocity, state->desired_torque,
+           state->ethercat_status ? "OK" : "LOST",
+           state->hid_status ? "OK" : "LOST",
+           emergency_stop ? "STOP" : "OK",
+           logged_records, profile.name);
+    print_safety_faults();
+    print_position_debug(state);
+    rt_histogram_print_all();
+    rt_alloc_track_report();
 }
 
 // Reset performance statistics
@@ -494,12 +857,45 @@ static void reset_performance_stats(performance_stats_t *stats) {
     stats->min_time_ns = LONG_MAX;
 }
 
+// Log the CiA 402 events queued by the EtherCAT thread since the last loop. Each one is
+// printed: a fault recovery passes several states within one rate window, on every drive.
+static void report_drive_events(app_state_t *state) {
+    soem_cia402_event_t event;
+    while (soem_cia402_poll_event(&event)) {
+        switch (event.type) {
+            case SOEM_CIA402_EVENT_STATE_CHANGED:
+                RT_LOG_EVENT(RT_LOG_INFO, "Drive %u: %s -> %s (statusword 0x%04X)\n", event.slave,
+                             get_cia402_state_name((cia402_state_t)event.previous_state),
+                             get_cia402_state_name((cia402_state_t)event.state), event.statusword);
+                break;
+            case SOEM_CIA402_EVENT_FAULT:
+                state->stats.drive_faults++;
+                RT_LOG_EVENT(RT_LOG_ERROR, "Drive %u: fault (statusword 0x%04X), reset scheduled\n", event.slave, event.statusword);
+                break;
+            case SOEM_CIA402_EVENT_ENABLED:
+                if (!first_torque_reported && event.slave == wheel_slave) {
+                    first_torque_reported = 1;
+                    RT_LOG_EVENT(RT_LOG_INFO, "Wheel drive enabled %.1f ms after startup (time to first torque)\n",
+                                 (event.time_ns - startup_time_ns) / 1e6);
+                }
+                // Fall through
+            case SOEM_CIA402_EVENT_FAULT_RESET:
+                RT_LOG_EVENT(RT_LOG_INFO, "Drive %u: %s (%u fault resets)\n", event.slave,
+                             soem_cia402_event_name((soem_cia402_event_type_t)event.type), event.reset_attempts);
+                break;
+            default:
+                RT_LOG_EVENT(RT_LOG_INFO, "Drive %u: %s\n", event.slave, soem_cia402_event_name((soem_cia402_event_type_t)event.type));
+                break;
+        }
+    }
+}
+
 // Apply safety checks and emergency procedures
 static int apply_safety_checks(app_state_t *state) {
-    // Check for emergency stop conditions
+    // Check for emergency stop conditions; the stop latches until Ctrl+F
     if (fabs(state->desired_torque) > EMERGENCY_STOP_THRESHOLD) {
         if (!emergency_stop) {
-            printf("EMERGENCY STOP: Torque %.1f exceeds threshold %.1f\n",
+            RT_LOG(RT_LOG_INFO, "EMERGENCY STOP: Torque %.1f exceeds threshold %.1f, Ctrl+F to reset\n",
                    state->desired_torque, EMERGENCY_STOP_THRESHOLD);
             emergency_stop = 1;
             state->stats.emergency_stops++;
@@ -508,26 +904,16 @@ static int apply_safety_checks(app_state_t *state) {
         return 1;
     }
     
-    // Check for communication loss
-    if (!state->ethercat_status) {
-        static int comm_loss_count = 0;
-        if (++comm_loss_count > 100) { // 1 second without communication at 100Hz
-            printf("SAFETY: EtherCAT communication lost, setting zero torque\n");
-            state->desired_torque = 0.0f;
-            comm_loss_count = 0;
-            return 1;
-        }
-    }
-    
     // Apply torque limits
-    if (fabs(state->desired_torque) > MAX_TORQUE_LIMIT) {
-        state->desired_torque = (state->desired_torque > 0) ? MAX_TORQUE_LIMIT : -MAX_TORQUE_LIMIT;
+    float torque_limit = engine_profile.max_torque;
+    if (fabs(state->desired_torque) > torque_limit) {
+        state->desired_torque = (state->desired_torque > 0) ? torque_limit : -torque_limit;
     }
     
-    // Check for excessive steering angle (beyond ±540°)
-    if (fabs(state->current_angle_degrees) > MAX_STEERING_ANGLE * 1.1f) {
-        printf("WARNING: Steering angle %.1f° exceeds safe range (±%.0f°)\n", 
-               state->current_angle_degrees, MAX_STEERING_ANGLE);
+    // Check for excessive steering angle (beyond the profile's steering range)
+    if (fabs(state->current_angle_degrees) > engine_profile.steering_range_deg * 1.1f) {
+        RT_LOG(RT_LOG_INFO, "WARNING: Steering angle %.1f° exceeds safe range (±%.0f°)\n", 
+               state->current_angle_degrees, engine_profile.steering_range_deg);
     }
     
     return 0;
@@ -535,8 +921,6 @@ static int apply_safety_checks(app_state_t *state) {
 
 // Maintain loop timing
 static void maintain_loop_timing(const struct timespec *start_time, const struct timespec *end_time) {
-    static int late_warning_count = 0;
-    
     long elapsed_ns = timespec_diff_ns(start_time, end_time);
     long sleep_ns = CYCLE_TIME_NS - elapsed_ns;
     
@@ -546,20 +930,122 @@ static void maintain_loop_timing(const struct timespec *start_time, const struct
             .tv_nsec = sleep_ns % 1000000000L
         };
         nanosleep(&sleep_time, NULL);
-    } else if (sleep_ns < -1000000 && late_warning_count < MAX_LATE_WARNINGS) {
-        printf("Warning: Loop running %.3fms late (target: %.3fms, actual: %.3fms)\n",
+
+        struct timespec wake_time;
+        clock_gettime(CLOCK_MONOTONIC, &wake_time);
+        long late_ns = timespec_diff_ns(end_time, &wake_time) - sleep_ns;
+        rt_histogram_record(hist_loop_wakeup_late, late_ns > 0 ? (uint64_t)late_ns : 0);
+    } else if (sleep_ns < -1000000) {
+        RT_LOG(RT_LOG_INFO, "Warning: Loop running %.3fms late (target: %.3fms, actual: %.3fms)\n",
                -sleep_ns / 1000000.0, CYCLE_TIME_NS / 1000000.0, elapsed_ns / 1000000.0);
-        late_warning_count++;
     }
 }
 
+// Brings up the EtherCAT master; runs with the scheduling the main thread had at startup
+static void *ethercat_boot_thread(void *arg) {
+    ethercat_boot_t *boot = (ethercat_boot_t *)arg;
+    boot->result = soem_interface_init_enhanced(boot->ifname);
+    return NULL;
+}
+
+// Print command line usage
+static void print_usage(const char *prog) {
+    printf("Usage: %s [-c cycle_us] [-n] [-i] [-r rate_hz] [-R capture_file] [-T topology] [-U] [-N] [-F] [-P profile]... [-B results.json] [ifname]\n", prog);
+    printf("  -c cycle_us  EtherCAT cycle time in microseconds (%d-%d, default %d)\n",
+           SOEM_CYCLE_TIME_MIN_US, SOEM_CYCLE_TIME_MAX_US, SOEM_CYCLE_TIME_DEFAULT_US);
+    printf("  -n           Disable distributed-clock synchronization (free-running cycle)\n");
+    printf("  -i           Inline mode: run the FFB engine inside the EtherCAT cycle\n");
+    printf("  -r rate_hz   Gamepad report rate, match the USB endpoint polling rate (1000-8000, default 1000);\n"
+           "               new samples every EtherCAT cycle with -i, at 100 Hz without\n");
+    printf("  -R file      Record the HID output reports from the host for ffb_replay\n");
+    printf("  -T spec      Thread topology, role=cpu[:policy[:priority]],... with roles ethercat, engine,\n");
+    printf("               hid_rx, hid_tx, background (e.g. ethercat=3:fifo:80,engine=2:fifo:50)\n");
+    printf("  -U           Run even if the EtherCAT core is not isolated (isolcpus)\n");
+    printf("  -N           Leave the NIC as configured (no coalescing, busy polling or socket priority changes)\n");
+    printf("  -F           Configure every drive in full, ignoring the drive configuration cache (%s)\n",
+           SOEM_CONFIG_CACHE_PATH);
+    printf("  -P file      Tuning profile (gains, max torque, steering range); repeat to switch with Ctrl+P.\n");
+    printf("               The first is active at startup, edited files are reloaded while running\n");
+    printf("  -B file      At exit, write the latency histograms and the end-to-end probe (HID report to\n");
+    printf("               torque write to torque actual) as JSON; drive it with ffb_inject from the host\n");
+    printf("  ifname       EtherCAT network interface (default eth1)\n");
+}
+
 // Main function
 int main(int argc, char *argv[]) {
+    int opt;
+    int dc_sync = 1;
+    const char *capture_filename = NULL;
+    int allow_unisolated = 0;
+
+    startup_time_ns = monotonic_now_ns();
+    rt_arena_init();
+    while ((opt = getopt(argc, argv, "c:nir:R:T:UNFP:B:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (soem_interface_set_cycle_time((uint32_t)strtoul(optarg, NULL, 10)) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                dc_sync = 0;
+                break;
+            case 'i':
+                inline_mode = 1;
+                break;
+            case 'r':
+                if (hid_interface_set_report_rate(atoi(optarg)) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                capture_filename = optarg;
+                break;
+            case 'T':
+                if (rt_threads_configure(optarg) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'U':
+                allow_unisolated = 1;
+                break;
+            case 'N':
+                soem_interface_set_nic_tuning(0);
+                break;
+            case 'F':
+                soem_interface_set_config_cache(0);
+                break;
+            case 'P':
+                if (ffb_profile_add_file(optarg) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                bench_results_path = optarg;
+                break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    soem_interface_set_dc_sync(dc_sync);
+    ffb_e2e_init();
+    
+    // Messages from the real-time threads are formatted and printed by a background thread
+    if (rt_log_start() != 0) {
+        fprintf(stderr, "Warning: deferred logging unavailable, real-time threads print directly\n");
+    }
+
+    ffb_profile_t startup_profile;
+    ffb_profile_get_current(&startup_profile);
     printf("=== Raspberry Pi FFB Steering Wheel Application ===\n");
     printf("Synapticon 16-bit Absolute Encoder Version with FFB Logging\n");
     printf("Encoder: %d counts/revolution (%.4f° precision), ±%.0f° steering range\n", 
-           (int)ENCODER_COUNTS_PER_REV, 360.0f / ENCODER_COUNTS_PER_REV, MAX_STEERING_ANGLE);
-    printf("Controls: Ctrl+C=Exit, Ctrl+R=Recenter wheel, Ctrl+L=Toggle FFB logging\n");
+           (int)ENCODER_COUNTS_PER_REV, 360.0f / ENCODER_COUNTS_PER_REV, startup_profile.steering_range_deg);
+    printf("Tuning profile: %s (gain %.2f, max torque %.0f)\n", startup_profile.name,
+           startup_profile.global_gain, startup_profile.max_torque);
+    printf("Controls: Ctrl+C=Exit, Ctrl+R=Recenter wheel, Ctrl+L=Toggle FFB logging, Ctrl+T=Status and latency, Ctrl+E=Quick stop on/off, Ctrl+F=Reset faults, Ctrl+P=Next profile, +/-=Max torque\n");
     printf("\n");
     
     // Initialize application state
@@ -567,60 +1053,138 @@ int main(int argc, char *argv[]) {
     memset(&app_state, 0, sizeof(app_state));
     reset_performance_stats(&app_state.stats);
     
+    // The EtherCAT cycle must own its core, otherwise every other task adds jitter
+    rt_threads_print();
+    if (rt_threads_check_isolation() != 0 && !allow_unisolated) {
+        fprintf(stderr, "Refusing to start; pass -U to run on a shared core anyway.\n");
+        rt_log_stop();
+        return EXIT_FAILURE;
+    }
+    
     // Setup real-time environment
     setup_real_time_scheduling();
     setup_signal_handlers();
     enable_raw_mode();
     
+    // --- Subsystem Initialization ---
+    printf("\n=== Initializing Subsystems ===\n");
+    
+    // EtherCAT bring-up takes longest and depends on nothing below, so it runs on its own
+    // thread while logging, the FFB calculator and HID start. The HID threads only fill the
+    // effect queue, which the engine drains once the wheel is up.
+    const char *ethercat_ifname = (optind < argc) ? argv[optind] : "eth1";
+    rt_threads_setup_system(ethercat_ifname);
+    printf("Initializing EtherCAT master on interface %s (cycle %u us, DC sync %s)...\n",
+           ethercat_ifname, soem_interface_get_cycle_time(), dc_sync ? "on" : "off");
+    
+    ethercat_boot_t boot = { .ifname = ethercat_ifname, .result = -1 };
+    pthread_t boot_thread;
+    int boot_threaded = pthread_create(&boot_thread, NULL, ethercat_boot_thread, &boot) == 0;
+    if (!boot_threaded) {
+        ethercat_boot_thread(&boot);
+    }
+    
     // Initialize FFB logging
+    uint64_t phase_start_ns = monotonic_now_ns();
     if (init_ffb_logging() != 0) {
         fprintf(stderr, "Warning: FFB logging initialization failed, continuing without logging\n");
         logging_enabled = 0;
     }
     
-    // --- Subsystem Initialization ---
-    printf("\n=== Initializing Subsystems ===\n");
+    // Live state for dashboards (ffb_monitor)
+    if (shm_telemetry_init() != 0) {
+        fprintf(stderr, "Warning: shared memory telemetry unavailable, continuing without it\n");
+    }
     
     // Initialize FFB calculator
     printf("Initializing FFB calculator...\n");
     ffb_calculator_init();
-    
-    // Initialize EtherCAT
-    const char *ethercat_ifname = (argc > 1) ? argv[1] : "eth1";
-    printf("Initializing EtherCAT master on interface %s...\n", ethercat_ifname);
-    
-    if (soem_interface_init_enhanced(ethercat_ifname) != 0) {
-        fprintf(stderr, "Failed to initialize EtherCAT master.\n");
-        cleanup_and_exit(EXIT_FAILURE);
+    // Condition centers/dead bands from the host are normalized to full steering lock
+    ffb_calculator_set_input_range(ENCODER_COUNTS_PER_REV * engine_profile.steering_range_deg / 360.0f, 0.0f);
+    uint64_t logging_ns = monotonic_now_ns() - phase_start_ns;
+    
+    // Record the host's FFB reports before the reception thread starts
+    phase_start_ns = monotonic_now_ns();
+    int hid_result = 0;
+    if (capture_filename && ffb_capture_start(capture_filename) != 0) {
+        hid_result = -1;
     }
     
-    printf("EtherCAT master initialized and stabilized.\n"); 
-    
-    // Wait for SOEM to stabilize before initializing HID
-    printf("Waiting for SOEM to stabilize...\n");
-    sleep(2);
-    
     // Initialize HID interface
-    printf("Initializing HID interface...\n");
-    if (hid_interface_init() != 0) {
-        fprintf(stderr, "Failed to initialize HID interface.\n");
+    if (hid_result == 0) {
+        printf("Initializing HID interface...\n");
+        hid_result = hid_interface_init();
+        if (hid_result != 0) {
+            fprintf(stderr, "Failed to initialize HID interface.\n");
+        }
+    }
+    if (hid_result == 0) {
+        hid_result = hid_interface_start();
+        if (hid_result != 0) {
+            fprintf(stderr, "Failed to start HID interface.\n");
+        }
+    }
+    uint64_t hid_ns = monotonic_now_ns() - phase_start_ns;
+    
+    // Both branches must be done before anything is torn down
+    if (boot_threaded) {
+        pthread_join(boot_thread, NULL);
+    }
+    if (boot.result != 0) {
+        fprintf(stderr, "Failed to initialize EtherCAT master.\n");
         cleanup_and_exit(EXIT_FAILURE);
     }
-
-    if (hid_interface_start() != 0) {
-        fprintf(stderr, "Failed to start HID interface.\n");
+    if (hid_result != 0) {
         cleanup_and_exit(EXIT_FAILURE);
     }
+    printf("EtherCAT master initialized; logging %.1f ms and HID %.1f ms ran alongside, %.1f ms since startup\n",
+           logging_ns / 1e6, hid_ns / 1e6, (monotonic_now_ns() - startup_time_ns) / 1e6);
     
     // --- Main Control Loop ---
     printf("\n=== Starting Main Control Loop ===\n");
     printf("Loop frequency: %d Hz (target cycle time: %.1f ms)\n", 
            MAIN_LOOP_FREQUENCY_HZ, (float)CYCLE_TIME_NS / 1000000.0);
     printf("Steering range: ±%.0f degrees (%.1f full rotations)\n",
-           MAX_STEERING_ANGLE, MAX_STEERING_REVOLUTIONS);
+           startup_profile.steering_range_deg, startup_profile.steering_range_deg / 360.0f);
     printf("High precision: %.4f degrees per encoder step\n", 360.0f / ENCODER_COUNTS_PER_REV);
     printf("FFB Logging: %s\n", logging_enabled ? "Enabled" : "Disabled");
-    printf("Ready! Turn your wheel and enjoy the full 540° range.\n\n");
+    printf("Engine mode: %s\n", inline_mode ? "inline (runs in the EtherCAT cycle)" : "main loop");
+    printf("Ready! Turn your wheel and enjoy the full %.0f° range.\n\n", startup_profile.steering_range_deg);
+    
+    hist_loop_wakeup_late = rt_histogram_create("loop wakeup late", "ns");
+    hist_stage_status = rt_histogram_create("loop status", "ns");
+    hist_stage_engine = rt_histogram_create("loop engine", "ns");
+    hist_stage_log = rt_histogram_create("loop log", "ns");
+    hist_stage_send = rt_histogram_create("loop send", "ns");
+    hist_stage_hid = rt_histogram_create("loop HID report", "ns");
+    hist_loop_work = rt_histogram_create("loop work", "ns");
+
+    init_extra_axes();
+
+    // Gains and the gap limit follow the rate the estimator is fed at: every EtherCAT cycle
+    // inline, every main loop pass otherwise. Transport latency is one EtherCAT cycle either way.
+    float cycle_s = soem_interface_get_cycle_time() * 1e-6f;
+    float sample_period_s = inline_mode ? cycle_s : (float)CYCLE_TIME_NS * 1e-9f;
+    ffb_estimator_init(&wheel_estimator, sample_period_s, engine_profile.estimator_time_constant_s, cycle_s);
+    
+    // Re-read the profile files when they are edited; the engine picks them up between cycles
+    if (ffb_profile_watch_start() != 0) {
+        fprintf(stderr, "Warning: tuning profiles are not reloaded when their files change\n");
+    }
+
+    // Inline mode: hand the engine to the EtherCAT thread; this loop becomes supervisory
+    int inline_effects_seen = 0;
+    if (inline_mode) {
+        memset(&engine_state, 0, sizeof(engine_state));
+        soem_interface_set_cycle_callback(engine_cycle_callback, &engine_state);
+    }
+
+    // HID deadline of the safety supervisor: FFB reports from the host while a non-condition effect plays
+    soem_interface_set_host_activity_source(host_ffb_activity_ns);
+
+    // Everything the loop needs is allocated; from here on the real-time threads must not
+    rt_arena_seal();
+    rt_alloc_track_arm();
     
     while (running) {
         clock_gettime(CLOCK_MONOTONIC, &app_state.loop_start_time);
@@ -628,85 +1192,97 @@ int main(int argc, char *argv[]) {
         // Check for keyboard input (non-blocking)
         check_ctrl_combinations();
         
-        // Skip control if paused
-        if (pause_control) {
+        // Skip control if paused (the inline engine commands zero torque itself)
+        if (pause_control && !inline_mode) {
             usleep(10000); // Sleep 10ms when paused
             continue;
         }
         
         // 1. Update communication status
+        uint64_t stage_start_ns = rt_clock_now_ns();
+        uint64_t loop_start_ns = stage_start_ns;
+        uint64_t stage_end_ns;
         app_state.ethercat_status = soem_interface_get_communication_status();
         app_state.hid_status = hid_interface_get_connection_status();
         
         if (app_state.ethercat_status != app_state.last_ethercat_status) {
-            printf("EtherCAT status changed: %s\n", 
+            RT_LOG(RT_LOG_INFO, "EtherCAT status changed: %s\n", 
                    app_state.ethercat_status ? "OK" : "LOST");
             if (!app_state.ethercat_status) {
                 app_state.stats.communication_errors++;
             }
             app_state.last_ethercat_status = app_state.ethercat_status;
         }
+        report_drive_events(&app_state);
         
-        // 2. Update position system (centralized with correct 16-bit encoder handling)
-        update_position_system(&app_state);
-        
-        // 3. Get velocity from servo
-        app_state.current_velocity = soem_interface_get_current_velocity();
-        
-        // 4. Get FFB commands from PC
-        app_state.effect_available = hid_interface_get_ffb_effect(&app_state.current_ffb_effect);
-        const ffb_motor_effect_t *effect_ptr = app_state.effect_available ? &app_state.current_ffb_effect : NULL;
-        
-        // 5. Calculate desired torque (use relative position in encoder counts)
-        app_state.desired_torque = ffb_calculator_calculate_torque(
-            effect_ptr, app_state.current_position_relative, app_state.current_velocity);
-        
-        // 6. Apply safety checks
-        apply_safety_checks(&app_state);
+        // 2-6. Engine: position, velocity, FFB effects, torque calculation and safety
+        const ffb_motor_effect_t *effect_ptr = NULL;
+        ffb_torque_t torque_command = 0;
+        if (inline_mode) {
+            // The engine already ran in the EtherCAT cycle; pick up its latest output
+            read_engine_status(&app_state, &inline_effects_seen);
+            stage_end_ns = rt_clock_now_ns();
+            rt_histogram_record(hist_stage_status, stage_end_ns - stage_start_ns);
+        } else {
+            stage_end_ns = rt_clock_now_ns();
+            rt_histogram_record(hist_stage_status, stage_end_ns - stage_start_ns);
+            stage_start_ns = stage_end_ns;
+            soem_pdo_snapshot_t sample;
+            soem_interface_get_pdo_snapshot(&sample);
+            torque_command = run_ffb_engine(&app_state, &sample);
+            effect_ptr = app_state.effect_available ? &app_state.current_ffb_effect : NULL;
+            stage_end_ns = rt_clock_now_ns();
+            rt_histogram_record(hist_stage_engine, stage_end_ns - stage_start_ns);
+        }
+        stage_start_ns = stage_end_ns;
         
         // 7. Log FFB data before sending to motor
         log_ffb_data(effect_ptr, app_state.current_angle_degrees, app_state.current_velocity, 
-                     app_state.desired_torque, app_state.effect_available);
+                     app_state.desired_torque, app_state.effect_available, app_state.active_mask,
+                     app_state.ethercat_status, app_state.hid_status);
+        stage_end_ns = rt_clock_now_ns();
+        rt_histogram_record(hist_stage_log, stage_end_ns - stage_start_ns);
+        stage_start_ns = stage_end_ns;
         
-        // 8. Send torque command to servo (only if EtherCAT is connected)
-        if (app_state.ethercat_status && !emergency_stop) {
-            soem_interface_send_and_receive_pdo(app_state.desired_torque);
-        } else {
-            // Send zero torque if communication is lost or emergency stop is active
-            soem_interface_send_and_receive_pdo(0.0f);
+        // 8. Send torque command to servo (zero if EtherCAT is lost or emergency stop is active)
+        if (!inline_mode) {
+            soem_interface_send_and_receive_pdo(torque_command);
+            stage_end_ns = rt_clock_now_ns();
+            rt_histogram_record(hist_stage_send, stage_end_ns - stage_start_ns);
+            stage_start_ns = stage_end_ns;
         }
         
         // 9. Read button states
         app_state.button_states = read_button_states();
+        atomic_store_explicit(&gamepad_buttons, app_state.button_states, memory_order_relaxed);
         
-        // 10. Send gamepad report to PC (use normalized position)
-        if (app_state.hid_status) {
-            hid_interface_send_gamepad_report(app_state.normalized_position, app_state.button_states);
+        // 10. Send gamepad report to PC (use normalized position); inline, the engine does it
+        // every EtherCAT cycle
+        if (app_state.hid_status && !inline_mode) {
+            publish_gamepad_report(app_state.normalized_position);
         }
+        stage_end_ns = rt_clock_now_ns();
+        rt_histogram_record(hist_stage_hid, stage_end_ns - stage_start_ns);
+        rt_histogram_record(hist_loop_work, stage_end_ns - loop_start_ns);
         
         // 11. Update performance statistics
         clock_gettime(CLOCK_MONOTONIC, &app_state.loop_end_time);
         update_performance_stats(&app_state);
         
-        // 12. Print periodic statistics
-        if (app_state.stats.loop_count % STATS_PRINT_INTERVAL == 0) {
-            printf("Status: Deg=%.1f° (%.3f rev), Norm=%.4f, Vel=%.1f°/s, Torque=%.1f, EtherCAT=%s, HID=%s, Emergency=%s, Log=%d\n",
-                   app_state.current_angle_degrees, app_state.current_angle_degrees / 360.0f,
-                   app_state.normalized_position, app_state.current_velocity, app_state.desired_torque,
-                   app_state.ethercat_status ? "OK" : "LOST",
-                   app_state.hid_status ? "OK" : "LOST",
-                   emergency_stop ? "STOP" : "OK",
-                   log_counter);
+        publish_live_state(&app_state);
+        
+        // 12. Print status and latency histograms on request (Ctrl+T)
+        if (status_requested) {
+            status_requested = 0;
+            print_status(&app_state);
         }
         
         // 13. Maintain loop timing
         maintain_loop_timing(&app_state.loop_start_time, &app_state.loop_end_time);
-        
-        // Clear emergency stop if torque is back to normal
-        if (emergency_stop && fabs(app_state.desired_torque) < MAX_TORQUE_LIMIT * 0.5f) {
-            emergency_stop = 0;
-            printf("Emergency stop cleared\n");
-        }
+    }
+    
+    if (inline_mode) {
+        soem_interface_set_cycle_callback(NULL, NULL);
     }
     
     // --- Final Statistics and Cleanup ---
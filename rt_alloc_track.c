@@ -0,0 +1,127 @@
+// rt_alloc_track.c - malloc() and relatives that count allocations by real-time threads
+#include "rt_alloc_track.h"
+#include "rt_threads.h"
+#include "rt_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sched.h>
+
+// The C library's implementations, exported by glibc under these names
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+// Start of the executable's mapping (linker-defined), so offsets survive PIE relocation
+extern char __executable_start;
+
+static atomic_int armed = 0;
+static atomic_ulong allocation_count = 0;
+static const char *caller_function[RT_ALLOC_TRACK_MAX_CALLERS];
+static uintptr_t caller_offset[RT_ALLOC_TRACK_MAX_CALLERS];
+static atomic_int caller_count = 0;
+
+// Must not allocate: runs inside malloc(). TLS, atomics and RT_LOG() only.
+static void track(const char *function, size_t size, void *caller) {
+    if (!atomic_load_explicit(&armed, memory_order_relaxed)) return;
+    int role = rt_threads_current_role();
+    if (role < 0) return;
+    const rt_thread_config_t *config = rt_threads_get_config((rt_thread_role_t)role);
+    if (config->policy == SCHED_OTHER) return;
+
+    uintptr_t offset = (uintptr_t)caller - (uintptr_t)&__executable_start;
+    atomic_fetch_add(&allocation_count, 1);
+    int index = atomic_fetch_add(&caller_count, 1);
+    if (index < RT_ALLOC_TRACK_MAX_CALLERS) {
+        caller_function[index] = function;
+        caller_offset[index] = offset;
+    }
+    RT_LOG(RT_LOG_ERROR, "RT_Alloc: ERROR: %s(%zu) in the %s thread during the control loop, called from +0x%lx\n",
+           function, size, config->name, (unsigned long)offset);
+#ifdef RT_ALLOC_TRACK_ABORT
+    abort();
+#endif
+}
+
+void *malloc(size_t size) {
+    track("malloc", size, __builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    track("calloc", count * size, __builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    track("realloc", size, __builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    track("memalign", size, __builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    track("aligned_alloc", size, __builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    track("posix_memalign", size, __builtin_return_address(0));
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return EINVAL;
+    void *memory = __libc_memalign(alignment, size);
+    if (!memory) return ENOMEM;
+    *memptr = memory;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    track("valloc", size, __builtin_return_address(0));
+    return __libc_memalign((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    track("pvalloc", size, __builtin_return_address(0));
+    return __libc_memalign(page_size, (size + page_size - 1) & ~(page_size - 1));
+}
+
+/**
+ * @brief Starts counting allocations by real-time threads.
+ */
+void rt_alloc_track_arm(void) {
+    atomic_store(&armed, 1);
+    printf("RT_Alloc: tracking heap allocations by real-time threads\n");
+}
+
+/**
+ * @brief Returns the number of allocations by real-time threads since rt_alloc_track_arm().
+ */
+unsigned long rt_alloc_track_count(void) {
+    return atomic_load(&allocation_count);
+}
+
+/**
+ * @brief Prints the count and the first call sites.
+ */
+void rt_alloc_track_report(void) {
+    unsigned long count = atomic_load(&allocation_count);
+    if (!atomic_load(&armed)) return;
+    if (count == 0) {
+        printf("RT_Alloc: no heap allocations by real-time threads during the control loop\n");
+        return;
+    }
+    printf("RT_Alloc: ERROR: %lu heap allocations by real-time threads during the control loop\n", count);
+    int callers = atomic_load(&caller_count);
+    if (callers > RT_ALLOC_TRACK_MAX_CALLERS) callers = RT_ALLOC_TRACK_MAX_CALLERS;
+    for (int i = 0; i < callers; i++) {
+        printf("RT_Alloc:   %-14s from +0x%lx\n", caller_function[i], (unsigned long)caller_offset[i]);
+    }
+}
@@ -0,0 +1,30 @@
+// rt_alloc_track.h - Counts heap allocations made by real-time threads once the control loop runs
+//
+// Linked into the application only: rt_alloc_track.c defines malloc() and its relatives, which
+// take precedence over the C library's and forward to it. Allocations count once
+// rt_alloc_track_arm() was called and only from threads whose role (rt_threads_current_role())
+// has a real-time policy; the background threads format, open files and may allocate. Each one
+// is reported through RT_LOG() with the caller's offset in the executable, for
+//   addr2line -f -e ffb_app <offset>
+// Build with -DRT_ALLOC_TRACK_ABORT to abort() at the allocation instead (for a core dump).
+#ifndef RT_ALLOC_TRACK_H
+#define RT_ALLOC_TRACK_H
+
+#define RT_ALLOC_TRACK_MAX_CALLERS 8    // Call sites kept for rt_alloc_track_report()
+
+/**
+ * @brief Starts counting. Call right before the control loop, after all setup allocations.
+ */
+void rt_alloc_track_arm(void);
+
+/**
+ * @brief Returns the number of allocations by real-time threads since rt_alloc_track_arm().
+ */
+unsigned long rt_alloc_track_count(void);
+
+/**
+ * @brief Prints the count and the first call sites; says so when there were none.
+ */
+void rt_alloc_track_report(void);
+
+#endif // RT_ALLOC_TRACK_H
@@ -0,0 +1,113 @@
+// rt_arena.c - One prefaulted, locked region for the state the real-time threads touch
+#include "rt_arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef struct {
+    const char *what;
+    size_t size;
+} rt_arena_entry_t;
+
+static uint8_t arena[RT_ARENA_CAPACITY] __attribute__((aligned(4096)));
+static size_t arena_used = 0;
+static int arena_locked = 0;
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static rt_arena_entry_t entries[RT_ARENA_MAX_ENTRIES];
+static int entry_count = 0;
+static size_t unlisted_bytes = 0;   // Allocations beyond RT_ARENA_MAX_ENTRIES
+
+static atomic_int sealed = 0;
+static atomic_uint late_count = 0;
+
+/**
+ * @brief Prefaults and locks the arena.
+ */
+int rt_arena_init(void) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) page_size = 4096;
+
+    // A write per page: reads alone would all map the shared zero page
+    for (size_t offset = 0; offset < sizeof(arena); offset += (size_t)page_size) {
+        ((volatile uint8_t *)arena)[offset] = 0;
+    }
+    if (mlock(arena, sizeof(arena)) != 0) {
+        fprintf(stderr, "RT_Arena: mlock of %zu KiB failed: %s (pages are prefaulted but may be swapped)\n",
+                sizeof(arena) / 1024, strerror(errno));
+        return -1;
+    }
+    arena_locked = 1;
+    return 0;
+}
+
+/**
+ * @brief Carves zeroed memory out of the arena; aborts when it is full.
+ */
+void *rt_arena_alloc(size_t size, const char *what) {
+    size_t rounded = (size + RT_ARENA_ALIGNMENT - 1) & ~(size_t)(RT_ARENA_ALIGNMENT - 1);
+
+    if (atomic_load(&sealed)) {
+        atomic_fetch_add(&late_count, 1);
+        fprintf(stderr, "RT_Arena: ERROR: '%s' (%zu bytes) allocated after the control loop started\n", what, size);
+    }
+
+    pthread_mutex_lock(&arena_lock);
+    if (rounded > sizeof(arena) - arena_used) {
+        pthread_mutex_unlock(&arena_lock);
+        fprintf(stderr, "RT_Arena: out of space for '%s' (%zu bytes); raise RT_ARENA_CAPACITY\n", what, size);
+        rt_arena_print();
+        abort();
+    }
+    void *memory = &arena[arena_used];
+    arena_used += rounded;
+    if (entry_count < RT_ARENA_MAX_ENTRIES) {
+        entries[entry_count].what = what;
+        entries[entry_count].size = rounded;
+        entry_count++;
+    } else {
+        unlisted_bytes += rounded;
+    }
+    pthread_mutex_unlock(&arena_lock);
+    return memory; // Static storage: zero until handed out, and never handed out twice
+}
+
+/**
+ * @brief Marks the start of the control loop and prints the arena usage.
+ */
+void rt_arena_seal(void) {
+    atomic_store(&sealed, 1);
+    pthread_mutex_lock(&arena_lock);
+    printf("RT_Arena: %zu of %zu KiB used by %d allocations, %s\n", arena_used / 1024, sizeof(arena) / 1024,
+           entry_count, arena_locked ? "prefaulted and locked" : "NOT locked");
+    pthread_mutex_unlock(&arena_lock);
+}
+
+/**
+ * @brief Returns the number of allocations made after rt_arena_seal().
+ */
+unsigned int rt_arena_late_count(void) {
+    return atomic_load(&late_count);
+}
+
+/**
+ * @brief Prints the used and total size and every allocation.
+ */
+void rt_arena_print(void) {
+    pthread_mutex_lock(&arena_lock);
+    printf("RT_Arena: %zu of %zu bytes used\n", arena_used, sizeof(arena));
+    for (int i = 0; i < entry_count; i++) {
+        printf("RT_Arena:   %-28s %8zu bytes\n", entries[i].what, entries[i].size);
+    }
+    if (unlisted_bytes) {
+        printf("RT_Arena:   (not listed)                 %8zu bytes\n", unlisted_bytes);
+    }
+    pthread_mutex_unlock(&arena_lock);
+}
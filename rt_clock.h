@@ -0,0 +1,30 @@
+// rt_clock.h - Cheap timestamps for stage timing in the real-time loops
+#ifndef RT_CLOCK_H
+#define RT_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Durations only: the epoch is arbitrary, so never compare these with CLOCK_MONOTONIC.
+// On AArch64 this reads the generic timer (cntvct_el0) directly, which is what the vDSO
+// does underneath, minus the call and the seqcount retry. Elsewhere it uses
+// CLOCK_MONOTONIC_RAW, which NTP slewing does not stretch.
+static inline uint64_t rt_clock_now_ns(void) {
+#if defined(__aarch64__)
+    static double ns_per_tick = 0.0;
+    uint64_t ticks;
+    if (ns_per_tick == 0.0) {
+        uint64_t frequency;
+        __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+        ns_per_tick = 1e9 / (double)frequency;
+    }
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(ticks) :: "memory");
+    return (uint64_t)((double)ticks * ns_per_tick);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#endif // RT_CLOCK_H
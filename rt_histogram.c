@@ -0,0 +1,182 @@
+// rt_histogram.c - Histogram registry, snapshots and percentile summaries
+#include "rt_histogram.h"
+#include "rt_arena.h"
+#include <stdio.h>
+#include <string.h>
+
+static rt_histogram_t *registry[RT_HISTOGRAM_MAX_REGISTERED];
+static _Atomic int registry_count = 0;
+
+// Largest value that falls into a bucket
+static uint64_t bucket_upper_bound(uint32_t index) {
+    if (index < RT_HISTOGRAM_SUB_COUNT) return index;
+    if (index == RT_HISTOGRAM_BUCKETS - 1) return UINT64_MAX;
+    uint32_t exponent = index / RT_HISTOGRAM_SUB_COUNT - 1;
+    uint64_t mantissa = index - exponent * RT_HISTOGRAM_SUB_COUNT;
+    return ((mantissa + 1) << exponent) - 1;
+}
+
+/**
+ * @brief Clears a histogram and adds it to the registry read by rt_histogram_get_summaries().
+ */
+int rt_histogram_register(rt_histogram_t *histogram, const char *name, const char *unit) {
+    for (uint32_t i = 0; i < RT_HISTOGRAM_BUCKETS; i++) {
+        atomic_store_explicit(&histogram->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&histogram->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&histogram->sum, 0, memory_order_relaxed);
+    atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+    histogram->name = name;
+    histogram->unit = unit;
+
+    int count = atomic_load(&registry_count);
+    for (int i = 0; i < count; i++) {
+        if (registry[i] == histogram) return 0; // Re-registered after a restart
+    }
+    if (count == RT_HISTOGRAM_MAX_REGISTERED) {
+        fprintf(stderr, "RT_Histogram: registry full, '%s' is not reported\n", name);
+        return -1;
+    }
+    registry[count] = histogram;
+    atomic_store_explicit(&registry_count, count + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * @brief Allocates a histogram in the arena and registers it.
+ */
+rt_histogram_t *rt_histogram_create(const char *name, const char *unit) {
+    int count = atomic_load(&registry_count);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(registry[i]->name, name) == 0) {
+            rt_histogram_register(registry[i], name, unit); // Created again after a restart
+            return registry[i];
+        }
+    }
+    rt_histogram_t *histogram = rt_arena_alloc(sizeof(*histogram), name);
+    rt_histogram_register(histogram, name, unit);
+    return histogram;
+}
+
+/**
+ * @brief Copies the counters of a histogram.
+ */
+void rt_histogram_snapshot(const rt_histogram_t *histogram, rt_histogram_snapshot_t *snapshot_out) {
+    rt_histogram_t *h = (rt_histogram_t *)histogram;
+    for (uint32_t i = 0; i < RT_HISTOGRAM_BUCKETS; i++) {
+        snapshot_out->buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    snapshot_out->count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    snapshot_out->sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    snapshot_out->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+/**
+ * @brief Subtracts an earlier snapshot to get the samples recorded in between.
+ */
+void rt_histogram_snapshot_delta(const rt_histogram_snapshot_t *later, const rt_histogram_snapshot_t *earlier,
+                                 rt_histogram_snapshot_t *delta_out) {
+    for (uint32_t i = 0; i < RT_HISTOGRAM_BUCKETS; i++) {
+        delta_out->buckets[i] = later->buckets[i] - earlier->buckets[i];
+    }
+    delta_out->count = later->count - earlier->count;
+    delta_out->sum = later->sum - earlier->sum;
+    delta_out->max = later->max;
+}
+
+/**
+ * @brief Computes count, mean, p50/p99/p99.9 and max of a snapshot.
+ */
+void rt_histogram_summarize(const rt_histogram_snapshot_t *snapshot, rt_histogram_summary_t *summary_out) {
+    // Count from the buckets: it may differ from snapshot->count by a sample in flight
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < RT_HISTOGRAM_BUCKETS; i++) total += snapshot->buckets[i];
+
+    summary_out->count = snapshot->count;
+    summary_out->mean = snapshot->count ? (double)snapshot->sum / (double)snapshot->count : 0.0;
+    summary_out->max = snapshot->max;
+    summary_out->p50 = summary_out->p99 = summary_out->p999 = 0;
+    if (total == 0) return;
+
+    // Ranks are rounded up so a single slow sample shows in p99.9 of 1000 samples
+    const uint64_t rank50 = (total * 500 + 999) / 1000;
+    const uint64_t rank99 = (total * 990 + 999) / 1000;
+    const uint64_t rank999 = (total * 999 + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < RT_HISTOGRAM_BUCKETS; i++) {
+        if (!snapshot->buckets[i]) continue;
+        uint64_t before = seen;
+        seen += snapshot->buckets[i];
+        uint64_t bound = bucket_upper_bound(i);
+        if (bound > snapshot->max) bound = snapshot->max; // Never report above the true max
+        if (before < rank50 && seen >= rank50) summary_out->p50 = bound;
+        if (before < rank99 && seen >= rank99) summary_out->p99 = bound;
+        if (before < rank999 && seen >= rank999) summary_out->p999 = bound;
+    }
+}
+
+/**
+ * @brief Snapshots and summarizes every registered histogram.
+ */
+int rt_histogram_get_summaries(rt_histogram_summary_t *summaries_out, int max_count) {
+    static rt_histogram_snapshot_t snapshot; // ~2 KiB, keep it off the caller's stack
+    int count = atomic_load_explicit(&registry_count, memory_order_acquire);
+    if (count > max_count) count = max_count;
+
+    for (int i = 0; i < count; i++) {
+        rt_histogram_snapshot(registry[i], &snapshot);
+        rt_histogram_summarize(&snapshot, &summaries_out[i]);
+        summaries_out[i].name = registry[i]->name;
+        summaries_out[i].unit = registry[i]->unit;
+    }
+    return count;
+}
+
+/**
+ * @brief Prints a table of all registered histograms (durations in microseconds).
+ */
+void rt_histogram_print_all(void) {
+    rt_histogram_summary_t summaries[RT_HISTOGRAM_MAX_REGISTERED];
+    int count = rt_histogram_get_summaries(summaries, RT_HISTOGRAM_MAX_REGISTERED);
+
+    printf("%-28s %10s %9s %9s %9s %9s %9s\n", "Timing", "count", "mean", "p50", "p99", "p99.9", "max");
+    for (int i = 0; i < count; i++) {
+        const rt_histogram_summary_t *s = &summaries[i];
+        if (strcmp(s->unit, "ns") == 0) {
+            printf("%-28s %10llu %7.1fus %7.1fus %7.1fus %7.1fus %7.1fus\n", s->name,
+                   (unsigned long long)s->count, s->mean / 1000.0, s->p50 / 1000.0,
+                   s->p99 / 1000.0, s->p999 / 1000.0, s->max / 1000.0);
+        } else {
+            printf("%-28s %10llu %9.1f %9llu %9llu %9llu %9llu %s\n", s->name,
+                   (unsigned long long)s->count, s->mean, (unsigned long long)s->p50,
+                   (unsigned long long)s->p99, (unsigned long long)s->p999,
+                   (unsigned long long)s->max, s->unit);
+        }
+    }
+}
+
+/**
+ * @brief Writes one summary as a JSON object.
+ */
+void rt_histogram_write_json_summary(FILE *file, const rt_histogram_summary_t *summary) {
+    fprintf(file, "{\"name\": \"%s\", \"unit\": \"%s\", \"count\": %llu, \"mean\": %.1f, "
+                  "\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+            summary->name, summary->unit, (unsigned long long)summary->count, summary->mean,
+            (unsigned long long)summary->p50, (unsigned long long)summary->p99,
+            (unsigned long long)summary->p999, (unsigned long long)summary->max);
+}
+
+/**
+ * @brief Writes the summaries of all registered histograms as a JSON array.
+ */
+void rt_histogram_write_json(FILE *file) {
+    rt_histogram_summary_t summaries[RT_HISTOGRAM_MAX_REGISTERED];
+    int count = rt_histogram_get_summaries(summaries, RT_HISTOGRAM_MAX_REGISTERED);
+
+    fprintf(file, "[");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s\n    ", i ? "," : "");
+        rt_histogram_write_json_summary(file, &summaries[i]);
+    }
+    fprintf(file, "\n  ]");
+}
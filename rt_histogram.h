@@ -0,0 +1,132 @@
+// rt_histogram.h - Fixed-bucket log-linear histograms for latency and jitter measurements
+#ifndef RT_HISTOGRAM_H
+#define RT_HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Values below 2^RT_HISTOGRAM_SUB_BITS get one bucket each; above that every power of two
+// is split into 2^RT_HISTOGRAM_SUB_BITS linear buckets (at most 6.25% wide). Values up to
+// 2^32 - 1 (4.3 s in ns) are resolved, larger ones land in the last bucket.
+#define RT_HISTOGRAM_SUB_BITS 4
+#define RT_HISTOGRAM_SUB_COUNT (1u << RT_HISTOGRAM_SUB_BITS)
+#define RT_HISTOGRAM_BUCKETS ((32u - RT_HISTOGRAM_SUB_BITS) * RT_HISTOGRAM_SUB_COUNT + RT_HISTOGRAM_SUB_COUNT)
+#define RT_HISTOGRAM_MAX_REGISTERED 32
+
+// Only ONE thread may record into a given histogram; any thread may take snapshots.
+// Recording never blocks: counters use relaxed atomics, so a snapshot taken during an
+// update can be off by the sample in flight.
+typedef struct {
+    const char *name;
+    const char *unit;           // "ns" or a count unit such as "cycles"
+    _Atomic uint32_t buckets[RT_HISTOGRAM_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} rt_histogram_t;
+
+typedef struct {
+    uint32_t buckets[RT_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} rt_histogram_snapshot_t;
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    uint64_t count;
+    double mean;
+    uint64_t p50;               // Percentiles are bucket upper bounds
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;               // Exact
+} rt_histogram_summary_t;
+
+static inline uint32_t rt_histogram_bucket(uint64_t value) {
+    if (value >= (1ULL << 32)) return RT_HISTOGRAM_BUCKETS - 1;
+    if (value < RT_HISTOGRAM_SUB_COUNT) return (uint32_t)value;
+    uint32_t exponent = (31u - (uint32_t)__builtin_clz((uint32_t)value)) - RT_HISTOGRAM_SUB_BITS;
+    return exponent * RT_HISTOGRAM_SUB_COUNT + (uint32_t)(value >> exponent);
+}
+
+// A load and a store rather than a read-modify-write: there is a single writer
+static inline void rt_histogram_add(_Atomic uint64_t *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Records one value (writer thread only). Constant time, no locks, no syscalls.
+ */
+static inline void rt_histogram_record(rt_histogram_t *histogram, uint64_t value) {
+    _Atomic uint32_t *bucket = &histogram->buckets[rt_histogram_bucket(value)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    rt_histogram_add(&histogram->count, 1);
+    rt_histogram_add(&histogram->sum, value);
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Clears a histogram and adds it to the registry read by rt_histogram_get_summaries().
+ *        Call before the writer starts; not real-time safe.
+ * @param name Static string naming the measurement.
+ * @param unit Static string, "ns" for durations.
+ * @return 0 on success, -1 if the registry is full (the histogram still records).
+ */
+int rt_histogram_register(rt_histogram_t *histogram, const char *name, const char *unit);
+
+/**
+ * @brief Allocates a cleared histogram in the arena (rt_arena.h) and registers it. Creating
+ *        a name again, e.g. when a subsystem restarts, clears and returns the existing one.
+ *        Call before the writer starts; not real-time safe.
+ * @param name Static string naming the measurement.
+ * @param unit Static string, "ns" for durations.
+ * @return The histogram, never NULL.
+ */
+rt_histogram_t *rt_histogram_create(const char *name, const char *unit);
+
+/**
+ * @brief Copies the counters of a histogram.
+ */
+void rt_histogram_snapshot(const rt_histogram_t *histogram, rt_histogram_snapshot_t *snapshot_out);
+
+/**
+ * @brief Subtracts an earlier snapshot to get the samples recorded in between.
+ *        The max of the interval is not known, so the later snapshot's max is kept.
+ */
+void rt_histogram_snapshot_delta(const rt_histogram_snapshot_t *later, const rt_histogram_snapshot_t *earlier,
+                                 rt_histogram_snapshot_t *delta_out);
+
+/**
+ * @brief Computes count, mean, p50/p99/p99.9 and max of a snapshot.
+ */
+void rt_histogram_summarize(const rt_histogram_snapshot_t *snapshot, rt_histogram_summary_t *summary_out);
+
+/**
+ * @brief Snapshots and summarizes every registered histogram.
+ * @param summaries_out Array of at least max_count entries.
+ * @return The number of entries filled in.
+ */
+int rt_histogram_get_summaries(rt_histogram_summary_t *summaries_out, int max_count);
+
+/**
+ * @brief Prints a table of all registered histograms (durations in microseconds).
+ */
+void rt_histogram_print_all(void);
+
+/**
+ * @brief Writes one summary as a JSON object: name, unit, count, mean, p50, p99, p999, max.
+ */
+void rt_histogram_write_json_summary(FILE *file, const rt_histogram_summary_t *summary);
+
+/**
+ * @brief Writes the summaries of all registered histograms as a JSON array, in the units
+ *        they were recorded in (ns for durations), indented as the value of a top-level key.
+ */
+void rt_histogram_write_json(FILE *file);
+
+#endif // RT_HISTOGRAM_H
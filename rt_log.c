@@ -0,0 +1,331 @@
+// rt_log.c - Lock-free message ring drained by a low-priority formatting thread
+#include "rt_log.h"
+#include "rt_threads.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if (RT_LOG_RING_SIZE & (RT_LOG_RING_SIZE - 1)) != 0
+#error "RT_LOG_RING_SIZE must be a power of two"
+#endif
+
+#define RT_LOG_DRAIN_PERIOD_MS 10
+
+// Bounded MPMC queue (Vyukov): a slot is free for position p when sequence == p and holds
+// the message for position p when sequence == p + 1. Producers claim positions with a CAS
+// on ring_tail; there is one consumer.
+typedef struct {
+    atomic_uint sequence;
+    uint8_t level;
+    uint8_t rate_limited;
+    uint8_t nargs;
+    rt_log_arg_t args[RT_LOG_MAX_ARGS];
+} rt_log_slot_t;
+
+static rt_log_slot_t ring[RT_LOG_RING_SIZE];
+static atomic_uint ring_tail = 0;
+static unsigned int ring_head = 0;            // Consumer only
+static atomic_int ring_ready = 0;             // Slot sequences initialized
+static atomic_int log_running = 0;
+static atomic_uint dropped_count = 0;
+static atomic_uint suppressed_count = 0;
+static pthread_t log_thread;
+
+// Rate limiting per call site (consumer only)
+typedef struct {
+    const char *format;
+    uint64_t last_print_ms;
+    uint32_t suppressed;          // Messages since last_print_ms that were not printed
+    rt_log_level_t level;
+    char last_line[RT_LOG_LINE_MAX];
+} rt_log_site_t;
+
+static rt_log_site_t sites[RT_LOG_MAX_SITES];
+static int site_count = 0;
+
+static uint64_t get_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static void append(char *out, size_t size, size_t *used, const char *text, size_t length) {
+    if (*used + 1 >= size) return;
+    if (length > size - 1 - *used) length = size - 1 - *used;
+    memcpy(out + *used, text, length);
+    *used += length;
+    out[*used] = '\0';
+}
+
+// Formats one conversion spec with the argument converted to the type the length modifier asks for
+static int format_conversion(char *out, size_t size, const char *spec, size_t spec_length, const rt_log_arg_t *arg) {
+    char conversion = spec[spec_length - 1];
+    char flags[32];
+    size_t flag_length = 0;
+    char length[3] = "";
+    size_t length_chars = 0;
+
+    // Flags, width and precision are kept; the length modifier is replaced
+    for (size_t i = 0; i < spec_length - 1 && flag_length < sizeof(flags) - 4; i++) {
+        if (strchr("hljztLq", spec[i])) {
+            if (length_chars < 2) length[length_chars++] = spec[i];
+            continue;
+        }
+        flags[flag_length++] = spec[i];
+    }
+    flags[flag_length] = '\0';
+    int bits = !strcmp(length, "hh") ? 8 : !strcmp(length, "h") ? 16 : !length[0] ? 32 :
+               !strcmp(length, "l") ? (int)(sizeof(long) * 8) : 64;
+
+    long long i = (arg->type == RT_LOG_ARG_DOUBLE) ? (long long)arg->value.d : arg->value.i;
+    double d = (arg->type == RT_LOG_ARG_DOUBLE) ? arg->value.d : (double)arg->value.i;
+
+    switch (conversion) {
+        case 'd': case 'i': {
+            long long value = bits == 8 ? (signed char)i : bits == 16 ? (short)i : bits == 32 ? (int)i : i;
+            memcpy(flags + flag_length, "lld", 4);
+            return snprintf(out, size, flags, value);
+        }
+        case 'u': case 'x': case 'X': case 'o': {
+            unsigned long long value = bits == 8 ? (unsigned char)i : bits == 16 ? (unsigned short)i :
+                                       bits == 32 ? (unsigned int)i : (unsigned long long)i;
+            flags[flag_length++] = 'l';
+            flags[flag_length++] = 'l';
+            flags[flag_length++] = conversion;
+            flags[flag_length] = '\0';
+            return snprintf(out, size, flags, value);
+        }
+        case 'c':
+            flags[flag_length++] = 'c';
+            flags[flag_length] = '\0';
+            return snprintf(out, size, flags, (int)i);
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            flags[flag_length++] = conversion;
+            flags[flag_length] = '\0';
+            return snprintf(out, size, flags, d);
+        case 's':
+            flags[flag_length++] = 's';
+            flags[flag_length] = '\0';
+            return snprintf(out, size, flags,
+                            (arg->type == RT_LOG_ARG_STRING && arg->value.s) ? arg->value.s : "(null)");
+        case 'p':
+            flags[flag_length++] = 'p';
+            flags[flag_length] = '\0';
+            return snprintf(out, size, flags, arg->value.p);
+        default:
+            return -1;
+    }
+}
+
+// printf() for a queued message; args[0] is the format
+static void format_message(char *out, size_t size, int nargs, const rt_log_arg_t *args) {
+    const char *format = args[0].value.s;
+    size_t used = 0;
+    int next_arg = 1;
+    char piece[RT_LOG_LINE_MAX];
+
+    out[0] = '\0';
+    while (*format) {
+        const char *percent = strchr(format, '%');
+        if (!percent) {
+            append(out, size, &used, format, strlen(format));
+            break;
+        }
+        append(out, size, &used, format, (size_t)(percent - format));
+        if (percent[1] == '%') {
+            append(out, size, &used, "%", 1);
+            format = percent + 2;
+            continue;
+        }
+        // Spec runs up to the first conversion character
+        const char *end = percent + 1;
+        while (*end && !strchr("diouxXcfFeEgGaAsp", *end) && end - percent < 16) end++;
+        if (!*end || !strchr("diouxXcfFeEgGaAsp", *end) || next_arg >= nargs) {
+            append(out, size, &used, percent, (size_t)(end - percent) + (*end ? 1 : 0));
+            format = *end ? end + 1 : end;
+            continue;
+        }
+        int length = format_conversion(piece, sizeof(piece), percent, (size_t)(end - percent) + 1, &args[next_arg++]);
+        if (length > 0) append(out, size, &used, piece, strlen(piece));
+        format = end + 1;
+    }
+}
+
+static void print_line(rt_log_level_t level, const char *line) {
+    FILE *stream = (level == RT_LOG_ERROR) ? stderr : stdout;
+    fputs(line, stream);
+}
+
+// Prints "<last message> [xN in last 1.0s]" for a site whose window has ended
+static void flush_site(rt_log_site_t *site, uint64_t now_ms) {
+    char line[RT_LOG_LINE_MAX + 64];
+    size_t length = strlen(site->last_line);
+    while (length > 0 && site->last_line[length - 1] == '\n') length--;
+    snprintf(line, sizeof(line), "%.*s [x%u in last %.1fs]\n", (int)length, site->last_line,
+             site->suppressed, (double)(now_ms - site->last_print_ms) / 1000.0);
+    print_line(site->level, line);
+    site->suppressed = 0;
+    site->last_print_ms = now_ms;
+}
+
+static rt_log_site_t *find_site(const char *format) {
+    for (int i = 0; i < site_count; i++) {
+        if (sites[i].format == format) return &sites[i];
+    }
+    if (site_count == RT_LOG_MAX_SITES) return NULL; // Not rate limited
+    rt_log_site_t *site = &sites[site_count++];
+    memset(site, 0, sizeof(*site));
+    site->format = format;
+    return site;
+}
+
+static void handle_message(const rt_log_slot_t *slot, uint64_t now_ms) {
+    char line[RT_LOG_LINE_MAX];
+    format_message(line, sizeof(line), slot->nargs, slot->args);
+    if (!slot->rate_limited) {
+        print_line((rt_log_level_t)slot->level, line);
+        return;
+    }
+
+    rt_log_site_t *site = find_site(slot->args[0].value.s);
+    if (site && site->last_print_ms && now_ms - site->last_print_ms < RT_LOG_RATE_WINDOW_MS) {
+        site->suppressed++;
+        site->level = (rt_log_level_t)slot->level;
+        memcpy(site->last_line, line, sizeof(line));
+        atomic_fetch_add_explicit(&suppressed_count, 1, memory_order_relaxed);
+        return;
+    }
+    print_line((rt_log_level_t)slot->level, line);
+    if (site) site->last_print_ms = now_ms;
+}
+
+static void drain(int final) {
+    static uint32_t reported_drops = 0;
+    uint64_t now_ms = get_monotonic_ms();
+
+    for (;;) {
+        rt_log_slot_t *slot = &ring[ring_head & (RT_LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != ring_head + 1) {
+            break; // Empty, or the producer of this slot has not finished writing it
+        }
+        handle_message(slot, now_ms);
+        atomic_store_explicit(&slot->sequence, ring_head + RT_LOG_RING_SIZE, memory_order_release);
+        ring_head++;
+    }
+
+    for (int i = 0; i < site_count; i++) {
+        if (sites[i].suppressed && (final || now_ms - sites[i].last_print_ms >= RT_LOG_RATE_WINDOW_MS)) {
+            flush_site(&sites[i], now_ms);
+        }
+    }
+
+    uint32_t drops = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    if (drops != reported_drops) {
+        fprintf(stderr, "RT_Log: %u messages dropped (ring full)\n", drops - reported_drops);
+        reported_drops = drops;
+    }
+    fflush(stdout);
+}
+
+static void *rt_log_thread(void *arg) {
+    (void)arg;
+    struct timespec period = { 0, RT_LOG_DRAIN_PERIOD_MS * 1000000L };
+    while (atomic_load(&log_running)) {
+        nanosleep(&period, NULL);
+        drain(0);
+    }
+    return NULL;
+}
+
+static void init_ring(void) {
+    for (unsigned int i = 0; i < RT_LOG_RING_SIZE; i++) {
+        atomic_store_explicit(&ring[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store(&ring_tail, 0);
+    ring_head = 0;
+    atomic_store_explicit(&ring_ready, 1, memory_order_release);
+}
+
+/**
+ * @brief Queues one message; before rt_log_start() and after rt_log_stop() it is printed directly.
+ */
+int rt_log_write(rt_log_level_t level, int rate_limited, int nargs, const rt_log_arg_t *args) {
+    if (nargs > RT_LOG_MAX_ARGS) nargs = RT_LOG_MAX_ARGS;
+
+    if (!atomic_load_explicit(&log_running, memory_order_acquire)) {
+        char line[RT_LOG_LINE_MAX];
+        format_message(line, sizeof(line), nargs, args);
+        print_line(level, line);
+        return 0;
+    }
+
+    unsigned int position = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    rt_log_slot_t *slot;
+    for (;;) {
+        slot = &ring[position & (RT_LOG_RING_SIZE - 1)];
+        int diff = (int)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - position);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring_tail, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+            return -1; // Full
+        } else {
+            position = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
+    }
+
+    slot->level = (uint8_t)level;
+    slot->rate_limited = rate_limited ? 1 : 0;
+    slot->nargs = (uint8_t)nargs;
+    memcpy(slot->args, args, (size_t)nargs * sizeof(rt_log_arg_t));
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * @brief Starts the thread that formats and prints queued messages.
+ */
+int rt_log_start(void) {
+    if (atomic_load(&log_running)) return 0;
+    if (!atomic_load_explicit(&ring_ready, memory_order_acquire)) {
+        init_ring();
+    }
+    atomic_store(&log_running, 1);
+
+    // Formatting and terminal output must never compete with the control threads
+    int ret = rt_threads_create(RT_THREAD_BACKGROUND, &log_thread, rt_log_thread, NULL);
+    if (ret != 0) {
+        atomic_store(&log_running, 0);
+        fprintf(stderr, "RT_Log: failed to create log thread: %s\n", strerror(ret));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints everything still queued and pending burst counts, then stops the thread.
+ */
+void rt_log_stop(void) {
+    if (!atomic_exchange(&log_running, 0)) {
+        return;
+    }
+    pthread_join(log_thread, NULL);
+    // Producers that saw log_running set may still be finishing a message
+    struct timespec settle = { 0, RT_LOG_DRAIN_PERIOD_MS * 1000000L };
+    nanosleep(&settle, NULL);
+    drain(1);
+}
+
+/**
+ * @brief Returns the messages dropped because the ring was full, and those folded into bursts.
+ */
+void rt_log_get_stats(uint32_t *dropped, uint32_t *suppressed) {
+    if (dropped) *dropped = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    if (suppressed) *suppressed = atomic_load_explicit(&suppressed_count, memory_order_relaxed);
+}
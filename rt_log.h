@@ -0,0 +1,129 @@
+// rt_log.h - Deferred logging for real-time threads
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// RT_LOG() copies the format pointer and up to RT_LOG_MAX_ARGS - 1 arguments into a
+// lock-free multi-producer ring; a SCHED_OTHER thread formats and prints them. Producers
+// never block, format or make syscalls: when the ring is full the message is counted as
+// dropped. A message from the same call site (format string) within RT_LOG_RATE_WINDOW_MS
+// of the last one printed is only counted, and the burst is reported once the window ends:
+//   SOEM_Interface: Working counter too low: 0 < 3 [x347 in last 1.0s]
+// RT_LOG_EVENT() skips the rate limit, for state changes whose source already bounds them
+// and where every message counts (CiA 402 transitions of each drive).
+// String arguments are stored as pointers, so they must stay valid (literals, static tables).
+#define RT_LOG_RING_SIZE 1024          // Messages (power of two)
+#define RT_LOG_MAX_ARGS 8              // Including the format string
+#define RT_LOG_RATE_WINDOW_MS 1000
+#define RT_LOG_MAX_SITES 64            // Call sites tracked for rate limiting
+#define RT_LOG_LINE_MAX 256
+
+typedef enum {
+    RT_LOG_INFO = 0,                   // stdout
+    RT_LOG_ERROR                       // stderr
+} rt_log_level_t;
+
+typedef enum {
+    RT_LOG_ARG_INT = 0,
+    RT_LOG_ARG_DOUBLE,
+    RT_LOG_ARG_STRING,
+    RT_LOG_ARG_POINTER
+} rt_log_arg_type_t;
+
+typedef struct {
+    union {
+        long long i;
+        double d;
+        const char *s;
+        const void *p;
+    } value;
+    rt_log_arg_type_t type;
+} rt_log_arg_t;
+
+static inline rt_log_arg_t rt_log_arg_int(long long value) {
+    rt_log_arg_t arg = { .value.i = value, .type = RT_LOG_ARG_INT };
+    return arg;
+}
+
+static inline rt_log_arg_t rt_log_arg_double(double value) {
+    rt_log_arg_t arg = { .value.d = value, .type = RT_LOG_ARG_DOUBLE };
+    return arg;
+}
+
+static inline rt_log_arg_t rt_log_arg_string(const char *value) {
+    rt_log_arg_t arg = { .value.s = value, .type = RT_LOG_ARG_STRING };
+    return arg;
+}
+
+static inline rt_log_arg_t rt_log_arg_pointer(const void *value) {
+    rt_log_arg_t arg = { .value.p = value, .type = RT_LOG_ARG_POINTER };
+    return arg;
+}
+
+// Other pointer types must be cast to void * (printed with %p)
+#define RT_LOG_ARG(x) _Generic((x),                                   \
+    float: rt_log_arg_double, double: rt_log_arg_double,              \
+    char *: rt_log_arg_string, const char *: rt_log_arg_string,       \
+    void *: rt_log_arg_pointer, const void *: rt_log_arg_pointer,     \
+    default: rt_log_arg_int)(x)
+
+#define RT_LOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define RT_LOG_NARGS(...) RT_LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define RT_LOG_MAP1(a) RT_LOG_ARG(a)
+#define RT_LOG_MAP2(a, ...) RT_LOG_ARG(a), RT_LOG_MAP1(__VA_ARGS__)
+#define RT_LOG_MAP3(a, ...) RT_LOG_ARG(a), RT_LOG_MAP2(__VA_ARGS__)
+#define RT_LOG_MAP4(a, ...) RT_LOG_ARG(a), RT_LOG_MAP3(__VA_ARGS__)
+#define RT_LOG_MAP5(a, ...) RT_LOG_ARG(a), RT_LOG_MAP4(__VA_ARGS__)
+#define RT_LOG_MAP6(a, ...) RT_LOG_ARG(a), RT_LOG_MAP5(__VA_ARGS__)
+#define RT_LOG_MAP7(a, ...) RT_LOG_ARG(a), RT_LOG_MAP6(__VA_ARGS__)
+#define RT_LOG_MAP8(a, ...) RT_LOG_ARG(a), RT_LOG_MAP7(__VA_ARGS__)
+#define RT_LOG_CAT_(a, b) a##b
+#define RT_LOG_CAT(a, b) RT_LOG_CAT_(a, b)
+
+/**
+ * @brief Logs a printf-style message from any thread without blocking.
+ *        RT_LOG(RT_LOG_INFO, "Module: value %d\n", value);
+ *        The printf() in the dead branch only lets the compiler check the format.
+ */
+#define RT_LOG(level, ...) RT_LOG_WRITE_((level), 1, __VA_ARGS__)
+
+/**
+ * @brief As RT_LOG(), but every message is printed, never folded into a burst.
+ */
+#define RT_LOG_EVENT(level, ...) RT_LOG_WRITE_((level), 0, __VA_ARGS__)
+
+#define RT_LOG_WRITE_(level, rate_limited, ...)                                     \
+    do {                                                                            \
+        if (0) printf(__VA_ARGS__);                                                 \
+        rt_log_write((level), (rate_limited), RT_LOG_NARGS(__VA_ARGS__),            \
+                     (const rt_log_arg_t[]){ RT_LOG_CAT(RT_LOG_MAP, RT_LOG_NARGS(__VA_ARGS__))(__VA_ARGS__) }); \
+    } while (0)
+
+/**
+ * @brief Queues one message; use RT_LOG() or RT_LOG_EVENT() instead. Before rt_log_start()
+ *        and after rt_log_stop() the message is printed directly.
+ * @param rate_limited 0 to print the message even within its call site's rate window.
+ * @param args args[0] is the format string.
+ * @return 0 if queued or printed, -1 if the ring was full.
+ */
+int rt_log_write(rt_log_level_t level, int rate_limited, int nargs, const rt_log_arg_t *args);
+
+/**
+ * @brief Starts the thread that formats and prints queued messages.
+ * @return 0 on success, -1 on failure (messages are then printed directly).
+ */
+int rt_log_start(void);
+
+/**
+ * @brief Prints everything still queued and pending burst counts, then stops the thread.
+ */
+void rt_log_stop(void);
+
+/**
+ * @brief Returns the messages dropped because the ring was full, and those folded into bursts.
+ */
+void rt_log_get_stats(uint32_t *dropped, uint32_t *suppressed);
+
+#endif // RT_LOG_H
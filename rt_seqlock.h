@@ -0,0 +1,49 @@
+// rt_seqlock.h - Single-writer sequence lock for sharing small structs with real-time threads
+#ifndef RT_SEQLOCK_H
+#define RT_SEQLOCK_H
+
+#include <stdatomic.h>
+
+// The writer never blocks or waits: it bumps the sequence to an odd value, updates the
+// protected data and bumps it back to even. Readers copy the data and retry if the
+// sequence was odd or changed while they were copying.
+// Only ONE thread may write a given seqlock.
+typedef struct {
+    atomic_uint sequence;
+} rt_seqlock_t;
+
+#define RT_SEQLOCK_INIT { 0 }
+
+static inline void rt_seqlock_cpu_relax(void) {
+#if defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause" ::: "memory");
+#endif
+}
+
+static inline void rt_seqlock_write_begin(rt_seqlock_t *lock) {
+    unsigned int seq = atomic_load_explicit(&lock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&lock->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void rt_seqlock_write_end(rt_seqlock_t *lock) {
+    unsigned int seq = atomic_load_explicit(&lock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&lock->sequence, seq + 1, memory_order_release);
+}
+
+static inline unsigned int rt_seqlock_read_begin(rt_seqlock_t *lock) {
+    unsigned int seq;
+    while ((seq = atomic_load_explicit(&lock->sequence, memory_order_acquire)) & 1U) {
+        rt_seqlock_cpu_relax(); // Writer is mid-update
+    }
+    return seq;
+}
+
+static inline int rt_seqlock_read_retry(rt_seqlock_t *lock, unsigned int start_seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&lock->sequence, memory_order_relaxed) != start_seq;
+}
+
+#endif // RT_SEQLOCK_H
@@ -0,0 +1,466 @@
+// rt_threads.c - Thread topology table, core isolation checks, NIC IRQ affinity and CPU latency
+#include "rt_threads.h"
+#include "rt_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define RT_THREADS_MAX_IRQS     16
+#define RT_THREADS_MAX_STARTING 16      // Threads between pthread_create() and their start routine
+
+// Default topology for a 4-core Raspberry Pi booted with isolcpus=3: the EtherCAT cycle owns
+// core 3, the main loop runs on core 2, the HID threads share core 1 and everything that
+// formats or touches the disk stays on core 0 with the rest of the system. The real-time
+// loops keep their state in static storage and need little stack; the background threads
+// call stdio and libc formatting, whose frames are larger.
+static rt_thread_config_t topology[RT_THREAD_ROLE_COUNT] = {
+    [RT_THREAD_ETHERCAT]   = { "ethercat",   3, SCHED_FIFO,  80, 256 * 1024 },
+    [RT_THREAD_ENGINE]     = { "engine",     2, SCHED_FIFO,  50, 256 * 1024 },
+    [RT_THREAD_HID_RX]     = { "hid_rx",     1, SCHED_FIFO,  60, 256 * 1024 },
+    [RT_THREAD_HID_TX]     = { "hid_tx",     1, SCHED_FIFO,  55, 256 * 1024 },
+    [RT_THREAD_MAILBOX]    = { "mailbox",    0, SCHED_FIFO,  30, 256 * 1024 },
+    [RT_THREAD_BACKGROUND] = { "background", 0, SCHED_OTHER, 0,  512 * 1024 },
+};
+
+// Start routine and argument handed to a new thread through start_trampoline()
+typedef struct {
+    atomic_int in_use;
+    rt_thread_role_t role;
+    void *(*start_routine)(void *);
+    void *arg;
+} rt_thread_start_t;
+
+static rt_thread_start_t starting[RT_THREADS_MAX_STARTING];
+static __thread int current_role = -1;
+
+// Changed IRQ affinities, restored at exit
+static int irq_numbers[RT_THREADS_MAX_IRQS];
+static char irq_saved_affinity[RT_THREADS_MAX_IRQS][64];
+static int irq_count = 0;
+static int dma_latency_fd = -1;
+
+static const char *policy_name(int policy) {
+    switch (policy) {
+        case SCHED_FIFO: return "fifo";
+        case SCHED_RR: return "rr";
+        case SCHED_OTHER: return "other";
+        default: return "unknown";
+    }
+}
+
+// Parses a kernel cpu list ("0-1,3") into a mask of cores 0-63
+static uint64_t parse_cpu_list(const char *list) {
+    uint64_t mask = 0;
+    char *p = (char *)list;
+    while (*p) {
+        while (*p == ',' || isspace((unsigned char)*p)) p++;
+        if (!isdigit((unsigned char)*p)) break;
+        long first = strtol(p, &p, 10), last = first;
+        if (*p == '-') last = strtol(p + 1, &p, 10);
+        for (long cpu = first; cpu <= last && cpu < 64; cpu++) mask |= 1ULL << cpu;
+        // Skip a stride suffix (":2/4"), not used by the kernel files read here
+        while (*p && *p != ',') p++;
+    }
+    return mask;
+}
+
+static uint64_t read_cpu_list_file(const char *path) {
+    char buffer[256] = "";
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+    if (!fgets(buffer, sizeof(buffer), file)) buffer[0] = '\0';
+    fclose(file);
+    return parse_cpu_list(buffer);
+}
+
+static void format_cpu_mask(uint64_t mask, char *out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    for (int cpu = 0; cpu < 64 && used + 4 < size; cpu++) {
+        if (mask & (1ULL << cpu)) used += (size_t)snprintf(out + used, size - used, "%s%d", used ? "," : "", cpu);
+    }
+    if (!used) snprintf(out, size, "none");
+}
+
+static int cpu_usable(int cpu) {
+    long online = sysconf(_SC_NPROCESSORS_CONF);
+    return cpu >= 0 && cpu < online && cpu < CPU_SETSIZE;
+}
+
+static int parse_policy(const char *text, int *policy) {
+    if (!strcasecmp(text, "fifo")) *policy = SCHED_FIFO;
+    else if (!strcasecmp(text, "rr")) *policy = SCHED_RR;
+    else if (!strcasecmp(text, "other")) *policy = SCHED_OTHER;
+    else return -1;
+    return 0;
+}
+
+/**
+ * @brief Overrides entries of the default topology from a role=cpu[:policy[:priority]] list.
+ */
+int rt_threads_configure(const char *spec) {
+    rt_thread_config_t updated[RT_THREAD_ROLE_COUNT];
+    char buffer[512];
+
+    if (strlen(spec) >= sizeof(buffer)) {
+        fprintf(stderr, "RT_Threads: topology spec too long\n");
+        return -1;
+    }
+    memcpy(updated, topology, sizeof(updated));
+    strcpy(buffer, spec);
+
+    char *save_entry = NULL;
+    for (char *entry = strtok_r(buffer, ",", &save_entry); entry; entry = strtok_r(NULL, ",", &save_entry)) {
+        char *equals = strchr(entry, '=');
+        if (!equals) {
+            fprintf(stderr, "RT_Threads: '%s' is not role=cpu[:policy[:priority]]\n", entry);
+            return -1;
+        }
+        *equals = '\0';
+        int role;
+        for (role = 0; role < RT_THREAD_ROLE_COUNT; role++) {
+            if (!strcmp(entry, topology[role].name)) break;
+        }
+        if (role == RT_THREAD_ROLE_COUNT) {
+            fprintf(stderr, "RT_Threads: unknown thread role '%s'\n", entry);
+            return -1;
+        }
+
+        rt_thread_config_t *config = &updated[role];
+        char *save_field = NULL;
+        char *cpu = strtok_r(equals + 1, ":", &save_field);
+        char *policy = strtok_r(NULL, ":", &save_field);
+        char *priority = strtok_r(NULL, ":", &save_field);
+        if (cpu) {
+            config->cpu = !strcmp(cpu, "any") ? -1 : atoi(cpu);
+        }
+        if (policy && parse_policy(policy, &config->policy) != 0) {
+            fprintf(stderr, "RT_Threads: unknown policy '%s' (fifo, rr, other)\n", policy);
+            return -1;
+        }
+        if (priority) {
+            config->priority = atoi(priority);
+        } else if (policy) {
+            config->priority = (config->policy == SCHED_OTHER) ? 0 : topology[role].priority;
+        }
+        int min = sched_get_priority_min(config->policy), max = sched_get_priority_max(config->policy);
+        if (config->priority < min || config->priority > max) {
+            fprintf(stderr, "RT_Threads: priority %d out of range for %s (%d-%d)\n",
+                    config->priority, policy_name(config->policy), min, max);
+            return -1;
+        }
+    }
+
+    memcpy(topology, updated, sizeof(topology));
+    return 0;
+}
+
+/**
+ * @brief Returns the configuration of a role.
+ */
+const rt_thread_config_t *rt_threads_get_config(rt_thread_role_t role) {
+    return &topology[role];
+}
+
+/**
+ * @brief Prints the topology and the isolated/nohz_full cores reported by the kernel.
+ */
+void rt_threads_print(void) {
+    char isolated[128], nohz[128];
+    format_cpu_mask(read_cpu_list_file("/sys/devices/system/cpu/isolated"), isolated, sizeof(isolated));
+    format_cpu_mask(read_cpu_list_file("/sys/devices/system/cpu/nohz_full"), nohz, sizeof(nohz));
+
+    printf("RT_Threads: isolated cores: %s, nohz_full cores: %s\n", isolated, nohz);
+    for (int role = 0; role < RT_THREAD_ROLE_COUNT; role++) {
+        const rt_thread_config_t *config = &topology[role];
+        char cpu[16];
+        if (config->cpu < 0) snprintf(cpu, sizeof(cpu), "any");
+        else snprintf(cpu, sizeof(cpu), "%d", config->cpu);
+        printf("RT_Threads:   %-10s cpu %-3s %-5s priority %-2d stack %zu KiB%s\n", config->name, cpu,
+               policy_name(config->policy), config->priority, config->stack_size / 1024,
+               (config->cpu >= 0 && !cpu_usable(config->cpu)) ? " (core not present, not pinned)" : "");
+    }
+}
+
+/**
+ * @brief Checks that the EtherCAT core is isolated and warns if it is not nohz_full.
+ */
+int rt_threads_check_isolation(void) {
+    const rt_thread_config_t *config = &topology[RT_THREAD_ETHERCAT];
+    if (config->cpu < 0 || !cpu_usable(config->cpu)) {
+        fprintf(stderr, "RT_Threads: WARNING: the EtherCAT thread is not pinned to a core\n");
+        return 0;
+    }
+
+    uint64_t isolated = read_cpu_list_file("/sys/devices/system/cpu/isolated");
+    uint64_t nohz = read_cpu_list_file("/sys/devices/system/cpu/nohz_full");
+    uint64_t bit = 1ULL << config->cpu;
+    if (!(isolated & bit)) {
+        fprintf(stderr, "\n"
+                "**********************************************************************\n"
+                "RT_Threads: ERROR: EtherCAT core %d is not isolated.\n"
+                "  Other tasks will be scheduled on it and cause cycle jitter.\n"
+                "  Add to /boot/cmdline.txt and reboot: isolcpus=%d nohz_full=%d rcu_nocbs=%d\n"
+                "**********************************************************************\n\n",
+                config->cpu, config->cpu, config->cpu, config->cpu);
+        return -1;
+    }
+    if (!(nohz & bit)) {
+        fprintf(stderr, "RT_Threads: WARNING: EtherCAT core %d is isolated but not nohz_full; "
+                "the scheduler tick still interrupts it\n", config->cpu);
+    }
+    return 0;
+}
+
+// The interface's name as a whole word of an /proc/interrupts line ("eth1", "eth1-rx-0")
+static int irq_line_matches(const char *line, const char *ifname) {
+    size_t length = strlen(ifname);
+    for (const char *p = strstr(line, ifname); p; p = strstr(p + 1, ifname)) {
+        char before = (p == line) ? ' ' : p[-1];
+        char after = p[length];
+        if ((isspace((unsigned char)before) || before == ',') && !isalnum((unsigned char)after)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int write_text_file(const char *path, const char *text) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t written = write(fd, text, strlen(text));
+    close(fd);
+    return written == (ssize_t)strlen(text) ? 0 : -1;
+}
+
+static void move_nic_irqs(const char *ifname, int cpu) {
+    char line[1024];
+    FILE *interrupts = fopen("/proc/interrupts", "r");
+    if (!interrupts) {
+        fprintf(stderr, "RT_Threads: cannot read /proc/interrupts: %s\n", strerror(errno));
+        return;
+    }
+
+    char cpu_text[16];
+    snprintf(cpu_text, sizeof(cpu_text), "%d\n", cpu);
+    while (fgets(line, sizeof(line), interrupts) && irq_count < RT_THREADS_MAX_IRQS) {
+        char *end;
+        long irq = strtol(line, &end, 10);
+        if (end == line || *end != ':' || !irq_line_matches(end + 1, ifname)) continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/irq/%ld/smp_affinity_list", irq);
+        FILE *current = fopen(path, "r");
+        if (!current) continue;
+        char *saved = irq_saved_affinity[irq_count];
+        if (!fgets(saved, sizeof(irq_saved_affinity[0]), current)) saved[0] = '\0';
+        fclose(current);
+
+        if (write_text_file(path, cpu_text) != 0) {
+            fprintf(stderr, "RT_Threads: failed to move IRQ %ld (%s) to core %d: %s\n", irq, ifname, cpu, strerror(errno));
+            continue;
+        }
+        irq_numbers[irq_count++] = (int)irq;
+        printf("RT_Threads: IRQ %ld (%s) moved to core %d\n", irq, ifname, cpu);
+    }
+    fclose(interrupts);
+
+    if (irq_count == 0) {
+        // USB adapters have no IRQ of their own; they share the USB host controller's
+        fprintf(stderr, "RT_Threads: no IRQ named after %s in /proc/interrupts (USB NIC?), IRQ affinity unchanged\n", ifname);
+    }
+}
+
+/**
+ * @brief Moves the NIC IRQs to the EtherCAT core and requests zero CPU wakeup latency.
+ */
+void rt_threads_setup_system(const char *ifname) {
+    const rt_thread_config_t *config = &topology[RT_THREAD_ETHERCAT];
+    if (config->cpu >= 0 && cpu_usable(config->cpu)) {
+        move_nic_irqs(ifname, config->cpu);
+    }
+
+    // The request holds as long as the file stays open
+    int32_t latency_us = 0;
+    dma_latency_fd = open("/dev/cpu_dma_latency", O_WRONLY | O_CLOEXEC);
+    if (dma_latency_fd < 0 || write(dma_latency_fd, &latency_us, sizeof(latency_us)) != sizeof(latency_us)) {
+        fprintf(stderr, "RT_Threads: failed to set /dev/cpu_dma_latency to 0: %s\n", strerror(errno));
+        if (dma_latency_fd >= 0) close(dma_latency_fd);
+        dma_latency_fd = -1;
+    } else {
+        printf("RT_Threads: CPU idle states limited to 0 us wakeup latency\n");
+    }
+}
+
+/**
+ * @brief Restores the IRQ affinities and releases the CPU latency request.
+ */
+void rt_threads_restore_system(void) {
+    for (int i = 0; i < irq_count; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq_numbers[i]);
+        if (irq_saved_affinity[i][0]) write_text_file(path, irq_saved_affinity[i]);
+    }
+    irq_count = 0;
+    if (dma_latency_fd >= 0) {
+        close(dma_latency_fd);
+        dma_latency_fd = -1;
+    }
+}
+
+// Writes every page of the next bytes of stack below the caller. Not inlined, so the array
+// is a frame of its own that is gone again when the thread's work starts.
+static __attribute__((noinline)) void prefault_stack(size_t bytes) {
+    uint8_t pages[bytes];
+    volatile uint8_t *touch = pages;
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) page_size = 4096;
+    for (size_t offset = 0; offset < bytes; offset += (size_t)page_size) {
+        touch[offset] = 0;
+    }
+}
+
+static void prefault_role_stack(rt_thread_role_t role) {
+    size_t size = topology[role].stack_size;
+    if (size > RT_THREADS_STACK_RESERVE) prefault_stack(size - RT_THREADS_STACK_RESERVE);
+}
+
+static void *start_trampoline(void *context) {
+    rt_thread_start_t *start = context;
+    rt_thread_role_t role = start->role;
+    void *(*start_routine)(void *) = start->start_routine;
+    void *arg = start->arg;
+    atomic_store(&start->in_use, 0);
+
+    current_role = (int)role;
+    prefault_role_stack(role);
+    return start_routine(arg);
+}
+
+static rt_thread_start_t *claim_start_slot(void) {
+    for (int i = 0; i < RT_THREADS_MAX_STARTING; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&starting[i].in_use, &expected, 1)) return &starting[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief pthread_create() with the role's affinity, policy, priority and stack size.
+ */
+int rt_threads_create(rt_thread_role_t role, pthread_t *thread, void *(*start_routine)(void *), void *arg) {
+    const rt_thread_config_t *config = &topology[role];
+    struct sched_param param = { .sched_priority = config->priority };
+    cpu_set_t cpuset;
+    pthread_attr_t attr;
+
+    rt_thread_start_t *start = claim_start_slot();
+    if (!start) {
+        fprintf(stderr, "RT_Threads: more than %d threads starting at once\n", RT_THREADS_MAX_STARTING);
+        return EAGAIN;
+    }
+    start->role = role;
+    start->start_routine = start_routine;
+    start->arg = arg;
+
+    // Threads never inherit: the creator may be a pinned real-time thread
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, config->stack_size);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, config->policy);
+    pthread_attr_setschedparam(&attr, &param);
+    CPU_ZERO(&cpuset);
+    if (config->cpu >= 0 && cpu_usable(config->cpu)) {
+        CPU_SET(config->cpu, &cpuset);
+    } else {
+        for (int cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF) && cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &cpuset);
+    }
+    pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+
+    int ret = pthread_create(thread, &attr, start_trampoline, start);
+    if (ret == EPERM && config->policy != SCHED_OTHER) {
+        fprintf(stderr, "RT_Threads: WARNING: no permission for %s priority %d, %s thread runs with SCHED_OTHER\n",
+                policy_name(config->policy), config->priority, config->name);
+        param.sched_priority = 0;
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        pthread_attr_setschedparam(&attr, &param);
+        ret = pthread_create(thread, &attr, start_trampoline, start);
+    }
+    pthread_attr_destroy(&attr);
+    if (ret != 0) atomic_store(&start->in_use, 0);
+    return ret;
+}
+
+/**
+ * @brief Applies the role's affinity, policy and priority to the calling thread.
+ */
+int rt_threads_apply_self(rt_thread_role_t role) {
+    const rt_thread_config_t *config = &topology[role];
+    struct sched_param param = { .sched_priority = config->priority };
+    int status = 0;
+
+    if (config->cpu >= 0 && cpu_usable(config->cpu)) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(config->cpu, &cpuset);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        if (ret != 0) {
+            fprintf(stderr, "RT_Threads: failed to pin %s thread to core %d: %s\n", config->name, config->cpu, strerror(ret));
+            status = -1;
+        }
+    }
+    int ret = pthread_setschedparam(pthread_self(), config->policy, &param);
+    if (ret != 0) {
+        fprintf(stderr, "RT_Threads: failed to set %s priority %d for the %s thread: %s\n",
+                policy_name(config->policy), config->priority, config->name, strerror(ret));
+        status = -1;
+    }
+
+    current_role = (int)role;
+    prefault_role_stack(role);
+    return status;
+}
+
+/**
+ * @brief Returns the role of the calling thread, -1 if it has none.
+ */
+int rt_threads_current_role(void) {
+    return current_role;
+}
+
+/**
+ * @brief Checks from inside a thread that it runs with its role's policy, priority and CPU.
+ */
+int rt_threads_verify_self(rt_thread_role_t role) {
+    const rt_thread_config_t *config = &topology[role];
+    struct sched_param param;
+    int policy, status = 0;
+
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0 &&
+        (policy != config->policy || param.sched_priority != config->priority)) {
+        RT_LOG(RT_LOG_ERROR, "RT_Threads: ERROR: %s thread runs %s priority %d, configured %s priority %d\n",
+               config->name, policy_name(policy), param.sched_priority,
+               policy_name(config->policy), config->priority);
+        status = -1;
+    }
+    if (config->cpu >= 0 && cpu_usable(config->cpu)) {
+        cpu_set_t cpuset;
+        int cpu = sched_getcpu();
+        if (pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0 &&
+            (CPU_COUNT(&cpuset) != 1 || !CPU_ISSET(config->cpu, &cpuset) || cpu != config->cpu)) {
+            RT_LOG(RT_LOG_ERROR, "RT_Threads: ERROR: %s thread is on core %d, configured core %d\n",
+                   config->name, cpu, config->cpu);
+            status = -1;
+        }
+    }
+    return status;
+}
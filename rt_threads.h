@@ -0,0 +1,99 @@
+// rt_threads.h - Thread topology: CPU, scheduling policy and priority of every application thread
+#ifndef RT_THREADS_H
+#define RT_THREADS_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+typedef enum {
+    RT_THREAD_ETHERCAT = 0,     // ecat_loop (and the inline engine)
+    RT_THREAD_ENGINE,           // main loop
+    RT_THREAD_HID_RX,           // FFB report reception
+    RT_THREAD_HID_TX,           // Gamepad report writer
+    RT_THREAD_MAILBOX,          // SDO transfers and slave state supervision (soem_mailbox.c)
+    RT_THREAD_BACKGROUND,       // Log formatting, telemetry writer, shared memory histograms
+    RT_THREAD_ROLE_COUNT
+} rt_thread_role_t;
+
+typedef struct {
+    const char *name;           // Role name used by rt_threads_configure()
+    int cpu;                    // Core to pin to, -1 for no pinning
+    int policy;                 // SCHED_FIFO, SCHED_RR or SCHED_OTHER
+    int priority;               // 1-99 for SCHED_FIFO/SCHED_RR, 0 for SCHED_OTHER
+    size_t stack_size;          // Bytes, prefaulted at thread start
+} rt_thread_config_t;
+
+// Part of the stack left untouched by the prefault: glibc carves the thread descriptor and
+// static TLS out of the stack size, and the prefault itself needs a frame
+#define RT_THREADS_STACK_RESERVE    (32 * 1024)
+
+/**
+ * @brief Overrides entries of the default topology.
+ *        The spec is a comma separated list of role=cpu[:policy[:priority]], e.g.
+ *        "ethercat=3:fifo:80,engine=2,hid_rx=1:fifo:60,background=any:other".
+ *        Roles: ethercat, engine, hid_rx, hid_tx, mailbox, background. cpu "any" disables pinning.
+ * @return 0 on success, -1 if the spec is malformed (nothing is changed).
+ */
+int rt_threads_configure(const char *spec);
+
+/**
+ * @brief Returns the configuration of a role.
+ */
+const rt_thread_config_t *rt_threads_get_config(rt_thread_role_t role);
+
+/**
+ * @brief Prints the topology and the isolated/nohz_full cores reported by the kernel.
+ */
+void rt_threads_print(void);
+
+/**
+ * @brief Checks that the EtherCAT core is isolated (isolcpus) and warns if it is not nohz_full.
+ *        Prints a loud error when it is not isolated.
+ * @return 0 if isolated (or the EtherCAT thread is not pinned), -1 otherwise.
+ */
+int rt_threads_check_isolation(void);
+
+/**
+ * @brief Moves the IRQs of the EtherCAT NIC to the EtherCAT core and requests zero
+ *        CPU wakeup latency through /dev/cpu_dma_latency (held until rt_threads_restore_system()).
+ *        Failures are reported and otherwise ignored; needs root.
+ * @param ifname EtherCAT network interface.
+ */
+void rt_threads_setup_system(const char *ifname);
+
+/**
+ * @brief Restores the IRQ affinities changed by rt_threads_setup_system() and releases the
+ *        CPU latency request.
+ */
+void rt_threads_restore_system(void);
+
+/**
+ * @brief pthread_create() with the role's affinity, policy, priority and stack size. The new
+ *        thread writes every page of its stack before start_routine runs, so stack growth in
+ *        the cycle never faults. If the real-time policy is not permitted (no root), the thread
+ *        is created with SCHED_OTHER instead and a warning is printed.
+ * @return 0 on success, an error number as from pthread_create() otherwise.
+ */
+int rt_threads_create(rt_thread_role_t role, pthread_t *thread, void *(*start_routine)(void *), void *arg);
+
+/**
+ * @brief Applies the role's affinity, policy and priority to the calling thread and prefaults
+ *        the role's stack size of its stack.
+ * @return 0 on success, -1 if any of them could not be applied.
+ */
+int rt_threads_apply_self(rt_thread_role_t role);
+
+/**
+ * @brief Returns the role of the calling thread, -1 for threads not started through
+ *        rt_threads_create() or rt_threads_apply_self(). Async-signal-safe.
+ */
+int rt_threads_current_role(void);
+
+/**
+ * @brief Checks from inside a thread that it runs with its role's policy, priority and CPU.
+ *        Reports mismatches through RT_LOG(). Makes syscalls: call once at thread start.
+ * @return 0 if everything matches, -1 otherwise.
+ */
+int rt_threads_verify_self(rt_thread_role_t role);
+
+#endif // RT_THREADS_H
@@ -0,0 +1,180 @@
+// shm_telemetry.c - Seqlock-protected live state block in /dev/shm for external readers
+#include "shm_telemetry.h"
+#include "rt_histogram.h"
+#include "rt_threads.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static shm_telemetry_t *shm = NULL;
+static atomic_int histogram_thread_running = 0;
+static pthread_t histogram_thread;
+
+static void copy_name(char *dest, size_t size, const char *src) {
+    strncpy(dest, src ? src : "", size - 1);
+    dest[size - 1] = '\0';
+}
+
+// Summaries cost a pass over every bucket, so they are refreshed here instead of in the loop
+static void *shm_telemetry_histogram_thread(void *arg) {
+    (void)arg;
+    static rt_histogram_summary_t summaries[SHM_TELEMETRY_MAX_HISTOGRAMS];
+    struct timespec period = { 0, SHM_TELEMETRY_HISTOGRAM_PERIOD_MS * 1000000L };
+
+    while (atomic_load(&histogram_thread_running)) {
+        nanosleep(&period, NULL);
+
+        int count = rt_histogram_get_summaries(summaries, SHM_TELEMETRY_MAX_HISTOGRAMS);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        rt_seqlock_write_begin(&shm->histogram_lock);
+        for (int i = 0; i < count; i++) {
+            shm_telemetry_histogram_t *h = &shm->histograms[i];
+            copy_name(h->name, sizeof(h->name), summaries[i].name);
+            copy_name(h->unit, sizeof(h->unit), summaries[i].unit);
+            h->count = summaries[i].count;
+            h->mean = summaries[i].mean;
+            h->p50 = summaries[i].p50;
+            h->p99 = summaries[i].p99;
+            h->p999 = summaries[i].p999;
+            h->max = summaries[i].max;
+        }
+        shm->histogram_count = (uint32_t)count;
+        shm->histogram_timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+        rt_seqlock_write_end(&shm->histogram_lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates the shared memory segment and the thread that refreshes the histogram block.
+ */
+int shm_telemetry_init(void) {
+    int fd = shm_open(SHM_TELEMETRY_NAME, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "SHM_Telemetry: shm_open %s failed: %s\n", SHM_TELEMETRY_NAME, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(shm_telemetry_t)) != 0) {
+        fprintf(stderr, "SHM_Telemetry: ftruncate failed: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // MAP_POPULATE so the first publish from the control loop does not fault
+    void *map = mmap(NULL, sizeof(shm_telemetry_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "SHM_Telemetry: mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+    shm = map;
+
+    // A reader that sees the magic sees a fully initialized segment
+    atomic_store_explicit(&shm->magic, 0, memory_order_relaxed);
+    memset((char *)shm + sizeof(shm->magic), 0, sizeof(*shm) - sizeof(shm->magic));
+    shm->version = SHM_TELEMETRY_VERSION;
+    shm->size = sizeof(shm_telemetry_t);
+    shm->writer_pid = (int32_t)getpid();
+    atomic_store_explicit(&shm->magic, SHM_TELEMETRY_MAGIC, memory_order_release);
+
+    atomic_store(&histogram_thread_running, 1);
+    int ret = rt_threads_create(RT_THREAD_BACKGROUND, &histogram_thread, shm_telemetry_histogram_thread, NULL);
+    if (ret != 0) {
+        // The state block still works; only the histograms stay empty
+        fprintf(stderr, "SHM_Telemetry: failed to create histogram thread: %s\n", strerror(ret));
+        atomic_store(&histogram_thread_running, 0);
+    }
+
+    printf("SHM_Telemetry: live state at /dev/shm%s (%zu bytes)\n", SHM_TELEMETRY_NAME, sizeof(shm_telemetry_t));
+    return 0;
+}
+
+/**
+ * @brief Copies the state into the shared segment (single writer).
+ */
+void shm_telemetry_publish(const shm_telemetry_state_t *state) {
+    if (!shm) return;
+    rt_seqlock_write_begin(&shm->state_lock);
+    uint64_t update_count = shm->state.update_count + 1;
+    shm->state = *state;
+    shm->state.update_count = update_count;
+    rt_seqlock_write_end(&shm->state_lock);
+}
+
+/**
+ * @brief Stops the histogram thread and removes the segment.
+ */
+void shm_telemetry_cleanup(void) {
+    if (!shm) return;
+    if (atomic_exchange(&histogram_thread_running, 0)) {
+        pthread_join(histogram_thread, NULL);
+    }
+    // Readers that still have it mapped see the magic cleared
+    atomic_store_explicit(&shm->magic, 0, memory_order_release);
+    munmap(shm, sizeof(shm_telemetry_t));
+    shm = NULL;
+    shm_unlink(SHM_TELEMETRY_NAME);
+}
+
+/**
+ * @brief Maps an existing segment read-only (for external readers).
+ */
+const shm_telemetry_t *shm_telemetry_open_reader(void) {
+    int fd = shm_open(SHM_TELEMETRY_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_telemetry_t)) {
+        close(fd);
+        return NULL;
+    }
+    const shm_telemetry_t *map = mmap(NULL, sizeof(shm_telemetry_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    if (atomic_load_explicit(&map->magic, memory_order_acquire) != SHM_TELEMETRY_MAGIC ||
+        map->version != SHM_TELEMETRY_VERSION || map->size < sizeof(shm_telemetry_t)) {
+        munmap((void *)map, sizeof(shm_telemetry_t));
+        return NULL;
+    }
+    return map;
+}
+
+/**
+ * @brief Reads a consistent copy of the state block.
+ */
+void shm_telemetry_read_state(const shm_telemetry_t *reader, shm_telemetry_state_t *state_out) {
+    rt_seqlock_t *lock = (rt_seqlock_t *)&reader->state_lock;
+    unsigned int seq;
+    do {
+        seq = rt_seqlock_read_begin(lock);
+        *state_out = reader->state;
+    } while (rt_seqlock_read_retry(lock, seq));
+}
+
+/**
+ * @brief Reads a consistent copy of the histogram block.
+ */
+int shm_telemetry_read_histograms(const shm_telemetry_t *reader, shm_telemetry_histogram_t *histograms_out) {
+    rt_seqlock_t *lock = (rt_seqlock_t *)&reader->histogram_lock;
+    unsigned int seq;
+    uint32_t count;
+    do {
+        seq = rt_seqlock_read_begin(lock);
+        count = reader->histogram_count;
+        if (count > SHM_TELEMETRY_MAX_HISTOGRAMS) count = SHM_TELEMETRY_MAX_HISTOGRAMS;
+        memcpy(histograms_out, reader->histograms, count * sizeof(shm_telemetry_histogram_t));
+    } while (rt_seqlock_read_retry(lock, seq));
+    return (int)count;
+}
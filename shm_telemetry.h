@@ -0,0 +1,109 @@
+// shm_telemetry.h - Live state in POSIX shared memory for dashboards and tuning tools
+#ifndef SHM_TELEMETRY_H
+#define SHM_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "rt_seqlock.h"
+
+// shm_open() name; the segment appears as /dev/shm/ddecat
+#define SHM_TELEMETRY_NAME "/ddecat"
+#define SHM_TELEMETRY_MAGIC 0x43454444u   // "DDEC" little endian
+#define SHM_TELEMETRY_VERSION 1
+#define SHM_TELEMETRY_MAX_HISTOGRAMS 32
+#define SHM_TELEMETRY_HISTOGRAM_PERIOD_MS 100 // Histogram block refresh
+
+// shm_telemetry_state_t.status bits
+#define SHM_TELEMETRY_STATUS_EMERGENCY_STOP 0x0001
+#define SHM_TELEMETRY_STATUS_ETHERCAT_OK    0x0002
+#define SHM_TELEMETRY_STATUS_HID_OK         0x0004
+#define SHM_TELEMETRY_STATUS_PAUSED         0x0008
+#define SHM_TELEMETRY_STATUS_INLINE         0x0010
+
+// Published by the main loop every cycle
+typedef struct {
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC
+    uint64_t update_count;      // Publications since the application started
+    uint32_t status;            // SHM_TELEMETRY_STATUS_* bits
+    uint32_t ethercat_cycle;    // EtherCAT cycle of the feedback sample
+    float angle_deg;            // Relative to the center
+    float normalized_position;  // As sent to the host, -1.0 to 1.0
+    float velocity;             // Drive units
+    float torque_command;       // After the safety checks
+    int16_t torque_actual;      // 0x6077 per mille of rated torque
+    uint16_t statusword;        // 0x6041
+    uint16_t cia402_state;      // cia402_state_t
+    uint16_t reserved0;
+    uint64_t active_mask;       // Playing effect blocks (bit i = effect block i + 1)
+    uint32_t effects_received;  // Effect block operations applied since the start
+    uint32_t reserved1;
+} shm_telemetry_state_t;
+
+typedef struct {
+    char name[32];
+    char unit[8];               // "ns" or a count unit
+    uint64_t count;
+    double mean;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} shm_telemetry_histogram_t;
+
+// Layout of the shared memory segment. Each block has its own seqlock: copy the block
+// between rt_seqlock_read_begin() and rt_seqlock_read_retry() and retry on change.
+// Fields are only ever appended; readers check magic, version and size.
+typedef struct {
+    _Atomic uint32_t magic;     // SHM_TELEMETRY_MAGIC, written last during setup
+    uint16_t version;           // SHM_TELEMETRY_VERSION
+    uint16_t reserved0;
+    uint32_t size;              // sizeof(shm_telemetry_t)
+    int32_t writer_pid;
+
+    rt_seqlock_t state_lock;
+    shm_telemetry_state_t state;
+
+    rt_seqlock_t histogram_lock;
+    uint32_t histogram_count;
+    uint64_t histogram_timestamp_ns;
+    shm_telemetry_histogram_t histograms[SHM_TELEMETRY_MAX_HISTOGRAMS];
+} shm_telemetry_t;
+
+/**
+ * @brief Creates the shared memory segment and the thread that refreshes the histogram block.
+ *        The control path only ever calls shm_telemetry_publish().
+ * @return 0 on success, -1 on failure (the application runs on without it).
+ */
+int shm_telemetry_init(void);
+
+/**
+ * @brief Copies the state into the shared segment (single writer). No syscalls; does
+ *        nothing if shm_telemetry_init() failed or was not called.
+ */
+void shm_telemetry_publish(const shm_telemetry_state_t *state);
+
+/**
+ * @brief Stops the histogram thread and removes the segment.
+ */
+void shm_telemetry_cleanup(void);
+
+/**
+ * @brief Maps an existing segment read-only (for external readers).
+ * @return The mapping, or NULL if it does not exist or has an unknown version.
+ */
+const shm_telemetry_t *shm_telemetry_open_reader(void);
+
+/**
+ * @brief Reads a consistent copy of the state block.
+ */
+void shm_telemetry_read_state(const shm_telemetry_t *shm, shm_telemetry_state_t *state_out);
+
+/**
+ * @brief Reads a consistent copy of the histogram block.
+ * @param histograms_out Array of SHM_TELEMETRY_MAX_HISTOGRAMS entries.
+ * @return The number of entries filled in.
+ */
+int shm_telemetry_read_histograms(const shm_telemetry_t *shm, shm_telemetry_histogram_t *histograms_out);
+
+#endif // SHM_TELEMETRY_H
@@ -0,0 +1,181 @@
+// soem_cia402.c - Incremental CiA 402 drive state machine and its event queue
+#include "soem_cia402.h"
+
+#if (SOEM_CIA402_EVENT_QUEUE_SIZE & (SOEM_CIA402_EVENT_QUEUE_SIZE - 1)) != 0
+#error "SOEM_CIA402_EVENT_QUEUE_SIZE must be a power of two"
+#endif
+
+// Controlword commands (CiA 402 device control)
+#define CW_DISABLE_VOLTAGE    0x0000
+#define CW_QUICK_STOP         0x0002
+#define CW_SHUTDOWN           0x0006
+#define CW_SWITCH_ON          0x0007
+#define CW_ENABLE_OPERATION   0x000F
+#define CW_FAULT_RESET        0x0080
+
+#define MS_TO_NS(ms) ((uint64_t)(ms) * 1000000ULL)
+
+static soem_cia402_event_t event_ring[SOEM_CIA402_EVENT_QUEUE_SIZE];
+static atomic_uint event_head; // Next event to consume (written by consumer)
+static atomic_uint event_tail; // Next event to fill (written by producer)
+static atomic_uint dropped_events;
+
+static void push_event(const soem_cia402_t *sm, soem_cia402_event_type_t type, cia402_state_t previous,
+                       uint16_t statusword, uint64_t now_ns) {
+    unsigned int tail = atomic_load_explicit(&event_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&event_head, memory_order_acquire);
+    if (tail - head >= SOEM_CIA402_EVENT_QUEUE_SIZE) {
+        atomic_fetch_add_explicit(&dropped_events, 1, memory_order_relaxed);
+        return;
+    }
+    soem_cia402_event_t *event = &event_ring[tail & (SOEM_CIA402_EVENT_QUEUE_SIZE - 1)];
+    event->time_ns = now_ns;
+    event->slave = sm->slave;
+    event->statusword = statusword;
+    event->type = (uint8_t)type;
+    event->state = (uint8_t)sm->state;
+    event->previous_state = (uint8_t)previous;
+    event->reset_attempts = sm->reset_attempts;
+    atomic_store_explicit(&event_tail, tail + 1, memory_order_release);
+}
+
+/**
+ * @brief Prepares the state machine of one drive.
+ */
+void soem_cia402_init(soem_cia402_t *sm, uint16_t slave) {
+    sm->slave = slave;
+    sm->state = CIA402_STATE_NOT_READY;
+    sm->controlword = CW_DISABLE_VOLTAGE;
+    atomic_store_explicit(&sm->quick_stop_request, 0, memory_order_relaxed);
+    sm->quick_stop_sent = 0;
+    sm->reset_attempts = 0;
+    sm->backoff_ns = MS_TO_NS(SOEM_CIA402_BACKOFF_MIN_MS);
+    sm->next_reset_ns = 0;
+    sm->pulse_end_ns = 0;
+    sm->enabled_since_ns = 0;
+    sm->started = 0;
+}
+
+// Bookkeeping when the drive reports a new state
+static void enter_state(soem_cia402_t *sm, cia402_state_t state, uint16_t statusword, uint64_t now_ns) {
+    cia402_state_t previous = sm->state;
+    sm->state = state;
+    push_event(sm, SOEM_CIA402_EVENT_STATE_CHANGED, previous, statusword, now_ns);
+
+    if (state == CIA402_STATE_FAULT) {
+        sm->next_reset_ns = now_ns + sm->backoff_ns;
+        push_event(sm, SOEM_CIA402_EVENT_FAULT, previous, statusword, now_ns);
+    } else if (state == CIA402_STATE_OPERATION_ENABLED) {
+        sm->enabled_since_ns = now_ns;
+        push_event(sm, SOEM_CIA402_EVENT_ENABLED, previous, statusword, now_ns);
+    }
+}
+
+// FAULT: pulse bit 7 for a rising edge, again after each backoff while the fault persists
+static uint16_t fault_reset_controlword(soem_cia402_t *sm, uint16_t statusword, uint64_t now_ns) {
+    if (now_ns < sm->pulse_end_ns) {
+        return CW_FAULT_RESET;
+    }
+    if (now_ns < sm->next_reset_ns) {
+        return CW_DISABLE_VOLTAGE;
+    }
+    sm->reset_attempts++;
+    sm->pulse_end_ns = now_ns + MS_TO_NS(SOEM_CIA402_RESET_PULSE_MS);
+    sm->backoff_ns *= 2;
+    if (sm->backoff_ns > MS_TO_NS(SOEM_CIA402_BACKOFF_MAX_MS)) sm->backoff_ns = MS_TO_NS(SOEM_CIA402_BACKOFF_MAX_MS);
+    sm->next_reset_ns = now_ns + sm->backoff_ns;
+    push_event(sm, SOEM_CIA402_EVENT_FAULT_RESET, sm->state, statusword, now_ns);
+    return CW_FAULT_RESET;
+}
+
+/**
+ * @brief Advances the state machine with the statusword of the frame just received.
+ */
+uint16_t soem_cia402_step(soem_cia402_t *sm, uint16_t statusword, uint64_t now_ns) {
+    cia402_state_t state = get_cia402_state(statusword);
+    int quick_stop = atomic_load_explicit(&sm->quick_stop_request, memory_order_relaxed);
+
+    if (!sm->started || state != sm->state) {
+        sm->started = 1;
+        enter_state(sm, state, statusword, now_ns);
+    }
+    if (!quick_stop) {
+        sm->quick_stop_sent = 0;
+    }
+
+    // One command per cycle, chosen from the state the drive reports now
+    switch (state) {
+        case CIA402_STATE_FAULT:
+            sm->controlword = fault_reset_controlword(sm, statusword, now_ns);
+            break;
+        case CIA402_STATE_SWITCH_ON_DISABLED:
+            sm->controlword = quick_stop ? CW_DISABLE_VOLTAGE : CW_SHUTDOWN;
+            break;
+        case CIA402_STATE_READY_TO_SWITCH_ON:
+            sm->controlword = quick_stop ? CW_DISABLE_VOLTAGE : CW_SWITCH_ON;
+            break;
+        case CIA402_STATE_SWITCHED_ON:
+            sm->controlword = quick_stop ? CW_DISABLE_VOLTAGE : CW_ENABLE_OPERATION;
+            break;
+        case CIA402_STATE_OPERATION_ENABLED:
+            if (quick_stop) {
+                sm->controlword = CW_QUICK_STOP;
+                if (!sm->quick_stop_sent) {
+                    sm->quick_stop_sent = 1;
+                    push_event(sm, SOEM_CIA402_EVENT_QUICK_STOP, state, statusword, now_ns);
+                }
+            } else {
+                sm->controlword = CW_ENABLE_OPERATION;
+                if (now_ns - sm->enabled_since_ns >= MS_TO_NS(SOEM_CIA402_STABLE_MS)) {
+                    sm->reset_attempts = 0;
+                    sm->backoff_ns = MS_TO_NS(SOEM_CIA402_BACKOFF_MIN_MS);
+                }
+            }
+            break;
+        case CIA402_STATE_QUICK_STOP_ACTIVE:
+            // Hold while requested, then leave through SWITCH_ON_DISABLED and enable again
+            sm->controlword = quick_stop ? CW_QUICK_STOP : CW_DISABLE_VOLTAGE;
+            break;
+        case CIA402_STATE_NOT_READY:
+        case CIA402_STATE_FAULT_REACTION_ACTIVE:
+        default:
+            sm->controlword = CW_DISABLE_VOLTAGE; // The drive moves on by itself
+            break;
+    }
+    return sm->controlword;
+}
+
+/**
+ * @brief Takes the oldest queued event (consumer side).
+ */
+int soem_cia402_poll_event(soem_cia402_event_t *event_out) {
+    unsigned int head = atomic_load_explicit(&event_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&event_tail, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+    *event_out = event_ring[head & (SOEM_CIA402_EVENT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&event_head, head + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Returns the number of events lost to a full queue.
+ */
+uint32_t soem_cia402_get_dropped_events(void) {
+    return atomic_load_explicit(&dropped_events, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns a short name for an event type.
+ */
+const char *soem_cia402_event_name(soem_cia402_event_type_t type) {
+    switch (type) {
+        case SOEM_CIA402_EVENT_STATE_CHANGED: return "state";
+        case SOEM_CIA402_EVENT_FAULT: return "fault";
+        case SOEM_CIA402_EVENT_FAULT_RESET: return "fault reset";
+        case SOEM_CIA402_EVENT_QUICK_STOP: return "quick stop";
+        case SOEM_CIA402_EVENT_ENABLED: return "enabled";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,98 @@
+// soem_cia402.h - Incremental CiA 402 drive state machine, stepped once per EtherCAT cycle
+//
+// soem_cia402_step() looks at the statusword of the frame just received and returns the
+// controlword for the next one: at most one transition is requested per cycle and nothing
+// blocks, so the cyclic loop keeps its timing while a drive is brought up or recovers.
+// A fault is reset with a controlword bit 7 pulse, retried with exponential backoff while
+// the drive stays in FAULT. A quick stop request takes the drive out of OPERATION_ENABLED
+// through QUICK_STOP_ACTIVE; once released the drive is enabled again like at startup.
+// State changes are queued as events for a non real-time consumer.
+#ifndef SOEM_CIA402_H
+#define SOEM_CIA402_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "soem_interface.h"
+
+#define SOEM_CIA402_RESET_PULSE_MS      5      // Bit 7 held high per fault reset attempt
+#define SOEM_CIA402_BACKOFF_MIN_MS      20     // Delay before the first fault reset
+#define SOEM_CIA402_BACKOFF_MAX_MS      2000   // Backoff doubles per failed attempt up to this
+#define SOEM_CIA402_STABLE_MS           1000   // Enabled this long: the next fault starts a fresh backoff
+
+// Event ring capacity (power of two), single producer (EtherCAT thread), single consumer
+#define SOEM_CIA402_EVENT_QUEUE_SIZE    64
+
+typedef enum {
+    SOEM_CIA402_EVENT_STATE_CHANGED = 0,   // The drive reported a different state
+    SOEM_CIA402_EVENT_FAULT,               // Entered FAULT, a reset is scheduled
+    SOEM_CIA402_EVENT_FAULT_RESET,         // Fault reset pulse sent
+    SOEM_CIA402_EVENT_QUICK_STOP,          // Quick stop commanded
+    SOEM_CIA402_EVENT_ENABLED              // Reached OPERATION_ENABLED (startup or recovery)
+} soem_cia402_event_type_t;
+
+typedef struct {
+    uint64_t time_ns;                // CLOCK_MONOTONIC time of the cycle
+    uint16_t slave;                  // 1-based slave index
+    uint16_t statusword;
+    uint8_t type;                    // soem_cia402_event_type_t
+    uint8_t state;                   // cia402_state_t after the event
+    uint8_t previous_state;          // cia402_state_t before it (STATE_CHANGED)
+    uint32_t reset_attempts;         // Fault resets since the drive was last stably enabled
+} soem_cia402_event_t;
+
+// Per-drive state. Everything except quick_stop_request is owned by the stepping thread.
+typedef struct {
+    uint16_t slave;
+    cia402_state_t state;            // As reported by the last statusword
+    uint16_t controlword;            // Controlword for the next frame
+    _Atomic int quick_stop_request;  // Set from any thread with soem_cia402_request_quick_stop()
+    int quick_stop_sent;
+    uint32_t reset_attempts;
+    uint64_t backoff_ns;
+    uint64_t next_reset_ns;          // Earliest time of the next fault reset pulse
+    uint64_t pulse_end_ns;           // Bit 7 goes low again at this time
+    uint64_t enabled_since_ns;
+    int started;
+} soem_cia402_t;
+
+/**
+ * @brief Prepares the state machine of one drive; the first step only observes its state.
+ * @param sm State machine to initialize.
+ * @param slave The index of the slave (1-based), reported in events.
+ */
+void soem_cia402_init(soem_cia402_t *sm, uint16_t slave);
+
+/**
+ * @brief Advances the state machine with the statusword of the frame just received.
+ *        Only one thread may step a given state machine (the EtherCAT thread).
+ * @param sm State machine of the drive.
+ * @param statusword 0x6041 from this cycle's inputs.
+ * @param now_ns CLOCK_MONOTONIC time of the cycle.
+ * @return Controlword (0x6040) to send in the next frame.
+ */
+uint16_t soem_cia402_step(soem_cia402_t *sm, uint16_t statusword, uint64_t now_ns);
+
+/**
+ * @brief Requests or releases a quick stop. Safe to call from any thread.
+ */
+static inline void soem_cia402_request_quick_stop(soem_cia402_t *sm, int active) {
+    atomic_store_explicit(&sm->quick_stop_request, active ? 1 : 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Takes the oldest queued event (consumer side, one thread only).
+ * @return 1 if an event was returned, 0 if the queue is empty.
+ */
+int soem_cia402_poll_event(soem_cia402_event_t *event_out);
+
+/**
+ * @brief Returns the number of events lost to a full queue.
+ */
+uint32_t soem_cia402_get_dropped_events(void);
+
+/**
+ * @brief Returns a short name for an event type.
+ */
+const char *soem_cia402_event_name(soem_cia402_event_type_t type);
+
+#endif // SOEM_CIA402_H
@@ -0,0 +1,124 @@
+// soem_config_cache.c - Verified drive configuration kept across restarts
+#include "soem_config_cache.h"
+#include <stdio.h>
+#include <string.h>
+
+static soem_config_cache_entry_t entries[SOEM_CONFIG_CACHE_MAX_ENTRIES];
+static int entry_count = 0;
+
+static int same_drive(const soem_config_cache_entry_t *a, const soem_config_cache_entry_t *b) {
+    return a->vendor == b->vendor && a->product == b->product && a->revision == b->revision && a->serial == b->serial;
+}
+
+static int find_drive(const soem_config_cache_entry_t *key) {
+    for (int i = 0; i < entry_count; i++) {
+        if (same_drive(&entries[i], key)) return i;
+    }
+    return -1;
+}
+
+// One drive per line: identity and signature in hex, then output/input bytes and offsets
+static int parse_entry(const char *line, soem_config_cache_entry_t *entry) {
+    int consumed = 0;
+    if (sscanf(line, "%x %x %x %x %x %u %u%n", &entry->vendor, &entry->product, &entry->revision, &entry->serial,
+               &entry->signature, &entry->output_bytes, &entry->input_bytes, &consumed) != 7) {
+        return -1;
+    }
+    line += consumed;
+    for (int i = 0; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        if (sscanf(line, "%d%n", &entry->offset[i], &consumed) != 1) return -1;
+        line += consumed;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the cache file.
+ */
+int soem_config_cache_load(const char *path) {
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    entry_count = 0;
+    if (!f) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f) && entry_count < SOEM_CONFIG_CACHE_MAX_ENTRIES) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (parse_entry(line, &entries[entry_count]) != 0) {
+            printf("SOEM_ConfigCache: Ignoring malformed line in %s\n", path);
+            continue;
+        }
+        entry_count++;
+    }
+    fclose(f);
+    return entry_count;
+}
+
+/**
+ * @brief Looks up the drive identified by key's vendor, product, revision and serial.
+ */
+int soem_config_cache_find(const soem_config_cache_entry_t *key, soem_config_cache_entry_t *entry_out) {
+    int i = find_drive(key);
+    if (i < 0 || entries[i].signature != key->signature) {
+        return 0;
+    }
+    *entry_out = entries[i];
+    return 1;
+}
+
+// Write a new file and rename it over the old one, so a crash never leaves half a cache
+static int write_file(const char *path) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        perror("SOEM_ConfigCache: Cannot write the drive configuration cache");
+        return -1;
+    }
+    fprintf(f, "# Drive configuration cache: vendor product revision serial signature output_bytes input_bytes"
+               " PDO offsets (%d)\n", SOEM_PDO_OBJECT_COUNT);
+    for (int e = 0; e < entry_count; e++) {
+        const soem_config_cache_entry_t *c = &entries[e];
+        fprintf(f, "%08x %08x %08x %08x %08x %u %u", c->vendor, c->product, c->revision, c->serial,
+                c->signature, c->output_bytes, c->input_bytes);
+        for (int o = 0; o < SOEM_PDO_OBJECT_COUNT; o++) {
+            fprintf(f, " %d", c->offset[o]);
+        }
+        fputc('\n', f);
+    }
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0) {
+        perror("SOEM_ConfigCache: Cannot write the drive configuration cache");
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds or replaces the entry of a drive and rewrites the cache file.
+ */
+int soem_config_cache_store(const char *path, const soem_config_cache_entry_t *entry) {
+    int i = find_drive(entry);
+    if (i < 0) {
+        if (entry_count == SOEM_CONFIG_CACHE_MAX_ENTRIES) {
+            // Full: the oldest entry goes
+            memmove(&entries[0], &entries[1], (SOEM_CONFIG_CACHE_MAX_ENTRIES - 1) * sizeof(entries[0]));
+            entry_count--;
+        }
+        i = entry_count++;
+    }
+    entries[i] = *entry;
+    return write_file(path);
+}
+
+/**
+ * @brief Drops the entry of a drive and rewrites the cache file.
+ */
+int soem_config_cache_forget(const char *path, const soem_config_cache_entry_t *key) {
+    int i = find_drive(key);
+    if (i < 0) return 0;
+    memmove(&entries[i], &entries[i + 1], (size_t)(entry_count - i - 1) * sizeof(entries[0]));
+    entry_count--;
+    return write_file(path);
+}
@@ -0,0 +1,75 @@
+// soem_config_cache.h - Verified drive configuration kept across restarts
+//
+// Bringing a drive up costs dozens of SDO round trips: PDO remapping, the mapping readback
+// and the CiA 402 parameters. Drives keep these settings while powered, so after a drive
+// was configured once its identity (vendor, product, revision, serial number) is stored
+// together with a signature of the configuration written and the PDO layout read back.
+// On the next start a drive with a matching entry and signature skips the layout readback.
+// Its mapping and parameters are still read back and only the values that differ are
+// written, since a power cycle or another tool may have changed them (see soem_interface.c).
+// The header does not depend on SOEM.
+#ifndef SOEM_CONFIG_CACHE_H
+#define SOEM_CONFIG_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "soem_pdo.h"
+
+#define SOEM_CONFIG_CACHE_PATH          "ffb_drive_cache.txt"   // Default, relative to the working directory
+#define SOEM_CONFIG_CACHE_MAX_ENTRIES   16
+#define SOEM_CONFIG_CACHE_HASH_INIT     2166136261u             // FNV-1a offset basis
+
+typedef struct {
+    uint32_t vendor;                            // EEPROM vendor ID (eep_man)
+    uint32_t product;                           // EEPROM product code (eep_id)
+    uint32_t revision;                          // EEPROM revision (eep_rev)
+    uint32_t serial;                            // 0x1018:04, 0 if the drive does not report one
+    uint32_t signature;                         // Hash of the parameters and PDO table written
+    uint32_t output_bytes;                      // Process data sizes the layout was read back with
+    uint32_t input_bytes;
+    int32_t offset[SOEM_PDO_OBJECT_COUNT];      // soem_pdo_layout_t offsets
+} soem_config_cache_entry_t;
+
+/**
+ * @brief Reads the cache file. A missing or unreadable file leaves the cache empty.
+ * @param path Cache file.
+ * @return Number of entries loaded.
+ */
+int soem_config_cache_load(const char *path);
+
+/**
+ * @brief Looks up the drive identified by key's vendor, product, revision and serial.
+ * @param key Drive identity and the signature of the configuration it should have.
+ * @param entry_out Filled in with the stored entry when it is found.
+ * @return 1 if an entry with the same identity and signature exists, 0 otherwise.
+ */
+int soem_config_cache_find(const soem_config_cache_entry_t *key, soem_config_cache_entry_t *entry_out);
+
+/**
+ * @brief Adds or replaces the entry of a drive (same identity) and rewrites the cache file.
+ * @param path Cache file.
+ * @param entry Verified configuration of the drive.
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int soem_config_cache_store(const char *path, const soem_config_cache_entry_t *entry);
+
+/**
+ * @brief Drops the entry of a drive whose cached configuration turned out to be stale and
+ *        rewrites the cache file.
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int soem_config_cache_forget(const char *path, const soem_config_cache_entry_t *key);
+
+/**
+ * @brief Extends an FNV-1a hash over size bytes; start from SOEM_CONFIG_CACHE_HASH_INIT.
+ */
+static inline uint32_t soem_config_cache_hash(uint32_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#endif // SOEM_CONFIG_CACHE_H
@@ -1,5 +1,16 @@
 // soem_interface.c - Fixed for Synapticon 14-bit absolute encoder
 #include "soem_interface.h" 
+#include "rt_seqlock.h"
+#include "rt_clock.h"
+#include "rt_histogram.h"
+#include "rt_log.h"
+#include "rt_threads.h"
+#include "soem_nic.h"
+#include "soem_pdo.h"
+#include "soem_cia402.h"
+#include "soem_mailbox.h"
+#include "soem_config_cache.h"
+#include "ffb_e2e.h"
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
@@ -8,15 +19,12 @@
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <stdatomic.h>
 
 // --- SOEM Library Includes ---
 #include "ethercat.h"  
 #include "ethercattype.h" 
 
-#ifndef PACKED
-#define PACKED __attribute__((__packed__))
-#endif
-
 // --- CiA 402 State Machine Definitions ---
 #define CIA402_STATUSWORD_RTSO          0x0001  // Ready to switch on
 #define CIA402_STATUSWORD_SO            0x0002  // Switched on
@@ -49,34 +57,106 @@ ec_groupt DCgroup;
 int wkc;
 int expectedWKC;
 ec_timet tmo;
-// Cycle time matches main loop (100Hz = 10ms)
-int cycle_time = 10000; // 10 ms in microseconds
-
-// Use minimal essential mapping to avoid size issues
-uint32_t rxpdo_mapping[] = {
-    0x60400010,  // Controlword (16-bit)
-    0x60600008,  // Modes of operation (8-bit)
-    0x60710010,  // Target torque (16-bit)
-    0x607A0020   // Target position (32-bit)
-    };
-    
-uint32_t txpdo_mapping[] = {
-    0x60410010,  // Statusword (16-bit)
-    0x60610008,  // Modes of operation display (8-bit)
-    0x60640020,  // Position actual value (32-bit) - This gives us the 14-bit encoder data
-    0x60770010   // Torque actual value (16-bit)
-    };
-    
-    // Calculate and verify sizes
-    uint16_t rxpdo_size_bits = 16 + 8 + 16 + 32; // 72 bits = 9 bytes
-    uint16_t txpdo_size_bits = 16 + 8 + 32 + 16; // 72 bits = 9 bytes
-
-// Pointers to the PDO data in the IOmap
-somanet_rx_pdo_enhanced_t *somanet_outputs; 
-somanet_tx_pdo_enhanced_t *somanet_inputs; 
-
-// Mutex for protecting PDO data access
-static pthread_mutex_t pdo_mutex = PTHREAD_MUTEX_INITIALIZER;
+// EtherCAT cycle time in microseconds (selectable 250us - 1ms)
+int cycle_time = SOEM_CYCLE_TIME_DEFAULT_US;
+
+// One entry per slave on the bus, all exchanged in the same frame. Drives (CiA 402) have a
+// PDO layout read back from the drive (soem_pdo.h), a state machine and their own wait-free
+// channels: feedback is published through a seqlock, the torque command is a single atomic
+// slot with a counter of the commands written, which the output stage (ffb_output.h) ramps
+// between. Other slaves (I/O terminals) publish a copy of their inputs.
+typedef struct {
+    uint16_t slave;                     // SOEM slave index (1-based)
+    soem_axis_kind_t kind;
+    soem_pdo_layout_t layout;           // Drives
+    int layout_valid;
+    soem_cia402_t drive_sm;             // Stepped by the EtherCAT thread every cycle
+    uint16_t statusword;
+    _Atomic ffb_torque_t target_torque; // Engine units
+    atomic_uint torque_updates;         // Incremented after every new target_torque
+    atomic_uint engine_updates;         // Only the engine's commands: the supervisor's deadline
+    ffb_output_t output;                // Drives: stepped by the EtherCAT thread every cycle
+    atomic_uint max_torque;             // Drives: 0x6072 as last written, per mille
+    uint32_t scale_max_torque;          // 0x6072 and full scale generation per_mille_scale is for
+    uint32_t scale_generation;
+#if FFB_FIXED_POINT
+    int32_t per_mille_scale;            // 0x6071 per mille per engine torque unit, Q16
+#else
+    float per_mille_scale;              // 0x6071 per mille per engine torque unit
+#endif
+    rt_seqlock_t lock;                  // Protects snapshot and io_inputs
+    soem_pdo_snapshot_t snapshot;
+    uint8_t io_inputs[SOEM_AXIS_IO_BYTES];
+    uint32_t io_input_bytes;
+    soem_config_cache_entry_t config;   // Drives: identity, signature and layout for the cache
+    int config_cached;                  // Cached PDO layout applies: skip the layout readback
+    int config_verified;                // Configured in full without errors: store in the cache
+} soem_axis_t;
+
+static soem_axis_t axes[SOEM_MAX_AXES];
+static int axis_count = 0;
+static soem_axis_t *wheel = NULL;       // First drive on the bus; the single-axis API refers to it
+static uint32_t ecat_cycle_count = 0;
+
+// Output stage, safety and torque scale configuration, written by the engine side, taken over
+// by the EtherCAT thread
+static rt_seqlock_t cycle_config_lock = RT_SEQLOCK_INIT;
+static ffb_output_config_t output_config = FFB_OUTPUT_CONFIG_DEFAULT;
+static soem_safety_config_t safety_config = SOEM_SAFETY_CONFIG_DEFAULT;
+static float torque_full_scale = SOEM_TORQUE_FULL_SCALE_DEFAULT;
+// The EtherCAT thread's copy; the generation tells the drives to recompute their scale
+static float applied_full_scale = SOEM_TORQUE_FULL_SCALE_DEFAULT;
+static uint32_t full_scale_generation = 1;
+
+// Safety supervisor, stepped by the EtherCAT thread every cycle
+static soem_safety_t safety;
+static _Atomic(uint64_t (*)(void)) host_activity_source = NULL;
+static atomic_int quick_stop_requested = 0;    // soem_interface_request_quick_stop()
+
+// Feedback timestamp behind the current torque command, for the encoder-to-torque delay
+static _Atomic uint64_t latest_sample_ns = 0;
+static _Atomic uint64_t torque_sample_ns = 0;
+
+// Cycle timing, recorded by the EtherCAT thread only
+static rt_histogram_t *hist_wakeup_late;    // Wakeup after the scheduled cycle start
+static rt_histogram_t *hist_roundtrip;      // ec_send_processdata() to ec_receive_processdata() return
+static rt_histogram_t *hist_callback;       // Inline engine
+static rt_histogram_t *hist_cycle_work;     // Wakeup to the end of the cycle's work
+static rt_histogram_t *hist_encoder_torque; // Feedback sample to the frame carrying its torque
+static rt_histogram_t *hist_wkc_burst;      // Consecutive cycles with a low working counter
+static rt_histogram_t *hist_probe_roundtrip; // Frame round trip of the first cycles, reported once
+
+#define ROUND_TRIP_PROBE_FRAMES 1000
+static int nic_tuning_enabled = 1;
+static int config_cache_enabled = 1;
+
+// AL state polling: short intervals first, growing while a transition takes longer
+#define STATE_POLL_MIN_US           500
+#define STATE_POLL_MAX_US           20000
+#define STATE_TIMEOUT_FIRST_US      250000  // First attempt; doubles per retry
+#define STATE_MAX_RETRIES           4
+
+// Cycles the new EtherCAT thread must publish before startup continues
+#define ECAT_STARTUP_CYCLES         10
+#define ECAT_STARTUP_TIMEOUT_MS     100
+
+// Modes of operation display is polled after the parameters until it shows the new mode
+#define MODE_SETTLE_TIMEOUT_MS      100
+#define MODE_POLL_US                2000
+
+// Startup phases, printed as a table once the master runs
+#define STARTUP_MAX_PHASES 16
+static struct {
+    const char *name;
+    uint64_t duration_ns;
+} startup_phases[STARTUP_MAX_PHASES];
+static int startup_phase_count = 0;
+static uint64_t startup_start_ns = 0;
+static uint64_t phase_start_ns = 0;
+
+// Optional engine callback run inside the cycle (inline mode)
+static _Atomic(soem_cycle_callback_t) cycle_callback = NULL;
+static void *cycle_callback_data = NULL;
 
 // Thread for EtherCAT communication
 static pthread_t ecat_thread;
@@ -84,13 +164,11 @@ static volatile int ecat_thread_running = 0;
 static volatile int master_initialized = 0;
 static volatile int communication_ok = 0;
 
-// Global variables to hold current PDO values
-static float target_torque_f = 0.0f;
-static float current_position_f = 0.0f;
-static float current_velocity_f = 0.0f;
-static cia402_state_t current_cia402_state = CIA402_STATE_NOT_READY;
-static uint16_t current_statusword = 0;
-static uint16_t current_controlword = 0;
+// Distributed clock synchronization state
+static int dc_sync_enabled = 1;
+static int dc_sync_active = 0;
+static int64_t dc_integral = 0;
+static volatile int64_t dc_sync_error_ns = 0;
 
 // --- CiA 402 State Machine Functions ---
 cia402_state_t get_cia402_state(uint16_t statusword) {
@@ -161,104 +239,316 @@ uint16_t get_cia402_controlword_for_transition(cia402_state_t current_state, cia
     return 0x0006;
 }
 
-// Function to initialize CiA 402 parameters via SDO - CONFIGURED FOR SYNAPTICON
-int initialize_cia402_parameters(uint16_t slave_idx) {
-    printf("SOEM_Interface: Initializing CiA 402 parameters for Synapticon 14-bit encoder...\n");
-    
-    // Set modes of operation to torque mode (4)
-    int8_t torque_mode = 4;
-    if (soem_interface_write_sdo(slave_idx, 0x6060, 0x00, sizeof(torque_mode), &torque_mode) != 0) {
-        fprintf(stderr, "SOEM_Interface: Failed to set modes of operation to torque mode\n");
-        return -1;
+#if FFB_FIXED_POINT
+// Q15.16 engine torque to 0x6071 per mille: one multiply by the Q16 scale, rounded and
+// saturated to the INTEGER16 range
+static int16_t torque_to_per_mille(ffb_torque_t torque, int32_t per_mille_scale) {
+    int64_t per_mille = ((int64_t)torque * per_mille_scale + ((int64_t)1 << 31)) >> 32;
+    if (per_mille > 32767) return 32767;
+    if (per_mille < -32767) return -32767;
+    return (int16_t)per_mille;
+}
+#else
+// Engine torque to 0x6071 per mille, saturated to the INTEGER16 range
+static int16_t torque_to_per_mille(float torque, float per_mille_scale) {
+    float per_mille = torque * per_mille_scale;
+    if (isnan(per_mille)) return 0;
+    if (per_mille > 32767.0f) return 32767;
+    if (per_mille < -32767.0f) return -32767;
+    return (int16_t)per_mille;
+}
+#endif
+
+// Full scale engine torque is sent as the drive's 0x6072; recomputed only when either changes
+static void update_torque_scale(soem_axis_t *axis) {
+    uint32_t max_torque = atomic_load_explicit(&axis->max_torque, memory_order_relaxed);
+    if (max_torque == axis->scale_max_torque && full_scale_generation == axis->scale_generation) return;
+    float scale = (float)max_torque / applied_full_scale;
+#if FFB_FIXED_POINT
+    axis->per_mille_scale = ffb_fixed_from_float(scale, FFB_Q16_SHIFT);
+#else
+    axis->per_mille_scale = scale;
+#endif
+    axis->scale_max_torque = max_torque;
+    axis->scale_generation = full_scale_generation;
+}
+
+// --- Cycle timing helpers ---
+static int8_t get_operation_mode(void) {
+    return dc_sync_active ? SOEM_MODE_CYCLIC_SYNC_TORQUE : 4; // CST or profile torque
+}
+
+// Express the cycle time as 0x60C2 period (uint8) * 10^index seconds
+static void get_interpolation_time(int cycle_time_us, uint8_t *period, int8_t *index) {
+    int value = cycle_time_us;
+    int8_t exponent = -6;
+
+    while (value > 255 || (value % 10 == 0 && exponent < -3)) {
+        value /= 10;
+        exponent++;
     }
-    printf("SOEM_Interface: Set modes of operation to torque mode (4)\n");
-    
-    // Set motor rated current (example: 3000 mA = 3A)
-    // Adjust this value according to your motor specifications
-    uint32_t motor_rated_current = 3000; // mA
-    if (soem_interface_write_sdo(slave_idx, 0x6075, 0x00, sizeof(motor_rated_current), &motor_rated_current) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set motor rated current (may not be supported)\n");
-    } else {
-        printf("SOEM_Interface: Set motor rated current to %u mA\n", motor_rated_current);
+    *period = (uint8_t)value;
+    *index = exponent;
+}
+
+static void timespec_add_ns(struct timespec *ts, int64_t ns) {
+    int64_t total = (int64_t)ts->tv_nsec + ns;
+    ts->tv_sec += total / 1000000000L;
+    total %= 1000000000L;
+    if (total < 0) {
+        total += 1000000000L;
+        ts->tv_sec--;
     }
-    
-    // Set max torque (example: 1000 per mille = 100% of rated torque)
-    uint16_t max_torque = 1000; // per mille
-    if (soem_interface_write_sdo(slave_idx, 0x6072, 0x00, sizeof(max_torque), &max_torque) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set max torque\n");
-    } else {
-        printf("SOEM_Interface: Set max torque to %u per mille\n", max_torque);
+    ts->tv_nsec = total;
+}
+
+// PI controller locking the master wakeup phase to the DC reference clock.
+// Returns the correction (ns) to add to the next wakeup time.
+static int64_t dc_sync_pi(int64_t reftime, int64_t cycle_ns) {
+    int64_t delta = (reftime - SOEM_DC_MASTER_SHIFT_NS) % cycle_ns;
+    if (delta > cycle_ns / 2) {
+        delta -= cycle_ns;
     }
-    
-    // Set torque slope (acceleration/deceleration limit)
-    uint32_t torque_slope = 10000;
-    if (soem_interface_write_sdo(slave_idx, 0x6087, 0x00, sizeof(torque_slope), &torque_slope) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set torque slope\n");
-    } else {
-        printf("SOEM_Interface: Set torque slope to %u per mille/s\n", torque_slope);
+
+    dc_integral += delta;
+    // Anti-windup: limit the integral correction to a quarter cycle
+    int64_t integral_limit = (cycle_ns / 4) * SOEM_DC_PI_KI_DIV;
+    if (dc_integral > integral_limit) dc_integral = integral_limit;
+    if (dc_integral < -integral_limit) dc_integral = -integral_limit;
+
+    dc_sync_error_ns = delta;
+    return -(delta / SOEM_DC_PI_KP_DIV) - (dc_integral / SOEM_DC_PI_KI_DIV);
+}
+
+// --- Startup phase timing ---
+static void startup_phase_begin(void) {
+    startup_phase_count = 0;
+    startup_start_ns = rt_clock_now_ns();
+    phase_start_ns = startup_start_ns;
+}
+
+// Closes the running phase under name and starts the next one
+static void startup_phase_end(const char *name) {
+    uint64_t now_ns = rt_clock_now_ns();
+    if (startup_phase_count < STARTUP_MAX_PHASES) {
+        startup_phases[startup_phase_count].name = name;
+        startup_phases[startup_phase_count].duration_ns = now_ns - phase_start_ns;
+        startup_phase_count++;
     }
-    
-    // **SYNAPTICON-SPECIFIC: Set encoder resolution to match 14-bit encoder**
-    // Set position encoder resolution (16384 increments per revolution for 14-bit)
-    uint32_t encoder_increments = 65536.0f; // 2^16 = 65536.0 for 16-bit encoder
-    if (soem_interface_write_sdo(slave_idx, 0x608F, 0x01, sizeof(encoder_increments), &encoder_increments) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set encoder increments (may use internal default)\n");
-    } else {
-        printf("SOEM_Interface: Set encoder increments to %u per revolution (14-bit)\n", encoder_increments);
+    phase_start_ns = now_ns;
+}
+
+static void print_startup_phases(void) {
+    printf("SOEM_Interface: Startup phases:\n");
+    for (int i = 0; i < startup_phase_count; i++) {
+        printf("  %-28s %8.1f ms\n", startup_phases[i].name, startup_phases[i].duration_ns / 1e6);
     }
-    
-    // Set gear ratio to 1:1 (direct drive)
-    uint32_t gear_ratio_num = 1;   // Numerator
-    uint32_t gear_ratio_den = 1;   // Denominator
-    if (soem_interface_write_sdo(slave_idx, 0x608F, 0x02, sizeof(gear_ratio_num), &gear_ratio_num) != 0) {
-        printf("SOEM_Interface: Info: Gear ratio numerator setting not available\n");
-    } else {
-        printf("SOEM_Interface: Set gear ratio numerator to %u\n", gear_ratio_num);
+    printf("  %-28s %8.1f ms\n", "total", (rt_clock_now_ns() - startup_start_ns) / 1e6);
+}
+
+// One startup parameter. Records with several entries of equal size are written with a
+// single complete access transfer when the slave supports it.
+typedef struct {
+    uint16_t index;
+    uint8_t subindex;           // First subindex
+    uint8_t entries;            // Consecutive subindices
+    uint16_t size;              // Bytes of all entries
+    const void *value;
+    const char *name;
+    int required;               // 0: a failure is only a warning
+} cia402_param_t;
+
+#define CIA402_PARAM_MAX_ENTRIES 2
+
+// Queues the writes of one parameter: one transfer, or one per entry
+static int queue_param_write(uint16_t slave_idx, const cia402_param_t *param, int complete_access,
+                             soem_mailbox_future_t *futures) {
+    if (param->entries == 1 || complete_access) {
+        return soem_mailbox_sdo_write(slave_idx, param->index, param->subindex, param->entries > 1,
+                                      param->value, param->size, &futures[0], NULL, NULL) == 0 ? 1 : 0;
     }
-    
-    // Set interpolation time period (for smoother operation)
-    uint8_t interpolation_time_period = 10; // 10ms to match our cycle time
-    int8_t interpolation_time_index = -3;  // 10^-3 seconds (milliseconds)
-    if (soem_interface_write_sdo(slave_idx, 0x60C2, 0x01, sizeof(interpolation_time_period), &interpolation_time_period) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set interpolation time period\n");
-    } else {
-        printf("SOEM_Interface: Set interpolation time period to %u ms\n", interpolation_time_period);
+    uint16_t entry_size = param->size / param->entries;
+    int queued = 0;
+    for (uint8_t e = 0; e < param->entries; e++) {
+        if (soem_mailbox_sdo_write(slave_idx, param->index, param->subindex + e, 0,
+                                   (const uint8_t *)param->value + e * entry_size, entry_size, &futures[e], NULL, NULL) != 0) {
+            break;
+        }
+        queued++;
     }
-    
-    if (soem_interface_write_sdo(slave_idx, 0x60C2, 0x02, sizeof(interpolation_time_index), &interpolation_time_index) != 0) {
-        printf("SOEM_Interface: Warning: Failed to set interpolation time index\n");
-    } else {
-        printf("SOEM_Interface: Set interpolation time index to %d\n", interpolation_time_index);
+    return queued;
+}
+
+// Queues one read per entry of a parameter. Entries are read one by one so the data compares
+// directly with the value, whatever the slave's complete access support.
+static int queue_param_read(uint16_t slave_idx, const cia402_param_t *param, soem_mailbox_future_t *futures) {
+    uint16_t entry_size = param->size / param->entries;
+    int queued = 0;
+    for (uint8_t e = 0; e < param->entries; e++) {
+        if (soem_mailbox_sdo_read(slave_idx, param->index, param->subindex + e, 0, entry_size,
+                                  &futures[e], NULL, NULL) != 0) {
+            break;
+        }
+        queued++;
     }
-    
-    // Wait for parameters to be processed
-    usleep(100000); // 100ms delay
-    
-    // Verify modes of operation was set correctly
+    return queued;
+}
+
+// Values written at startup; cia402_param_t entries point into it
+typedef struct {
+    int8_t torque_mode;
+    uint32_t motor_rated_current;
+    uint16_t max_torque;
+    uint32_t torque_slope;
+    uint32_t encoder_resolution[2];
+    int8_t interpolation_time[2];
+} cia402_config_t;
+
+#define CIA402_PARAM_COUNT 6
+
+// Fills in the startup values and the parameter table that writes them - CONFIGURED FOR SYNAPTICON
+static void get_cia402_params(cia402_config_t *config, cia402_param_t *params) {
+    // Modes of operation: CST (10) when DC-synchronized, profile torque (4) otherwise
+    config->torque_mode = get_operation_mode();
+    config->motor_rated_current = 3000;                 // mA, adjust to the motor
+    config->max_torque = SOEM_MAX_TORQUE_DEFAULT;       // Per mille of rated torque
+    config->torque_slope = SOEM_TORQUE_SLOPE_DEFAULT;   // Per mille per second
+    // 0x608F position encoder resolution: 2^16 increments per motor revolution (direct drive)
+    config->encoder_resolution[0] = 65536;
+    config->encoder_resolution[1] = 1;
+    // 0x60C2 interpolation time: period and index matching our cycle time
+    get_interpolation_time(cycle_time, (uint8_t *)&config->interpolation_time[0], &config->interpolation_time[1]);
+
+    const cia402_param_t table[CIA402_PARAM_COUNT] = {
+        { 0x6060, 0x00, 1, sizeof(config->torque_mode), &config->torque_mode, "modes of operation", 1 },
+        { 0x6075, 0x00, 1, sizeof(config->motor_rated_current), &config->motor_rated_current, "motor rated current", 0 },
+        { 0x6072, 0x00, 1, sizeof(config->max_torque), &config->max_torque, "max torque", 0 },
+        { 0x6087, 0x00, 1, sizeof(config->torque_slope), &config->torque_slope, "torque slope", 0 },
+        { 0x608F, 0x01, 2, sizeof(config->encoder_resolution), config->encoder_resolution, "position encoder resolution", 0 },
+        { 0x60C2, 0x01, 2, sizeof(config->interpolation_time), config->interpolation_time, "interpolation time", 0 },
+    };
+    memcpy(params, table, sizeof(table));
+}
+
+// Hash of everything a drive is configured with at startup: the parameters and the PDO table
+static uint32_t drive_config_signature(void) {
+    cia402_config_t config;
+    cia402_param_t params[CIA402_PARAM_COUNT];
+    uint32_t hash = SOEM_CONFIG_CACHE_HASH_INIT;
+
+    get_cia402_params(&config, params);
+    for (int p = 0; p < CIA402_PARAM_COUNT; p++) {
+        hash = soem_config_cache_hash(hash, &params[p].index, sizeof(params[p].index));
+        hash = soem_config_cache_hash(hash, &params[p].subindex, sizeof(params[p].subindex));
+        hash = soem_config_cache_hash(hash, params[p].value, params[p].size);
+    }
+    return soem_pdo_signature(hash);
+}
+
+// Function to initialize CiA 402 parameters via SDO
+int initialize_cia402_parameters(uint16_t slave_idx) {
+    printf("SOEM_Interface: Initializing CiA 402 parameters of slave %u...\n", slave_idx);
+
+    cia402_config_t config;
+    cia402_param_t params[CIA402_PARAM_COUNT];
+    get_cia402_params(&config, params);
+    const int param_count = CIA402_PARAM_COUNT;
+    soem_mailbox_future_t futures[CIA402_PARAM_COUNT][CIA402_PARAM_MAX_ENTRIES];
+    int queued[CIA402_PARAM_COUNT];
+    int matches[CIA402_PARAM_COUNT];
+    int complete_access = (ec_slave[slave_idx].CoEdetails & ECT_COEDET_SDOCA) != 0;
+    int result = 0;
+
+    // Read everything back and write only what differs: a power cycle or another tool may
+    // have changed any parameter. Queue everything first: the worker runs the transfers back to back.
+    for (int p = 0; p < param_count; p++) {
+        queued[p] = queue_param_read(slave_idx, &params[p], futures[p]);
+    }
+    for (int p = 0; p < param_count; p++) {
+        uint16_t entry_size = params[p].size / params[p].entries;
+        matches[p] = queued[p] == params[p].entries;
+        for (int e = 0; e < queued[p]; e++) {
+            if (soem_mailbox_wait(&futures[p][e], -1) != 0 || futures[p][e].size != entry_size ||
+                memcmp(futures[p][e].data, (const uint8_t *)params[p].value + e * entry_size, entry_size) != 0) {
+                matches[p] = 0;
+            }
+        }
+    }
+
+    for (int p = 0; p < param_count; p++) {
+        queued[p] = matches[p] ? 0 : queue_param_write(slave_idx, &params[p], complete_access, futures[p]);
+    }
+
+    for (int p = 0; p < param_count; p++) {
+        if (matches[p]) {
+            printf("SOEM_Interface: %s (0x%04X) already set\n", params[p].name, params[p].index);
+            continue;
+        }
+        int ok = queued[p] == ((params[p].entries == 1 || complete_access) ? 1 : params[p].entries);
+        for (int e = 0; e < queued[p]; e++) {
+            if (soem_mailbox_wait(&futures[p][e], -1) != 0) ok = 0;
+        }
+        if (!ok && complete_access && params[p].entries > 1) {
+            // Some drives list complete access but refuse it for single objects
+            printf("SOEM_Interface: Complete access to 0x%04X refused, writing its entries one by one\n", params[p].index);
+            ok = 1;
+            int retried = queue_param_write(slave_idx, &params[p], 0, futures[p]);
+            for (int e = 0; e < retried; e++) {
+                if (soem_mailbox_wait(&futures[p][e], -1) != 0) ok = 0;
+            }
+            if (retried != params[p].entries) ok = 0;
+        }
+
+        if (ok) {
+            printf("SOEM_Interface: Set %s (0x%04X)\n", params[p].name, params[p].index);
+        } else if (params[p].required) {
+            fprintf(stderr, "SOEM_Interface: Failed to set %s (0x%04X)\n", params[p].name, params[p].index);
+            result = -1;
+        } else {
+            printf("SOEM_Interface: Warning: Failed to set %s (0x%04X, may not be supported)\n", params[p].name, params[p].index);
+            result = 1;
+        }
+    }
+    if (result < 0) {
+        return result;
+    }
+    printf("SOEM_Interface: Torque mode %d, max torque %u per mille, torque slope %u per mille/s, interpolation %u x 10^%d s\n",
+           config.torque_mode, config.max_torque, config.torque_slope,
+           (uint8_t)config.interpolation_time[0], config.interpolation_time[1]);
+
+    // The drive takes the new mode over asynchronously; poll the display until it does
     int8_t current_mode = 0;
-    if (soem_interface_read_sdo(slave_idx, 0x6061, 0x00, sizeof(current_mode), &current_mode) == 0) {
+    int mode_read = 0;
+    uint64_t settle_start_ns = rt_clock_now_ns();
+    do {
+        mode_read = soem_interface_read_sdo(slave_idx, 0x6061, 0x00, sizeof(current_mode), &current_mode) == 0;
+        if (!mode_read || current_mode == config.torque_mode) break;
+        usleep(MODE_POLL_US);
+    } while (rt_clock_now_ns() - settle_start_ns < (uint64_t)MODE_SETTLE_TIMEOUT_MS * 1000000ULL);
+
+    if (mode_read) {
         printf("SOEM_Interface: Current modes of operation display: %d\n", current_mode);
-        if (current_mode == torque_mode) {
-            printf("SOEM_Interface: Mode verification successful\n");
+        if (current_mode == config.torque_mode) {
+            printf("SOEM_Interface: Mode verification successful after %.1f ms\n",
+                   (rt_clock_now_ns() - settle_start_ns) / 1e6);
         } else {
-            printf("SOEM_Interface: Warning: Mode not yet active (expected %d, got %d)\n", torque_mode, current_mode);
+            printf("SOEM_Interface: Warning: Mode not yet active (expected %d, got %d)\n", config.torque_mode, current_mode);
         }
     } else {
         printf("SOEM_Interface: Warning: Could not verify modes of operation\n");
     }
-    
-    printf("SOEM_Interface: Synapticon 14-bit encoder initialization completed\n");
-    return 0;
+
+    printf("SOEM_Interface: CiA 402 parameters of slave %u initialized\n", slave_idx);
+    return result;
 }
 
-// --- Helper function to check if slave is in operational state ---
 int is_slave_operational(int slave_idx) {
     uint16 actual_state = ec_slave[slave_idx].state & 0x0F;
     return actual_state == EC_STATE_OPERATIONAL;
 }
 
 // --- Helper function to get readable state name ---
-const char* get_state_name(uint16 state) {
+const char* get_state_name(uint16_t state) {
     uint16 actual_state = state & 0x0F;
     switch(actual_state) {
         case EC_STATE_INIT: return "INIT";
@@ -273,6 +563,14 @@ const char* get_state_name(uint16 state) {
 // --- Helper functions for SDO operations ---
 int soem_interface_write_sdo(uint16_t slave_idx, uint16_t index, uint8_t subindex, uint16_t data_size, void *data) {
     int wkc_sdo;
+    // Once the mailbox worker runs it owns every mailbox transfer; wait for ours there
+    if (soem_mailbox_is_running()) {
+        soem_mailbox_future_t future;
+        if (soem_mailbox_sdo_write(slave_idx, index, subindex, 0, data, data_size, &future, NULL, NULL) != 0) {
+            return -1;
+        }
+        return soem_mailbox_wait(&future, -1);
+    }
     wkc_sdo = ec_SDOwrite(slave_idx, index, subindex, FALSE, data_size, data, 50000); // 50ms timeout
     if (wkc_sdo == 0) {
         fprintf(stderr, "SOEM_Interface: SDO write failed for slave %u, index 0x%04X:%02X\n", slave_idx, index, subindex);
@@ -284,6 +582,15 @@ int soem_interface_write_sdo(uint16_t slave_idx, uint16_t index, uint8_t subinde
 int soem_interface_read_sdo(uint16_t slave_idx, uint16_t index, uint8_t subindex, uint16_t data_size, void *data) {
     int wkc_sdo;
     int actual_size = data_size;
+    if (soem_mailbox_is_running()) {
+        soem_mailbox_future_t future;
+        if (soem_mailbox_sdo_read(slave_idx, index, subindex, 0, data_size, &future, NULL, NULL) != 0 ||
+            soem_mailbox_wait(&future, -1) != 0) {
+            return -1;
+        }
+        memcpy(data, future.data, future.size < data_size ? future.size : data_size);
+        return 0;
+    }
     wkc_sdo = ec_SDOread(slave_idx, index, subindex, FALSE, &actual_size, data, 50000); // 50ms timeout
     if (wkc_sdo == 0) {
         fprintf(stderr, "SOEM_Interface: SDO read failed for slave %u, index 0x%04X:%02X\n", slave_idx, index, subindex);
@@ -292,256 +599,525 @@ int soem_interface_read_sdo(uint16_t slave_idx, uint16_t index, uint8_t subindex
     return 0;
 }
 
+// Reads the AL state of all slaves; 1 if slave_idx (0: every slave) is in state without error
+static int slaves_in_state(uint16_t slave_idx, uint16_t state) {
+    ec_readstate();
+    if (slave_idx != 0) {
+        return ec_slave[slave_idx].state == state;
+    }
+    for (int i = 1; i <= ec_slavecount; i++) {
+        if (ec_slave[i].state != state) return 0;
+    }
+    return 1;
+}
+
+// Polls the AL state until slave_idx (0: all slaves) reports state or timeout_us passes.
+// The poll interval starts short and doubles, so a fast transition is seen within a fraction
+// of a millisecond. While exchange_pdo is set a frame goes out every cycle instead: drives
+// only enter OPERATIONAL once valid outputs arrive and their sync manager watchdog runs.
+static int wait_for_state(uint16_t slave_idx, uint16_t state, uint32_t timeout_us, int exchange_pdo) {
+    uint64_t start_ns = rt_clock_now_ns();
+    uint64_t timeout_ns = (uint64_t)timeout_us * 1000ULL;
+    uint32_t poll_us = exchange_pdo ? (uint32_t)cycle_time : STATE_POLL_MIN_US;
+
+    for (;;) {
+        if (exchange_pdo) {
+            ec_send_processdata();
+            ec_receive_processdata(EC_TIMEOUTRET);
+        }
+        if (slaves_in_state(slave_idx, state)) {
+            return 0;
+        }
+        uint64_t elapsed_ns = rt_clock_now_ns() - start_ns;
+        if (elapsed_ns >= timeout_ns) {
+            return -1;
+        }
+        uint64_t remaining_us = (timeout_ns - elapsed_ns) / 1000ULL;
+        usleep(poll_us < remaining_us ? poll_us : (uint32_t)remaining_us);
+        if (!exchange_pdo && poll_us < STATE_POLL_MAX_US) {
+            poll_us *= 2;
+            if (poll_us > STATE_POLL_MAX_US) poll_us = STATE_POLL_MAX_US;
+        }
+    }
+}
+
 // --- Function to set EtherCAT slave state ---
-int soem_interface_set_ethercat_state(uint16_t slave_idx, ec_state desired_state) {
-    int max_retries = 10;
-    int retry_count = 0;
-    
-    while (retry_count < max_retries) {
-        printf("SOEM_Interface: Attempt %d/%d - Setting slave %u to state %s...\n", 
-               retry_count + 1, max_retries, slave_idx, get_state_name(desired_state));
-        
+int soem_interface_set_ethercat_state(uint16_t slave_idx, uint16_t desired_state) {
+    int exchange_pdo = (desired_state == EC_STATE_OPERATIONAL);
+    uint32_t timeout_us = STATE_TIMEOUT_FIRST_US;
+
+    for (int attempt = 1; attempt <= STATE_MAX_RETRIES; attempt++, timeout_us *= 2) {
+        uint64_t start_ns = rt_clock_now_ns();
+        printf("SOEM_Interface: Attempt %d/%d - Setting slave %u to state %s...\n",
+               attempt, STATE_MAX_RETRIES, slave_idx, get_state_name(desired_state));
+
         ec_slave[slave_idx].ALstatuscode = 0;
         ec_slave[slave_idx].state = desired_state;
         ec_writestate(slave_idx);
-        usleep(50000); // 50ms delay
-        
-        int wkc_state = ec_statecheck(slave_idx, desired_state, 100000); // 100ms timeout
-        
-        if (wkc_state > 0 && (ec_slave[slave_idx].state & 0x0F) == desired_state) {
-            printf("SOEM_Interface: Slave %u successfully transitioned to state %s\n", 
-                   slave_idx, get_state_name(ec_slave[slave_idx].state));
+
+        if (wait_for_state(slave_idx, desired_state, timeout_us, exchange_pdo) == 0) {
+            printf("SOEM_Interface: Slave %u transitioned to state %s in %.1f ms\n",
+                   slave_idx, get_state_name(desired_state), (rt_clock_now_ns() - start_ns) / 1e6);
             return 0;
         }
-        
-        printf("SOEM_Interface: State transition failed - Current state: %s, ALstatuscode: 0x%04X\n",
-               get_state_name(ec_slave[slave_idx].state), ec_slave[slave_idx].ALstatuscode);
-        
+
+        printf("SOEM_Interface: State transition timed out after %u ms - Current state: %s, ALstatuscode: 0x%04X\n",
+               timeout_us / 1000, get_state_name(ec_slave[slave_idx].state), ec_slave[slave_idx].ALstatuscode);
+
+        // Slaves that refused with the error flag set only accept a new request once acknowledged
+        for (int i = 1; i <= ec_slavecount; i++) {
+            if ((slave_idx != 0 && slave_idx != i) || !(ec_slave[i].state & EC_STATE_ERROR)) continue;
+            printf("SOEM_Interface: Slave %d refused (AL status 0x%04X), acknowledging\n", i, ec_slave[i].ALstatuscode);
+            ec_slave[i].state = (ec_slave[i].state & 0x0F) + EC_STATE_ACK;
+            ec_writestate(i);
+        }
+
         // Try intermediate states if stuck in PRE_OP
         if (desired_state == EC_STATE_OPERATIONAL && (ec_slave[slave_idx].state & 0x0F) == EC_STATE_PRE_OP) {
             printf("SOEM_Interface: Trying intermediate SAFE_OP transition...\n");
-            
+
             ec_slave[slave_idx].state = EC_STATE_SAFE_OP;
             ec_writestate(slave_idx);
-            usleep(200000);
-            
-            if (ec_statecheck(slave_idx, EC_STATE_SAFE_OP, 200000) > 0) {
+            if (wait_for_state(slave_idx, EC_STATE_SAFE_OP, timeout_us, 0) == 0) {
                 printf("SOEM_Interface: Intermediate SAFE_OP successful\n");
                 ec_slave[slave_idx].state = EC_STATE_OPERATIONAL;
                 ec_writestate(slave_idx);
-                usleep(200000);
-                
-                if (ec_statecheck(slave_idx, EC_STATE_OPERATIONAL, 200000) > 0) {
+
+                if (wait_for_state(slave_idx, EC_STATE_OPERATIONAL, timeout_us, 1) == 0) {
                     printf("SOEM_Interface: Final OPERATIONAL transition successful\n");
                     return 0;
                 }
             }
         }
-        
-        retry_count++;
-        if (retry_count < max_retries) {
-            printf("SOEM_Interface: Retrying in 100ms...\n");
-            usleep(100000);
-        }
     }
-    
+
     fprintf(stderr, "SOEM_Interface: Failed to set slave %u to state %s after %d attempts\n",
-            slave_idx, get_state_name(desired_state), max_retries);
+            slave_idx, get_state_name(desired_state), STATE_MAX_RETRIES);
     return -1;
 }
 
-// --- Function to perform CiA 402 state machine transition ---
-int perform_cia402_transition_to_operational(uint16_t slave_idx) {
-    printf("SOEM_Interface: Starting CiA 402 state machine transition to operational...\n");
-    
-    int max_attempts = 100;
-    int attempt = 0;
-    
-    while (attempt < max_attempts) {
-        // Read current statusword
-        if (somanet_inputs) {
-            current_statusword = somanet_inputs->statusword;
-        } else {
-            fprintf(stderr, "SOEM_Interface: somanet_inputs not available for status reading.\n");
-            return -1;
-        }
-        
-        current_cia402_state = get_cia402_state(current_statusword);
-        
-        printf("SOEM_Interface: CiA 402 State: %s (statusword: 0x%04X)\n", 
-               get_cia402_state_name(current_cia402_state), current_statusword);
-        
-        // Check if we're in operational state
-        if (current_cia402_state == CIA402_STATE_OPERATION_ENABLED) {
-            printf("SOEM_Interface: Successfully reached Operation Enabled state!\n");
+// Returns 1 if the assignment holds only pdo_map_idx and the mapping equals mapped_objects
+static int pdo_mapping_matches(uint16_t slave_idx, uint16_t pdo_assign_idx, uint16_t pdo_map_idx,
+                               const uint32_t *mapped_objects, uint8_t num_mapped_objects) {
+    uint8_t count = 0;
+    uint16_t assigned = 0;
+    if (soem_interface_read_sdo(slave_idx, pdo_assign_idx, 0x00, sizeof(count), &count) != 0 || count != 1 ||
+        soem_interface_read_sdo(slave_idx, pdo_assign_idx, 0x01, sizeof(assigned), &assigned) != 0 ||
+        assigned != pdo_map_idx) {
+        return 0;
+    }
+    if (soem_interface_read_sdo(slave_idx, pdo_map_idx, 0x00, sizeof(count), &count) != 0 || count != num_mapped_objects) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < num_mapped_objects; i++) {
+        uint32_t object = 0;
+        if (soem_interface_read_sdo(slave_idx, pdo_map_idx, i + 1, sizeof(object), &object) != 0 ||
+            object != mapped_objects[i]) {
             return 0;
         }
-        
-        // Handle fault state
-        if (current_cia402_state == CIA402_STATE_FAULT) {
-            printf("SOEM_Interface: Device in fault state. Attempting fault reset...\n");
-            current_controlword = CIA402_CONTROLWORD_FAULT_RESET;
-        } else {
-            // Determine next transition
-            switch (current_cia402_state) {
-                case CIA402_STATE_NOT_READY:
-                case CIA402_STATE_SWITCH_ON_DISABLED:
-                    current_controlword = 0x0006; // Shutdown
-                    break;
-                case CIA402_STATE_READY_TO_SWITCH_ON:
-                    current_controlword = 0x0007; // Switch on
-                    break;
-                case CIA402_STATE_SWITCHED_ON:
-                    current_controlword = 0x000F; // Enable operation
-                    break;
-                case CIA402_STATE_QUICK_STOP_ACTIVE:
-                    current_controlword = 0x0006; // Shutdown
-                    break;
-                default:
-                    current_controlword = 0x0006; // Default to shutdown
-                    break;
-            }
+    }
+    return 1;
+}
+
+// --- Function to remap a PDO (slave in PRE_OP) ---
+int soem_interface_configure_pdo_mapping_enhanced(uint16_t slave_idx, uint16_t pdo_assign_idx, uint16_t pdo_map_idx,
+                                                  uint32_t *mapped_objects, uint8_t num_mapped_objects) {
+    uint8_t zero = 0;
+    uint8_t one = 1;
+
+    if (pdo_mapping_matches(slave_idx, pdo_assign_idx, pdo_map_idx, mapped_objects, num_mapped_objects)) {
+        printf("SOEM_Interface: PDO 0x%04X of slave %u already mapped\n", pdo_map_idx, slave_idx);
+        return 0;
+    }
+    printf("SOEM_Interface: Mapping %u objects to PDO 0x%04X of slave %u\n", num_mapped_objects, pdo_map_idx, slave_idx);
+
+    // Synapticon sequence: clear the assignment, clear the mapping, write the entries,
+    // set the entry count, then assign the PDO again
+    if (soem_interface_write_sdo(slave_idx, pdo_assign_idx, 0x00, sizeof(zero), &zero) != 0 ||
+        soem_interface_write_sdo(slave_idx, pdo_map_idx, 0x00, sizeof(zero), &zero) != 0) {
+        return -1;
+    }
+    for (uint8_t i = 0; i < num_mapped_objects; i++) {
+        if (soem_interface_write_sdo(slave_idx, pdo_map_idx, i + 1, sizeof(uint32_t), &mapped_objects[i]) != 0) {
+            return -1;
         }
-        
-        // Apply controlword
-        if (somanet_outputs) {
-            somanet_outputs->controlword = current_controlword;
-            somanet_outputs->modes_of_operation = 4; // Torque mode
+    }
+    if (soem_interface_write_sdo(slave_idx, pdo_map_idx, 0x00, sizeof(num_mapped_objects), &num_mapped_objects) != 0 ||
+        soem_interface_write_sdo(slave_idx, pdo_assign_idx, 0x01, sizeof(pdo_map_idx), &pdo_map_idx) != 0 ||
+        soem_interface_write_sdo(slave_idx, pdo_assign_idx, 0x00, sizeof(one), &one) != 0) {
+        return -1;
+    }
+
+    if (!pdo_mapping_matches(slave_idx, pdo_assign_idx, pdo_map_idx, mapped_objects, num_mapped_objects)) {
+        fprintf(stderr, "SOEM_Interface: PDO 0x%04X of slave %u does not read back as written\n", pdo_map_idx, slave_idx);
+        return -1;
+    }
+    return 0;
+}
+
+// Store a drive's torque command for the next cycle and count it for the output stage
+static void store_target_torque(soem_axis_t *axis, ffb_torque_t torque) {
+    atomic_store_explicit(&axis->target_torque, torque, memory_order_relaxed);
+    atomic_fetch_add_explicit(&axis->torque_updates, 1, memory_order_release);
+}
+
+// An engine command also counts as a sign of life for the safety supervisor
+static void set_target_torque(soem_axis_t *axis, ffb_torque_t torque) {
+    store_target_torque(axis, torque);
+    atomic_fetch_add_explicit(&axis->engine_updates, 1, memory_order_relaxed);
+}
+
+// Take over a new output stage, safety and torque scale configuration. Skipped while the
+// writer is mid-update; the next cycle tries again, so the cycle never waits for it.
+static void update_cycle_config(unsigned int *applied_sequence) {
+    unsigned int seq = atomic_load_explicit(&cycle_config_lock.sequence, memory_order_acquire);
+    if (seq == *applied_sequence || (seq & 1U)) return;
+
+    ffb_output_config_t config = output_config;
+    soem_safety_config_t new_safety_config = safety_config;
+    float full_scale = torque_full_scale;
+    if (rt_seqlock_read_retry(&cycle_config_lock, seq)) return;
+    for (int i = 0; i < axis_count; i++) {
+        if (axes[i].kind == SOEM_AXIS_DRIVE) ffb_output_configure(&axes[i].output, &config);
+    }
+    soem_safety_configure(&safety, &new_safety_config, cycle_time * 1e-6f);
+    if (full_scale != applied_full_scale) {
+        applied_full_scale = full_scale;
+        full_scale_generation++;
+    }
+    *applied_sequence = seq;
+}
+
+// One supervisor step after the frame: the scale and quick stop apply from the next frame on
+static float step_safety(int wkc_ok, uint64_t now_ns, int *quick_stop_applied) {
+    uint64_t (*source)(void) = atomic_load_explicit(&host_activity_source, memory_order_acquire);
+    soem_safety_inputs_t inputs = {
+        .now_ns = now_ns,
+        .hid_activity_ns = source ? source() : 0,
+        .torque_updates = atomic_load_explicit(&wheel->engine_updates, memory_order_relaxed),
+        .torque_command = atomic_load_explicit(&wheel->target_torque, memory_order_relaxed),
+        .wkc_ok = wkc_ok,
+    };
+    float scale = soem_safety_step(&safety, &inputs);
+
+    // Quick stop while a hard fault is latched or one was requested
+    int quick_stop = soem_safety_quick_stop(&safety) ||
+                     atomic_load_explicit(&quick_stop_requested, memory_order_relaxed);
+    if (quick_stop != *quick_stop_applied) {
+        for (int i = 0; i < axis_count; i++) {
+            if (axes[i].kind == SOEM_AXIS_DRIVE) soem_cia402_request_quick_stop(&axes[i].drive_sm, quick_stop);
         }
-        
-        // Send PDO data to apply controlword
-        ec_send_processdata();
-        wkc = ec_receive_processdata(EC_TIMEOUTRET);
-        
-        printf("SOEM_Interface: Applied controlword: 0x%04X, WKC: %d/%d\n", current_controlword, wkc, expectedWKC);
-        
-        attempt++;
-        usleep(10000); // 10ms delay between attempts
+        *quick_stop_applied = quick_stop;
+    }
+    return scale;
+}
+
+// Write each drive's command into the IOmap ahead of the frame, scaled by the safety
+// supervisor; returns the target torque sent
+static int16_t write_axis_outputs(soem_axis_t *axis, float safety_scale) {
+    int16_t target = 0;
+
+    // Only send torque while the drive is enabled and kept enabled (no quick stop pending)
+    if (axis->drive_sm.state == CIA402_STATE_OPERATION_ENABLED &&
+        axis->drive_sm.controlword == SOEM_CONTROLWORD_OPERATION_ENABLED) {
+        unsigned int updates = atomic_load_explicit(&axis->torque_updates, memory_order_acquire);
+        ffb_torque_t command = atomic_load_explicit(&axis->target_torque, memory_order_relaxed);
+        ffb_torque_t torque = ffb_output_step(&axis->output, command, updates);
+        update_torque_scale(axis);
+#if FFB_FIXED_POINT
+        torque = ffb_q16_mul(torque, ffb_q16_from_float(safety_scale));
+#else
+        torque *= safety_scale;
+#endif
+        target = torque_to_per_mille(torque, axis->per_mille_scale);
+        soem_pdo_set_target_torque(&axis->layout, target);
+    } else {
+        ffb_output_reset(&axis->output); // Start from zero once enabled again
+        soem_pdo_set_target_torque(&axis->layout, 0); // Safe value
+    }
+
+    // Controlword chosen by the state machine from the previous frame
+    soem_pdo_set_controlword(&axis->layout, axis->drive_sm.controlword);
+    soem_pdo_set_modes_of_operation(&axis->layout, get_operation_mode());
+    return target;
+}
+
+// Publish a slave's part of the frame just received. Readers retry instead of blocking us.
+static void publish_axis_inputs(soem_axis_t *axis, uint64_t timestamp_ns) {
+    rt_seqlock_write_begin(&axis->lock);
+    if (axis->kind == SOEM_AXIS_DRIVE) {
+        axis->statusword = soem_pdo_get_statusword(&axis->layout);
+        axis->snapshot.position = soem_pdo_get_position(&axis->layout);
+        axis->snapshot.velocity = soem_pdo_get_velocity(&axis->layout);
+        axis->snapshot.torque_actual = soem_pdo_get_torque_actual(&axis->layout);
+        axis->snapshot.statusword = axis->statusword;
+        axis->snapshot.drive_time_us = soem_pdo_get_timestamp(&axis->layout);
+    } else {
+        if (axis->io_input_bytes) memcpy(axis->io_inputs, ec_slave[axis->slave].inputs, axis->io_input_bytes);
+    }
+    axis->snapshot.timestamp_ns = timestamp_ns;
+    axis->snapshot.cycle_count = ecat_cycle_count;
+    rt_seqlock_write_end(&axis->lock);
+}
+
+// Reports the round trip of the first cycles once they are in, to show how much of the cycle
+// the NIC path leaves for everything else. Measured on the DC-synchronized cycle itself, so
+// startup does not wait for it; runs once, in the EtherCAT thread, and only logs.
+static void report_startup_round_trip(int lost) {
+    rt_histogram_snapshot_t snapshot;
+    rt_histogram_summary_t summary;
+    rt_histogram_snapshot(hist_probe_roundtrip, &snapshot);
+    rt_histogram_summarize(&snapshot, &summary);
+    RT_LOG(RT_LOG_INFO, "SOEM_Interface: Frame round trip over the first %d cycles: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us, %d low WKC\n",
+           ROUND_TRIP_PROBE_FRAMES, summary.p50 / 1000.0, summary.p99 / 1000.0, summary.p999 / 1000.0,
+           summary.max / 1000.0, lost);
+
+    // Leave at least half of the cycle for the engine, the wakeup jitter and the DC margin
+    uint32_t safe_cycle_us = (uint32_t)((summary.p999 * 2 + 999) / 1000);
+    if (safe_cycle_us < SOEM_CYCLE_TIME_MIN_US) safe_cycle_us = SOEM_CYCLE_TIME_MIN_US;
+    if (safe_cycle_us > SOEM_CYCLE_TIME_MAX_US) {
+        // Even the longest cycle -c accepts is too short; do not suggest one it rejects
+        RT_LOG(RT_LOG_ERROR, "SOEM_Interface: Warning: round trip p99.9 is %.1f us; no supported cycle time (%d-%d us) "
+               "leaves half of it free, check the NIC and its driver\n",
+               summary.p999 / 1000.0, SOEM_CYCLE_TIME_MIN_US, SOEM_CYCLE_TIME_MAX_US);
+    } else if (summary.p999 * 2 > (uint64_t)cycle_time * 1000) {
+        RT_LOG(RT_LOG_ERROR, "SOEM_Interface: Warning: round trip p99.9 uses more than half of the %d us cycle; "
+               "use -c %u or more\n", cycle_time, safe_cycle_us);
+    } else {
+        RT_LOG(RT_LOG_INFO, "SOEM_Interface: Shortest cycle keeping half of it free: %u us\n", safe_cycle_us);
     }
-    
-    fprintf(stderr, "SOEM_Interface: Failed to reach operational state after %d attempts.\n", max_attempts);
-    return -1;
 }
 
 // --- SOEM Thread Function ---
 void *ecat_loop(void *ptr) {
-    int slave_idx = 1;
-    int state_machine_initialized = 0;
 
-    printf("SOEM_Interface: EtherCAT thread started (10ms cycle time).\n");
+    RT_LOG(RT_LOG_INFO, "SOEM_Interface: EtherCAT thread started (%dus cycle time, DC sync %s).\n",
+           cycle_time, dc_sync_active ? "on" : "off");
+    rt_threads_verify_self(RT_THREAD_ETHERCAT);
 
     while (!master_initialized && ecat_thread_running) {
         usleep(10000); // Wait for master to be initialized
     }
 
     if (!master_initialized) {
-        printf("SOEM_Interface: Master not initialized, exiting thread.\n");
+        RT_LOG(RT_LOG_INFO, "SOEM_Interface: Master not initialized, exiting thread.\n");
         return NULL;
     }
 
-    printf("SOEM_Interface: Entering EtherCAT cyclic loop.\n");
+    RT_LOG(RT_LOG_INFO, "SOEM_Interface: Entering EtherCAT cyclic loop.\n");
+
+    const int64_t cycle_ns = (int64_t)cycle_time * 1000;
+    int64_t dc_correction_ns = 0;
+    struct timespec next_wakeup, now;
+    uint32_t wkc_failures_in_row = 0;
+    uint64_t last_torque_sample_ns = 0;
+    uint32_t probe_frames = 0;
+    int probe_lost = 0;
+    unsigned int cycle_config_sequence = 0;
+    float safety_scale = 1.0f;
+    int quick_stop_applied = 0;
+
+    soem_safety_init(&safety, &safety_config, cycle_time * 1e-6f);
 
-    struct timespec loop_start, loop_end;
-    long elapsed_ns;
+    // Start on a whole cycle boundary of the monotonic clock
+    clock_gettime(CLOCK_MONOTONIC, &next_wakeup);
+    timespec_add_ns(&next_wakeup, cycle_ns - (next_wakeup.tv_nsec % cycle_ns));
 
     while (ecat_thread_running) {
-        clock_gettime(CLOCK_MONOTONIC, &loop_start);
-
-        // Update output PDO data
-        pthread_mutex_lock(&pdo_mutex);
-        if (somanet_outputs) {
-            // Only update torque if we're in operational state
-            if (current_cia402_state == CIA402_STATE_OPERATION_ENABLED) {
-                somanet_outputs->target_torque = (int16_t)(target_torque_f * 1000.0f);
-            } else {
-                somanet_outputs->target_torque = 0; // Safe value
+        // Absolute wakeups do not accumulate drift; the DC correction adjusts phase only
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_wakeup, NULL);
+        uint64_t wake_raw_ns = rt_clock_now_ns();
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t wake_late_ns = (int64_t)(now.tv_sec - next_wakeup.tv_sec) * 1000000000L + (now.tv_nsec - next_wakeup.tv_nsec);
+        rt_histogram_record(hist_wakeup_late, wake_late_ns > 0 ? (uint64_t)wake_late_ns : 0);
+
+        // A new torque goes out in this frame: how old is the feedback it was computed from
+        uint64_t sample_ns = atomic_load_explicit(&torque_sample_ns, memory_order_relaxed);
+        if (sample_ns != last_torque_sample_ns) {
+            uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+            rt_histogram_record(hist_encoder_torque, now_ns > sample_ns ? now_ns - sample_ns : 0);
+            last_torque_sample_ns = sample_ns;
+        }
+
+        // Update output PDO data of every drive
+        update_cycle_config(&cycle_config_sequence);
+        for (int i = 0; i < axis_count; i++) {
+            if (axes[i].kind != SOEM_AXIS_DRIVE) continue;
+            int16_t target = write_axis_outputs(&axes[i], safety_scale);
+            if (&axes[i] == wheel) {
+                ffb_e2e_torque_written(target, (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
             }
-            
-            // Keep controlword updated for state machine
-            somanet_outputs->controlword = current_controlword;
-            somanet_outputs->modes_of_operation = 4; // Torque mode
         }
-        pthread_mutex_unlock(&pdo_mutex);
 
-        // Exchange process data
+        // Exchange process data: one frame for all slaves
+        uint64_t send_raw_ns = rt_clock_now_ns();
         ec_send_processdata();
         wkc = ec_receive_processdata(EC_TIMEOUTRET);
+        uint64_t roundtrip_ns = rt_clock_now_ns() - send_raw_ns;
+        rt_histogram_record(hist_roundtrip, roundtrip_ns);
+        if (probe_frames < ROUND_TRIP_PROBE_FRAMES) {
+            rt_histogram_record(hist_probe_roundtrip, roundtrip_ns);
+            if (wkc < expectedWKC) probe_lost++;
+            if (++probe_frames == ROUND_TRIP_PROBE_FRAMES) report_startup_round_trip(probe_lost);
+        }
+        ecat_cycle_count++;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        // Lock the master cycle to the DC reference time latched by this frame
+        if (dc_sync_active && wkc > 0) {
+            dc_correction_ns = dc_sync_pi(ec_DCtime, cycle_ns);
+        }
 
-        if (wkc < expectedWKC) {
-            printf("SOEM_Interface: Working counter too low: %d < %d\n", wkc, expectedWKC);
+        soem_cycle_callback_t callback = atomic_load_explicit(&cycle_callback, memory_order_acquire);
+        uint64_t sample_time_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+        int wkc_ok = wkc >= expectedWKC;
+
+        if (!wkc_ok) {
+            RT_LOG(RT_LOG_INFO, "SOEM_Interface: Working counter too low: %d < %d\n", wkc, expectedWKC);
+            wkc_failures_in_row++;
             communication_ok = 0;
+            if (callback) {
+                // No fresh feedback for the engine: command zero rather than a stale torque.
+                // Not an engine command, so a stalled engine still runs into its deadline.
+                store_target_torque(wheel, 0);
+            }
         } else {
+            if (wkc_failures_in_row) {
+                rt_histogram_record(hist_wkc_burst, wkc_failures_in_row);
+                wkc_failures_in_row = 0;
+            }
             communication_ok = 1;
             
-            // Update input PDO data - This is where we get the 14-bit encoder position
-            pthread_mutex_lock(&pdo_mutex);
-            if (somanet_inputs) {
-                current_statusword = somanet_inputs->statusword;
-                current_cia402_state = get_cia402_state(current_statusword);
-                
-                // **CRITICAL: Position from 14-bit encoder comes via position_actual_value**
-                current_position_f = (float)somanet_inputs->position_actual_value;
-                current_velocity_f = (float)somanet_inputs->velocity_actual_value;
-                
-                // Debug: Print encoder position periodically (every 1000 cycles = ~10 seconds)
-                static int debug_counter = 0;
-                if (++debug_counter % 1000 == 0) {
-                    printf("SOEM_Interface: 16-bit Encoder Position: %d (%.2f), Velocity: %d (%.2f)\n", 
-                           somanet_inputs->position_actual_value, current_position_f,
-                           somanet_inputs->velocity_actual_value, current_velocity_f);
-                }
+            // Update input PDO data of every slave - the wheel's is the 14-bit encoder position
+            for (int i = 0; i < axis_count; i++) {
+                publish_axis_inputs(&axes[i], sample_time_ns);
             }
-            pthread_mutex_unlock(&pdo_mutex);
-
-            // Initialize state machine once after successful PDO exchange
-            if (!state_machine_initialized && somanet_inputs && somanet_outputs) {
-                printf("SOEM_Interface: Attempting CiA 402 state machine initialization...\n");
-                if (perform_cia402_transition_to_operational(slave_idx) == 0) {
-                    state_machine_initialized = 1;
-                    printf("SOEM_Interface: CiA 402 state machine initialized to Operation Enabled.\n");
-                    printf("SOEM_Interface: 14-bit encoder ready, resolution: %.0f counts/rev\n", ENCODER_COUNTS_PER_REV);
-                } else {
-                    fprintf(stderr, "SOEM_Interface: Failed to initialize CiA 402 state machine.\n");
-                    communication_ok = 0; 
-                }
+            atomic_store_explicit(&latest_sample_ns, sample_time_ns, memory_order_relaxed);
+            ffb_e2e_torque_actual(wheel->snapshot.torque_actual, sample_time_ns);
+
+            // Inline engine: compute torque from this cycle's sample; it goes out with the next send
+            if (callback) {
+                uint64_t callback_raw_ns = rt_clock_now_ns();
+                ffb_torque_t torque = callback(&wheel->snapshot, cycle_callback_data);
+                rt_histogram_record(hist_callback, rt_clock_now_ns() - callback_raw_ns);
+                set_target_torque(wheel, torque);
+                atomic_store_explicit(&torque_sample_ns, sample_time_ns, memory_order_relaxed);
             }
-        }
 
-        // Check EtherCAT slave state periodically
-        if (!is_slave_operational(slave_idx)) {
-            ec_statecheck(slave_idx, EC_STATE_OPERATIONAL, 100000);
+            // Debug: Print encoder position periodically (~10 seconds)
+            static int debug_counter = 0;
+            if (++debug_counter % (10000000 / cycle_time) == 0) {
+                RT_LOG(RT_LOG_INFO, "SOEM_Interface: 16-bit Encoder Position: %d, Velocity: %d\n",
+                       wheel->snapshot.position, wheel->snapshot.velocity);
+            }
         }
 
-        clock_gettime(CLOCK_MONOTONIC, &loop_end);
-        elapsed_ns = (loop_end.tv_sec - loop_start.tv_sec) * 1000000000L + (loop_end.tv_nsec - loop_start.tv_nsec);
-        long sleep_ns = cycle_time * 1000L - elapsed_ns; // cycle_time is in microseconds
+        // Deadlines are checked on every frame, lost or not; a quick stop from a hard fault
+        // goes into the controlword chosen right below
+        safety_scale = step_safety(wkc_ok, sample_time_ns, &quick_stop_applied);
 
-        if (sleep_ns > 0) {
-            struct timespec sleep_time = {
-                .tv_sec = sleep_ns / 1000000000L,
-                .tv_nsec = sleep_ns % 1000000000L
-            };
-            nanosleep(&sleep_time, NULL);
-        } else {
-            // EtherCAT thread running late
-            static int late_warnings = 0;
-            if (late_warnings < 10) {
-                printf("SOEM_Interface: EtherCAT thread running %.3fms late\n", -sleep_ns / 1000000.0);
-                late_warnings++;
+        // One CiA 402 step per drive: bring-up, fault recovery and quick stop never stall the cycle
+        if (wkc_ok) {
+            for (int i = 0; i < axis_count; i++) {
+                if (axes[i].kind == SOEM_AXIS_DRIVE) {
+                    soem_cia402_step(&axes[i].drive_sm, axes[i].statusword, sample_time_ns);
+                }
             }
         }
+
+        // Slave AL states are supervised by the mailbox thread, never inside the cycle
+
+        rt_histogram_record(hist_cycle_work, rt_clock_now_ns() - wake_raw_ns);
+
+        timespec_add_ns(&next_wakeup, cycle_ns + dc_correction_ns);
+        dc_correction_ns = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t late_ns = (int64_t)(now.tv_sec - next_wakeup.tv_sec) * 1000000000L + (now.tv_nsec - next_wakeup.tv_nsec);
+        if (late_ns > 0) {
+            // EtherCAT thread overran a whole cycle: resynchronize instead of bursting to catch up
+            RT_LOG(RT_LOG_INFO, "SOEM_Interface: EtherCAT thread running %.3fms late\n", late_ns / 1000000.0);
+            next_wakeup = now;
+            timespec_add_ns(&next_wakeup, cycle_ns - (next_wakeup.tv_nsec % cycle_ns));
+        }
     }
 
-    printf("SOEM_Interface: EtherCAT thread stopping.\n");
+    RT_LOG(RT_LOG_INFO, "SOEM_Interface: EtherCAT thread stopping.\n");
     return NULL;
 }
 
+// CiA 402 drives report device profile 402 in the low word of the device type (0x1000)
+static int slave_is_cia402_drive(uint16_t slave_idx) {
+    uint32_t device_type = 0;
+    if (!ec_slave[slave_idx].CoEdetails) return 0; // No CoE mailbox, e.g. simple I/O terminals
+    if (soem_interface_read_sdo(slave_idx, 0x1000, 0x00, sizeof(device_type), &device_type) != 0) return 0;
+    return (device_type & 0xFFFF) == 402;
+}
+
+// Builds the axis table in bus order; the first drive is the wheel
+static int discover_axes(void) {
+    axis_count = 0;
+    wheel = NULL;
+    if (ec_slavecount > SOEM_MAX_AXES) {
+        printf("SOEM_Interface: Warning: %d slaves on the bus, only the first %d are used\n", ec_slavecount, SOEM_MAX_AXES);
+    }
+    for (int i = 1; i <= ec_slavecount && axis_count < SOEM_MAX_AXES; i++) {
+        soem_axis_t *axis = &axes[axis_count++];
+        memset(axis, 0, sizeof(*axis));
+        atomic_store_explicit(&axis->target_torque, 0, memory_order_relaxed);
+        atomic_store_explicit(&axis->max_torque, SOEM_MAX_TORQUE_DEFAULT, memory_order_relaxed);
+        ffb_output_init(&axis->output, cycle_time * 1e-6f, &output_config);
+        axis->slave = (uint16_t)i;
+        axis->kind = slave_is_cia402_drive(axis->slave) ? SOEM_AXIS_DRIVE : SOEM_AXIS_IO;
+        soem_cia402_init(&axis->drive_sm, axis->slave);
+        if (axis->kind == SOEM_AXIS_DRIVE && !wheel) wheel = axis;
+        printf("SOEM_Interface: Axis %d: slave %d (%s) %s\n", axis_count - 1, i, ec_slave[i].name,
+               axis->kind == SOEM_AXIS_DRIVE ? (axis == wheel ? "CiA 402 drive, wheel" : "CiA 402 drive") : "I/O");
+    }
+    if (!wheel) {
+        fprintf(stderr, "SOEM_Interface: No CiA 402 drive found for the wheel\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Fills in the drive's identity and looks it up in the configuration cache. An entry only
+// saves reading the PDO layout back: the mapping and the CiA 402 parameters are still read
+// back and rewritten where they differ, since a power cycle or another tool may have changed them.
+static void lookup_cached_config(soem_axis_t *axis, uint32_t signature) {
+    soem_config_cache_entry_t *config = &axis->config;
+    soem_config_cache_entry_t cached;
+    ec_slavet *slave = &ec_slave[axis->slave];
+    uint32_t serial = 0;
+
+    memset(config, 0, sizeof(*config));
+    config->vendor = slave->eep_man;
+    config->product = slave->eep_id;
+    config->revision = slave->eep_rev;
+    if (soem_interface_read_sdo(axis->slave, 0x1018, 0x04, sizeof(serial), &serial) == 0) {
+        config->serial = serial;
+    }
+    config->signature = signature;
+    axis->config_cached = 0;
+
+    if (!config_cache_enabled) {
+        return;
+    }
+    if (!soem_config_cache_find(config, &cached)) {
+        printf("SOEM_Interface: No cached configuration for slave %u (serial %u)\n", axis->slave, config->serial);
+        return;
+    }
+    *config = cached;
+    axis->config_cached = 1;
+    printf("SOEM_Interface: Slave %u has a cached configuration, verifying it\n", axis->slave);
+}
+
 // Enhanced SOEM initialization (simplified for key parts)
 int soem_interface_init_enhanced(const char *ifname) {
     int i;
-    int slave_idx = 1;
 
     printf("SOEM_Interface: Enhanced initialization for Synapticon 14-bit encoder on %s...\n", ifname);
+    startup_phase_begin();
 
     if (!ec_init(ifname)) {
         fprintf(stderr, "SOEM_Interface: ec_init failed on %s\n", ifname);
@@ -550,6 +1126,11 @@ int soem_interface_init_enhanced(const char *ifname) {
 
     printf("SOEM_Interface: ec_init succeeded\n");
 
+    if (nic_tuning_enabled) {
+        soem_nic_prepare(ifname, ecx_context.port ? ecx_context.port->sockhandle : -1);
+    }
+    startup_phase_end("NIC open");
+
     if (ec_config_init(FALSE) <= 0) {
         fprintf(stderr, "SOEM_Interface: No slaves found during config_init\n");
         return -1;
@@ -565,16 +1146,56 @@ int soem_interface_init_enhanced(const char *ifname) {
     // Print detailed slave information
     for (i = 1; i <= ec_slavecount; i++) {
         printf("SOEM_Interface: Slave %d: %s\n", i, ec_slave[i].name);
-        printf("  - Vendor ID: 0x%08X, Product Code: 0x%08X\n", 
-               ec_slave[i].eep_id, ec_slave[i].eep_pdi);
+        printf("  - Vendor ID: 0x%08X, Product Code: 0x%08X, Revision: 0x%08X\n",
+               ec_slave[i].eep_man, ec_slave[i].eep_id, ec_slave[i].eep_rev);
         printf("  - Output: %d bits (%d bytes), Input: %d bits (%d bytes)\n",
                ec_slave[i].Obits, ec_slave[i].Obits/8, ec_slave[i].Ibits, ec_slave[i].Ibits/8);
         printf("  - State: %s, ALstatuscode: 0x%04X\n", 
                get_state_name(ec_slave[i].state), ec_slave[i].ALstatuscode);
     }
 
-    // Configure distributed clocks
-    ec_configdc();
+    if (discover_axes() != 0) {
+        return -1;
+    }
+    startup_phase_end("slave discovery");
+
+    // Configure distributed clocks; the wheel drive decides whether the cycle is DC-locked.
+    // This also fixes the torque mode, which is part of the cached configuration's signature.
+    dc_sync_active = 0;
+    if (ec_configdc() && dc_sync_enabled && ec_slave[wheel->slave].hasdc) {
+        dc_sync_active = 1;
+    } else if (dc_sync_enabled) {
+        printf("SOEM_Interface: Warning: Slave %u has no distributed clock, running free-running cycle\n", wheel->slave);
+    }
+    startup_phase_end("distributed clocks");
+
+    if (config_cache_enabled) {
+        printf("SOEM_Interface: %d cached drive configurations in %s\n",
+               soem_config_cache_load(SOEM_CONFIG_CACHE_PATH), SOEM_CONFIG_CACHE_PATH);
+    }
+    uint32_t signature = drive_config_signature();
+    for (i = 0; i < axis_count; i++) {
+        if (axes[i].kind == SOEM_AXIS_DRIVE) lookup_cached_config(&axes[i], signature);
+    }
+    startup_phase_end("configuration cache");
+
+    // Program the PDO mapping while the slaves are in PRE_OP; ec_config_map() sizes the
+    // sync managers from it. Mappings that read back as in the table are not rewritten.
+    // If a drive refuses, its own mapping is read back and used.
+    for (i = 0; i < axis_count; i++) {
+        if (axes[i].kind != SOEM_AXIS_DRIVE) continue;
+        if (soem_pdo_configure(axes[i].slave) != 0) {
+            printf("SOEM_Interface: Keeping the PDO mapping of slave %u\n", axes[i].slave);
+            if (axes[i].config_cached) {
+                soem_config_cache_forget(SOEM_CONFIG_CACHE_PATH, &axes[i].config);
+                axes[i].config_cached = 0;
+                axes[i].config.signature = signature;
+            }
+        } else {
+            axes[i].config_verified = 1;
+        }
+    }
+    startup_phase_end("PDO mapping");
 
     // Map the IO
     printf("SOEM_Interface: Mapping IO...\n");
@@ -590,60 +1211,96 @@ int soem_interface_init_enhanced(const char *ifname) {
                i, ec_slave[i].Obits/8, ec_slave[i].Ibits/8);
     }
 
-    // Assign PDO pointers
-    if (ec_slave[slave_idx].outputs > 0) {
-        somanet_outputs = (somanet_rx_pdo_enhanced_t *)(ec_slave[slave_idx].outputs);
-        printf("SOEM_Interface: somanet_outputs mapped successfully\n");
-    } else {
-        fprintf(stderr, "SOEM_Interface: No output PDO data available!\n");
-        return -1;
+    // Activate SYNC0 on the drives so they sample and apply PDOs on the DC cycle
+    if (dc_sync_active) {
+        dc_integral = 0;
+        for (i = 0; i < axis_count; i++) {
+            if (axes[i].kind != SOEM_AXIS_DRIVE || !ec_slave[axes[i].slave].hasdc) continue;
+            ec_dcsync0(axes[i].slave, TRUE, (uint32)cycle_time * 1000U, 0);
+            printf("SOEM_Interface: DC SYNC0 enabled on slave %u, cycle time %d us\n", axes[i].slave, cycle_time);
+        }
     }
-    
-    if (ec_slave[slave_idx].inputs > 0) {
-        somanet_inputs = (somanet_tx_pdo_enhanced_t *)(ec_slave[slave_idx].inputs);
-        printf("SOEM_Interface: somanet_inputs mapped successfully (14-bit encoder data)\n");
-    } else {
-        fprintf(stderr, "SOEM_Interface: No input PDO data available!\n");
-        return -1;
+    startup_phase_end("IO map");
+
+    // Locate each drive's objects in the IOmap from the mapping it reports (or reported last time)
+    for (i = 0; i < axis_count; i++) {
+        soem_axis_t *axis = &axes[i];
+        ec_slavet *slave = &ec_slave[axis->slave];
+        if (axis->kind == SOEM_AXIS_IO) {
+            axis->io_input_bytes = slave->inputs ? (slave->Ibits + 7) / 8 : 0;
+            if (axis->io_input_bytes > SOEM_AXIS_IO_BYTES) axis->io_input_bytes = SOEM_AXIS_IO_BYTES;
+            continue;
+        }
+        if (!slave->outputs || !slave->inputs) {
+            fprintf(stderr, "SOEM_Interface: No process data mapped for slave %u!\n", axis->slave);
+            return -1;
+        }
+        uint32_t output_bytes = (slave->Obits + 7) / 8;
+        uint32_t input_bytes = (slave->Ibits + 7) / 8;
+        if (axis->config_cached) {
+            // ec_config_map() read the drive's assignment again; the sizes show whether it still holds
+            if (axis->config.output_bytes == output_bytes && axis->config.input_bytes == input_bytes &&
+                soem_pdo_apply_layout(axis->slave, slave->outputs, output_bytes, slave->inputs, input_bytes,
+                                      axis->config.offset, &axis->layout) == 0) {
+                axis->layout_valid = 1;
+                continue;
+            }
+            // Use whatever the drive has now; the next start remaps it
+            printf("SOEM_Interface: Slave %u no longer matches its cached configuration, reading it back\n", axis->slave);
+            soem_config_cache_forget(SOEM_CONFIG_CACHE_PATH, &axis->config);
+            axis->config_cached = 0;
+            axis->config.signature = signature;
+        }
+        if (soem_pdo_build_layout(axis->slave, slave->outputs, output_bytes,
+                                  slave->inputs, input_bytes, &axis->layout) != 0) {
+            fprintf(stderr, "SOEM_Interface: PDO layout of slave %u is not usable\n", axis->slave);
+            return -1;
+        }
+        axis->layout_valid = 1;
+        axis->config.output_bytes = output_bytes;
+        axis->config.input_bytes = input_bytes;
+        memcpy(axis->config.offset, axis->layout.offset, sizeof(axis->config.offset));
     }
+    startup_phase_end("PDO layout");
 
     expectedWKC = (ec_group[0].outputsWKC * 2) + ec_group[0].inputsWKC;
     printf("SOEM_Interface: Expected WKC: %d\n", expectedWKC);
 
-    // Initialize CiA 402 parameters in PRE_OP
-    if (initialize_cia402_parameters(slave_idx) != 0) {
-        printf("SOEM_Interface: CiA 402 initialization had issues, continuing anyway\n");
+    // From here on SDO transfers go through the mailbox thread
+    if (soem_mailbox_start() != 0) {
+        return -1;
     }
-    
-    // Initialize safe values
-    if (somanet_outputs) {
-        memset(somanet_outputs, 0, sizeof(somanet_rx_pdo_enhanced_t));
-        somanet_outputs->controlword = 0x0006; // Shutdown
-        somanet_outputs->modes_of_operation = 4; // Torque mode
+
+    for (i = 0; i < axis_count; i++) {
+        soem_axis_t *axis = &axes[i];
+        if (axis->kind != SOEM_AXIS_DRIVE) continue;
+
+        // Initialize CiA 402 parameters in PRE_OP; values the drive already has are not rewritten
+        int result = initialize_cia402_parameters(axis->slave);
+        if (result != 0) {
+            printf("SOEM_Interface: CiA 402 initialization of slave %u had issues, continuing anyway\n", axis->slave);
+            axis->config_verified = 0;
+        }
+
+        // Initialize safe values
+        memset(axis->layout.outputs, 0, axis->layout.output_bytes);
+        soem_pdo_set_controlword(&axis->layout, 0x0006); // Shutdown
+        soem_pdo_set_modes_of_operation(&axis->layout, get_operation_mode());
     }
+    startup_phase_end("CiA 402 parameters");
 
-    // Transition to Safe-Operational
+    // Transition all slaves to Safe-Operational
     printf("SOEM_Interface: Transitioning to Safe-Operational...\n");
-    if (soem_interface_set_ethercat_state(slave_idx, EC_STATE_SAFE_OP) != 0) {
+    if (soem_interface_set_ethercat_state(0, EC_STATE_SAFE_OP) != 0) {
         fprintf(stderr, "SOEM_Interface: Failed to reach Safe-Operational state\n");
         return -1;
     }
+    startup_phase_end("SAFE_OP");
 
-    // Send initial PDO data
-    ec_send_processdata();
-    ec_receive_processdata(EC_TIMEOUTRET);
-    usleep(10000);
-    
-    // Send multiple cycles to establish communication
-    for (int wd_cycles = 0; wd_cycles < 10; wd_cycles++) {
-        ec_send_processdata();
-        ec_receive_processdata(EC_TIMEOUTRET);
-        usleep(cycle_time);
-    }
-
-    // Transition to Operational
+    // Transition to Operational; process data flows from the first poll, so the drives
+    // see valid outputs before they are asked to leave SAFE_OP
     printf("SOEM_Interface: Transitioning to Operational...\n");
-    if (soem_interface_set_ethercat_state(slave_idx, EC_STATE_OPERATIONAL) != 0) {
+    if (soem_interface_set_ethercat_state(0, EC_STATE_OPERATIONAL) != 0) {
         fprintf(stderr, "SOEM_Interface: Failed to reach Operational state\n");
         return -1;
     }
@@ -655,20 +1312,37 @@ int soem_interface_init_enhanced(const char *ifname) {
             return -1;
         }
     }
+    startup_phase_end("OPERATIONAL");
 
     printf("SOEM_Interface: All slaves operational, starting communication thread...\n");
     
+    hist_wakeup_late = rt_histogram_create("ecat wakeup late", "ns");
+    hist_roundtrip = rt_histogram_create("ecat frame round trip", "ns");
+    hist_callback = rt_histogram_create("ecat inline engine", "ns");
+    hist_cycle_work = rt_histogram_create("ecat cycle work", "ns");
+    hist_encoder_torque = rt_histogram_create("encoder to torque", "ns");
+    hist_wkc_burst = rt_histogram_create("ecat low WKC bursts", "cycles");
+    hist_probe_roundtrip = rt_histogram_create("ecat startup round trip", "ns");
+
     // Start communication thread immediately
     master_initialized = 1;
     ecat_thread_running = 1;
     
-    if (pthread_create(&ecat_thread, NULL, ecat_loop, NULL) != 0) {
+    if (rt_threads_create(RT_THREAD_ETHERCAT, &ecat_thread, ecat_loop, NULL) != 0) {
         fprintf(stderr, "SOEM_Interface: Failed to create EtherCAT thread\n");
         return -1;
     }
     
-    // Give the thread time to start
-    usleep(50000);
+    // Wait for the first cycles instead of a fixed delay: a stalled thread lets the drives'
+    // sync manager watchdog expire
+    uint64_t thread_start_ns = rt_clock_now_ns();
+    soem_pdo_snapshot_t first_cycles;
+    do {
+        usleep(cycle_time);
+        soem_interface_get_pdo_snapshot(&first_cycles);
+    } while (first_cycles.cycle_count < ECAT_STARTUP_CYCLES &&
+             rt_clock_now_ns() - thread_start_ns < (uint64_t)ECAT_STARTUP_TIMEOUT_MS * 1000000ULL);
+    soem_mailbox_set_supervision(1);
     
     // Verify slaves are still operational
     for (i = 1; i <= ec_slavecount; i++) {
@@ -677,32 +1351,199 @@ int soem_interface_init_enhanced(const char *ifname) {
             return -1;
         }
     }
+    startup_phase_end("cyclic thread");
+
+    // Remember the drives configured in full; the next start can skip their setup
+    for (i = 0; i < axis_count && config_cache_enabled; i++) {
+        if (axes[i].kind != SOEM_AXIS_DRIVE || axes[i].config_cached || !axes[i].config_verified) continue;
+        if (soem_config_cache_store(SOEM_CONFIG_CACHE_PATH, &axes[i].config) == 0) {
+            printf("SOEM_Interface: Cached the configuration of slave %u\n", axes[i].slave);
+        }
+    }
     
+    print_startup_phases();
     printf("SOEM_Interface: Synapticon 14-bit encoder initialization completed successfully\n");
     return 0;
 }
 
-void soem_interface_send_and_receive_pdo(float target_torque) {
+int soem_interface_set_cycle_time(uint32_t cycle_time_us) {
+    if (master_initialized) {
+        fprintf(stderr, "SOEM_Interface: Cycle time cannot be changed while the master is running\n");
+        return -1;
+    }
+    if (cycle_time_us < SOEM_CYCLE_TIME_MIN_US || cycle_time_us > SOEM_CYCLE_TIME_MAX_US) {
+        fprintf(stderr, "SOEM_Interface: Cycle time %u us out of range (%d-%d us)\n",
+                cycle_time_us, SOEM_CYCLE_TIME_MIN_US, SOEM_CYCLE_TIME_MAX_US);
+        return -1;
+    }
+    cycle_time = (int)cycle_time_us;
+    return 0;
+}
+
+uint32_t soem_interface_get_cycle_time(void) {
+    return (uint32_t)cycle_time;
+}
+
+void soem_interface_set_dc_sync(int enable) {
+    dc_sync_enabled = enable ? 1 : 0;
+}
+
+void soem_interface_set_nic_tuning(int enable) {
+    nic_tuning_enabled = enable ? 1 : 0;
+}
+
+void soem_interface_set_config_cache(int enable) {
+    config_cache_enabled = enable ? 1 : 0;
+}
+
+int64_t soem_interface_get_dc_sync_error_ns(void) {
+    return dc_sync_active ? dc_sync_error_ns : 0;
+}
+
+void soem_interface_set_cycle_callback(soem_cycle_callback_t callback, void *user_data) {
+    atomic_store_explicit(&cycle_callback, NULL, memory_order_release);
+    cycle_callback_data = user_data;
+    atomic_store_explicit(&cycle_callback, callback, memory_order_release);
+}
+
+void soem_interface_set_output_config(const ffb_output_config_t *config) {
+    rt_seqlock_write_begin(&cycle_config_lock);
+    output_config = *config;
+    rt_seqlock_write_end(&cycle_config_lock);
+}
+
+void soem_interface_set_safety_config(const soem_safety_config_t *config) {
+    rt_seqlock_write_begin(&cycle_config_lock);
+    safety_config = *config;
+    rt_seqlock_write_end(&cycle_config_lock);
+}
+
+int soem_interface_set_torque_full_scale(float full_scale) {
+    if (!(full_scale > 0.0f)) {
+        RT_LOG(RT_LOG_ERROR, "SOEM_Interface: Torque full scale must be positive, got %.1f\n", full_scale);
+        return -1;
+    }
+    rt_seqlock_write_begin(&cycle_config_lock);
+    torque_full_scale = full_scale;
+    rt_seqlock_write_end(&cycle_config_lock);
+    return 0;
+}
+
+void soem_interface_set_host_activity_source(uint64_t (*source)(void)) {
+    atomic_store_explicit(&host_activity_source, source, memory_order_release);
+}
+
+uint32_t soem_interface_get_safety_faults(void) {
+    return soem_safety_get_faults(&safety);
+}
+
+void soem_interface_reset_safety_faults(uint32_t faults) {
+    soem_safety_request_reset(&safety, faults);
+}
+
+void soem_interface_send_and_receive_pdo(ffb_torque_t target_torque) {
     if (!master_initialized) return;
+    if (atomic_load_explicit(&cycle_callback, memory_order_relaxed)) return; // Inline engine owns the torque
     
-    pthread_mutex_lock(&pdo_mutex);
-    target_torque_f = target_torque;
-    pthread_mutex_unlock(&pdo_mutex);
+    set_target_torque(wheel, target_torque);
+    // Approximates the sample the caller used by the newest one; they differ only if a
+    // cycle completed in between
+    atomic_store_explicit(&torque_sample_ns, atomic_load_explicit(&latest_sample_ns, memory_order_relaxed),
+                          memory_order_relaxed);
+}
+
+void soem_interface_get_pdo_snapshot(soem_pdo_snapshot_t *snapshot_out) {
+    if (!wheel || soem_interface_get_axis_snapshot((int)(wheel - axes), snapshot_out) != 0) {
+        memset(snapshot_out, 0, sizeof(*snapshot_out));
+    }
+}
+
+// Applied by the EtherCAT thread, combined with the safety supervisor's quick stop
+void soem_interface_request_quick_stop(int active) {
+    atomic_store_explicit(&quick_stop_requested, active ? 1 : 0, memory_order_relaxed);
+}
+
+// Completion of a live tuning write, run by the mailbox thread
+static void log_tuning_result(const soem_mailbox_future_t *future, void *user_data) {
+    RT_LOG(future->result == 0 ? RT_LOG_INFO : RT_LOG_ERROR, "SOEM_Interface: Slave %u %s (0x%04X) %s\n",
+           future->slave_idx, (const char *)user_data, future->index, future->result == 0 ? "updated" : "update failed");
+}
+
+static int queue_tuning_write(int axis, uint16_t index, const void *value, uint16_t size, const char *name) {
+    if (axis < 0 || axis >= axis_count || axes[axis].kind != SOEM_AXIS_DRIVE) return -1;
+    // The drive no longer holds its startup values, so the next start must write them again
+    if (config_cache_enabled) {
+        soem_config_cache_forget(SOEM_CONFIG_CACHE_PATH, &axes[axis].config);
+    }
+    return soem_mailbox_sdo_write(axes[axis].slave, index, 0x00, 0, value, size, NULL, log_tuning_result, (void *)name);
+}
+
+int soem_interface_set_max_torque(int axis, uint16_t max_torque) {
+    if (queue_tuning_write(axis, 0x6072, &max_torque, sizeof(max_torque), "max torque") != 0) return -1;
+    // The full scale follows the new limit from the next cycle on
+    atomic_store_explicit(&axes[axis].max_torque, max_torque, memory_order_relaxed);
+    return 0;
+}
+
+int soem_interface_set_torque_slope(int axis, uint32_t torque_slope) {
+    return queue_tuning_write(axis, 0x6087, &torque_slope, sizeof(torque_slope), "torque slope");
+}
+
+int soem_interface_get_axis_count(void) {
+    return axis_count;
+}
+
+int soem_interface_get_axis_info(int axis, soem_axis_info_t *info_out) {
+    if (axis < 0 || axis >= axis_count) return -1;
+    info_out->slave = axes[axis].slave;
+    info_out->kind = axes[axis].kind;
+    info_out->is_wheel = (&axes[axis] == wheel);
+    snprintf(info_out->name, sizeof(info_out->name), "%s", ec_slave[axes[axis].slave].name);
+    return 0;
+}
+
+void soem_interface_set_axis_torque(int axis, ffb_torque_t target_torque) {
+    if (!master_initialized || axis < 0 || axis >= axis_count) return;
+    if (&axes[axis] == wheel) {
+        soem_interface_send_and_receive_pdo(target_torque);
+    } else if (axes[axis].kind == SOEM_AXIS_DRIVE) {
+        set_target_torque(&axes[axis], target_torque);
+    }
+}
+
+int soem_interface_get_axis_snapshot(int axis, soem_pdo_snapshot_t *snapshot_out) {
+    if (axis < 0 || axis >= axis_count) return -1;
+    soem_axis_t *a = &axes[axis];
+    unsigned int seq;
+    do {
+        seq = rt_seqlock_read_begin(&a->lock);
+        *snapshot_out = a->snapshot;
+    } while (rt_seqlock_read_retry(&a->lock, seq));
+    return 0;
+}
+
+int soem_interface_get_axis_inputs(int axis, uint8_t *inputs_out, int size) {
+    if (axis < 0 || axis >= axis_count || axes[axis].kind != SOEM_AXIS_IO) return -1;
+    soem_axis_t *a = &axes[axis];
+    int copied = (size < (int)a->io_input_bytes) ? size : (int)a->io_input_bytes;
+    unsigned int seq;
+    do {
+        seq = rt_seqlock_read_begin(&a->lock);
+        memcpy(inputs_out, a->io_inputs, (size_t)copied);
+    } while (rt_seqlock_read_retry(&a->lock, seq));
+    return copied;
 }
 
 float soem_interface_get_current_position(void) {
-    pthread_mutex_lock(&pdo_mutex);
-    float raw_pos = current_position_f;
-    pthread_mutex_unlock(&pdo_mutex);
-    return raw_pos;
+    soem_pdo_snapshot_t snapshot;
+    soem_interface_get_pdo_snapshot(&snapshot);
+    return (float)snapshot.position;
 }
 
 float soem_interface_get_current_velocity() {
-    float velocity;
-    pthread_mutex_lock(&pdo_mutex);
-    velocity = current_velocity_f;
-    pthread_mutex_unlock(&pdo_mutex);
-    return velocity;
+    soem_pdo_snapshot_t snapshot;
+    soem_interface_get_pdo_snapshot(&snapshot);
+    return (float)snapshot.velocity;
 }
 
 int soem_interface_get_communication_status() {
@@ -710,14 +1551,19 @@ int soem_interface_get_communication_status() {
 }
 
 cia402_state_t soem_interface_get_cia402_state() {
-    return current_cia402_state;
+    return get_cia402_state(soem_interface_get_statusword());
 }
 
 uint16_t soem_interface_get_statusword() {
-    return current_statusword;
+    soem_pdo_snapshot_t snapshot;
+    soem_interface_get_pdo_snapshot(&snapshot);
+    return snapshot.statusword;
 }
 
 void soem_interface_stop_master() {
+    // Stop supervising first: it would bring the slaves back to OPERATIONAL below
+    soem_mailbox_stop();
+
     if (master_initialized) {
         printf("SOEM_Interface: Stopping EtherCAT master...\n");
 
@@ -727,20 +1573,31 @@ void soem_interface_stop_master() {
         }
 
         // Safe shutdown: disable operation
-        if (somanet_outputs) {
-            somanet_outputs->target_torque = 0;
-            somanet_outputs->controlword = 0x0006; // Shutdown
+        for (int i = 0; i < axis_count; i++) {
+            if (!axes[i].layout_valid) continue;
+            soem_pdo_set_target_torque(&axes[i].layout, 0);
+            soem_pdo_set_controlword(&axes[i].layout, 0x0006); // Shutdown
         }
         ec_send_processdata();
         
         usleep(10000); // Wait 10ms
 
+        if (dc_sync_active) {
+            for (int i = 0; i < axis_count; i++) {
+                if (axes[i].kind == SOEM_AXIS_DRIVE) ec_dcsync0(axes[i].slave, FALSE, 0, 0);
+            }
+            dc_sync_active = 0;
+        }
+
         // Transition to Safe-Op then Init
         soem_interface_set_ethercat_state(0, EC_STATE_SAFE_OP);
         soem_interface_set_ethercat_state(0, EC_STATE_INIT);
 
         ec_close();
+        soem_nic_restore();
         master_initialized = 0;
+        axis_count = 0;
+        wheel = NULL;
         printf("SOEM_Interface: EtherCAT master stopped.\n");
     }
 }
\ No newline at end of file
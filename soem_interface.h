@@ -3,7 +3,8 @@
 #define SOEM_INTERFACE_H
 
 #include <stdint.h>
-#include "ethercat.h" // Include for ec_state
+#include "ffb_output.h"
+#include "soem_safety.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,7 +15,9 @@ extern "C" {
 // Scaling factors for unit conversion
 #define SOEM_POSITION_SCALE_FACTOR (360.0f / 1000000.0f)  // Convert from encoder counts to degrees
 #define SOEM_VELOCITY_SCALE_FACTOR (1.0f / 1000.0f)       // Convert from internal units to deg/s
-#define SOEM_TORQUE_SCALE_FACTOR   (1000.0f)              // Convert from float torque to motor units
+// Torque commands are in engine units (ffb_torque_t); this many is sent as the drive's max
+// torque (0x6072). Same as the max_torque of FFB_PROFILE_DEFAULT.
+#define SOEM_TORQUE_FULL_SCALE_DEFAULT (5000.0f)
 
 // EtherCAT state machine control words
 #define SOEM_CONTROLWORD_SHUTDOWN           0x06  // Ready to switch on
@@ -26,9 +29,23 @@ extern "C" {
 #define SOEM_STATUSWORD_FAULT_MASK          0x08  // Fault bit mask
 #define SOEM_STATUSWORD_OPERATION_ENABLED   0x37  // Operation enabled state
 
+// Drive limits written at startup; both can be changed live
+#define SOEM_MAX_TORQUE_DEFAULT             1000   // 0x6072, per mille of rated torque
+#define SOEM_TORQUE_SLOPE_DEFAULT           10000  // 0x6087, per mille per second
+
 // Modes of operation
 #define SOEM_MODE_CYCLIC_SYNC_TORQUE        0x0A  // Cyclic Synchronous Torque mode
 
+// Cyclic timing (microseconds). The DC-synchronized loop supports 1-4 kHz.
+#define SOEM_CYCLE_TIME_MIN_US              250
+#define SOEM_CYCLE_TIME_MAX_US              1000
+#define SOEM_CYCLE_TIME_DEFAULT_US          1000
+
+// Distributed clock synchronization
+#define SOEM_DC_MASTER_SHIFT_NS             50000  // Master wakes 50us after SYNC0
+#define SOEM_DC_PI_KP_DIV                   100    // Proportional gain = 1/100
+#define SOEM_DC_PI_KI_DIV                   2000   // Integral gain = 1/2000
+
 // --- Error Codes ---
 #define SOEM_SUCCESS                         0
 #define SOEM_ERROR_INIT_FAILED              -1
@@ -49,48 +66,95 @@ typedef enum {
     CIA402_STATE_FAULT
 } cia402_state_t;
 
-// --- PDO Structures for Synapticon ACTILINK-S (Slave 1) ---
-// These structures define the expected PDO layout based on PDO_mapping.md.
-// They are crucial for correct data alignment and size matching with the EtherCAT slave.
-typedef struct PACKED
-{
-    uint16_t controlword;         // 0x6040:0x00 (16 bits)
-    int8_t   modes_of_operation;  // 0x6060:0x00 (8 bits)
-    int16_t  target_torque;       // 0x6071:0x00 (16 bits)
-    //int32  target_position;     // 0x607A:0x00 (32 bits)
-    //int32  target_velocity;     // 0x60FF:0x00 (32 bits)
-    //int16  torque_offset;       // 0x60B2:0x00 (16 bits)
-    //uint32 tuning_command;      // 0x2701:0x00 (32 bits)
-    //uint32 physical_outputs;    // 0x60FE:0x01 (32 bits)
-    //uint32 bit_mask;            // 0x60FE:0x02 (32 bits) - Assuming this is the 'Bit mask' from doc
-    //uint32 user_mosi;           // 0x2703:0x00 (32 bits)
-    //int32  velocity_offset;     // 0x60B1:0x00 (32 bits)
-} somanet_rx_pdo_enhanced_t;
-
-typedef struct PACKED
-{
-    uint16_t statusword;                  // 0x6041:0x00 (16 bits)
-    int8_t   modes_of_operation_display;  // 0x6061:0x00 (8 bits)
-    int32_t  position_actual_value;       // 0x6064:0x00 (32 bits)
-    int32_t  velocity_actual_value;       // 0x606C:0x00 (32 bits)
-    int16_t  torque_actual_value;         // 0x6077:0x00 (16 bits)
-    //uint16 analog_input_1;              // 0x2401:0x00 (16 bits)
-    //uint16 analog_input_2;              // 0x2402:0x00 (16 bits)
-    //uint16 analog_input_3;              // 0x2403:0x00 (16 bits)
-    //uint16 analog_input_4;              // 0x2404:0x00 (16 bits)
-    //uint32 tuning_status;               // 0x2702:0x00 (32 bits)
-    //uint32 digital_inputs;              // 0x60FD:0x00 (32 bits)
-    //uint32 user_miso;                   // 0x2704:0x00 (32 bits)
-    //uint32 timestamp;                   // 0x20F0:0x00 (32 bits)
-    //int32  position_demand_internal_value; // 0x60FC:0x00 (32 bits)
-    //int32  velocity_demand_value;       // 0x606B:0x00 (32 bits)
-    //int16  torque_demand;               // 0x6074:0x00 (16 bits)
-} somanet_tx_pdo_enhanced_t;
+// --- Axes ---
+// Every slave on the segment is an axis, in bus order. CiA 402 drives (device profile 402 in
+// 0x1000) exchange the torque PDOs; other slaves (pedal/shifter I/O terminals) publish their
+// raw input process data. The first drive is the wheel.
+#define SOEM_MAX_AXES                       8
+#define SOEM_AXIS_IO_BYTES                  16     // Input bytes kept per I/O axis
+
+typedef enum {
+    SOEM_AXIS_DRIVE = 0,    // CiA 402 drive in CST mode
+    SOEM_AXIS_IO            // Any other slave, inputs only
+} soem_axis_kind_t;
+
+typedef struct {
+    uint16_t slave;           // 1-based slave index
+    soem_axis_kind_t kind;
+    int is_wheel;             // 1 for the drive that receives the FFB torque
+    char name[32];            // Slave name from the EEPROM
+} soem_axis_info_t;
+
+// --- Cyclic feedback snapshot ---
+// Published by the EtherCAT thread once per cycle through a seqlock, so readers never
+// block the real-time loop.
+typedef struct {
+    int32_t  position;        // 0x6064 Position actual value (encoder counts)
+    int32_t  velocity;        // 0x606C Velocity actual value (drive units)
+    int16_t  torque_actual;   // 0x6077 Torque actual value (per mille of rated torque)
+    uint16_t statusword;      // 0x6041 Statusword
+    uint32_t drive_time_us;   // 0x20F0 Drive time of the sample (microseconds, wraps), 0 if not mapped
+    uint64_t timestamp_ns;    // CLOCK_MONOTONIC time of the PDO exchange
+    uint32_t cycle_count;     // EtherCAT cycle counter at the time of the exchange
+} soem_pdo_snapshot_t;
+
+/**
+ * @brief Per-cycle callback invoked from the EtherCAT thread ("inline" engine mode).
+ * Called after ec_receive_processdata() with the freshest feedback sample; the returned
+ * torque is written to the IOmap and sent with the next ec_send_processdata().
+ * Runs in the real-time thread: it must not block, allocate or do I/O.
+ * @param sample The feedback sample received in this cycle.
+ * @param user_data The pointer passed to soem_interface_set_cycle_callback().
+ * @return The torque command for the next cycle (same units as soem_interface_send_and_receive_pdo()).
+ */
+typedef ffb_torque_t (*soem_cycle_callback_t)(const soem_pdo_snapshot_t *sample, void *user_data);
 
 // --- Function Prototypes ---
 
 /**
- * @brief Initializes the SOEM master and discovers slaves.
+ * @brief Selects the EtherCAT cycle time. Must be called before soem_interface_init_enhanced().
+ * @param cycle_time_us Cycle time in microseconds (SOEM_CYCLE_TIME_MIN_US..SOEM_CYCLE_TIME_MAX_US).
+ * @return 0 on success, -1 if the value is out of range or the master is already running.
+ */
+int soem_interface_set_cycle_time(uint32_t cycle_time_us);
+
+/**
+ * @brief Returns the configured EtherCAT cycle time.
+ * @return The cycle time in microseconds.
+ */
+uint32_t soem_interface_get_cycle_time(void);
+
+/**
+ * @brief Enables or disables distributed-clock SYNC0 synchronization.
+ * Must be called before soem_interface_init_enhanced(). Enabled by default.
+ * @param enable 1 to synchronize the drive and master to the DC reference clock, 0 to free-run.
+ */
+void soem_interface_set_dc_sync(int enable);
+
+/**
+ * @brief Enables or disables the NIC preparation stage (soem_nic.h): interrupt coalescing off,
+ * busy polling, socket priority. Must be called before soem_interface_init_enhanced(). Enabled by default.
+ * @param enable 1 to tune the NIC and socket, 0 to leave them as configured by the system.
+ */
+void soem_interface_set_nic_tuning(int enable);
+
+/**
+ * @brief Enables or disables the drive configuration cache (soem_config_cache.h). With the cache a
+ * drive that is still configured from the last run skips its PDO remapping, mapping readback and
+ * parameter writes. Must be called before soem_interface_init_enhanced(). Enabled by default.
+ * @param enable 1 to use and update SOEM_CONFIG_CACHE_PATH, 0 to configure every drive in full.
+ */
+void soem_interface_set_config_cache(int enable);
+
+/**
+ * @brief Returns the last measured phase error between the master cycle and the DC reference time.
+ * @return The phase error in nanoseconds (0 when DC synchronization is inactive).
+ */
+int64_t soem_interface_get_dc_sync_error_ns(void);
+
+/**
+ * @brief Initializes the SOEM master and discovers slaves. Does not touch HID or logging and
+ * may run on a thread of its own while those start. Prints the duration of each phase.
  * @param ifname The network interface name (e.g., "eth0").
  * @return 0 on success, -1 on failure.
  */
@@ -99,9 +163,135 @@ int soem_interface_init_enhanced(const char *ifname);
 /**
  * @brief Sends target torque to the EtherCAT thread.
  * The actual PDO communication happens in the EtherCAT thread.
- * @param target_torque The desired torque to send to the servo motor.
+ * @param target_torque The desired torque in engine units, see soem_interface_set_torque_full_scale().
+ */
+void soem_interface_send_and_receive_pdo(ffb_torque_t target_torque);
+
+/**
+ * @brief Registers a callback that computes the torque inside the EtherCAT cycle.
+ * While a callback is registered, values passed to soem_interface_send_and_receive_pdo()
+ * are ignored. Pass NULL to return to externally supplied torque.
+ * @param callback The per-cycle callback, or NULL.
+ * @param user_data Opaque pointer handed to the callback.
+ */
+void soem_interface_set_cycle_callback(soem_cycle_callback_t callback, void *user_data);
+
+/**
+ * @brief Configures the output stage every drive's torque command passes through in the
+ * EtherCAT cycle (reconstruction, notch/low-pass and slew limit, see ffb_output.h). Taken over
+ * at the start of the next cycle, keeping the filter state. One writer thread at a time.
+ * @param config Filters and limits; FFB_OUTPUT_CONFIG_DEFAULT until this is called.
+ */
+void soem_interface_set_output_config(const ffb_output_config_t *config);
+
+/**
+ * @brief Configures the safety supervisor stepped in the EtherCAT cycle (deadlines and ramp,
+ * see soem_safety.h). Taken over at the start of the next cycle with the output stage; latched
+ * faults stay. One writer thread at a time, the same as for soem_interface_set_output_config().
+ * @param config Deadlines and ramp; SOEM_SAFETY_CONFIG_DEFAULT until this is called.
  */
-void soem_interface_send_and_receive_pdo(float target_torque);
+void soem_interface_set_safety_config(const soem_safety_config_t *config);
+
+/**
+ * @brief Sets the engine torque that is commanded as each drive's max torque (0x6072), i.e.
+ * the profile's max_torque: a command of full_scale is written as 0x6072 per mille to the
+ * target torque (0x6071). Taken over at the start of the next cycle and again whenever
+ * soem_interface_set_max_torque() changes a drive's limit. Same writer thread as
+ * soem_interface_set_output_config().
+ * @param full_scale Engine torque units; SOEM_TORQUE_FULL_SCALE_DEFAULT until this is called.
+ * @return 0 on success, -1 if full_scale is not positive.
+ */
+int soem_interface_set_torque_full_scale(float full_scale);
+
+/**
+ * @brief Sets where the supervisor reads the last host activity from: a function returning
+ * the CLOCK_MONOTONIC time of the last FFB report from the host, or 0 while the deadline does
+ * not apply (no report yet, no effect playing). Called every cycle from the EtherCAT thread,
+ * so it must not block. NULL disables the HID deadline.
+ */
+void soem_interface_set_host_activity_source(uint64_t (*source)(void));
+
+/**
+ * @brief Returns the latched safety faults (soem_safety_fault_t bits), 0 if none.
+ */
+uint32_t soem_interface_get_safety_faults(void);
+
+/**
+ * @brief Clears the given latched safety faults whose condition is gone, at the next cycle.
+ * Once none is latched the torque ramps back up, and a quick stop from a hard fault is
+ * released unless one was requested with soem_interface_request_quick_stop().
+ * @param faults soem_safety_fault_t bits to clear, SOEM_SAFETY_ALL_FAULTS for all.
+ */
+void soem_interface_reset_safety_faults(uint32_t faults);
+
+/**
+ * @brief Copies the latest cyclic feedback published by the EtherCAT thread.
+ * Never blocks the EtherCAT thread; retries internally if a cycle update is in progress.
+ * @param snapshot_out Destination for the snapshot.
+ */
+void soem_interface_get_pdo_snapshot(soem_pdo_snapshot_t *snapshot_out);
+
+/**
+ * @brief Requests (1) or releases (0) a CiA 402 quick stop on every drive. The drives are
+ * enabled again automatically once released and no hard safety fault is latched. State changes are reported through
+ * soem_cia402_poll_event() (soem_cia402.h).
+ */
+void soem_interface_request_quick_stop(int active);
+
+/**
+ * @brief Changes the max torque (0x6072) of a drive axis during operation. The SDO write is
+ * queued to the mailbox thread and its outcome logged; the cycle is not affected.
+ * @param axis Axis number.
+ * @param max_torque Per mille of rated torque.
+ * @return 0 if queued, -1 if the axis is not a drive or the mailbox queue is full.
+ */
+int soem_interface_set_max_torque(int axis, uint16_t max_torque);
+
+/**
+ * @brief Changes the torque slope (0x6087) of a drive axis during operation, like
+ * soem_interface_set_max_torque().
+ * @param torque_slope Per mille of rated torque per second.
+ * @return 0 if queued, -1 otherwise.
+ */
+int soem_interface_set_torque_slope(int axis, uint32_t torque_slope);
+
+/**
+ * @brief Returns the number of axes found on the segment (0 before initialization).
+ */
+int soem_interface_get_axis_count(void);
+
+/**
+ * @brief Describes one axis.
+ * @param axis Axis number, 0 to soem_interface_get_axis_count() - 1.
+ * @param info_out Destination for the description.
+ * @return 0 on success, -1 if the axis does not exist.
+ */
+int soem_interface_get_axis_info(int axis, soem_axis_info_t *info_out);
+
+/**
+ * @brief Sets the target torque of a drive axis for the next cycle (e.g. active pedal feel).
+ * For the wheel this is soem_interface_send_and_receive_pdo(); ignored for I/O axes.
+ * @param axis Axis number.
+ * @param target_torque Torque in the same engine units as the wheel.
+ */
+void soem_interface_set_axis_torque(int axis, ffb_torque_t target_torque);
+
+/**
+ * @brief Copies the latest feedback of a drive axis, published in the same cycle as the wheel's.
+ * @param axis Axis number.
+ * @param snapshot_out Destination for the snapshot (only timestamp and cycle for I/O axes).
+ * @return 0 on success, -1 if the axis does not exist.
+ */
+int soem_interface_get_axis_snapshot(int axis, soem_pdo_snapshot_t *snapshot_out);
+
+/**
+ * @brief Copies the latest raw input process data of an I/O axis.
+ * @param axis Axis number.
+ * @param inputs_out Destination buffer.
+ * @param size Size of the buffer in bytes.
+ * @return Number of bytes copied, or -1 if the axis is not an I/O axis.
+ */
+int soem_interface_get_axis_inputs(int axis, uint8_t *inputs_out, int size);
 
 /**
  * @brief Returns the last known position from the servo motor.
@@ -162,16 +352,20 @@ int soem_interface_write_sdo(uint16_t slave_idx, uint16_t index, uint8_t subinde
 int soem_interface_read_sdo(uint16_t slave_idx, uint16_t index, uint8_t subindex, uint16_t data_size, void *data);
 
 /**
- * @brief Attempts to set a specific EtherCAT slave to a desired state.
+ * @brief Attempts to set a specific EtherCAT slave to a desired state. The AL state is polled at
+ * growing intervals and each retry waits twice as long as the one before, so fast slaves are not
+ * held up by fixed delays. Process data is exchanged while waiting for OPERATIONAL.
  * @param slave_idx The index of the slave (0 for all slaves, 1-based for specific).
- * @param desired_state The target EtherCAT state (e.g., EC_STATE_PRE_OP, EC_STATE_OPERATIONAL).
+ * @param desired_state The target EtherCAT state (SOEM ec_state, e.g. EC_STATE_PRE_OP, EC_STATE_OPERATIONAL).
  * @return 0 on success, -1 on failure.
  */
-int soem_interface_set_ethercat_state(uint16_t slave_idx, ec_state desired_state);
+int soem_interface_set_ethercat_state(uint16_t slave_idx, uint16_t desired_state);
 
 /**
  * @brief Configures PDO mapping dynamically for a specific slave.
- * This function implements the steps for dynamic PDO remapping as per Synapticon documentation.
+ * This function implements the steps for dynamic PDO remapping as per Synapticon documentation:
+ * the PDO becomes the only one assigned to its sync manager. The slave must be in PRE_OP.
+ * Nothing is written if the drive already has this mapping.
  * @param slave_idx The index of the slave (1-based).
  * @param pdo_assign_idx The index of the PDO Assign object (e.g., 0x1C12 for RxPDO, 0x1C13 for TxPDO).
  * @param pdo_map_idx The index of the PDO Mapping object (e.g., 0x1600 for RxPDO, 0x1A00 for TxPDO).
@@ -218,22 +412,16 @@ int is_slave_operational(int slave_idx);
  * @param state The EtherCAT state value.
  * @return A string representation of the state.
  */
-const char* get_state_name(uint16 state);
+const char* get_state_name(uint16_t state);
 
 /**
- * @brief Initializes CiA 402 parameters for a specific slave.
+ * @brief Initializes CiA 402 parameters for a specific slave. Each parameter is read back
+ *        first and written only if the drive holds a different value.
  * @param slave_idx The index of the slave to initialize.
- * @return 0 on success, -1 on failure.
+ * @return 0 on success, 1 if optional parameters were refused, -1 on failure.
  */
 int initialize_cia402_parameters(uint16_t slave_idx);
 
-/**
- * @brief Performs CiA 402 state machine transition to operational state.
- * @param slave_idx The index of the slave.
- * @return 0 on success, -1 on failure.
- */
-int perform_cia402_transition_to_operational(uint16_t slave_idx);
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,236 @@
+// soem_interface_mock.c - Offline stand-in for soem_interface.c used by ffb_replay
+//
+// Implements the cyclic API of soem_interface.h (cycle configuration, torque command and
+// output stage, feedback snapshots, status) on top of a simulated wheel. Time only advances in
+// soem_interface_mock_step(), so a replay runs as fast as the host allows and is
+// deterministic. SDO access and the EtherCAT/CiA 402 state helpers are not provided.
+#include "soem_interface_mock.h"
+#include <stdio.h>
+#include <math.h>
+
+#define MOCK_SUBSTEPS 4             // Integration steps per cycle
+#define MOCK_STATUSWORD_OPERATION_ENABLED 0x0237
+
+static soem_mock_plant_t plant = SOEM_MOCK_PLANT_DEFAULT;
+static uint32_t cycle_time_us = SOEM_CYCLE_TIME_DEFAULT_US;
+static int dc_sync_enabled = 1;
+static int master_running = 0;
+
+static double angle_rad = 0.0;
+static double velocity_rad_s = 0.0;
+static ffb_torque_t torque_command = 0;
+static uint32_t torque_updates = 0;
+static float drive_torque = 0.0f;       // Torque command after the output stage, engine units
+static ffb_output_t output;
+static ffb_output_config_t output_config = FFB_OUTPUT_CONFIG_DEFAULT;
+static uint64_t sim_time_ns = 0;
+static soem_pdo_snapshot_t snapshot;
+
+static soem_cycle_callback_t cycle_callback = NULL;
+static void *cycle_callback_data = NULL;
+
+static void publish_snapshot(void) {
+    double rpm = velocity_rad_s * 60.0 / (2.0 * M_PI);
+    snapshot.position = (int32_t)lround(angle_rad / (2.0 * M_PI) * SOEM_MOCK_COUNTS_PER_REV);
+    snapshot.velocity = (int32_t)lround(rpm * SOEM_MOCK_VELOCITY_UNITS_PER_RPM);
+    snapshot.torque_actual = (int16_t)lround(fmax(-32767.0, fmin(32767.0, drive_torque * plant.torque_per_unit * 100.0)));
+    snapshot.statusword = MOCK_STATUSWORD_OPERATION_ENABLED;
+    snapshot.drive_time_us = (uint32_t)(sim_time_ns / 1000);
+    snapshot.timestamp_ns = sim_time_ns;
+    snapshot.cycle_count++;
+}
+
+static void integrate(double dt) {
+    double motor = drive_torque * plant.torque_per_unit;
+    double hands = -plant.hand_stiffness * angle_rad - plant.hand_damping * velocity_rad_s;
+    double driving = motor + hands - plant.damping * velocity_rad_s;
+
+    // Coulomb friction opposes motion; at rest it holds until the torque exceeds it
+    if (fabs(velocity_rad_s) < 1e-6 && fabs(driving) <= plant.friction) {
+        velocity_rad_s = 0.0;
+        return;
+    }
+    double direction = (velocity_rad_s != 0.0) ? copysign(1.0, velocity_rad_s) : copysign(1.0, driving);
+    double next = velocity_rad_s + (driving - plant.friction * direction) / plant.inertia * dt;
+    // Friction can stop the wheel but never reverse it within a step
+    if (velocity_rad_s != 0.0 && (next * velocity_rad_s) < 0.0) {
+        next = 0.0;
+    }
+    velocity_rad_s = next;
+    angle_rad += velocity_rad_s * dt; // Semi-implicit Euler
+}
+
+/**
+ * @brief Replaces the plant parameters and puts the wheel back at rest at position 0.
+ */
+void soem_interface_mock_set_plant(const soem_mock_plant_t *new_plant) {
+    plant = *new_plant;
+    angle_rad = 0.0;
+    velocity_rad_s = 0.0;
+    publish_snapshot();
+}
+
+/**
+ * @brief Runs one EtherCAT cycle of simulated time.
+ */
+void soem_interface_mock_step(void) {
+    if (cycle_callback) {
+        torque_command = cycle_callback(&snapshot, cycle_callback_data);
+        torque_updates++;
+    }
+    drive_torque = ffb_torque_to_float(ffb_output_step(&output, torque_command, torque_updates));
+    double dt = cycle_time_us * 1e-6 / MOCK_SUBSTEPS;
+    for (int i = 0; i < MOCK_SUBSTEPS; i++) {
+        integrate(dt);
+    }
+    sim_time_ns += (uint64_t)cycle_time_us * 1000ULL;
+    publish_snapshot();
+}
+
+/**
+ * @brief Returns the simulated time in nanoseconds.
+ */
+uint64_t soem_interface_mock_time_ns(void) {
+    return sim_time_ns;
+}
+
+int soem_interface_set_cycle_time(uint32_t cycle_time) {
+    if (cycle_time < SOEM_CYCLE_TIME_MIN_US || cycle_time > SOEM_CYCLE_TIME_MAX_US) {
+        fprintf(stderr, "SOEM_Mock: cycle time %u us out of range (%d-%d)\n",
+                cycle_time, SOEM_CYCLE_TIME_MIN_US, SOEM_CYCLE_TIME_MAX_US);
+        return -1;
+    }
+    if (master_running) return -1;
+    cycle_time_us = cycle_time;
+    return 0;
+}
+
+uint32_t soem_interface_get_cycle_time(void) {
+    return cycle_time_us;
+}
+
+void soem_interface_set_dc_sync(int enable) {
+    dc_sync_enabled = enable;
+}
+
+int64_t soem_interface_get_dc_sync_error_ns(void) {
+    return 0; // The simulated cycle is exact
+}
+
+int soem_interface_init_enhanced(const char *ifname) {
+    printf("SOEM_Mock: simulated drive on '%s' (cycle %u us, DC sync %s)\n",
+           ifname, cycle_time_us, dc_sync_enabled ? "on" : "off");
+    angle_rad = 0.0;
+    velocity_rad_s = 0.0;
+    torque_command = 0;
+    drive_torque = 0.0f;
+    ffb_output_init(&output, cycle_time_us * 1e-6f, &output_config);
+    sim_time_ns = 0;
+    snapshot.cycle_count = 0;
+    publish_snapshot();
+    master_running = 1;
+    return 0;
+}
+
+void soem_interface_send_and_receive_pdo(ffb_torque_t target_torque) {
+    if (!cycle_callback) {
+        torque_command = target_torque;
+        torque_updates++;
+    }
+}
+
+void soem_interface_set_output_config(const ffb_output_config_t *config) {
+    output_config = *config;
+    if (master_running) ffb_output_configure(&output, config);
+}
+
+void soem_interface_set_cycle_callback(soem_cycle_callback_t callback, void *user_data) {
+    cycle_callback_data = user_data;
+    cycle_callback = callback;
+}
+
+void soem_interface_get_pdo_snapshot(soem_pdo_snapshot_t *snapshot_out) {
+    *snapshot_out = snapshot;
+}
+
+// The simulated drive is always in OPERATION_ENABLED and has no CiA 402 state machine
+void soem_interface_request_quick_stop(int active) {
+    (void)active;
+}
+
+// Replays are not supervised: nothing goes stale on the simulated clock
+void soem_interface_set_safety_config(const soem_safety_config_t *config) {
+    (void)config;
+}
+
+// The plant takes engine units directly; there is no drive limit to scale to
+int soem_interface_set_torque_full_scale(float full_scale) {
+    return full_scale > 0.0f ? 0 : -1;
+}
+
+void soem_interface_set_host_activity_source(uint64_t (*source)(void)) {
+    (void)source;
+}
+
+uint32_t soem_interface_get_safety_faults(void) {
+    return 0;
+}
+
+void soem_interface_reset_safety_faults(uint32_t faults) {
+    (void)faults;
+}
+
+// The simulated segment has a single axis: the wheel
+int soem_interface_get_axis_count(void) {
+    return 1;
+}
+
+int soem_interface_get_axis_info(int axis, soem_axis_info_t *info_out) {
+    if (axis != 0) return -1;
+    info_out->slave = 1;
+    info_out->kind = SOEM_AXIS_DRIVE;
+    info_out->is_wheel = 1;
+    snprintf(info_out->name, sizeof(info_out->name), "Simulated wheel");
+    return 0;
+}
+
+void soem_interface_set_axis_torque(int axis, ffb_torque_t target_torque) {
+    if (axis == 0) soem_interface_send_and_receive_pdo(target_torque);
+}
+
+int soem_interface_get_axis_snapshot(int axis, soem_pdo_snapshot_t *snapshot_out) {
+    if (axis != 0) return -1;
+    *snapshot_out = snapshot;
+    return 0;
+}
+
+int soem_interface_get_axis_inputs(int axis, uint8_t *inputs_out, int size) {
+    (void)axis; (void)inputs_out; (void)size;
+    return -1;
+}
+
+float soem_interface_get_current_position(void) {
+    return (float)(angle_rad * 180.0 / M_PI);
+}
+
+float soem_interface_get_current_velocity(void) {
+    return (float)(velocity_rad_s * 180.0 / M_PI);
+}
+
+int soem_interface_get_communication_status(void) {
+    return master_running;
+}
+
+cia402_state_t soem_interface_get_cia402_state(void) {
+    return master_running ? CIA402_STATE_OPERATION_ENABLED : CIA402_STATE_SWITCH_ON_DISABLED;
+}
+
+uint16_t soem_interface_get_statusword(void) {
+    return snapshot.statusword;
+}
+
+void soem_interface_stop_master(void) {
+    torque_command = 0;
+    drive_torque = 0.0f;
+    master_running = 0;
+}
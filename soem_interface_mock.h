@@ -0,0 +1,43 @@
+// soem_interface_mock.h - Simulated drive and wheel behind the cyclic part of soem_interface.h
+#ifndef SOEM_INTERFACE_MOCK_H
+#define SOEM_INTERFACE_MOCK_H
+
+#include <stdint.h>
+#include "soem_interface.h"
+
+// Encoder and velocity units reported by the simulated drive (match the Synapticon setup)
+#define SOEM_MOCK_COUNTS_PER_REV 65536.0
+#define SOEM_MOCK_VELOCITY_UNITS_PER_RPM 1.0
+
+// Rigid wheel: inertia * dw/dt = motor torque - damping * w - Coulomb friction - driver's hands
+typedef struct {
+    double inertia;             // kg m^2, rotor plus wheel rim
+    double damping;             // N m s/rad, viscous losses
+    double friction;            // N m, Coulomb friction (also holds the wheel at rest)
+    double torque_per_unit;     // N m per torque command unit
+    double hand_stiffness;      // N m/rad towards center, 0 = hands off
+    double hand_damping;        // N m s/rad
+} soem_mock_plant_t;
+
+#define SOEM_MOCK_PLANT_DEFAULT { \
+    .inertia = 0.05, .damping = 0.02, .friction = 0.05, \
+    .torque_per_unit = 20.0 / 5000.0, .hand_stiffness = 5.0, .hand_damping = 0.3 }
+
+/**
+ * @brief Replaces the plant parameters and puts the wheel back at rest at position 0.
+ */
+void soem_interface_mock_set_plant(const soem_mock_plant_t *plant);
+
+/**
+ * @brief Runs one EtherCAT cycle of simulated time.
+ *        Calls the cycle callback (if registered) with the current sample, applies the torque
+ *        command for one cycle and publishes the next sample.
+ */
+void soem_interface_mock_step(void);
+
+/**
+ * @brief Returns the simulated time in nanoseconds (advanced by soem_interface_mock_step()).
+ */
+uint64_t soem_interface_mock_time_ns(void);
+
+#endif // SOEM_INTERFACE_MOCK_H
@@ -0,0 +1,292 @@
+// soem_mailbox.c - Mailbox worker thread: asynchronous CoE SDO access and slave state supervision
+#include "soem_mailbox.h"
+#include "rt_log.h"
+#include "rt_threads.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+// --- SOEM Library Includes ---
+#include "ethercat.h"
+
+typedef enum {
+    MAILBOX_SDO_WRITE = 0,
+    MAILBOX_SDO_READ
+} mailbox_op_t;
+
+typedef struct {
+    uint8_t op;                             // mailbox_op_t
+    uint8_t complete_access;
+    uint16_t slave_idx;
+    uint16_t index;
+    uint8_t subindex;
+    uint16_t size;
+    uint8_t data[SOEM_MAILBOX_MAX_DATA];    // Write data
+    soem_mailbox_future_t *future;
+    soem_mailbox_callback_t callback;
+    void *user_data;
+} mailbox_request_t;
+
+// Requests come from non real-time threads (startup, main loop), so a mutex is fine here
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond;            // Request queued or stop; CLOCK_MONOTONIC
+static pthread_cond_t done_cond;            // A request completed; CLOCK_MONOTONIC
+static mailbox_request_t queue[SOEM_MAILBOX_QUEUE_SIZE];
+static unsigned int queue_head = 0;         // Next request to run
+static unsigned int queue_count = 0;
+
+static pthread_t mailbox_thread;
+static int worker_running = 0;
+static int stop_requested = 0;
+static atomic_int supervision_enabled = 0;
+static atomic_int all_operational = 0;
+
+static void deadline_after_ms(struct timespec *ts, int ms) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+static void run_request(mailbox_request_t *request) {
+    soem_mailbox_future_t local;
+    soem_mailbox_future_t *future = request->future ? request->future : &local;
+    int wkc_sdo;
+
+    future->slave_idx = request->slave_idx;
+    future->index = request->index;
+    future->subindex = request->subindex;
+    if (request->op == MAILBOX_SDO_WRITE) {
+        wkc_sdo = ec_SDOwrite(request->slave_idx, request->index, request->subindex, request->complete_access ? TRUE : FALSE,
+                              request->size, request->data, SOEM_MAILBOX_SDO_TIMEOUT_US);
+        future->size = request->size;
+    } else {
+        int size = request->size;
+        wkc_sdo = ec_SDOread(request->slave_idx, request->index, request->subindex, request->complete_access ? TRUE : FALSE,
+                             &size, future->data, SOEM_MAILBOX_SDO_TIMEOUT_US);
+        future->size = (uint16_t)size;
+    }
+    future->result = (wkc_sdo > 0) ? 0 : -1;
+    if (future->result != 0) {
+        RT_LOG(RT_LOG_ERROR, "SOEM_Mailbox: SDO %s failed for slave %u, index 0x%04X:%02X%s\n",
+               request->op == MAILBOX_SDO_WRITE ? "write" : "read", request->slave_idx, request->index,
+               request->subindex, request->complete_access ? " (complete access)" : "");
+    }
+
+    if (request->callback) {
+        request->callback(future, request->user_data);
+    }
+    if (request->future) {
+        pthread_mutex_lock(&queue_mutex);
+        atomic_store_explicit(&request->future->status, SOEM_MAILBOX_DONE, memory_order_release);
+        pthread_cond_broadcast(&done_cond);
+        pthread_mutex_unlock(&queue_mutex);
+    }
+}
+
+// Reads the AL state of all slaves and steps the ones that left OPERATIONAL back towards it
+static void supervise_slaves(void) {
+    int operational = 1;
+
+    ec_readstate();
+    for (int slave = 1; slave <= ec_slavecount; slave++) {
+        uint16 state = ec_slave[slave].state;
+        if (state == EC_STATE_OPERATIONAL) continue;
+
+        operational = 0;
+        if (state == (EC_STATE_SAFE_OP + EC_STATE_ERROR)) {
+            RT_LOG(RT_LOG_ERROR, "SOEM_Mailbox: Slave %d in SAFE_OP with error (AL status 0x%04X), acknowledging\n",
+                   slave, ec_slave[slave].ALstatuscode);
+            ec_slave[slave].state = EC_STATE_SAFE_OP + EC_STATE_ACK;
+            ec_writestate(slave);
+        } else if (state == EC_STATE_SAFE_OP) {
+            RT_LOG(RT_LOG_INFO, "SOEM_Mailbox: Slave %d in SAFE_OP, requesting OPERATIONAL\n", slave);
+            ec_slave[slave].state = EC_STATE_OPERATIONAL;
+            ec_writestate(slave);
+        } else if (state == EC_STATE_NONE) {
+            RT_LOG(RT_LOG_ERROR, "SOEM_Mailbox: Slave %d does not respond\n", slave);
+        } else {
+            RT_LOG(RT_LOG_INFO, "SOEM_Mailbox: Slave %d in state 0x%02X, not OPERATIONAL\n", slave, state);
+        }
+    }
+    atomic_store_explicit(&all_operational, operational, memory_order_relaxed);
+}
+
+static void *mailbox_loop(void *arg) {
+    (void)arg;
+    struct timespec next_check;
+    deadline_after_ms(&next_check, SOEM_MAILBOX_STATE_CHECK_MS);
+
+    pthread_mutex_lock(&queue_mutex);
+    for (;;) {
+        if (queue_count > 0) {
+            mailbox_request_t request = queue[queue_head];
+            queue_head = (queue_head + 1) % SOEM_MAILBOX_QUEUE_SIZE;
+            queue_count--;
+            pthread_mutex_unlock(&queue_mutex);
+            run_request(&request);
+            pthread_mutex_lock(&queue_mutex);
+            continue;
+        }
+        if (stop_requested) break;
+
+        if (pthread_cond_timedwait(&work_cond, &queue_mutex, &next_check) == ETIMEDOUT) {
+            deadline_after_ms(&next_check, SOEM_MAILBOX_STATE_CHECK_MS);
+            if (atomic_load_explicit(&supervision_enabled, memory_order_relaxed)) {
+                pthread_mutex_unlock(&queue_mutex);
+                supervise_slaves();
+                pthread_mutex_lock(&queue_mutex);
+            }
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return NULL;
+}
+
+/**
+ * @brief Starts the worker thread.
+ */
+int soem_mailbox_start(void) {
+    if (worker_running) return 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&work_cond, &attr);
+    pthread_cond_init(&done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    queue_head = 0;
+    queue_count = 0;
+    stop_requested = 0;
+    atomic_store(&supervision_enabled, 0);
+    atomic_store(&all_operational, 0);
+
+    if (rt_threads_create(RT_THREAD_MAILBOX, &mailbox_thread, mailbox_loop, NULL) != 0) {
+        fprintf(stderr, "SOEM_Mailbox: Failed to create mailbox thread\n");
+        pthread_cond_destroy(&work_cond);
+        pthread_cond_destroy(&done_cond);
+        return -1;
+    }
+    worker_running = 1;
+    return 0;
+}
+
+/**
+ * @brief Completes the queued requests, then stops the worker thread.
+ */
+void soem_mailbox_stop(void) {
+    if (!worker_running) return;
+
+    pthread_mutex_lock(&queue_mutex);
+    stop_requested = 1;
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    pthread_join(mailbox_thread, NULL);
+
+    pthread_cond_destroy(&work_cond);
+    pthread_cond_destroy(&done_cond);
+    worker_running = 0;
+}
+
+/**
+ * @brief Returns 1 while the worker thread runs.
+ */
+int soem_mailbox_is_running(void) {
+    pthread_mutex_lock(&queue_mutex);
+    int running = worker_running && !stop_requested;
+    pthread_mutex_unlock(&queue_mutex);
+    return running;
+}
+
+/**
+ * @brief Switches the periodic slave state supervision on or off.
+ */
+void soem_mailbox_set_supervision(int enable) {
+    atomic_store_explicit(&supervision_enabled, enable ? 1 : 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns 1 if the last supervision pass found every slave OPERATIONAL.
+ */
+int soem_mailbox_all_operational(void) {
+    return atomic_load_explicit(&all_operational, memory_order_relaxed);
+}
+
+static int submit(const mailbox_request_t *request) {
+    if (request->size > SOEM_MAILBOX_MAX_DATA) {
+        fprintf(stderr, "SOEM_Mailbox: SDO 0x%04X:%02X of %u bytes is too large\n",
+                request->index, request->subindex, request->size);
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue_mutex);
+    if (!worker_running || stop_requested || queue_count == SOEM_MAILBOX_QUEUE_SIZE) {
+        pthread_mutex_unlock(&queue_mutex);
+        fprintf(stderr, "SOEM_Mailbox: Cannot queue SDO 0x%04X:%02X (%s)\n", request->index, request->subindex,
+                worker_running && !stop_requested ? "queue full" : "worker not running");
+        return -1;
+    }
+    if (request->future) {
+        atomic_store_explicit(&request->future->status, SOEM_MAILBOX_PENDING, memory_order_relaxed);
+        request->future->result = -1;
+    }
+    queue[(queue_head + queue_count) % SOEM_MAILBOX_QUEUE_SIZE] = *request;
+    queue_count++;
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    return 0;
+}
+
+/**
+ * @brief Queues an SDO download (write).
+ */
+int soem_mailbox_sdo_write(uint16_t slave_idx, uint16_t index, uint8_t subindex, int complete_access,
+                           const void *data, uint16_t size, soem_mailbox_future_t *future,
+                           soem_mailbox_callback_t callback, void *user_data) {
+    mailbox_request_t request = {
+        .op = MAILBOX_SDO_WRITE, .complete_access = complete_access ? 1 : 0, .slave_idx = slave_idx,
+        .index = index, .subindex = subindex, .size = size,
+        .future = future, .callback = callback, .user_data = user_data,
+    };
+    if (size <= sizeof(request.data)) memcpy(request.data, data, size);
+    return submit(&request);
+}
+
+/**
+ * @brief Queues an SDO upload (read).
+ */
+int soem_mailbox_sdo_read(uint16_t slave_idx, uint16_t index, uint8_t subindex, int complete_access,
+                          uint16_t size, soem_mailbox_future_t *future,
+                          soem_mailbox_callback_t callback, void *user_data) {
+    mailbox_request_t request = {
+        .op = MAILBOX_SDO_READ, .complete_access = complete_access ? 1 : 0, .slave_idx = slave_idx,
+        .index = index, .subindex = subindex, .size = size,
+        .future = future, .callback = callback, .user_data = user_data,
+    };
+    return submit(&request);
+}
+
+/**
+ * @brief Waits until the future is done.
+ */
+int soem_mailbox_wait(soem_mailbox_future_t *future, int timeout_ms) {
+    struct timespec deadline;
+    deadline_after_ms(&deadline, timeout_ms > 0 ? timeout_ms : 0);
+
+    pthread_mutex_lock(&queue_mutex);
+    while (!soem_mailbox_is_done(future)) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&done_cond, &queue_mutex);
+        } else if (pthread_cond_timedwait(&done_cond, &queue_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return soem_mailbox_is_done(future) ? future->result : -1;
+}
@@ -0,0 +1,108 @@
+// soem_mailbox.h - Mailbox worker thread: asynchronous CoE SDO access and slave state supervision
+//
+// SDO transfers take a mailbox round trip each and may wait up to SOEM_MAILBOX_SDO_TIMEOUT_US,
+// so they are queued to a worker thread instead of running on the caller. The caller gets a
+// future to wait on or poll, or a callback run by the worker. While supervision is on, the
+// worker also reads the AL state of all slaves every SOEM_MAILBOX_STATE_CHECK_MS and brings
+// slaves that dropped out of OPERATIONAL back, which the cyclic thread used to do inline.
+// The EtherCAT thread never calls into this module.
+#ifndef SOEM_MAILBOX_H
+#define SOEM_MAILBOX_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SOEM_MAILBOX_QUEUE_SIZE        64      // Pending requests
+#define SOEM_MAILBOX_MAX_DATA          32      // Bytes per SDO transfer (enough for a complete access of a small record)
+#define SOEM_MAILBOX_SDO_TIMEOUT_US    50000   // Per transfer, as the blocking helpers used
+#define SOEM_MAILBOX_STATE_CHECK_MS    100     // Slave state supervision period
+
+typedef enum {
+    SOEM_MAILBOX_PENDING = 0,
+    SOEM_MAILBOX_DONE
+} soem_mailbox_status_t;
+
+// Outcome of one request. Owned by the caller and must stay valid until it is done.
+typedef struct {
+    _Atomic int status;                     // soem_mailbox_status_t
+    int result;                             // 0 on success, -1 if the transfer failed
+    uint16_t slave_idx;                     // Request, for callbacks and messages
+    uint16_t index;
+    uint8_t subindex;
+    uint16_t size;                          // Bytes read (reads) or written (writes)
+    uint8_t data[SOEM_MAILBOX_MAX_DATA];    // Read data
+} soem_mailbox_future_t;
+
+// Called by the worker thread when a request completes; must not block for long
+typedef void (*soem_mailbox_callback_t)(const soem_mailbox_future_t *future, void *user_data);
+
+/**
+ * @brief Starts the worker thread (RT_THREAD_MAILBOX role). Call after ec_config_init().
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int soem_mailbox_start(void);
+
+/**
+ * @brief Completes the queued requests, then stops the worker thread.
+ */
+void soem_mailbox_stop(void);
+
+/**
+ * @brief Returns 1 while the worker thread runs. All mailbox traffic must go through it then.
+ */
+int soem_mailbox_is_running(void);
+
+/**
+ * @brief Switches the periodic slave state supervision on or off.
+ */
+void soem_mailbox_set_supervision(int enable);
+
+/**
+ * @brief Returns 1 if the last supervision pass found every slave OPERATIONAL.
+ */
+int soem_mailbox_all_operational(void);
+
+/**
+ * @brief Queues an SDO download (write).
+ * @param slave_idx The index of the slave (1-based).
+ * @param index Object index.
+ * @param subindex Subindex; with complete_access the first subindex written (0 or 1).
+ * @param complete_access 1 to write the consecutive subindices in one transfer.
+ * @param data Value to write, copied at submission.
+ * @param size Size in bytes, at most SOEM_MAILBOX_MAX_DATA.
+ * @param future Filled in on completion, or NULL.
+ * @param callback Run by the worker on completion, or NULL.
+ * @param user_data Handed to the callback.
+ * @return 0 if queued, -1 if the worker is not running, the queue is full or size is too large.
+ */
+int soem_mailbox_sdo_write(uint16_t slave_idx, uint16_t index, uint8_t subindex, int complete_access,
+                           const void *data, uint16_t size, soem_mailbox_future_t *future,
+                           soem_mailbox_callback_t callback, void *user_data);
+
+/**
+ * @brief Queues an SDO upload (read) of up to size bytes into future->data.
+ *        Parameters as for soem_mailbox_sdo_write().
+ * @return 0 if queued, -1 otherwise.
+ */
+int soem_mailbox_sdo_read(uint16_t slave_idx, uint16_t index, uint8_t subindex, int complete_access,
+                          uint16_t size, soem_mailbox_future_t *future,
+                          soem_mailbox_callback_t callback, void *user_data);
+
+/**
+ * @brief Waits until the future is done. A future on the stack must not go out of scope
+ *        before it is done, so such callers wait without a timeout: every transfer ends
+ *        after at most SOEM_MAILBOX_SDO_TIMEOUT_US.
+ * @param future Future of a queued request.
+ * @param timeout_ms Maximum wait in milliseconds, negative to wait until done.
+ * @return The request's result (0 or -1), or -1 on timeout.
+ */
+int soem_mailbox_wait(soem_mailbox_future_t *future, int timeout_ms);
+
+/**
+ * @brief Returns 1 if the request has completed (non-blocking).
+ */
+static inline int soem_mailbox_is_done(const soem_mailbox_future_t *future) {
+    return atomic_load_explicit(&future->status, memory_order_acquire) == SOEM_MAILBOX_DONE;
+}
+
+#endif // SOEM_MAILBOX_H
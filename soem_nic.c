@@ -0,0 +1,115 @@
+// soem_nic.c - ethtool coalescing, busy polling and socket priority for the SOEM raw socket
+#include "soem_nic.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/if_packet.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+static struct ethtool_coalesce saved_coalesce;
+static int coalesce_changed = 0;
+static char saved_ifname[IFNAMSIZ];
+
+static int ethtool_ioctl(const char *ifname, void *data) {
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = data;
+    int ret = ioctl(fd, SIOCETHTOOL, &ifr);
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return ret;
+}
+
+// Interrupt per frame: no delay and no frame batching in either direction
+static int disable_coalescing(const char *ifname) {
+    struct ethtool_coalesce coalesce = { .cmd = ETHTOOL_GCOALESCE };
+    if (ethtool_ioctl(ifname, &coalesce) != 0) {
+        printf("SOEM_NIC: %s does not report interrupt coalescing (%s), left as is\n", ifname, strerror(errno));
+        return -1;
+    }
+    if (coalesce.rx_coalesce_usecs == 0 && coalesce.rx_max_coalesced_frames <= 1 &&
+        coalesce.tx_coalesce_usecs == 0 && coalesce.tx_max_coalesced_frames <= 1 &&
+        !coalesce.use_adaptive_rx_coalesce && !coalesce.use_adaptive_tx_coalesce) {
+        printf("SOEM_NIC: interrupt coalescing on %s already off\n", ifname);
+        return 0;
+    }
+
+    saved_coalesce = coalesce;
+    coalesce.cmd = ETHTOOL_SCOALESCE;
+    coalesce.rx_coalesce_usecs = 0;
+    coalesce.rx_max_coalesced_frames = 1;
+    coalesce.tx_coalesce_usecs = 0;
+    coalesce.tx_max_coalesced_frames = 1;
+    coalesce.use_adaptive_rx_coalesce = 0;
+    coalesce.use_adaptive_tx_coalesce = 0;
+    if (ethtool_ioctl(ifname, &coalesce) != 0) {
+        printf("SOEM_NIC: cannot change interrupt coalescing on %s (%s), was rx %u us/%u frames\n",
+               ifname, strerror(errno), saved_coalesce.rx_coalesce_usecs, saved_coalesce.rx_max_coalesced_frames);
+        return -1;
+    }
+    snprintf(saved_ifname, sizeof(saved_ifname), "%s", ifname);
+    coalesce_changed = 1;
+    printf("SOEM_NIC: interrupt coalescing on %s off (was rx %u us/%u frames, tx %u us/%u frames)\n",
+           ifname, saved_coalesce.rx_coalesce_usecs, saved_coalesce.rx_max_coalesced_frames,
+           saved_coalesce.tx_coalesce_usecs, saved_coalesce.tx_max_coalesced_frames);
+    return 0;
+}
+
+static int set_socket_option(int sockfd, int level, int option, int value, const char *name) {
+    if (setsockopt(sockfd, level, option, &value, sizeof(value)) != 0) {
+        printf("SOEM_NIC: %s=%d not applied (%s)\n", name, value, strerror(errno));
+        return -1;
+    }
+    printf("SOEM_NIC: %s=%d\n", name, value);
+    return 0;
+}
+
+/**
+ * @brief Prepares the EtherCAT NIC and socket for low round-trip latency.
+ */
+int soem_nic_prepare(const char *ifname, int sockfd) {
+    int applied = 0;
+
+    if (disable_coalescing(ifname) == 0) applied++;
+    if (sockfd < 0) {
+        printf("SOEM_NIC: no socket, socket options skipped\n");
+        return applied;
+    }
+
+    // ec_receive_processdata() polls the socket right after sending: spin on the NIC
+    // queue instead of waiting for the interrupt and the softirq
+    if (set_socket_option(sockfd, SOL_SOCKET, SO_BUSY_POLL, SOEM_NIC_BUSY_POLL_US, "SO_BUSY_POLL") == 0) applied++;
+#ifdef SO_PREFER_BUSY_POLL
+    if (set_socket_option(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, 1, "SO_PREFER_BUSY_POLL") == 0) applied++;
+#endif
+    if (set_socket_option(sockfd, SOL_SOCKET, SO_PRIORITY, SOEM_NIC_SOCKET_PRIORITY, "SO_PRIORITY") == 0) applied++;
+    // Frames go straight to the driver, not through the (possibly busy) qdisc
+    if (set_socket_option(sockfd, SOL_PACKET, PACKET_QDISC_BYPASS, 1, "PACKET_QDISC_BYPASS") == 0) applied++;
+    return applied;
+}
+
+/**
+ * @brief Restores the interrupt coalescing settings changed by soem_nic_prepare().
+ */
+void soem_nic_restore(void) {
+    if (!coalesce_changed) return;
+    saved_coalesce.cmd = ETHTOOL_SCOALESCE;
+    if (ethtool_ioctl(saved_ifname, &saved_coalesce) != 0) {
+        fprintf(stderr, "SOEM_NIC: failed to restore interrupt coalescing on %s: %s\n", saved_ifname, strerror(errno));
+    }
+    coalesce_changed = 0;
+}
@@ -0,0 +1,24 @@
+// soem_nic.h - Low-latency tuning of the NIC and raw socket used by SOEM
+#ifndef SOEM_NIC_H
+#define SOEM_NIC_H
+
+#define SOEM_NIC_BUSY_POLL_US 50      // SO_BUSY_POLL: spin on the NIC queue this long before sleeping
+#define SOEM_NIC_SOCKET_PRIORITY 6    // SO_PRIORITY, highest value allowed without CAP_NET_ADMIN
+
+/**
+ * @brief Prepares the EtherCAT NIC and socket for low round-trip latency:
+ *        interrupt coalescing off (ethtool), busy polling, socket priority and qdisc bypass.
+ *        Every step is best effort; unsupported ones are reported and skipped.
+ *        The original coalescing settings are restored by soem_nic_restore().
+ * @param ifname EtherCAT network interface.
+ * @param sockfd SOEM's raw socket.
+ * @return The number of steps that were applied.
+ */
+int soem_nic_prepare(const char *ifname, int sockfd);
+
+/**
+ * @brief Restores the interrupt coalescing settings changed by soem_nic_prepare().
+ */
+void soem_nic_restore(void);
+
+#endif // SOEM_NIC_H
@@ -0,0 +1,204 @@
+// soem_pdo.c - PDO mapping table, remapping and mapping readback for the SOMANET drive
+#include "soem_pdo.h"
+#include "soem_interface.h"
+#include "soem_config_cache.h"
+#include <stdio.h>
+
+#define PDO_MAX_ENTRIES 32      // Entries read back per PDO
+#define PDO_MAX_ASSIGNED 8      // PDOs read back per sync manager
+
+typedef struct {
+    uint16_t index;
+    uint8_t subindex;
+    uint8_t bits;
+    uint8_t required;           // 0: the layout is usable without it
+    const char *name;
+} pdo_object_t;
+
+// Mapped in this order. Everything the FFB loop needs, plus the drive's sample timestamp.
+static const pdo_object_t pdo_objects[SOEM_PDO_OBJECT_COUNT] = {
+    [SOEM_PDO_CONTROLWORD]        = { 0x6040, 0x00, 16, 1, "Controlword" },
+    [SOEM_PDO_MODES_OF_OPERATION] = { 0x6060, 0x00,  8, 1, "Modes of operation" },
+    [SOEM_PDO_TARGET_TORQUE]      = { 0x6071, 0x00, 16, 1, "Target torque" },
+    [SOEM_PDO_STATUSWORD]         = { 0x6041, 0x00, 16, 1, "Statusword" },
+    [SOEM_PDO_MODES_DISPLAY]      = { 0x6061, 0x00,  8, 0, "Modes of operation display" },
+    [SOEM_PDO_POSITION_ACTUAL]    = { 0x6064, 0x00, 32, 1, "Position actual value" },
+    [SOEM_PDO_VELOCITY_ACTUAL]    = { 0x606C, 0x00, 32, 1, "Velocity actual value" },
+    [SOEM_PDO_TORQUE_ACTUAL]      = { 0x6077, 0x00, 16, 1, "Torque actual value" },
+    [SOEM_PDO_TIMESTAMP]          = { 0x20F0, 0x00, 32, 0, "Timestamp" },
+};
+
+static uint32_t pdo_entry(const pdo_object_t *object) {
+    return ((uint32_t)object->index << 16) | ((uint32_t)object->subindex << 8) | object->bits;
+}
+
+static int find_object(uint16_t index, uint8_t subindex, int first, int last) {
+    for (int i = first; i < last; i++) {
+        if (pdo_objects[i].index == index && pdo_objects[i].subindex == subindex) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Programs the RxPDO/TxPDO mapping and assignment of a slave from the object table.
+ */
+int soem_pdo_configure(uint16_t slave_idx) {
+    uint32_t rx_entries[SOEM_PDO_FIRST_INPUT];
+    uint32_t tx_entries[SOEM_PDO_OBJECT_COUNT - SOEM_PDO_FIRST_INPUT];
+    int result = 0;
+
+    for (int i = 0; i < SOEM_PDO_FIRST_INPUT; i++) {
+        rx_entries[i] = pdo_entry(&pdo_objects[i]);
+    }
+    for (int i = SOEM_PDO_FIRST_INPUT; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        tx_entries[i - SOEM_PDO_FIRST_INPUT] = pdo_entry(&pdo_objects[i]);
+    }
+
+    if (soem_interface_configure_pdo_mapping_enhanced(slave_idx, SOEM_PDO_RX_ASSIGN_INDEX, SOEM_PDO_RX_MAP_INDEX,
+                                                      rx_entries, SOEM_PDO_FIRST_INPUT) != 0) {
+        fprintf(stderr, "SOEM_PDO: RxPDO remap of slave %u failed\n", slave_idx);
+        result = -1;
+    }
+    if (soem_interface_configure_pdo_mapping_enhanced(slave_idx, SOEM_PDO_TX_ASSIGN_INDEX, SOEM_PDO_TX_MAP_INDEX,
+                                                      tx_entries, SOEM_PDO_OBJECT_COUNT - SOEM_PDO_FIRST_INPUT) != 0) {
+        fprintf(stderr, "SOEM_PDO: TxPDO remap of slave %u failed\n", slave_idx);
+        result = -1;
+    }
+    return result;
+}
+
+// Every required object must have an offset for the accessors in soem_pdo.h
+static int check_required_objects(const soem_pdo_layout_t *layout) {
+    int result = 0;
+    for (int i = 0; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        if (layout->offset[i] >= 0) continue;
+        if (pdo_objects[i].required) {
+            fprintf(stderr, "SOEM_PDO: Required object %s (0x%04X:0x%02X) is not mapped\n",
+                    pdo_objects[i].name, pdo_objects[i].index, pdo_objects[i].subindex);
+            result = -1;
+        } else {
+            printf("SOEM_PDO: Optional object %s (0x%04X:0x%02X) is not mapped\n",
+                   pdo_objects[i].name, pdo_objects[i].index, pdo_objects[i].subindex);
+        }
+    }
+    return result;
+}
+
+// Walks the PDOs assigned to one sync manager and records the offsets of the known objects
+// in [first, last). Returns the mapped size in bits, or -1 if the readback failed.
+static int read_assigned_layout(uint16_t slave_idx, uint16_t assign_idx, const char *direction,
+                                int first, int last, int32_t *offset) {
+    uint8_t pdo_count = 0;
+    uint32_t bit_offset = 0;
+
+    if (soem_interface_read_sdo(slave_idx, assign_idx, 0x00, sizeof(pdo_count), &pdo_count) != 0) {
+        return -1;
+    }
+    if (pdo_count > PDO_MAX_ASSIGNED) pdo_count = PDO_MAX_ASSIGNED;
+
+    for (uint8_t p = 1; p <= pdo_count; p++) {
+        uint16_t pdo_idx = 0;
+        uint8_t entry_count = 0;
+        if (soem_interface_read_sdo(slave_idx, assign_idx, p, sizeof(pdo_idx), &pdo_idx) != 0 ||
+            soem_interface_read_sdo(slave_idx, pdo_idx, 0x00, sizeof(entry_count), &entry_count) != 0) {
+            return -1;
+        }
+        if (entry_count > PDO_MAX_ENTRIES) entry_count = PDO_MAX_ENTRIES;
+
+        for (uint8_t e = 1; e <= entry_count; e++) {
+            uint32_t entry = 0;
+            if (soem_interface_read_sdo(slave_idx, pdo_idx, e, sizeof(entry), &entry) != 0) {
+                return -1;
+            }
+            uint16_t index = (uint16_t)(entry >> 16);
+            uint8_t subindex = (uint8_t)(entry >> 8);
+            uint8_t bits = (uint8_t)entry;
+            int object = find_object(index, subindex, first, last);
+
+            printf("SOEM_PDO: %s [0x%04X.%u] 0x%04X:0x%02X %2u bits%s%s\n", direction, bit_offset / 8, bit_offset % 8,
+                   index, subindex, bits, object >= 0 ? "  " : "", object >= 0 ? pdo_objects[object].name : "");
+            if (object >= 0) {
+                if (bits != pdo_objects[object].bits) {
+                    fprintf(stderr, "SOEM_PDO: %s is mapped with %u bits, expected %u\n",
+                            pdo_objects[object].name, bits, pdo_objects[object].bits);
+                } else if (bit_offset % 8 != 0) {
+                    fprintf(stderr, "SOEM_PDO: %s is not byte aligned (bit %u)\n", pdo_objects[object].name, bit_offset);
+                } else {
+                    offset[object] = (int32_t)(bit_offset / 8);
+                }
+            }
+            bit_offset += bits;
+        }
+    }
+    return (int)bit_offset;
+}
+
+/**
+ * @brief Reads back the mapping assigned to SM2/SM3 and fills the offset table.
+ */
+int soem_pdo_build_layout(uint16_t slave_idx, uint8_t *outputs, uint32_t output_bytes,
+                          const uint8_t *inputs, uint32_t input_bytes, soem_pdo_layout_t *layout) {
+    layout->outputs = outputs;
+    layout->inputs = inputs;
+    layout->output_bytes = output_bytes;
+    layout->input_bytes = input_bytes;
+    for (int i = 0; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        layout->offset[i] = -1;
+    }
+
+    int output_bits = read_assigned_layout(slave_idx, SOEM_PDO_RX_ASSIGN_INDEX, "out", 0, SOEM_PDO_FIRST_INPUT, layout->offset);
+    int input_bits = read_assigned_layout(slave_idx, SOEM_PDO_TX_ASSIGN_INDEX, "in ", SOEM_PDO_FIRST_INPUT,
+                                          SOEM_PDO_OBJECT_COUNT, layout->offset);
+    if (output_bits < 0 || input_bits < 0) {
+        fprintf(stderr, "SOEM_PDO: Could not read back the PDO mapping of slave %u\n", slave_idx);
+        return -1;
+    }
+
+    // The sync managers were sized by ec_config_map() from the same assignment
+    if ((uint32_t)(output_bits + 7) / 8 != output_bytes || (uint32_t)(input_bits + 7) / 8 != input_bytes) {
+        fprintf(stderr, "SOEM_PDO: Mapping of slave %u is %d/%d bits, process data is %u/%u bytes\n",
+                slave_idx, output_bits, input_bits, output_bytes, input_bytes);
+        return -1;
+    }
+
+    int result = check_required_objects(layout);
+    if (result == 0) {
+        printf("SOEM_PDO: Slave %u layout: %d output bits, %d input bits\n", slave_idx, output_bits, input_bits);
+    }
+    return result;
+}
+
+/**
+ * @brief Fills the layout from offsets read back earlier (soem_config_cache.h).
+ */
+int soem_pdo_apply_layout(uint16_t slave_idx, uint8_t *outputs, uint32_t output_bytes,
+                          const uint8_t *inputs, uint32_t input_bytes, const int32_t *offset,
+                          soem_pdo_layout_t *layout) {
+    layout->outputs = outputs;
+    layout->inputs = inputs;
+    layout->output_bytes = output_bytes;
+    layout->input_bytes = input_bytes;
+    for (int i = 0; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        uint32_t area_bytes = (i < SOEM_PDO_FIRST_INPUT) ? output_bytes : input_bytes;
+        layout->offset[i] = -1;
+        if (offset[i] >= 0 && (uint32_t)offset[i] + pdo_objects[i].bits / 8 <= area_bytes) {
+            layout->offset[i] = offset[i];
+        } else if (offset[i] >= 0) {
+            fprintf(stderr, "SOEM_PDO: %s at byte %d is outside the process data of slave %u\n",
+                    pdo_objects[i].name, offset[i], slave_idx);
+            return -1;
+        }
+    }
+    return check_required_objects(layout);
+}
+
+/**
+ * @brief Extends a configuration hash with the object table.
+ */
+uint32_t soem_pdo_signature(uint32_t hash) {
+    for (int i = 0; i < SOEM_PDO_OBJECT_COUNT; i++) {
+        uint32_t entry = pdo_entry(&pdo_objects[i]);
+        hash = soem_config_cache_hash(hash, &entry, sizeof(entry));
+    }
+    return hash;
+}
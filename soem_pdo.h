@@ -0,0 +1,142 @@
+// soem_pdo.h - Table-driven PDO mapping of the SOMANET drive and offset-table accessors
+//
+// soem_pdo_configure() programs 0x1600/0x1A00 and their assignment 0x1C12/0x1C13 from the
+// object table in soem_pdo.c. After ec_config_map(), soem_pdo_build_layout() reads back the
+// mapping the drive actually uses and records the byte offset of every known object, so the
+// accessors below are single loads/stores at known IOmap offsets whatever the drive mapped.
+// soem_pdo_apply_layout() takes the offsets from the configuration cache instead.
+// The header does not depend on SOEM.
+#ifndef SOEM_PDO_H
+#define SOEM_PDO_H
+
+#include <stdint.h>
+#include <string.h>
+
+// EtherCAT process data is little-endian and the accessors copy it as is
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "soem_pdo accessors assume a little-endian host");
+
+#define SOEM_PDO_RX_MAP_INDEX       0x1600  // RxPDO mapping (master -> drive)
+#define SOEM_PDO_TX_MAP_INDEX       0x1A00  // TxPDO mapping (drive -> master)
+#define SOEM_PDO_RX_ASSIGN_INDEX    0x1C12  // SM2 PDO assignment
+#define SOEM_PDO_TX_ASSIGN_INDEX    0x1C13  // SM3 PDO assignment
+
+// Objects the application exchanges with the drive. Outputs come first.
+typedef enum {
+    SOEM_PDO_CONTROLWORD = 0,       // 0x6040:00 UNSIGNED16
+    SOEM_PDO_MODES_OF_OPERATION,    // 0x6060:00 INTEGER8
+    SOEM_PDO_TARGET_TORQUE,         // 0x6071:00 INTEGER16, per mille of rated torque
+    SOEM_PDO_STATUSWORD,            // 0x6041:00 UNSIGNED16
+    SOEM_PDO_MODES_DISPLAY,         // 0x6061:00 INTEGER8
+    SOEM_PDO_POSITION_ACTUAL,       // 0x6064:00 INTEGER32
+    SOEM_PDO_VELOCITY_ACTUAL,       // 0x606C:00 INTEGER32
+    SOEM_PDO_TORQUE_ACTUAL,         // 0x6077:00 INTEGER16
+    SOEM_PDO_TIMESTAMP,             // 0x20F0:00 UNSIGNED32, drive clock in microseconds (optional)
+    SOEM_PDO_OBJECT_COUNT
+} soem_pdo_object_t;
+
+#define SOEM_PDO_FIRST_INPUT SOEM_PDO_STATUSWORD
+
+typedef struct {
+    uint8_t *outputs;                           // Slave's output area in the IOmap
+    const uint8_t *inputs;                      // Slave's input area in the IOmap
+    uint32_t output_bytes;
+    uint32_t input_bytes;
+    int32_t offset[SOEM_PDO_OBJECT_COUNT];      // Byte offset in outputs/inputs, -1 if not mapped
+} soem_pdo_layout_t;
+
+/**
+ * @brief Programs the RxPDO/TxPDO mapping and assignment of a slave from the object table.
+ *        The slave must be in PRE_OP and ec_config_map() must run afterwards.
+ * @param slave_idx The index of the slave (1-based).
+ * @return 0 on success, -1 if the drive rejected the mapping (it keeps its previous one).
+ */
+int soem_pdo_configure(uint16_t slave_idx);
+
+/**
+ * @brief Reads back the mapping assigned to SM2/SM3 and fills the offset table.
+ *        Fails if a required object is missing, not byte aligned, has an unexpected size,
+ *        or if the mapped sizes do not match the slave's process data sizes.
+ * @param slave_idx The index of the slave (1-based).
+ * @param outputs Slave's output area in the IOmap and its size in bytes.
+ * @param inputs Slave's input area in the IOmap and its size in bytes.
+ * @param layout Destination for the layout.
+ * @return 0 on success, -1 on failure.
+ */
+int soem_pdo_build_layout(uint16_t slave_idx, uint8_t *outputs, uint32_t output_bytes,
+                          const uint8_t *inputs, uint32_t input_bytes, soem_pdo_layout_t *layout);
+
+/**
+ * @brief Fills the layout from offsets read back on an earlier run instead of the drive.
+ *        Fails if a required object is missing or an offset lies outside the process data.
+ * @param slave_idx The index of the slave (1-based), for messages.
+ * @param outputs Slave's output area in the IOmap and its size in bytes.
+ * @param inputs Slave's input area in the IOmap and its size in bytes.
+ * @param offset SOEM_PDO_OBJECT_COUNT byte offsets as in soem_pdo_layout_t.
+ * @param layout Destination for the layout.
+ * @return 0 on success, -1 on failure.
+ */
+int soem_pdo_apply_layout(uint16_t slave_idx, uint8_t *outputs, uint32_t output_bytes,
+                          const uint8_t *inputs, uint32_t input_bytes, const int32_t *offset,
+                          soem_pdo_layout_t *layout);
+
+/**
+ * @brief Extends a configuration hash (soem_config_cache_hash()) with the object table, so a
+ *        cached drive configuration no longer matches once the table changes.
+ */
+uint32_t soem_pdo_signature(uint32_t hash);
+
+/**
+ * @brief Returns 1 if the object is mapped in the layout.
+ */
+static inline int soem_pdo_has(const soem_pdo_layout_t *layout, soem_pdo_object_t object) {
+    return layout->offset[object] >= 0;
+}
+
+// --- Accessors for the required objects (always mapped once soem_pdo_build_layout() succeeded) ---
+
+static inline uint16_t soem_pdo_get_statusword(const soem_pdo_layout_t *layout) {
+    uint16_t value;
+    memcpy(&value, layout->inputs + layout->offset[SOEM_PDO_STATUSWORD], sizeof(value));
+    return value;
+}
+
+static inline int32_t soem_pdo_get_position(const soem_pdo_layout_t *layout) {
+    int32_t value;
+    memcpy(&value, layout->inputs + layout->offset[SOEM_PDO_POSITION_ACTUAL], sizeof(value));
+    return value;
+}
+
+static inline int32_t soem_pdo_get_velocity(const soem_pdo_layout_t *layout) {
+    int32_t value;
+    memcpy(&value, layout->inputs + layout->offset[SOEM_PDO_VELOCITY_ACTUAL], sizeof(value));
+    return value;
+}
+
+static inline int16_t soem_pdo_get_torque_actual(const soem_pdo_layout_t *layout) {
+    int16_t value;
+    memcpy(&value, layout->inputs + layout->offset[SOEM_PDO_TORQUE_ACTUAL], sizeof(value));
+    return value;
+}
+
+// 0x20F0 is optional: returns 0 when the drive does not map it
+static inline uint32_t soem_pdo_get_timestamp(const soem_pdo_layout_t *layout) {
+    uint32_t value = 0;
+    if (layout->offset[SOEM_PDO_TIMESTAMP] >= 0) {
+        memcpy(&value, layout->inputs + layout->offset[SOEM_PDO_TIMESTAMP], sizeof(value));
+    }
+    return value;
+}
+
+static inline void soem_pdo_set_controlword(const soem_pdo_layout_t *layout, uint16_t value) {
+    memcpy(layout->outputs + layout->offset[SOEM_PDO_CONTROLWORD], &value, sizeof(value));
+}
+
+static inline void soem_pdo_set_modes_of_operation(const soem_pdo_layout_t *layout, int8_t value) {
+    memcpy(layout->outputs + layout->offset[SOEM_PDO_MODES_OF_OPERATION], &value, sizeof(value));
+}
+
+static inline void soem_pdo_set_target_torque(const soem_pdo_layout_t *layout, int16_t value) {
+    memcpy(layout->outputs + layout->offset[SOEM_PDO_TARGET_TORQUE], &value, sizeof(value));
+}
+
+#endif // SOEM_PDO_H
@@ -0,0 +1,155 @@
+// soem_safety.c - Deadline supervisor for the torque path (see soem_safety.h)
+#include "soem_safety.h"
+#include "rt_log.h"
+
+#include <math.h>
+
+#define MS_TO_NS(ms) ((uint64_t)(ms) * 1000000ULL)
+
+static const char *const fault_names[SOEM_SAFETY_FAULT_COUNT] = {
+    "HID stale", "engine stale", "WKC lost", "over torque"
+};
+
+static int deadline_passed(uint64_t since_ns, uint64_t now_ns, uint32_t timeout_ms) {
+    return since_ns && now_ns > since_ns && now_ns - since_ns > MS_TO_NS(timeout_ms);
+}
+
+/**
+ * @brief Prepares a supervisor with no faults and full torque.
+ */
+void soem_safety_init(soem_safety_t *safety, const soem_safety_config_t *config, float cycle_s) {
+    safety->scale = 1.0f;
+    safety->active = 0;
+    atomic_store_explicit(&safety->latched, 0, memory_order_relaxed);
+    atomic_store_explicit(&safety->reset_request, 0, memory_order_relaxed);
+    safety->wkc_low_since_ns = 0;
+    safety->engine_update_ns = 0;
+    safety->engine_updates = 0;
+    safety->over_limit_cycles = 0;
+    soem_safety_configure(safety, config, cycle_s);
+}
+
+/**
+ * @brief Changes the deadlines and the ramp while running.
+ */
+void soem_safety_configure(soem_safety_t *safety, const soem_safety_config_t *config, float cycle_s) {
+    safety->config = *config;
+    safety->torque_limit = ffb_torque_from_float(config->torque_limit);
+    safety->ramp_step = config->ramp_ms ? cycle_s * 1000.0f / (float)config->ramp_ms : 1.0f;
+    if (safety->ramp_step > 1.0f) safety->ramp_step = 1.0f;
+}
+
+// Conditions of this cycle, as soem_safety_fault_t bits
+static uint32_t check_conditions(soem_safety_t *safety, const soem_safety_inputs_t *in) {
+    const soem_safety_config_t *config = &safety->config;
+    uint32_t active = 0;
+
+    // Supervised only while the source reports a time: a wheel without a game is not a fault
+    if (config->hid_timeout_ms && deadline_passed(in->hid_activity_ns, in->now_ns, config->hid_timeout_ms)) {
+        active |= SOEM_SAFETY_FAULT_HID_STALE;
+    }
+
+    // Supervised from the first command the engine writes
+    if (in->torque_updates != safety->engine_updates) {
+        safety->engine_updates = in->torque_updates;
+        safety->engine_update_ns = in->now_ns;
+    }
+    if (config->engine_timeout_ms && deadline_passed(safety->engine_update_ns, in->now_ns, config->engine_timeout_ms)) {
+        active |= SOEM_SAFETY_FAULT_ENGINE_STALE;
+    }
+
+    // Time since the last complete frame; a single good frame restarts the deadline
+    if (in->wkc_ok) {
+        safety->wkc_low_since_ns = 0;
+    } else {
+        if (!safety->wkc_low_since_ns) safety->wkc_low_since_ns = in->now_ns;
+        if (in->now_ns - safety->wkc_low_since_ns >= MS_TO_NS(config->wkc_timeout_ms)) {
+            active |= SOEM_SAFETY_FAULT_WKC_LOST;
+        }
+    }
+
+    // A profile switch can hand the new, larger command to the step before the cycle that
+    // takes over its limit, so one cycle beyond the limit is tolerated; NaN never is
+#if FFB_FIXED_POINT
+    int beyond_limit = ffb_sat_abs_s32(in->torque_command) > safety->torque_limit;
+    int not_finite = 0;
+#else
+    int beyond_limit = fabsf(in->torque_command) > safety->torque_limit;
+    int not_finite = !isfinite(in->torque_command);
+#endif
+    if (beyond_limit) {
+        safety->over_limit_cycles++;
+    } else {
+        safety->over_limit_cycles = 0;
+    }
+    if (not_finite || safety->over_limit_cycles > 1) {
+        active |= SOEM_SAFETY_FAULT_OVER_TORQUE;
+    }
+    return active;
+}
+
+// A reset clears the requested faults that are no longer present; the rest stays latched
+static uint32_t handle_reset(uint32_t latched, uint32_t active, uint32_t request) {
+    for (int i = 0; i < SOEM_SAFETY_FAULT_COUNT; i++) {
+        uint32_t fault = 1U << i;
+        if (!(latched & request & fault)) continue;
+        if (active & fault) {
+            RT_LOG(RT_LOG_ERROR, "SOEM_Safety: %s still present, stays latched\n", fault_names[i]);
+        } else {
+            RT_LOG(RT_LOG_INFO, "SOEM_Safety: %s cleared\n", fault_names[i]);
+        }
+    }
+    return latched & (active | ~request);
+}
+
+/**
+ * @brief Checks the deadlines, latches faults and advances the ramp.
+ */
+float soem_safety_step(soem_safety_t *safety, const soem_safety_inputs_t *inputs) {
+    uint32_t active = check_conditions(safety, inputs);
+    uint32_t latched = atomic_load_explicit(&safety->latched, memory_order_relaxed);
+
+    uint32_t request = atomic_exchange_explicit(&safety->reset_request, 0, memory_order_relaxed);
+    if (request) {
+        latched = handle_reset(latched, active, request);
+    }
+
+    uint32_t new_faults = active & ~latched;
+    for (int i = 0; new_faults && i < SOEM_SAFETY_FAULT_COUNT; i++) {
+        uint32_t fault = 1U << i;
+        if (!(new_faults & fault)) continue;
+        if (fault & SOEM_SAFETY_HARD_FAULTS) {
+            RT_LOG(RT_LOG_ERROR, "SOEM_Safety: %s - zero torque and quick stop, reset to resume\n", fault_names[i]);
+        } else {
+            RT_LOG(RT_LOG_ERROR, "SOEM_Safety: %s - ramping torque down over %u ms, reset to resume\n",
+                   fault_names[i], safety->config.ramp_ms);
+        }
+    }
+    latched |= active;
+    safety->active = active;
+    atomic_store_explicit(&safety->latched, latched, memory_order_relaxed);
+
+    // Hard faults cut the torque at once; soft faults and resets ramp. The ends snap within
+    // half a step, so float rounding of ramp_step does not add a cycle to ramp_ms.
+    float half_step = 0.5f * safety->ramp_step;
+    if (latched & SOEM_SAFETY_HARD_FAULTS) {
+        safety->scale = 0.0f;
+    } else if (latched) {
+        float down = safety->scale - safety->ramp_step;
+        safety->scale = down > half_step ? down : 0.0f;
+    } else if (safety->scale < 1.0f) {
+        float up = safety->scale + safety->ramp_step;
+        safety->scale = up < 1.0f - half_step ? up : 1.0f;
+    }
+    return safety->scale;
+}
+
+/**
+ * @brief Returns a short name for one fault bit.
+ */
+const char *soem_safety_fault_name(soem_safety_fault_t fault) {
+    for (int i = 0; i < SOEM_SAFETY_FAULT_COUNT; i++) {
+        if ((uint32_t)fault == 1U << i) return fault_names[i];
+    }
+    return "unknown";
+}
@@ -0,0 +1,124 @@
+// soem_safety.h - Safety supervisor stepped once per EtherCAT cycle
+//
+// Watches deadlines, not loop counts, so the reaction time is the same at every cycle and
+// engine rate:
+//   HID stale     no FFB report from the host for hid_timeout_ms while a constant, ramp or
+//                 periodic effect plays (game crashed, cable pulled, host asleep); condition
+//                 effects alone are not supervised, games send them once
+//   engine stale  no new torque command for engine_timeout_ms (engine stalled or paused)
+//   WKC lost      working counter low for wkc_timeout_ms without a single good frame
+//   over torque   a torque command beyond torque_limit for two cycles, or not a number
+//                 (engine bug, corrupted command)
+// The first two are soft faults: the torque is scaled down to zero over ramp_ms, so the rim
+// does not snap when the game's forces stop. The last two are hard faults: the torque goes
+// to zero at once and every drive gets a CiA 402 quick stop.
+// Faults latch and none clears on its own, not even once its condition is gone.
+// soem_safety_request_reset() clears the chosen ones whose condition is gone, then the torque
+// ramps back up over ramp_ms (main.c: Ctrl+F requests all, SIGUSR2 only engine stale). A step is a handful of comparisons; it neither
+// blocks nor allocates. The header does not depend on SOEM.
+#ifndef SOEM_SAFETY_H
+#define SOEM_SAFETY_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "ffb_fixed.h"
+
+typedef enum {
+    SOEM_SAFETY_FAULT_HID_STALE     = 1 << 0,
+    SOEM_SAFETY_FAULT_ENGINE_STALE  = 1 << 1,
+    SOEM_SAFETY_FAULT_WKC_LOST      = 1 << 2,
+    SOEM_SAFETY_FAULT_OVER_TORQUE   = 1 << 3
+} soem_safety_fault_t;
+
+#define SOEM_SAFETY_FAULT_COUNT     4
+#define SOEM_SAFETY_HARD_FAULTS     (SOEM_SAFETY_FAULT_WKC_LOST | SOEM_SAFETY_FAULT_OVER_TORQUE)
+#define SOEM_SAFETY_ALL_FAULTS      ((1U << SOEM_SAFETY_FAULT_COUNT) - 1)
+
+typedef struct {
+    uint32_t ramp_ms;           // Soft faults and resets ramp the torque over this, 0 = step
+    uint32_t hid_timeout_ms;    // 0 = not supervised
+    uint32_t engine_timeout_ms; // 0 = not supervised
+    uint32_t wkc_timeout_ms;
+    float torque_limit;         // Motor command units, the profile's max_torque plus a margin
+} soem_safety_config_t;
+
+// Same values as ffb_profile_safety_config() gives for FFB_PROFILE_DEFAULT
+#define SOEM_SAFETY_CONFIG_DEFAULT { \
+    .ramp_ms = 50, .hid_timeout_ms = 100, .engine_timeout_ms = 50, .wkc_timeout_ms = 10, \
+    .torque_limit = 5250.0f }
+
+// What the EtherCAT thread saw this cycle
+typedef struct {
+    uint64_t now_ns;            // CLOCK_MONOTONIC time of the cycle
+    uint64_t hid_activity_ns;   // Last FFB report from the host, 0 = not supervised now
+    unsigned int torque_updates; // The wheel's engine command counter
+    ffb_torque_t torque_command; // The wheel's current command
+    int wkc_ok;                 // The frame just received came back complete
+} soem_safety_inputs_t;
+
+// Everything except reset_request and latched is owned by the stepping thread
+typedef struct {
+    soem_safety_config_t config;
+    float ramp_step;                // Scale change per cycle
+    ffb_torque_t torque_limit;      // config.torque_limit in the command's format
+    float scale;                    // Applied to every drive's torque, 0-1
+    uint32_t active;                // Conditions present in the last step
+    _Atomic uint32_t latched;       // Readable from any thread
+    _Atomic uint32_t reset_request; // Faults to clear, set from any thread with soem_safety_request_reset()
+    uint64_t wkc_low_since_ns;      // 0 while frames come back complete
+    uint64_t engine_update_ns;      // Time the command counter last changed, 0 = no command yet
+    unsigned int engine_updates;
+    uint32_t over_limit_cycles;     // Consecutive steps with the command beyond torque_limit
+} soem_safety_t;
+
+/**
+ * @brief Prepares a supervisor with no faults and full torque.
+ * @param safety Supervisor to initialize.
+ * @param config Deadlines and ramp.
+ * @param cycle_s Cycle time it is stepped at, in seconds.
+ */
+void soem_safety_init(soem_safety_t *safety, const soem_safety_config_t *config, float cycle_s);
+
+/**
+ * @brief Changes the deadlines and the ramp while running; latched faults stay.
+ */
+void soem_safety_configure(soem_safety_t *safety, const soem_safety_config_t *config, float cycle_s);
+
+/**
+ * @brief Checks the deadlines, latches faults and advances the ramp. Only one thread may
+ *        step a supervisor (the EtherCAT thread).
+ * @param safety The supervisor.
+ * @param inputs This cycle's frame, HID activity and torque command.
+ * @return Scale (0-1) for the torque of the next frame.
+ */
+float soem_safety_step(soem_safety_t *safety, const soem_safety_inputs_t *inputs);
+
+/**
+ * @brief Returns 1 while a hard fault is latched: the drives must be quick stopped.
+ */
+static inline int soem_safety_quick_stop(const soem_safety_t *safety) {
+    return (atomic_load_explicit(&safety->latched, memory_order_relaxed) & SOEM_SAFETY_HARD_FAULTS) != 0;
+}
+
+/**
+ * @brief Returns the latched faults (soem_safety_fault_t bits). Safe to call from any thread.
+ */
+static inline uint32_t soem_safety_get_faults(const soem_safety_t *safety) {
+    return atomic_load_explicit(&safety->latched, memory_order_relaxed);
+}
+
+/**
+ * @brief Asks the next step to clear the latched faults whose condition is gone. Safe to call
+ *        from any thread; requests before the next step add up.
+ * @param faults soem_safety_fault_t bits to clear, SOEM_SAFETY_ALL_FAULTS for all.
+ */
+static inline void soem_safety_request_reset(soem_safety_t *safety, uint32_t faults) {
+    atomic_fetch_or_explicit(&safety->reset_request, faults, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns a short name for one fault bit.
+ */
+const char *soem_safety_fault_name(soem_safety_fault_t fault);
+
+#endif // SOEM_SAFETY_H
@@ -0,0 +1,190 @@
+// soem_safety_test.c - Checks of the safety supervisor's deadlines, ramps and resets on a simulated clock
+#include "soem_safety.h"
+#include <stdio.h>
+#include <math.h>
+
+#define TEST_CYCLE_NS 1000000ULL   // 1 kHz EtherCAT cycle
+#define TEST_TORQUE_LIMIT 5250.0f
+
+static soem_safety_t safety;
+static soem_safety_inputs_t inputs;
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Fresh supervisor with host and engine alive, no faults
+static void start(void) {
+    soem_safety_config_t config = SOEM_SAFETY_CONFIG_DEFAULT;
+    config.torque_limit = TEST_TORQUE_LIMIT;
+    soem_safety_init(&safety, &config, TEST_CYCLE_NS * 1e-9f);
+    inputs = (soem_safety_inputs_t){ .now_ns = TEST_CYCLE_NS, .wkc_ok = 1 };
+}
+
+// One cycle; the flags say whether the host sent a report, the engine wrote a command and
+// the frame came back complete
+static float cycle(int host_report, int engine_update, int wkc_ok) {
+    inputs.now_ns += TEST_CYCLE_NS;
+    if (host_report) inputs.hid_activity_ns = inputs.now_ns;
+    if (engine_update) inputs.torque_updates++;
+    inputs.wkc_ok = wkc_ok;
+    return soem_safety_step(&safety, &inputs);
+}
+
+// One cycle with a new engine command
+static float step(float torque_command) {
+    inputs.torque_command = ffb_torque_from_float(torque_command);
+    return cycle(1, 1, 1);
+}
+
+// Cycles in a number of milliseconds
+static uint32_t cycles_in(uint32_t ms) {
+    return (uint32_t)(ms * 1000000ULL / TEST_CYCLE_NS);
+}
+
+static void test_limit(void) {
+    start();
+    check(step(TEST_TORQUE_LIMIT) == 1.0f, "a command at the limit keeps full torque");
+    check(step(-TEST_TORQUE_LIMIT - 1.0f) == 1.0f, "one cycle beyond the limit is tolerated");
+    check(step(-TEST_TORQUE_LIMIT - 1.0f) == 0.0f, "two cycles beyond the limit cut the torque");
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_OVER_TORQUE, "over torque latched");
+    check(soem_safety_quick_stop(&safety), "over torque quick stops the drives");
+
+    step(0.0f);
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_OVER_TORQUE, "over torque stays latched");
+    soem_safety_request_reset(&safety, SOEM_SAFETY_FAULT_ENGINE_STALE);
+    step(0.0f);
+    check(soem_safety_quick_stop(&safety), "an engine stale reset leaves over torque latched");
+    soem_safety_request_reset(&safety, SOEM_SAFETY_ALL_FAULTS);
+    step(0.0f);
+    check(soem_safety_get_faults(&safety) == 0 && !soem_safety_quick_stop(&safety), "reset clears over torque");
+}
+
+static void test_spike(void) {
+    start();
+    step(TEST_TORQUE_LIMIT * 2.0f);
+    check(step(0.0f) == 1.0f && soem_safety_get_faults(&safety) == 0, "a single spike is not a fault");
+}
+
+// The integer command has no NaN; a float one that is not finite is never tolerated
+static void test_not_a_number(void) {
+#if !FFB_FIXED_POINT
+    start();
+    check(step(NAN) == 0.0f, "NaN cuts the torque at once");
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_OVER_TORQUE, "NaN latches over torque");
+    start();
+    check(step(INFINITY) == 0.0f, "infinity cuts the torque at once");
+#endif
+}
+
+// No report for exactly the timeout is still in time; one cycle more is a soft fault
+static void test_hid_deadline(void) {
+    start();
+    step(0.0f);
+    for (uint32_t i = 0; i < cycles_in(safety.config.hid_timeout_ms); i++) cycle(0, 1, 1);
+    check(soem_safety_get_faults(&safety) == 0, "no HID report for exactly hid_timeout_ms is no fault");
+    float scale = cycle(0, 1, 1);
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_HID_STALE, "HID stale one cycle later");
+    check(scale > 0.0f && scale < 1.0f && !soem_safety_quick_stop(&safety), "HID stale ramps instead of cutting");
+}
+
+// hid_activity_ns == 0: no game feeding effects, so no deadline however long it stays quiet
+static void test_hid_not_supervised(void) {
+    start();
+    for (uint32_t i = 0; i < 10 * cycles_in(safety.config.hid_timeout_ms); i++) {
+        check(cycle(0, 1, 1) == 1.0f, "an unsupervised host keeps full torque");
+    }
+    check(soem_safety_get_faults(&safety) == 0, "no HID stale without host activity");
+}
+
+static void test_engine_deadline(void) {
+    start();
+    step(0.0f);
+    for (uint32_t i = 0; i < cycles_in(safety.config.engine_timeout_ms); i++) cycle(1, 0, 1);
+    check(soem_safety_get_faults(&safety) == 0, "no engine command for exactly engine_timeout_ms is no fault");
+    cycle(1, 0, 1);
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_ENGINE_STALE, "engine stale one cycle later");
+    check(!soem_safety_quick_stop(&safety), "engine stale does not quick stop");
+}
+
+// Low for wkc_timeout_ms counts from the first low frame; the fault cuts the torque in one step
+static void test_wkc_deadline(void) {
+    start();
+    step(0.0f);
+    for (uint32_t i = 0; i < cycles_in(safety.config.wkc_timeout_ms) - 1; i++) cycle(1, 1, 0);
+    check(cycle(1, 1, 1) == 1.0f, "a single good frame restarts the WKC deadline");
+    for (uint32_t i = 0; i < cycles_in(safety.config.wkc_timeout_ms); i++) {
+        check(cycle(1, 1, 0) == 1.0f, "low WKC short of wkc_timeout_ms keeps full torque");
+    }
+    check(cycle(1, 1, 0) == 0.0f, "WKC lost cuts the torque in one step");
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_WKC_LOST && soem_safety_quick_stop(&safety),
+          "WKC lost latches and quick stops");
+    check(step(0.0f) == 0.0f, "WKC lost stays latched once frames are back");
+}
+
+// A soft fault reaches zero after ramp_ms, a reset is refused while the condition is present,
+// and the torque ramps back up over ramp_ms once it is accepted
+static void test_ramp_and_reset(void) {
+    start();
+    uint32_t ramp_cycles = cycles_in(safety.config.ramp_ms);
+    step(0.0f);
+    for (uint32_t i = 0; i < cycles_in(safety.config.engine_timeout_ms); i++) cycle(1, 0, 1);
+    uint32_t steps = 0;
+    float scale = 1.0f;
+    while (scale > 0.0f && steps <= ramp_cycles) {
+        scale = cycle(1, 0, 1);
+        steps++;
+    }
+    check(steps == ramp_cycles, "a soft fault ramps to zero in ramp_ms");
+
+    soem_safety_request_reset(&safety, SOEM_SAFETY_ALL_FAULTS);
+    check(cycle(1, 0, 1) == 0.0f && soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_ENGINE_STALE,
+          "a reset is refused while the engine is still stale");
+    check(step(0.0f) == 0.0f, "a refused reset is not retried when the condition goes");
+
+    soem_safety_request_reset(&safety, SOEM_SAFETY_ALL_FAULTS);
+    steps = 0;
+    scale = 0.0f;
+    while (scale < 1.0f && steps <= ramp_cycles) {
+        scale = step(0.0f);
+        steps++;
+    }
+    check(soem_safety_get_faults(&safety) == 0, "the reset clears engine stale once commands are back");
+    check(steps == ramp_cycles, "the torque ramps back up in ramp_ms");
+}
+
+// SIGUSR2 resets only engine stale; Ctrl+F resets everything whose condition is gone
+static void test_selective_reset(void) {
+    start();
+    step(0.0f);
+    uint32_t quiet = cycles_in(safety.config.hid_timeout_ms) + 1;
+    for (uint32_t i = 0; i < quiet; i++) cycle(0, 0, 1);
+    check(soem_safety_get_faults(&safety) == (SOEM_SAFETY_FAULT_HID_STALE | SOEM_SAFETY_FAULT_ENGINE_STALE),
+          "host and engine stale latched together");
+
+    soem_safety_request_reset(&safety, SOEM_SAFETY_FAULT_ENGINE_STALE);
+    step(0.0f);
+    check(soem_safety_get_faults(&safety) == SOEM_SAFETY_FAULT_HID_STALE, "an engine stale reset leaves HID stale");
+    check(step(0.0f) == 0.0f, "HID stale keeps the torque at zero");
+
+    soem_safety_request_reset(&safety, SOEM_SAFETY_ALL_FAULTS);
+    check(step(0.0f) > 0.0f && soem_safety_get_faults(&safety) == 0, "a full reset clears HID stale and ramps up");
+}
+
+int main(void) {
+    test_hid_deadline();
+    test_hid_not_supervised();
+    test_engine_deadline();
+    test_wkc_deadline();
+    test_ramp_and_reset();
+    test_selective_reset();
+    test_limit();
+    test_spike();
+    test_not_a_number();
+    printf("soem_safety_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,486 @@
+// telemetry.c - SPSC record ring filled by the control loop, drained into mmap'd log segments
+// by a low-priority thread
+#include "telemetry.h"
+#include "rt_threads.h"
+#include "rt_arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#if (TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) != 0
+#error "TELEMETRY_RING_SIZE must be a power of two"
+#endif
+
+_Static_assert(sizeof(telemetry_record_t) == 48, "telemetry_record_t is part of the file format");
+_Static_assert(sizeof(telemetry_block_header_t) == 32, "telemetry_block_header_t is part of the file format");
+_Static_assert(sizeof(telemetry_segment_header_t) == 64, "telemetry_segment_header_t is part of the file format");
+
+#define TELEMETRY_WINDOW_BLOCKS 256        // Blocks mapped at a time (1 MiB)
+#define TELEMETRY_WRITER_PERIOD_MS 100     // Writer wakeup period
+#define TELEMETRY_FLUSH_INTERVAL_MS 1000   // Longest time a record waits for the disk
+#define TELEMETRY_BLOCKS_PER_SEGMENT \
+    ((TELEMETRY_SEGMENT_SIZE - TELEMETRY_SEGMENT_HEADER_SIZE) / TELEMETRY_BLOCK_SIZE)
+#define TELEMETRY_MAX_SEGMENTS (TELEMETRY_DISK_CAP / TELEMETRY_SEGMENT_SIZE + 1)
+
+static telemetry_record_t *ring = NULL;   // TELEMETRY_RING_SIZE records in the arena
+static atomic_uint ring_head; // Next record to write out (written by the writer thread)
+static atomic_uint ring_tail; // Next record to fill (written by the producer)
+
+static atomic_uint queued_count;
+static atomic_uint dropped_count;
+static atomic_uint written_count;
+static atomic_int telemetry_running = 0;
+
+static pthread_t writer_thread;
+
+// Everything below is owned by the writer thread once it runs.
+// The control threads never touch the mappings: the windows are created with MAP_POPULATE
+// here (and locked by mlockall(MCL_FUTURE) when the application uses it), so page faults
+// and the cost of remapping stay in this thread.
+static char segment_base[256];
+static long page_size = 4096;
+static int segment_fd = -1;                       // -1 while no segment is open (records are dropped)
+static uint32_t segment_number = 0;
+static telemetry_segment_header_t *segment_header = NULL;
+static uint64_t *segment_index = NULL;            // Follows the header in the same mapping
+static uint32_t index_stride = 1;
+static uint8_t *window = NULL;                    // Blocks [window_first, window_first + window_blocks)
+static uint32_t window_first = 0;
+static uint32_t window_blocks = 0;
+static uint32_t segment_block = 0;                // Block being filled
+static uint32_t block_sequence = 0;
+static uint32_t pending_records = 0;              // In finished blocks that are not committed yet
+static uint64_t pending_last_timestamp = 0;
+static uint64_t segment_opened_ms = 0;
+static uint64_t start_time_ns = 0;
+
+// Segments of this recording still on disk, oldest first, for the disk usage cap
+static uint32_t retained_segment[TELEMETRY_MAX_SEGMENTS];
+static uint64_t retained_bytes[TELEMETRY_MAX_SEGMENTS];
+static uint32_t retained_first = 0;
+static uint32_t retained_count = 0;
+static uint64_t retained_total = 0;
+
+static uint32_t crc_table[256];
+static int crc_table_ready = 0;
+
+static uint64_t timespec_to_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+static uint64_t get_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespec_to_ns(&ts) / 1000000ULL;
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, reflected) used for the block payload checksum.
+ */
+uint32_t telemetry_crc32(const void *data, size_t length) {
+    if (!crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crc_table[i] = c;
+        }
+        crc_table_ready = 1;
+    }
+
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void segment_path(char *path, size_t size, uint32_t number) {
+    snprintf(path, size, "%s_%04u.ffbt", segment_base, number);
+}
+
+static telemetry_block_header_t *current_block(void) {
+    return (telemetry_block_header_t *)(window + (size_t)(segment_block - window_first) * TELEMETRY_BLOCK_SIZE);
+}
+
+static void start_block(void) {
+    telemetry_block_header_t *header = current_block();
+    memset(header, 0, TELEMETRY_BLOCK_SIZE);
+    header->magic = TELEMETRY_BLOCK_MAGIC;
+    header->version = TELEMETRY_FORMAT_VERSION;
+    header->record_size = sizeof(telemetry_record_t);
+    header->block_sequence = block_sequence;
+    header->start_time_ns = start_time_ns;
+}
+
+static int map_window(uint32_t first_block) {
+    if (window) {
+        munmap(window, (size_t)window_blocks * TELEMETRY_BLOCK_SIZE);
+        window = NULL;
+    }
+    window_first = first_block;
+    window_blocks = TELEMETRY_BLOCKS_PER_SEGMENT - first_block;
+    if (window_blocks > TELEMETRY_WINDOW_BLOCKS) window_blocks = TELEMETRY_WINDOW_BLOCKS;
+
+    void *map = mmap(NULL, (size_t)window_blocks * TELEMETRY_BLOCK_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, segment_fd,
+                     TELEMETRY_SEGMENT_HEADER_SIZE + (off_t)first_block * TELEMETRY_BLOCK_SIZE);
+    if (map == MAP_FAILED) {
+        perror("Telemetry: failed to map log window");
+        return -1;
+    }
+    window = map;
+    return 0;
+}
+
+// Makes the finished blocks durable, then advances committed_blocks past them
+static void commit_segment(void) {
+    uint32_t committed = segment_header->committed_blocks;
+    if (segment_block == committed) {
+        return;
+    }
+
+    size_t offset = (size_t)(committed - window_first) * TELEMETRY_BLOCK_SIZE;
+    size_t aligned = offset & ~((size_t)page_size - 1);
+    size_t end = (size_t)(segment_block - window_first) * TELEMETRY_BLOCK_SIZE;
+    if (msync(window + aligned, end - aligned, MS_SYNC) != 0) {
+        perror("Telemetry: msync failed");
+    }
+
+    segment_header->committed_blocks = segment_block;
+    segment_header->last_timestamp_ns = pending_last_timestamp;
+    msync(segment_header, TELEMETRY_SEGMENT_HEADER_SIZE, MS_ASYNC);
+
+    atomic_fetch_add_explicit(&written_count, pending_records, memory_order_relaxed);
+    pending_records = 0;
+}
+
+static void close_segment(void) {
+    if (segment_fd < 0) {
+        return;
+    }
+    commit_segment();
+    segment_header->closed = 1;
+    msync(segment_header, TELEMETRY_SEGMENT_HEADER_SIZE, MS_SYNC);
+
+    munmap(window, (size_t)window_blocks * TELEMETRY_BLOCK_SIZE);
+    munmap(segment_header, TELEMETRY_SEGMENT_HEADER_SIZE);
+    window = NULL;
+    segment_header = NULL;
+    segment_index = NULL;
+
+    // Give the unused part of the preallocation back
+    uint64_t used = TELEMETRY_SEGMENT_HEADER_SIZE + (uint64_t)segment_block * TELEMETRY_BLOCK_SIZE;
+    if (ftruncate(segment_fd, (off_t)used) == 0) {
+        uint32_t last = (retained_first + retained_count - 1) % TELEMETRY_MAX_SEGMENTS;
+        retained_total -= retained_bytes[last] - used;
+        retained_bytes[last] = used;
+    }
+    fsync(segment_fd);
+    close(segment_fd);
+    segment_fd = -1;
+}
+
+// Deletes the oldest segments of this recording until a new one fits under the cap
+static void enforce_disk_cap(void) {
+    char path[sizeof(segment_base) + 16];
+    while (retained_count > 0 &&
+           (retained_total + TELEMETRY_SEGMENT_SIZE > TELEMETRY_DISK_CAP || retained_count == TELEMETRY_MAX_SEGMENTS)) {
+        segment_path(path, sizeof(path), retained_segment[retained_first]);
+        if (unlink(path) != 0 && errno != ENOENT) {
+            perror("Telemetry: failed to delete old segment");
+        } else {
+            printf("Telemetry: disk cap reached, deleted %s\n", path);
+        }
+        retained_total -= retained_bytes[retained_first];
+        retained_first = (retained_first + 1) % TELEMETRY_MAX_SEGMENTS;
+        retained_count--;
+    }
+}
+
+static int open_segment(void) {
+    char path[sizeof(segment_base) + 16];
+    uint32_t number = segment_number++;
+
+    enforce_disk_cap();
+    segment_path(path, sizeof(path), number);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Telemetry: failed to create log segment");
+        return -1;
+    }
+    // Reserve the whole segment now: writes through the mapping can then never hit ENOSPC
+    // (which would arrive as SIGBUS) and the file stays contiguous on the SD card
+    int ret = posix_fallocate(fd, 0, TELEMETRY_SEGMENT_SIZE);
+    if (ret != 0) {
+        fprintf(stderr, "Telemetry: failed to preallocate %s: %s\n", path, strerror(ret));
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    void *map = mmap(NULL, TELEMETRY_SEGMENT_HEADER_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("Telemetry: failed to map segment header");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    segment_fd = fd;
+    segment_header = map;
+    segment_index = (uint64_t *)(segment_header + 1);
+    segment_block = 0;
+
+    index_stride = 1;
+    while (TELEMETRY_BLOCKS_PER_SEGMENT / index_stride > TELEMETRY_SEGMENT_INDEX_ENTRIES) {
+        index_stride <<= 1;
+    }
+
+    memset(segment_header, 0, sizeof(*segment_header));
+    segment_header->magic = TELEMETRY_SEGMENT_MAGIC;
+    segment_header->version = TELEMETRY_FORMAT_VERSION;
+    segment_header->header_size = TELEMETRY_SEGMENT_HEADER_SIZE;
+    segment_header->segment_index = number;
+    segment_header->block_capacity = TELEMETRY_BLOCKS_PER_SEGMENT;
+    segment_header->index_stride = index_stride;
+    segment_header->start_time_ns = start_time_ns;
+
+    if (map_window(0) != 0) {
+        munmap(segment_header, TELEMETRY_SEGMENT_HEADER_SIZE);
+        segment_header = NULL;
+        segment_index = NULL;
+        close(fd);
+        unlink(path);
+        segment_fd = -1;
+        return -1;
+    }
+
+    uint32_t slot = (retained_first + retained_count) % TELEMETRY_MAX_SEGMENTS;
+    retained_segment[slot] = number;
+    retained_bytes[slot] = TELEMETRY_SEGMENT_SIZE;
+    retained_count++;
+    retained_total += TELEMETRY_SEGMENT_SIZE;
+
+    segment_opened_ms = get_monotonic_ms();
+    start_block();
+    return 0;
+}
+
+static void rotate_segment(void) {
+    close_segment();
+    if (open_segment() != 0) {
+        fprintf(stderr, "Telemetry: no log segment, further records are dropped\n");
+    }
+}
+
+// Seals the current block and moves to the next one, rotating or remapping as needed
+static void finish_block(void) {
+    telemetry_block_header_t *header = current_block();
+    const telemetry_record_t *records = (const telemetry_record_t *)(header + 1);
+
+    header->dropped_total = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    header->crc32 = telemetry_crc32(records, (size_t)header->record_count * sizeof(telemetry_record_t));
+
+    if (segment_block == 0) {
+        segment_header->first_timestamp_ns = records[0].timestamp_ns;
+    }
+    if ((segment_block & (index_stride - 1)) == 0) {
+        uint32_t entry = segment_block / index_stride;
+        segment_index[entry] = records[0].timestamp_ns;
+        segment_header->index_count = entry + 1;
+    }
+    pending_records += header->record_count;
+    pending_last_timestamp = records[header->record_count - 1].timestamp_ns;
+    segment_block++;
+    block_sequence++;
+
+    if (segment_block == TELEMETRY_BLOCKS_PER_SEGMENT) {
+        rotate_segment();
+        return;
+    }
+    if (segment_block - window_first == window_blocks) {
+        commit_segment();
+        if (map_window(segment_block) != 0) {
+            close_segment();
+            fprintf(stderr, "Telemetry: log segment unusable, further records are dropped\n");
+            return;
+        }
+    }
+    start_block();
+}
+
+// Moves queued records into blocks; returns once the ring is empty
+static void drain_ring(void) {
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+
+    if (segment_fd < 0) {
+        atomic_fetch_add_explicit(&dropped_count, tail - head, memory_order_relaxed);
+        atomic_store_explicit(&ring_head, tail, memory_order_release);
+        return;
+    }
+
+    while (head != tail && segment_fd >= 0) {
+        telemetry_block_header_t *header = current_block();
+        telemetry_record_t *records = (telemetry_record_t *)(header + 1);
+        records[header->record_count++] = ring[head & (TELEMETRY_RING_SIZE - 1)];
+        head++;
+
+        if (header->record_count == TELEMETRY_RECORDS_PER_BLOCK) {
+            // Release the slots before a possible msync or rotation so the producer can keep going
+            atomic_store_explicit(&ring_head, head, memory_order_release);
+            finish_block();
+        }
+    }
+    atomic_store_explicit(&ring_head, head, memory_order_release);
+}
+
+// Commits everything drained so far, including the partially filled block
+static void flush_blocks(void) {
+    if (segment_fd < 0) {
+        return;
+    }
+    if (current_block()->record_count > 0) {
+        finish_block();
+    }
+    if (segment_fd >= 0) {
+        commit_segment();
+    }
+}
+
+static void *telemetry_writer_thread(void *arg) {
+    (void)arg;
+    uint64_t last_flush_ms = get_monotonic_ms();
+    struct timespec period = { 0, TELEMETRY_WRITER_PERIOD_MS * 1000000L };
+
+    while (atomic_load(&telemetry_running)) {
+        nanosleep(&period, NULL);
+        drain_ring();
+
+        uint64_t now_ms = get_monotonic_ms();
+        if (now_ms - last_flush_ms >= TELEMETRY_FLUSH_INTERVAL_MS) {
+            flush_blocks();
+            last_flush_ms = now_ms;
+            if (segment_fd >= 0 && segment_block > 0 &&
+                now_ms - segment_opened_ms >= TELEMETRY_SEGMENT_MAX_SECONDS * 1000ULL) {
+                rotate_segment();
+            }
+        }
+    }
+
+    // Producer has stopped; write out the rest
+    drain_ring();
+    flush_blocks();
+    close_segment();
+    return NULL;
+}
+
+/**
+ * @brief Creates the first log segment and the background writer thread.
+ */
+int telemetry_init(const char *base_path) {
+    struct timespec ts;
+
+    if (strlen(base_path) >= sizeof(segment_base)) {
+        fprintf(stderr, "Telemetry: log path too long\n");
+        return -1;
+    }
+    strcpy(segment_base, base_path);
+    if (!ring) {
+        ring = rt_arena_alloc(TELEMETRY_RING_SIZE * sizeof(*ring), "telemetry ring");
+    }
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || TELEMETRY_SEGMENT_HEADER_SIZE % page_size != 0) {
+        fprintf(stderr, "Telemetry: unsupported page size %ld\n", page_size);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    start_time_ns = timespec_to_ns(&ts);
+    segment_number = 0;
+    block_sequence = 0;
+    pending_records = 0;
+    retained_first = retained_count = 0;
+    retained_total = 0;
+
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    atomic_store(&queued_count, 0);
+    atomic_store(&dropped_count, 0);
+    atomic_store(&written_count, 0);
+
+    if (open_segment() != 0) {
+        return -1;
+    }
+    atomic_store(&telemetry_running, 1);
+
+    // The writer must never compete with the control threads: background role, SCHED_OTHER
+    int ret = rt_threads_create(RT_THREAD_BACKGROUND, &writer_thread, telemetry_writer_thread, NULL);
+    if (ret != 0) {
+        fprintf(stderr, "Telemetry: failed to create writer thread: %s\n", strerror(ret));
+        atomic_store(&telemetry_running, 0);
+        close_segment();
+        return -1;
+    }
+
+    printf("Telemetry: logging to %s_NNNN.ffbt (%u MiB segments, %u s rotation, %llu MiB cap)\n",
+           segment_base, TELEMETRY_SEGMENT_SIZE >> 20, TELEMETRY_SEGMENT_MAX_SECONDS,
+           (unsigned long long)(TELEMETRY_DISK_CAP >> 20));
+    return 0;
+}
+
+/**
+ * @brief Queues one record (single producer).
+ */
+int telemetry_push(const telemetry_record_t *record) {
+    if (!atomic_load_explicit(&telemetry_running, memory_order_relaxed)) {
+        return -1;
+    }
+
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    if (tail - head >= TELEMETRY_RING_SIZE) {
+        atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    telemetry_record_t *slot = &ring[tail & (TELEMETRY_RING_SIZE - 1)];
+    *slot = *record;
+    slot->sequence = atomic_fetch_add_explicit(&queued_count, 1, memory_order_relaxed);
+    atomic_store_explicit(&ring_tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * @brief Writes out everything still queued, stops the writer thread and closes the segment.
+ */
+void telemetry_cleanup(void) {
+    if (!atomic_exchange(&telemetry_running, 0)) {
+        return;
+    }
+    pthread_join(writer_thread, NULL);
+
+    printf("Telemetry: closed, %u records written, %u dropped, %u segments\n",
+           atomic_load(&written_count), atomic_load(&dropped_count), segment_number);
+}
+
+/**
+ * @brief Returns the records queued, dropped and written to disk since telemetry_init().
+ */
+void telemetry_get_stats(uint32_t *queued, uint32_t *dropped, uint32_t *written) {
+    if (queued) *queued = atomic_load_explicit(&queued_count, memory_order_relaxed);
+    if (dropped) *dropped = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    if (written) *written = atomic_load_explicit(&written_count, memory_order_relaxed);
+}
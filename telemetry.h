@@ -0,0 +1,113 @@
+// telemetry.h - Binary telemetry recording: lock-free ring on the control path, segmented mmap log
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Ring capacity in records (power of two); about 80 s of the 100 Hz main loop
+#define TELEMETRY_RING_SIZE 8192
+
+// A recording is a series of segment files <base>_NNNN.ffbt. Each segment is preallocated
+// to TELEMETRY_SEGMENT_SIZE and starts with a TELEMETRY_SEGMENT_HEADER_SIZE header holding
+// the segment header and a timestamp index, followed by TELEMETRY_BLOCK_SIZE blocks. A block
+// is a block header followed by record_count records. Blocks carry their own CRC, so after a
+// crash everything up to the last complete block can be recovered.
+#define TELEMETRY_BLOCK_SIZE 4096
+#define TELEMETRY_BLOCK_MAGIC 0x54424646u   // "FFBT" little endian
+#define TELEMETRY_SEGMENT_MAGIC 0x53424646u // "FFBS" little endian
+#define TELEMETRY_FORMAT_VERSION 2
+#define TELEMETRY_SEGMENT_HEADER_SIZE 65536 // Multiple of every supported page size
+
+// Rotation and retention
+#define TELEMETRY_SEGMENT_SIZE (32u * 1024 * 1024)      // Bytes per segment file
+#define TELEMETRY_SEGMENT_MAX_SECONDS 600               // Start a new segment at least this often
+#define TELEMETRY_DISK_CAP (1024ull * 1024 * 1024)      // Oldest segments of the recording are deleted beyond this
+
+// telemetry_record_t.status bits
+#define TELEMETRY_STATUS_EMERGENCY_STOP 0x0001
+#define TELEMETRY_STATUS_ETHERCAT_OK    0x0002
+#define TELEMETRY_STATUS_HID_OK         0x0004
+#define TELEMETRY_STATUS_PAUSED         0x0008
+
+typedef struct {
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC
+    uint32_t sequence;          // Record number since telemetry_init()
+    uint16_t status;            // TELEMETRY_STATUS_* bits
+    uint8_t effects_applied;    // Effect operations applied this cycle
+    uint8_t last_report_id;     // Report of the last operation applied this cycle, 0 if none
+    float position_deg;
+    float velocity;
+    float torque;               // Torque after the safety checks
+    float last_magnitude;       // Magnitude of the last operation applied this cycle
+    uint64_t active_mask;       // Playing effect blocks (bit i = effect block i + 1)
+    uint32_t reserved[2];
+} telemetry_record_t;
+
+typedef struct {
+    uint32_t magic;             // TELEMETRY_BLOCK_MAGIC
+    uint16_t version;           // TELEMETRY_FORMAT_VERSION
+    uint16_t record_size;       // sizeof(telemetry_record_t)
+    uint32_t block_sequence;    // Block number within the recording
+    uint16_t record_count;
+    uint16_t flags;             // Reserved, 0
+    uint32_t dropped_total;     // Records lost to a full ring before this block
+    uint32_t crc32;             // CRC-32 (IEEE) of the record_count records
+    uint64_t start_time_ns;     // CLOCK_REALTIME at telemetry_init(), to place monotonic stamps
+} telemetry_block_header_t;
+
+#define TELEMETRY_RECORDS_PER_BLOCK \
+    ((TELEMETRY_BLOCK_SIZE - sizeof(telemetry_block_header_t)) / sizeof(telemetry_record_t))
+
+// First bytes of every segment, followed by index[index_count] up to TELEMETRY_SEGMENT_HEADER_SIZE
+typedef struct {
+    uint32_t magic;             // TELEMETRY_SEGMENT_MAGIC
+    uint16_t version;           // TELEMETRY_FORMAT_VERSION
+    uint16_t reserved0;
+    uint32_t header_size;       // Offset of block 0 (TELEMETRY_SEGMENT_HEADER_SIZE)
+    uint32_t segment_index;     // Segment number within the recording
+    uint32_t block_capacity;    // Blocks the preallocated segment can hold
+    uint32_t committed_blocks;  // Blocks known to be on disk; later blocks may be incomplete
+    uint32_t index_stride;      // Blocks per index entry (power of two)
+    uint32_t index_count;       // Valid index entries
+    uint64_t start_time_ns;     // CLOCK_REALTIME at telemetry_init()
+    uint64_t first_timestamp_ns; // First record of the segment (CLOCK_MONOTONIC), 0 if empty
+    uint64_t last_timestamp_ns;  // Last committed record
+    uint32_t closed;            // 1 once the writer rotated away from or closed the segment
+    uint32_t reserved1;
+} telemetry_segment_header_t;
+
+// index[i] = timestamp of the first record of block i * index_stride
+#define TELEMETRY_SEGMENT_INDEX_ENTRIES \
+    ((TELEMETRY_SEGMENT_HEADER_SIZE - sizeof(telemetry_segment_header_t)) / sizeof(uint64_t))
+
+/**
+ * @brief Creates the first log segment and the background writer thread.
+ * @param base_path Segment files are named <base_path>_NNNN.ffbt.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_init(const char *base_path);
+
+/**
+ * @brief Queues one record (single producer). Never blocks and never allocates;
+ *        sequence is filled in here. A full ring drops the record and counts it.
+ * @return 0 if queued, -1 if dropped or telemetry is not running.
+ */
+int telemetry_push(const telemetry_record_t *record);
+
+/**
+ * @brief Writes out everything still queued, stops the writer thread and closes the segment.
+ */
+void telemetry_cleanup(void);
+
+/**
+ * @brief Returns the records queued, dropped and written to disk since telemetry_init().
+ */
+void telemetry_get_stats(uint32_t *queued, uint32_t *dropped, uint32_t *written);
+
+/**
+ * @brief CRC-32 (IEEE 802.3, reflected) used for the block payload checksum.
+ */
+uint32_t telemetry_crc32(const void *data, size_t length);
+
+#endif // TELEMETRY_H